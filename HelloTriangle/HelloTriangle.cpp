@@ -2,6 +2,7 @@
 
 void HelloTriangleApplication::run()
 {
+	startupBegin = FrameClock::now();
 	initWindow(); // for GLFW
 
 	if (initVulkan() != OK) {
@@ -9,9 +10,7 @@ void HelloTriangleApplication::run()
 	}
 	else 
 	{
-		#ifdef DEBUG 
-			printf("DEBUG: Extensions enabled! Starting application.\n");
-		#endif 
+		LOG_DEBUG("Extensions enabled! Starting application.\n");
 
 		mainLoop();
 	}
@@ -22,10 +21,16 @@ void HelloTriangleApplication::run()
 // * MAIN * // 		
 void HelloTriangleApplication::mainLoop()
 {
-	while (!glfwWindowShouldClose(window))
+	lastLatencyReport = FrameClock::now();
+	// closing any window ends the app
+	auto closing = [this]() {
+		for(WindowTarget& target : windows)
+			if(glfwWindowShouldClose(target.window)) return true;
+		return false;
+	};
+	while (!closing())
 	{
-		glfwPollEvents();
-		drawFrame();
+		drawFrame(); // polls events itself, as late as possible
 	}
 	// cleanup and end
 	vkDeviceWaitIdle(device);
@@ -33,41 +38,222 @@ void HelloTriangleApplication::mainLoop()
 
 void HelloTriangleApplication::drawFrame()
 {
-	uint32_t imageIndex;
+	// pace first: everything after this point should run back to back
+	if(latencyMode == LATENCY_FIFO && presentWaitEnabled && presentId > 0)
+		collectPresents(PRESENT_WAIT_TIMEOUT); // previous frame is on screen, queue is empty
+	frameLimiter.wait();
+
+	// don't reuse this frame's acquire semaphores or upload buffers until the GPU is done with them
+	graphicsTimeline.wait(frameValues[currentFrame]);
+	// so are the culling counters its last frame wrote
+	if(occlusionEnabled && frameValues[currentFrame] != 0)
+	{
+		OcclusionStats culled = culler.readStats((uint32_t)currentFrame);
+		cullTotals.visible += culled.visible;
+		cullTotals.late += culled.late;
+		cullTotals.frustumCulled += culled.frustumCulled;
+		cullTotals.occluded += culled.occluded;
+		cullTotals.triangles += culled.triangles;
+		cullFrames++;
+		LOG_TRACE("culling: %u visible, %u late, %u outside the frustum, %u occluded, %u triangles\n", culled.visible, \
+			culled.late, culled.frustumCulled, culled.occluded, culled.triangles);
+	}
+	// anything released by frames that have retired can go, and finished captures go to the encoder; this never blocks
+	uint64_t completed = graphicsTimeline.completed();
+	deletionQueue.collect(completed);
+	frameCapture.poll(completed);
+	deletionQueue.setCurrent(graphicsTimeline.nextValue());
 	// logical device and swapchain from which we get the image
 	// timeout in nanoseconds, or max to disable timeout
 	// signaled sempahore and signaled fence
 	// finally output variable of swapchain image array index that is now available
-	vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-	// configure queue to wait for color writing on imageavailable
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-	// there are 1 cmd buffer
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-	// configure which semaphore to signal when render is finished
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
-	if(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE)!=VK_SUCCESS)
-		throw std::runtime_error("Failed to submit draw command buffer!\n");
+	for(WindowTarget& target : windows)
+	{
+		vkd.acquireNextImage(device, target.swapChain, UINT64_MAX, target.imageAvailableSemaphores[currentFrame], \
+			VK_NULL_HANDLE, &target.imageIndex);
+		// the image's command buffer may still be executing for an older frame
+		graphicsTimeline.wait(target.imageValues[target.imageIndex]);
+	}
+
+	// sample input only now, right before the frame's data is built and submitted
+	glfwPollEvents();
+	FrameClock::time_point inputSampled = FrameClock::now();
+	bool screenshotKey = false;
+	for(WindowTarget& target : windows) screenshotKey |= glfwGetKey(target.window, GLFW_KEY_F12) == GLFW_PRESS;
+	if(screenshotKey && !screenshotKeyDown) frameCapture.requestScreenshot();
+	screenshotKeyDown = screenshotKey;
+	// the frame's CPU work as jobs: the transform upload runs next to the sprite simulation and batch,
+	// then every window is recorded on its own (each has its own command pool)
+	JobCounter transformsUploaded;
+	auto uploadTransforms = [this](uint32_t, uint32_t) {
+		// rebuild dirty world matrices and write the changed ones into this frame's upload buffer
+		sceneTransforms.update();
+		sceneTransforms.upload((uint32_t)currentFrame, (glm::mat4*)transformBuffersMapped[currentFrame]);
+	};
+	jobs.run(uploadTransforms, transformsUploaded);
+	// sprites are streamed into the frame's vertex region and the culling camera moves,
+	// so the commands change with them
+	if(occlusionEnabled) updateCamera();
+	if(spritesEnabled) updateSprites();
+	if(spritesEnabled || occlusionEnabled)
+	{
+		JobCounter recorded;
+		auto recordWindows = [this](uint32_t begin, uint32_t end) {
+			for(uint32_t w = begin; w < end; w++) recordCommandBuffer(windows[w], windows[w].imageIndex);
+		};
+		jobs.parallelFor((uint32_t)windows.size(), 1, recordWindows, recorded);
+		jobs.wait(recorded);
+	}
+	jobs.wait(transformsUploaded);
+	// one submit for every window: wait for each acquired image before writing color, and for
+	// the mesh upload before fetching vertices; signal the binary semaphores present needs plus
+	// the next graphics timeline value. A captured frame's copy rides along in the same submit
+	VkCommandBuffer frameCommands[MAX_WINDOWS + 1];
+	TimelineSubmit submit;
+	for(WindowTarget& target : windows)
+	{
+		frameCommands[submit.commandBufferCount++] = target.commandBuffers[target.imageIndex];
+		submit.waitBinary(target.imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		submit.signalBinary(target.renderFinishedSemaphores[target.imageIndex]);
+	}
+	VkCommandBuffer captureCommands = VK_NULL_HANDLE;
+	if(frameCapture.wantsFrame()) captureCommands = frameCapture.record(windows[0].images[windows[0].imageIndex]);
+	if(captureCommands != VK_NULL_HANDLE) frameCommands[submit.commandBufferCount++] = captureCommands;
+	submit.commandBuffers = frameCommands;
+	submit.wait(graphicsTimeline, meshUploadValue, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	uint64_t frameValue = graphicsTimeline.submit(submit);
+	frameValues[currentFrame] = frameValue;
+	for(WindowTarget& target : windows) target.imageValues[target.imageIndex] = frameValue;
+	if(captureCommands != VK_NULL_HANDLE) frameCapture.submitted(frameValue);
+	FrameClock::time_point submitted = FrameClock::now();
+	inputToSubmit.add(millisecondsBetween(inputSampled, submitted));
 	
+	// and one present for all swapchains, so the windows flip together
+	VkSemaphore presentWaits[MAX_WINDOWS];
+	VkSwapchainKHR swapChains[MAX_WINDOWS];
+	uint32_t imageIndices[MAX_WINDOWS];
+	uint64_t presentIds[MAX_WINDOWS];
+	uint32_t windowCount = (uint32_t)windows.size();
+	for(uint32_t i = 0; i < windowCount; i++)
+	{
+		presentWaits[i] = windows[i].renderFinishedSemaphores[windows[i].imageIndex];
+		swapChains[i] = windows[i].swapChain;
+		imageIndices[i] = windows[i].imageIndex;
+	}
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores; // just like submitinfo
-	VkSwapchainKHR swapChains[] = {swapChain}; // one swapchain
-	presentInfo.swapchainCount = 1;
+	presentInfo.waitSemaphoreCount = windowCount;
+	presentInfo.pWaitSemaphores = presentWaits; // just like submitinfo
+	presentInfo.swapchainCount = windowCount;
 	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex; // almost always 1
+	presentInfo.pImageIndices = imageIndices;
 	presentInfo.pResults = nullptr;
-	vkQueuePresentKHR(presentQueue, &presentInfo);
-	vkQueueWaitIdle(presentQueue);
+	// tag the present so we can wait for it to reach the screen; latency is measured on the first window
+	VkPresentIdKHR presentIdInfo{};
+	if(presentWaitEnabled)
+	{
+		++presentId;
+		for(uint32_t i = 0; i < windowCount; i++) presentIds[i] = presentId;
+		presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIdInfo.swapchainCount = windowCount;
+		presentIdInfo.pPresentIds = presentIds;
+		presentInfo.pNext = &presentIdInfo;
+		pendingPresents.push_back({ presentId, submitted });
+	}
+	vkd.queuePresent(presentQueue, &presentInfo);
+	if(!firstFramePresented)
+	{
+		firstFramePresented = true;
+		LOG_INFO("Time to first frame: %.1f ms\n", millisecondsBetween(startupBegin, FrameClock::now()));
+	}
+	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	if(presentWaitEnabled) collectPresents(0);
+	vkd.frameDone();
+	reportLatency();
+}
+
+// record submit -> present for every tagged present that has reached the screen
+void HelloTriangleApplication::collectPresents(uint64_t timeout)
+{
+	size_t done = 0;
+	while(done < pendingPresents.size())
+	{
+		if(waitForPresent(device, windows[0].swapChain, pendingPresents[done].id, timeout) != VK_SUCCESS) break;
+		// waiting returns once any present >= id is shown, so later ones may already be done
+		FrameClock::time_point presented = FrameClock::now();
+		submitToPresent.add(millisecondsBetween(pendingPresents[done].submitted, presented));
+		done++;
+		timeout = 0;
+	}
+	pendingPresents.erase(pendingPresents.begin(), pendingPresents.begin() + done);
+}
+
+void HelloTriangleApplication::reportLatency()
+{
+	FrameClock::time_point now = FrameClock::now();
+	double seconds = millisecondsBetween(lastLatencyReport, now) / 1000.0;
+	if(seconds < LATENCY_REPORT_SECONDS) return;
+	LOG_INFO("%s: %.1f fps, input->submit %.2f ms (%.2f..%.2f, sd %.2f)\n", latencyModeName(latencyMode), \
+		inputToSubmit.count / seconds, inputToSubmit.mean(), inputToSubmit.min, inputToSubmit.max, inputToSubmit.deviation());
+	if(presentWaitEnabled)
+		LOG_INFO("%s: submit->present %.2f ms (%.2f..%.2f, sd %.2f)\n", latencyModeName(latencyMode), \
+			submitToPresent.mean(), submitToPresent.min, submitToPresent.max, submitToPresent.deviation());
+	if(spritesEnabled && spriteFrames > 0)
+	{
+		LOG_INFO("sprites: %llu per frame in %.1f draws, %.2f M quads/s, %llu dropped\n", \
+			(unsigned long long)(spriteQuads / spriteFrames), (double)spriteDraws / spriteFrames, \
+			spriteQuads / seconds / 1e6, (unsigned long long)spriteBatch.droppedCount());
+		spriteDraws = spriteQuads = spriteFrames = 0;
+	}
+	if(occlusionEnabled && cullFrames > 0)
+	{
+		double frames = (double)cullFrames;
+		LOG_INFO("culling: %u instances, per frame %.0f visible (%.0f late), %.0f outside the frustum, %.0f occluded, " \
+			"%.2f M triangles\n", culler.objectCount(), cullTotals.visible / frames, cullTotals.late / frames, \
+			cullTotals.frustumCulled / frames, cullTotals.occluded / frames, cullTotals.triangles / frames / 1e6);
+		cullTotals = {};
+		cullFrames = 0;
+	}
+	// CPU submission cost: calls and state changes per frame, time spent in the blocking entry points.
+	// Submitted counts cover prerecorded command buffers, recorded ones only what was recorded this frame
+	VkdFrameStats calls = vkd.takeStats();
+	if(calls.frames > 0)
+	{
+		double frames = (double)calls.frames;
+		LOG_INFO("vulkan: %.0f calls/frame; submitted %.1f draws, %.1f bind changes, %.1f redundant; recorded %.1f draws, " \
+			"%.1f bind changes, %.1f redundant; ms/frame acquire %.3f, submit %.3f, present %.3f\n", calls.calls / frames, \
+			calls.submitted.draws / frames, calls.submitted.bindChanges / frames, calls.submitted.redundantSets / frames, \
+			calls.recorded.draws / frames, calls.recorded.bindChanges / frames, calls.recorded.redundantSets / frames, \
+			calls.callMilliseconds[VKD_ACQUIRE_NEXT_IMAGE] / frames, calls.callMilliseconds[VKD_QUEUE_SUBMIT] / frames, \
+			calls.callMilliseconds[VKD_QUEUE_PRESENT] / frames);
+	}
+	// device memory per heap against its budget, exported for external dashboards when BENT_MEMORY_STATS is set
+	MemoryReport memory = queryMemoryBudget(physicalDevice, memoryBudget);
+	logMemoryReport(memory);
+	if(textureStreaming)
+	{
+		textureStreamer.setHeadroom(deviceLocalHeadroom(memory));
+		TextureStreamStats streamed = textureStreamer.takeStats();
+		LOG_INFO("textures: %.1f of %.1f MiB resident, %llu levels streamed in (%.1f MiB), %llu evicted, %llu failed allocations\n", \
+			streamed.residentBytes / 1048576.0, streamed.budget / 1048576.0, (unsigned long long)streamed.streamedLevels, \
+			streamed.uploadedBytes / 1048576.0, (unsigned long long)streamed.evictedLevels, \
+			(unsigned long long)streamed.failedAllocations);
+	}
+	const char* memoryStats = getenv("BENT_MEMORY_STATS");
+	if(memoryStats != nullptr && !writeMemoryReportJson(memory, memoryStats))
+		LOG_WARN("Couldn't write memory stats to %s\n", memoryStats);
+	// frame jobs and how many of them moved to another thread
+	JobStats jobStats = jobs.takeStats();
+	if(calls.frames > 0)
+		LOG_INFO("jobs: %.1f per frame, %.1f stolen, %u threads\n", jobStats.jobs / (double)calls.frames, \
+			jobStats.steals / (double)calls.frames, jobs.threadCount());
+	// driver heap churn in the frame loop shows up as allocations since the last report
+	logHostAllocationStats("frames", &lastHostStats);
+	lastHostStats = getHostAllocationStats();
+	inputToSubmit.reset();
+	submitToPresent.reset();
+	lastLatencyReport = now;
 }
 
 // * GLFW / VULKAN INIT * // 
@@ -79,89 +265,694 @@ void HelloTriangleApplication::initWindow()
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-	window = glfwCreateWindow(WIDTH, HEIGHT, WINDOW_TITLE, nullptr, nullptr);
+	// several windows for multi-monitor setups, each placed on its own monitor while there are enough
+	const char* windowCount = getenv("BENT_WINDOWS");
+	int count = windowCount != nullptr ? atoi(windowCount) : 1;
+	count = std::min(std::max(count, 1), MAX_WINDOWS);
+	int monitorCount = 0;
+	GLFWmonitor** monitors = glfwGetMonitors(&monitorCount);
+	windows.resize(count);
+	for(int i = 0; i < count; i++)
+	{
+		std::string title = WINDOW_TITLE;
+		if(count > 1) title += " " + std::to_string(i + 1);
+		windows[i].window = glfwCreateWindow(WIDTH, HEIGHT, title.c_str(), nullptr, nullptr);
+		if(windows[i].window == nullptr) throw std::runtime_error("Failed to create window!\n");
+		if(count > 1 && i < monitorCount)
+		{
+			int x, y;
+			glfwGetMonitorPos(monitors[i], &x, &y);
+			glfwSetWindowPos(windows[i].window, x, y);
+		}
+	}
+	if(count > 1) LOG_INFO("%d windows on %d monitors\n", count, monitorCount);
 }
 
+// init stages and what each one needs; the mesh, shader files and pipeline are built on workers
+// while the device, swapchains and buffers are created here. BENT_SERIAL_INIT=1 runs them in order.
 int HelloTriangleApplication::initVulkan()
 {
-	if(createInstance(instance) != VK_SUCCESS)
-		throw std::runtime_error("failed to make Vulkan instance.\n");
-	
-	if(!checkExtensions())
-		throw std::runtime_error("Vulkan requirements not met.\n");
-
-	setupDebugMessenger();
-
-	createSurface();
-
-	pickPhysicalDevice();
-	createLogicalDevice();
-	createSwapChain();
-	createImageViews();
-	createRenderPass();
-	createGraphicsPipeline(); // < exciting!
-	createFramebuffers();
-	createCommandPool();
-	createCommandBuffers();
-	createSemaphores();
+	double windowMilliseconds = millisecondsBetween(startupBegin, FrameClock::now());
+	InitGraph graph;
+	uint32_t instanceStage = graph.add("instance", [this]() {
+		if(createInstance(instance) != VK_SUCCESS)
+			throw std::runtime_error("failed to make Vulkan instance.\n");
+		if(!checkExtensions())
+			throw std::runtime_error("Vulkan requirements not met.\n");
+	});
+	uint32_t debugStage = graph.add("debug messenger", [this]() { setupDebugMessenger(); }, { instanceStage });
+	uint32_t surfaceStage = graph.add("surfaces", [this]() {
+		for(WindowTarget& target : windows) createSurface(target);
+	}, { instanceStage });
+	uint32_t physicalStage = graph.add("physical device", [this]() {
+		pickPhysicalDevice();
+		chooseLatencyMode();
+		shaderProfile = &chooseShaderProfile(physicalDevice, getenv("BENT_SHADER_PROFILE"));
+		LOG_INFO("Shader profile: %s\n", shaderProfile->name);
+	}, { surfaceStage });
+	uint32_t meshStage = graph.add("mesh", [this]() { loadMesh(); }, { physicalStage }, INIT_WORKER);
+	uint32_t shaderStage = graph.add("shader files", [this]() { loadShaders(); }, { meshStage }, INIT_WORKER);
+	uint32_t deviceStage = graph.add("device", [this]() { createLogicalDevice(); }, { physicalStage, debugStage });
+	uint32_t formatStage = graph.add("surface format", [this]() { chooseSurfaceFormat(); }, { physicalStage });
+	uint32_t poolStage = graph.add("command pool", [this]() { createCommandPool(); }, { deviceStage });
+	uint32_t cullingStage = graph.add("culling setup", [this]() { createCulling(); }, { poolStage, meshStage });
+	uint32_t renderPassStage = graph.add("render pass", [this]() { createRenderPass(); }, \
+		{ deviceStage, formatStage, cullingStage });
+	uint32_t pipelineStage = graph.add("pipeline", [this]() { createGraphicsPipeline(); }, \
+		{ renderPassStage, shaderStage, cullingStage }, INIT_WORKER);
+	uint32_t swapChainStage = graph.add("swapchains", [this]() {
+		for(WindowTarget& target : windows)
+		{
+			createSwapChain(target);
+			createImageViews(target);
+		}
+	}, { deviceStage, formatStage });
+	uint32_t depthStage = graph.add("depth buffers", [this]() {
+		for(WindowTarget& target : windows) createDepthBuffer(target);
+	}, { swapChainStage, cullingStage });
+	uint32_t framebufferStage = graph.add("framebuffers", [this]() {
+		for(WindowTarget& target : windows) createFramebuffers(target);
+	}, { swapChainStage, renderPassStage, depthStage });
+	uint32_t meshBufferStage = graph.add("mesh buffers", [this]() { createMeshBuffers(); }, { poolStage, meshStage });
+	uint32_t jobStage = graph.add("jobs", [this]() { startJobs(); });
+	// universal textures are transcoded on the job system
+	uint32_t spriteStage = graph.add("sprites", [this]() { createSprites(); }, \
+		{ poolStage, renderPassStage, swapChainStage, jobStage });
+	uint32_t syncStage = graph.add("sync objects", [this]() { createSyncObjects(); }, { swapChainStage });
+	uint32_t transformStage = graph.add("transform buffers", [this]() { createTransformBuffers(); }, { deviceStage });
+	uint32_t gridStage = graph.add("instance grid", [this]() { createInstances(); }, \
+		{ transformStage, depthStage, meshBufferStage });
+	graph.add("capture", [this]() { createCapture(); }, { swapChainStage });
+	graph.add("command buffers", [this]() { createCommandBuffers(); }, \
+		{ pipelineStage, framebufferStage, meshBufferStage, spriteStage, syncStage, transformStage, gridStage });
+
+	const char* serialInit = getenv("BENT_SERIAL_INIT");
+	graph.run(serialInit != nullptr && strcmp(serialInit, "0") != 0);
+	LOG_INFO("Window: %.1f ms\n", windowMilliseconds);
+	graph.log();
+	shaderVariants.log();
+	releaseShaderModules(device); // every pipeline is built; modules come back on request
+	logPipelineCacheStats("init");
+	logHostAllocationStats("init");
+	lastHostStats = getHostAllocationStats();
 	return OK;
 }
 
-void HelloTriangleApplication::createSemaphores()
+// map the converted mesh if there is one; the pipeline's vertex input depends on it
+void HelloTriangleApplication::loadMesh()
+{
+	if(!std::ifstream(MESH_PATH).good())
+	{
+		LOG_DEBUG("No mesh at %s, drawing the triangle.\n", MESH_PATH);
+		if(getenv("BENT_INSTANCES") != nullptr) LOG_WARN("BENT_INSTANCES needs a mesh at %s\n", MESH_PATH);
+		return;
+	}
+	meshFile.reset(new MeshFile(MESH_PATH));
+	const MeshFileHeader& header = meshFile->header();
+	const VertexLayout& layout = getVertexLayout(header.vertexLayout);
+	if(header.vertexStride != layout.stride)
+		throw std::runtime_error("Mesh vertex stride does not match its layout!\n");
+	// every attribute format must be fetchable from a vertex buffer on this device
+	for(uint32_t a = 0; a < layout.attributeCount; a++)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, vertexEncodingFormat(layout.attributes[a].encoding), &props);
+		if(!(props.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT))
+			throw std::runtime_error("Vertex format of mesh layout not supported by this GPU!\n");
+	}
+	meshVertexLayout = header.vertexLayout;
+	// the LOD table outlives the mapping; blobs without one are a single LOD of every index
+	uint64_t lodSize;
+	const MeshLod* lods = (const MeshLod*)meshFile->section(MESH_SECTION_LODS, &lodSize);
+	if(lods && header.lodCount > 0 && lodSize >= header.lodCount * sizeof(MeshLod))
+		meshLods.assign(lods, lods + header.lodCount);
+	else
+		meshLods.assign(1, MeshLod{ 0, header.indexCount, 0, 0, 0.0f, 0 });
+	for(const MeshLod& lod : meshLods)
+		if((uint64_t)lod.indexOffset + lod.indexCount > header.indexCount)
+			throw std::runtime_error("Mesh LOD indices out of range!\n");
+	meshIndexCount = meshLods[0].indexCount;
+	meshIndexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	// scale the bounds into the middle of clip space, flip y and keep depth within 0..1
+	float extent = 0.0f;
+	float center[3];
+	for(int k = 0; k < 3; k++)
+	{
+		extent = std::max(extent, header.boundsMax[k] - header.boundsMin[k]);
+		center[k] = (header.boundsMax[k] + header.boundsMin[k]) * 0.5f;
+	}
+	float scale = extent > 0.0f ? 1.6f / extent : 1.0f;
+	// the window's aspect ratio is applied when recording, see recordCommandBuffer
+	glm::mat4 fit(1.0f);
+	fit[0][0] = scale;
+	fit[1][1] = -scale;
+	fit[2][2] = 0.5f * scale;
+	fit[3] = glm::vec4(-center[0] * scale, center[1] * scale, 0.5f - center[2] * 0.5f * scale, 1.0f);
+	// stored positions are quantized: position = stored * scale + offset
+	glm::mat4 dequantize(1.0f);
+	for(int k = 0; k < 3; k++)
+	{
+		dequantize[k][k] = header.positionScale[k];
+		dequantize[3][k] = header.positionOffset[k];
+	}
+	meshConstants.transform = fit * dequantize;
+	meshConstants.uvTransform = glm::vec4(header.uvScale[0], header.uvScale[1], header.uvOffset[0], header.uvOffset[1]);
+	meshLoaded = true;
+
+	// BENT_INSTANCES=<count> draws a grid of the mesh instead, with occlusion culling on the GPU
+	const char* instances = getenv("BENT_INSTANCES");
+	instanceCount = instances != nullptr ? (uint32_t)std::min(std::max(atoi(instances), 0), MAX_SCENE_NODES) : 0;
+	occlusionEnabled = instanceCount > 0;
+	float diagonal = 0.0f;
+	for(int k = 0; k < 3; k++)
+		diagonal += (header.boundsMax[k] - header.boundsMin[k]) * (header.boundsMax[k] - header.boundsMin[k]);
+	meshCenter = glm::vec3(center[0], center[1], center[2]);
+	meshRadius = std::max(sqrtf(diagonal) * 0.5f, 1e-3f);
+	sceneConstants.uvTransform = meshConstants.uvTransform;
+	sceneConstants.positionScale = glm::vec4(header.positionScale[0], header.positionScale[1], header.positionScale[2], 0.0f);
+	sceneConstants.positionOffset = glm::vec4(header.positionOffset[0], header.positionOffset[1], header.positionOffset[2], 0.0f);
+}
+
+// the main pipeline's shader variants, SPIR-V read and checked here; meshes use the vertex shader
+// generated for their packed layout, specialized by the shader profile
+void HelloTriangleApplication::loadShaders()
+{
+	std::string vertShaderPath = "shaders/hello.vert.spv";
+	if(meshLoaded) vertShaderPath = std::string("shaders/mesh_") + getVertexLayout(meshVertexLayout).name + \
+		(occlusionEnabled ? "_instanced.vert.spv" : ".vert.spv");
+	ShaderVariantKey vertKey(vertShaderPath);
+	if(meshLoaded)
+		vertKey.set(SHADER_CONSTANT_QUALITY, shaderProfile->quality).set(SHADER_CONSTANT_LIGHT_COUNT, shaderProfile->lightCount);
+	vertShader = &shaderVariants.request(vertKey);
+	fragShader = &shaderVariants.request(ShaderVariantKey("shaders/hello.frag.spv"));
+}
+
+// copy the mapped vertex and index sections through one staging buffer into device local memory
+void HelloTriangleApplication::createMeshBuffers()
+{
+	if(!meshLoaded) return;
+	uint64_t vertexSize, indexSize;
+	const void* vertices = meshFile->section(MESH_SECTION_VERTICES, &vertexSize);
+	const void* indices = meshFile->section(MESH_SECTION_INDICES, &indexSize);
+	if(!vertices || !indices)
+		throw std::runtime_error("Mesh file is missing vertex or index data!\n");
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, \
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, \
+		MEMORY_STAGING);
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, vertexSize + indexSize, 0, &data);
+	memcpy(data, vertices, vertexSize);
+	memcpy((char*)data + vertexSize, indices, indexSize);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	createBuffer(physicalDevice, device, vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, \
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, MEMORY_MESH);
+	createBuffer(physicalDevice, device, indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, \
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, MEMORY_MESH);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	VkBufferCopy copyRegion{};
+	copyRegion.size = vertexSize;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, 1, &copyRegion);
+	copyRegion.srcOffset = vertexSize;
+	copyRegion.size = indexSize;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &copyRegion);
+	vkEndCommandBuffer(commandBuffer);
+	// no host stall: frames wait for this value on the GPU, the staging memory is freed once it retires
+	deletionQueue.setCurrent(graphicsTimeline.nextValue());
+	TimelineSubmit submit;
+	submit.commandBufferCount = 1;
+	submit.commandBuffers = &commandBuffer;
+	meshUploadValue = graphicsTimeline.submit(submit);
+	deletionQueue.release(commandPool, commandBuffer);
+	deletionQueue.release(stagingBuffer);
+	deletionQueue.release(stagingBufferMemory);
+	meshFile.reset(); // everything needed now lives on the GPU
+}
+
+// one host visible world matrix buffer per frame in flight, mapped for the app's lifetime
+void HelloTriangleApplication::createTransformBuffers()
+{
+	VkDeviceSize bufferSize = sizeof(glm::mat4) * MAX_SCENE_NODES;
+	transformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	transformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	transformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, \
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, \
+			transformBuffers[i], transformBuffersMemory[i], MEMORY_STREAM);
+		vkMapMemory(device, transformBuffersMemory[i], 0, bufferSize, 0, &transformBuffersMapped[i]);
+	}
+	sceneTransforms.setUploadTargets(MAX_FRAMES_IN_FLIGHT, MAX_SCENE_NODES);
+	LOG_DEBUG("Transform upload buffers created (%d nodes each).\n", MAX_SCENE_NODES);
+}
+
+// depth format and the culling passes' layouts and pipelines; the render passes and the scene pipeline need both
+void HelloTriangleApplication::createCulling()
+{
+	if(!occlusionEnabled) return;
+	// the pyramid's first level is built by sampling the depth buffer
+	depthFormat = findDepthFormat(physicalDevice, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	if(depthFormat == VK_FORMAT_UNDEFINED)
+		throw std::runtime_error("No depth format can be sampled for occlusion culling!\n");
+	culler.init(physicalDevice, device, graphicsQueue, commandPool, MAX_FRAMES_IN_FLIGHT, shaderVariants, \
+		shaderProfile->cullGroupSize);
+}
+
+// BENT_INSTANCES copies of the mesh on a square grid in the XZ plane, each a node of its own
+void HelloTriangleApplication::createInstances()
+{
+	if(!occlusionEnabled) return;
+	uint32_t side = (uint32_t)ceilf(sqrtf((float)instanceCount));
+	float spacing = meshRadius * 3.0f;
+	std::vector<TransformHandle> nodes(instanceCount);
+	std::vector<CullObject> objects(instanceCount);
+	for(uint32_t i = 0; i < instanceCount; i++)
+	{
+		glm::vec3 position(((float)(i % side) - (side - 1) * 0.5f) * spacing, 0.0f, ((float)(i / side) - (side - 1) * 0.5f) * spacing);
+		nodes[i] = sceneTransforms.addNode();
+		sceneTransforms.setPosition(nodes[i], position - meshCenter); // mesh centre on the grid point
+		objects[i] = CullObject{ glm::vec4(position, meshRadius), 0, { 0, 0, 0 } };
+	}
+	// the nodes have no parents, so their slots stay put from here on
+	sceneTransforms.update();
+	for(uint32_t i = 0; i < instanceCount; i++) objects[i].slot = sceneTransforms.slot(nodes[i]);
+	culler.setObjects(objects, meshLods);
+	const char* lodError = getenv("BENT_LOD_ERROR");
+	culler.setLodThreshold(lodError != nullptr ? std::max((float)atof(lodError), 0.0f) : LOD_ERROR_PIXELS);
+	culler.createPyramid(windows[0].extent, windows[0].depthView);
+	culler.createDrawSets(transformBuffers);
+	updateCamera();
+	LOG_INFO("Occlusion culling: %u instances on a %ux%u grid, %zu LODs\n", instanceCount, side, side, meshLods.size());
+}
+
+// a low orbit around the grid, so the nearer rows hide the ones behind them
+void HelloTriangleApplication::updateCamera()
 {
+	float angle = (float)(millisecondsBetween(startupBegin, FrameClock::now()) / 1000.0) * CAMERA_ORBIT_SPEED;
+	float side = ceilf(sqrtf((float)instanceCount));
+	float distance = side * meshRadius * 2.0f + meshRadius * 2.0f;
+	glm::vec3 eye(cosf(angle) * distance, meshRadius * 1.5f, sinf(angle) * distance);
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	float aspect = (float)windows[0].extent.width / (float)windows[0].extent.height;
+	float fov = glm::radians(60.0f);
+	glm::mat4 projection = glm::perspective(fov, aspect, meshRadius * 0.1f, distance * 3.0f);
+	projection[1][1] *= -1.0f; // clip space y points down
+	cullCamera.viewProjection = projection * view;
+	cullCamera.position = eye;
+	cullCamera.lodScale = (float)windows[0].extent.height * 0.5f / tanf(fov * 0.5f);
+	sceneConstants.transform = cullCamera.viewProjection;
+}
+
+void HelloTriangleApplication::createSyncObjects()
+{
+	frameValues.resize(MAX_FRAMES_IN_FLIGHT, 0);
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	if(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS || \
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create semaphores!\n");
+	for(WindowTarget& target : windows)
+	{
+		target.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		target.renderFinishedSemaphores.resize(target.images.size());
+		target.imageValues.resize(target.images.size(), 0);
+		for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			if(vkCreateSemaphore(device, &semaphoreInfo, hostAllocator(), &target.imageAvailableSemaphores[i]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create frame sync objects!\n");
+		}
+		for(size_t i = 0; i < target.renderFinishedSemaphores.size(); i++)
+		{
+			if(vkCreateSemaphore(device, &semaphoreInfo, hostAllocator(), &target.renderFinishedSemaphores[i]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create semaphores!\n");
+		}
+	}
+}
+
+// readback ring and encoder thread for BENT_CAPTURE and F12 screenshots, see capture.hpp
+void HelloTriangleApplication::createCapture()
+{
+	if(!frameCapture.configure(getenv("BENT_CAPTURE")))
+		LOG_WARN("BENT_CAPTURE should be png:<directory>, raw:<file> or raw:|<command>; only screenshots are enabled\n");
+	if(!windows[0].readable)
+	{
+		LOG_WARN("Swapchain images can't be copied from, frame capture disabled\n");
+		return;
+	}
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+	frameCapture.init(physicalDevice, device, indices.graphicsFamily.value(), windows[0].extent, swapChainImageFormat);
+}
+
+// BENT_SPRITES=<count>: bouncing sprites from a procedural texture array, to measure the batch.
+// BENT_TEXTURE=<file.btex>: a sprite with a streamed texture, BENT_TEXTURE_BUDGET=<MiB> caps what it may hold
+void HelloTriangleApplication::createSprites()
+{
+	const char* count = getenv("BENT_SPRITES");
+	const char* texturePath = getenv("BENT_TEXTURE");
+	uint32_t spriteCount = count != nullptr ? (uint32_t)atoi(count) : 0;
+	textureStreaming = texturePath != nullptr && texturePath[0] != '\0';
+	spritesEnabled = spriteCount > 0 || textureStreaming;
+	if(!spritesEnabled) return;
+	spriteBatch.init(physicalDevice, device, graphicsQueue, commandPool, MAX_FRAMES_IN_FLIGHT, \
+		std::max<uint32_t>(spriteCount + 1, SPRITE_CAPACITY));
+	spriteBatch.createPipelines(renderPass, swapChainImageFormat, depthFormat);
+	if(textureStreaming)
+	{
+		const char* budget = getenv("BENT_TEXTURE_BUDGET");
+		textureStreamer.init(physicalDevice, device, graphicsTimeline, commandPool, deletionQueue, \
+			budget != nullptr ? (VkDeviceSize)atoi(budget) << 20 : 0, &jobs);
+		textureStreamer.setHeadroom(deviceLocalHeadroom(queryMemoryBudget(physicalDevice, memoryBudget)));
+		streamedTexture = textureStreamer.load(texturePath);
+		streamedGeneration = textureStreamer.generation(streamedTexture);
+		streamedSpriteTexture = spriteBatch.addTexture(textureStreamer.view(streamedTexture));
+		zoomSprite = Sprite{};
+		zoomSprite.u1 = zoomSprite.v1 = 1.0f;
+		zoomSprite.color = 0xFFFFFFFFu;
+		zoomSprite.texture = streamedSpriteTexture;
+		zoomSprite.blend = SPRITE_BLEND_ALPHA;
+		zoomSprite.order = 1; // over the bouncing ones
+	}
+	lastSpriteUpdate = FrameClock::now();
+	if(spriteCount == 0) return;
+
+	// white shapes with soft edges, one per layer: disc, square, ring, diamond
+	const uint32_t size = 32, layers = 4;
+	std::vector<uint8_t> pixels(size * size * layers * 4);
+	for(uint32_t layer = 0; layer < layers; layer++)
+		for(uint32_t y = 0; y < size; y++)
+			for(uint32_t x = 0; x < size; x++)
+			{
+				float dx = (x + 0.5f) / size * 2.0f - 1.0f, dy = (y + 0.5f) / size * 2.0f - 1.0f;
+				float r = sqrtf(dx * dx + dy * dy);
+				float distance = layer == 0 ? r : layer == 1 ? std::max(fabsf(dx), fabsf(dy)) : \
+					layer == 2 ? fabsf(r - 0.7f) + 0.7f : fabsf(dx) + fabsf(dy);
+				float alpha = std::min(std::max((1.0f - distance) * size * 0.5f, 0.0f), 1.0f);
+				uint8_t* texel = &pixels[((layer * size + y) * size + x) * 4];
+				texel[0] = texel[1] = texel[2] = 255;
+				texel[3] = (uint8_t)(alpha * 255.0f);
+			}
+	uint16_t texture = spriteBatch.createTextureArray(size, size, layers, pixels.data());
+
+	demoSprites.resize(spriteCount);
+	demoMotion.resize(spriteCount);
+	srand(1);
+	auto random = [](float low, float high) { return low + (high - low) * (rand() / (float)RAND_MAX); };
+	for(uint32_t i = 0; i < spriteCount; i++)
+	{
+		Sprite& sprite = demoSprites[i];
+		sprite.x = random(0.0f, (float)windows[0].extent.width);
+		sprite.y = random(0.0f, (float)windows[0].extent.height);
+		sprite.width = sprite.height = random(4.0f, 24.0f);
+		sprite.rotation = random(0.0f, 6.2831853f);
+		sprite.u0 = sprite.v0 = 0.0f;
+		sprite.u1 = sprite.v1 = 1.0f;
+		sprite.color = (uint32_t)(rand() & 0xFFFFFF) | 0xC0000000u;
+		sprite.texture = texture;
+		sprite.layer = (uint16_t)(i % layers);
+		sprite.blend = i % 8 == 0 ? SPRITE_BLEND_ADDITIVE : SPRITE_BLEND_ALPHA;
+		sprite.order = 0;
+		demoMotion[i] = { random(-120.0f, 120.0f), random(-120.0f, 120.0f), random(-3.0f, 3.0f) };
+	}
+	LOG_INFO("Sprite demo: %u sprites\n", spriteCount);
+}
+
+// move the demo sprites and build this frame's batch
+void HelloTriangleApplication::updateSprites()
+{
+	FrameClock::time_point now = FrameClock::now();
+	float dt = std::min((float)(millisecondsBetween(lastSpriteUpdate, now) / 1000.0), 0.1f);
+	lastSpriteUpdate = now;
+	float width = (float)windows[0].extent.width, height = (float)windows[0].extent.height;
+	auto simulate = [this, dt, width, height](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+		{
+			Sprite& sprite = demoSprites[i];
+			SpriteMotion& motion = demoMotion[i];
+			sprite.x += motion.vx * dt;
+			sprite.y += motion.vy * dt;
+			if(sprite.x < 0.0f || sprite.x > width) motion.vx = sprite.x < 0.0f ? fabsf(motion.vx) : -fabsf(motion.vx);
+			if(sprite.y < 0.0f || sprite.y > height) motion.vy = sprite.y < 0.0f ? fabsf(motion.vy) : -fabsf(motion.vy);
+			sprite.rotation += motion.spin * dt;
+		}
+	};
+	JobCounter simulated;
+	jobs.parallelFor((uint32_t)demoSprites.size(), SPRITE_JOB_GRAIN, simulate, simulated);
+	jobs.wait(simulated);
+	spriteBatch.begin();
+	spriteBatch.add(demoSprites.data(), (uint32_t)demoSprites.size());
+	if(textureStreaming) updateZoomSprite(dt);
+	spriteBatch.end((uint32_t)currentFrame, &jobs);
+	spriteDraws += spriteBatch.drawCount();
+	spriteQuads += spriteBatch.quadCount();
+	spriteFrames++;
+}
+
+// the zoom sprite asks for the level it would sample at its size; levels move before anything records with the view
+void HelloTriangleApplication::updateZoomSprite(float dt)
+{
+	const TextureFileHeader& header = textureStreamer.header(streamedTexture);
+	zoomSeconds = fmodf(zoomSeconds + dt, TEXTURE_ZOOM_SECONDS);
+	float zoom = 0.5f - 0.5f * cosf(zoomSeconds / TEXTURE_ZOOM_SECONDS * 6.2831853f);
+	float largest = (float)std::max(header.width, header.height);
+	float scale = (32.0f + (largest - 32.0f) * zoom) / largest;
+	zoomSprite.x = windows[0].extent.width * 0.5f;
+	zoomSprite.y = windows[0].extent.height * 0.5f;
+	zoomSprite.width = header.width * scale;
+	zoomSprite.height = header.height * scale;
+	textureStreamer.request(streamedTexture, textureLevelForFootprint(header.width, zoomSprite.width));
+	textureStreamer.update();
+	if(textureStreamer.generation(streamedTexture) != streamedGeneration)
+	{
+		streamedGeneration = textureStreamer.generation(streamedTexture);
+		spriteBatch.setTextureView(streamedSpriteTexture, textureStreamer.view(streamedTexture), deletionQueue);
+	}
+	spriteBatch.add(zoomSprite);
+}
+
+// pick the latency mode and limiter rate; needs the physical device and runs before the swapchain
+void HelloTriangleApplication::chooseLatencyMode()
+{
+	const char* requested = getenv("BENT_LATENCY_MODE");
+	if(requested != nullptr && !findLatencyMode(requested, latencyMode))
+		LOG_WARN("Unknown latency mode %s, using %s\n", requested, latencyModeName(latencyMode));
+	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, windows[0].surface);
+	if(chooseSwapPresentMode(swapChainSupport.presentModes, latencyPresentMode(latencyMode)) != latencyPresentMode(latencyMode))
+	{
+		LOG_WARN("Latency mode %s not supported by the surface, using fifo\n", latencyModeName(latencyMode));
+		latencyMode = LATENCY_FIFO;
+	}
+
+	// FIFO is limited to the refresh rate so frames never queue up behind vsync
+	double limit = 0.0;
+	if(latencyMode == LATENCY_FIFO)
+	{
+		const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		limit = (videoMode != nullptr && videoMode->refreshRate > 0) ? videoMode->refreshRate : 60.0;
+	}
+	const char* fpsLimit = getenv("BENT_FPS_LIMIT");
+	if(fpsLimit != nullptr) limit = atof(fpsLimit);
+	frameLimiter.setInterval(limit > 0.0 ? 1.0 / limit : 0.0);
+
+	// present wait gives us submit -> present times and lets FIFO wait for an empty queue
+	presentWaitEnabled = hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) && \
+		hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	if(presentWaitEnabled)
+	{
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &presentIdFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+		presentWaitEnabled = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+	}
+	LOG_INFO("Latency mode %s, frame limit %.1f fps, present wait %s\n", latencyModeName(latencyMode), limit, \
+		presentWaitEnabled ? "on" : "unavailable");
 }
 
 // create buffer for drawing commands
 void HelloTriangleApplication::createCommandBuffers()
 {
-	commandBuffers.resize(swapChainFramebuffers.size());
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = commandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // secondary means it will be called from another primary command buffer
-	allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-	if(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data())!=VK_SUCCESS)
-		throw std::runtime_error("Failed to allocate command buffers!\n");
-	for(size_t i = 0; i < commandBuffers.size(); i++)
-	{
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // contains timing for submitting command buffer usage
-		beginInfo.pInheritanceInfo = nullptr; // for secondary command buffers
-		if(vkBeginCommandBuffer(commandBuffers[i], &beginInfo)!=VK_SUCCESS)
-			throw std::runtime_error("Failed to begin recording command buffer!\n");
-		
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = renderPass;
-		renderPassInfo.framebuffer = swapChainFramebuffers[i];
-		renderPassInfo.renderArea.offset = {0, 0};
-		renderPassInfo.renderArea.extent = swapChainExtent;
-		VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f}; // clear color = black
-		renderPassInfo.clearValueCount = 1;
-		renderPassInfo.pClearValues = &clearColor;
-		// render pass cmds are in primary command buffer
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); 
+	for(WindowTarget& target : windows)
+	{
+		target.commandBuffers.resize(target.images.size());
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = target.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // secondary means it will be called from another primary command buffer
+		allocInfo.commandBufferCount = (uint32_t)target.commandBuffers.size();
+		if(vkAllocateCommandBuffers(device, &allocInfo, target.commandBuffers.data())!=VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate command buffers!\n");
+		for(uint32_t i = 0; i < target.commandBuffers.size(); i++)
+			recordCommandBuffer(target, i);
+	}
+}
+
+// draw commands for one swapchain image of a window
+void HelloTriangleApplication::recordCommandBuffer(WindowTarget& target, uint32_t imageIndex)
+{
+	VkCommandBuffer commandBuffer = target.commandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	// with sprites or culling the buffer is recorded again every time its image is acquired
+	beginInfo.flags = spritesEnabled || occlusionEnabled ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : 0;
+	beginInfo.pInheritanceInfo = nullptr; // for secondary command buffers
+	if(vkd.beginCommandBuffer(commandBuffer, &beginInfo)!=VK_SUCCESS)
+		throw std::runtime_error("Failed to begin recording command buffer!\n");
+
+	// the first window culls: last frame's visible instances are drawn, the depth they leave is
+	// reduced into the pyramid, and whatever turns out visible on top of that is drawn in a second
+	// pass. The other windows come after it in the submit and draw both lists in one pass
+	bool culling = occlusionEnabled && &target == &windows[0];
+	if(culling) culler.recordEarly(commandBuffer, (uint32_t)currentFrame, cullCamera);
+	beginScenePass(commandBuffer, target, imageIndex, true, !culling);
+	auto bindScene = [&]() {
 		// configure pipline bind point as graphics pipline
-		vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-		
-		// now draw!
+		vkd.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		// pipelines are shared by every window, so the viewport is set per window
+		VkViewport viewport{ 0.0f, 0.0f, (float)target.extent.width, (float)target.extent.height, 0.0f, 1.0f };
+		VkRect2D scissor{ {0, 0}, target.extent };
+		vkd.cmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkd.cmdSetScissor(commandBuffer, 0, 1, &scissor);
+		if(!meshLoaded) return;
+		VkDeviceSize offsets[] = { 0 };
+		vkd.cmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+		vkd.cmdBindIndexBuffer(commandBuffer, indexBuffer, 0, meshIndexType);
+	};
+	bindScene();
+
+	// now draw!
+	if(occlusionEnabled)
+	{
+		VkDescriptorSet drawSet = culler.drawSet((uint32_t)currentFrame);
+		vkd.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &drawSet, 0, nullptr);
+		vkd.cmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(sceneConstants), &sceneConstants);
+		culler.recordDraw(commandBuffer, pipelineLayout, 0);
+		if(culling)
+		{
+			endScenePass(commandBuffer, target, imageIndex, false);
+			culler.recordLate(commandBuffer, (uint32_t)currentFrame, cullCamera, target.depthImage);
+			beginScenePass(commandBuffer, target, imageIndex, false, true);
+			bindScene();
+			vkd.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &drawSet, 0, nullptr);
+			vkd.cmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(sceneConstants), &sceneConstants);
+		}
+		culler.recordDraw(commandBuffer, pipelineLayout, 1);
+	}
+	else if(meshLoaded)
+	{
+		// squeeze x by the window's aspect ratio
+		MeshPushConstants constants = meshConstants;
+		glm::mat4 aspect(1.0f);
+		aspect[0][0] = (float)target.extent.height / (float)target.extent.width;
+		constants.transform = aspect * meshConstants.transform;
+		vkd.cmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+		// index count, instance count, first index, vertex offset, first instance
+		vkd.cmdDrawIndexed(commandBuffer, meshIndexCount, 1, 0, 0, 0);
+	}
+	else
+	{
 		// vertex count, instance count (for instanced rendering), 
 		//   first vertex (gl_VertexIndex), first instance offset (for instanced rendering) (gl_InstanceIndex)
-		
-		vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-		
-		vkCmdEndRenderPass(commandBuffers[i]);
+		vkd.cmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+	// 2D layer on top, pipelines and buffers are the batch's own
+	if(spritesEnabled) spriteBatch.record(commandBuffer, (uint32_t)currentFrame, target.extent);
+	endScenePass(commandBuffer, target, imageIndex, true);
+
+	if(vkd.endCommandBuffer(commandBuffer)!=VK_SUCCESS)
+		throw std::runtime_error("Failed to record command buffer!\n");
+}
 
-		if(vkEndCommandBuffer(commandBuffers[i])!=VK_SUCCESS)
-			throw std::runtime_error("Failed to record command buffer!\n");
+// clear: the pass starts the image (and depth buffer) from scratch, else it loads what the one before kept.
+// present: the image goes to the presentation engine once the pass ends
+void HelloTriangleApplication::beginScenePass(VkCommandBuffer commandBuffer, WindowTarget& target, uint32_t imageIndex, \
+	bool clear, bool present)
+{
+	VkClearValue clearValues[2];
+	clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}}; // clear color = black
+	clearValues[1].depthStencil = { 1.0f, 0 };
+	if(dynamicRendering)
+	{
+		if(clear)
+		{
+			// what the render pass did implicitly: wait for the acquire (the submit waits at
+			// color output) and move the image into attachment layout, contents discarded
+			transitionImageLayout(commandBuffer, target.images[imageIndex], VK_IMAGE_LAYOUT_UNDEFINED, \
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, \
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+			// the depth buffer is shared by the frames: wait for the last one's depth writes
+			if(target.depthImage != VK_NULL_HANDLE)
+				transitionImageLayout(commandBuffer, target.depthImage, VK_IMAGE_LAYOUT_UNDEFINED, \
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | \
+					VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, \
+					VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, \
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, \
+					VK_IMAGE_ASPECT_DEPTH_BIT);
+		}
+		else
+			// the previous pass's color, loaded; the culling pass already handed the depth buffer back
+			transitionImageLayout(commandBuffer, target.images[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, \
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, \
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, \
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+		VkAttachmentLoadOp loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		VkRenderingAttachmentInfo colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		colorAttachment.imageView = target.imageViews[imageIndex];
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = loadOp;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearValues[0];
+		VkRenderingAttachmentInfo depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		depthAttachment.imageView = target.depthView;
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = loadOp;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.clearValue = clearValues[1];
+		VkRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.renderArea.offset = {0, 0};
+		renderingInfo.renderArea.extent = target.extent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		if(target.depthView != VK_NULL_HANDLE) renderingInfo.pDepthAttachment = &depthAttachment;
+		vkd.cmdBeginRendering(commandBuffer, &renderingInfo);
+		return;
 	}
-	
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = clear && present ? renderPass : cullRenderPasses[clear ? 0 : 1];
+	renderPassInfo.framebuffer = target.framebuffers[imageIndex];
+	renderPassInfo.renderArea.offset = {0, 0};
+	renderPassInfo.renderArea.extent = target.extent;
+	renderPassInfo.clearValueCount = target.depthView != VK_NULL_HANDLE ? 2 : 1;
+	renderPassInfo.pClearValues = clearValues;
+	// render pass cmds are in primary command buffer
+	vkd.cmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); 
+}
+
+void HelloTriangleApplication::endScenePass(VkCommandBuffer commandBuffer, WindowTarget& target, uint32_t imageIndex, bool present)
+{
+	if(!dynamicRendering)
+	{
+		vkd.cmdEndRenderPass(commandBuffer);
+		return;
+	}
+	vkd.cmdEndRendering(commandBuffer);
+	// and the render pass's final layout: hand the image to the presentation engine
+	if(present)
+		transitionImageLayout(commandBuffer, target.images[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, \
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, \
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
 }
 
 // create pool to hold draw command buffers
@@ -172,64 +963,143 @@ void HelloTriangleApplication::createCommandPool()
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-	poolInfo.flags = 0; // if you want to change cmd buffers at runtime need flags
-	if(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool)!=VK_SUCCESS)
+	if(vkCreateCommandPool(device, &poolInfo, hostAllocator(), &commandPool)!=VK_SUCCESS)
 		throw std::runtime_error("Failed to create Vulkan command pool!\n");
+	// pools are externally synchronized, so each window records from its own
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // the sprite layer re-records them every frame
+	for(WindowTarget& target : windows)
+		if(vkCreateCommandPool(device, &poolInfo, hostAllocator(), &target.commandPool)!=VK_SUCCESS)
+			throw std::runtime_error("Failed to create Vulkan command pool!\n");
 }
 
-void HelloTriangleApplication::createFramebuffers()
+// BENT_JOB_THREADS=<n> workers besides the main thread, one per remaining core by default
+void HelloTriangleApplication::startJobs()
 {
+	const char* threads = getenv("BENT_JOB_THREADS");
+	uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t workers = threads != nullptr ? (uint32_t)atoi(threads) : cores - 1;
+	jobs.start(workers);
+	LOG_INFO("Job system: %u threads\n", jobs.threadCount());
+}
+
+// with occlusion culling every window gets a depth buffer; the first one's is also sampled into the depth pyramid
+void HelloTriangleApplication::createDepthBuffer(WindowTarget& target)
+{
+	if(!occlusionEnabled) return;
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = depthFormat;
+	imageInfo.extent = { target.extent.width, target.extent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if(vkCreateImage(device, &imageInfo, hostAllocator(), &target.depthImage) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth buffer!\n");
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, target.depthImage, &memRequirements);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if(allocateDeviceMemory(device, allocInfo, MEMORY_RENDER_TARGET, target.depthMemory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate depth buffer memory!\n");
+	vkBindImageMemory(device, target.depthImage, target.depthMemory, 0);
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = target.depthImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = depthFormat;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	if(vkCreateImageView(device, &viewInfo, hostAllocator(), &target.depthView) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth buffer view!\n");
+}
+
+void HelloTriangleApplication::createFramebuffers(WindowTarget& target)
+{
+	if(dynamicRendering) return; // attachments are given at vkCmdBeginRendering instead
 	// resize framebuffer to size of swapchain image views
-	swapChainFramebuffers.resize(swapChainImageViews.size());
-	for(size_t i = 0; i < swapChainImageViews.size(); i++)
+	target.framebuffers.resize(target.imageViews.size());
+	for(size_t i = 0; i < target.imageViews.size(); i++)
 	{
-		VkImageView attachments[] = { swapChainImageViews[i] };
-		// set the framebuffer to have a single swapchain image view and single layer
+		VkImageView attachments[] = { target.imageViews[i], target.depthView };
+		// set the framebuffer to have a single swapchain image view (and the depth buffer) and single layer
 		VkFramebufferCreateInfo framebufferInfo{};
 		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.attachmentCount = target.depthView != VK_NULL_HANDLE ? 2 : 1;
 		framebufferInfo.pAttachments = attachments;
-		framebufferInfo.width = swapChainExtent.width;
-		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.width = target.extent.width;
+		framebufferInfo.height = target.extent.height;
 		framebufferInfo.layers = 1;
-		if(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
+		if(vkCreateFramebuffer(device, &framebufferInfo, hostAllocator(), &target.framebuffers[i]) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create framebuffer!");
 	}
 	
-	#ifdef DEBUG 
-		printf("DEBUG: All framebuffers created successfully!\n");
-	#endif 
+	LOG_DEBUG("All framebuffers created successfully!\n");
 }
 
 void HelloTriangleApplication::createRenderPass()
 {
-	// we have a single color buffer attachment
-	VkAttachmentDescription colorAttachment{};
+	if(dynamicRendering) return; // pipelines are built against attachment formats instead
+	renderPass = createSceneRenderPass(true, true);
+	// occlusion culling splits the first window's frame around the culling pass; the passes only
+	// differ in load ops and layouts, so they stay compatible with the pipelines and framebuffers
+	if(occlusionEnabled)
+	{
+		cullRenderPasses[0] = createSceneRenderPass(true, false);
+		cullRenderPasses[1] = createSceneRenderPass(false, true);
+	}
+}
+
+// clear: start from scratch, else load what the previous pass kept; present: hand the image over at the end
+VkRenderPass HelloTriangleApplication::createSceneRenderPass(bool clear, bool present)
+{
+	// we have a single color buffer attachment, and a depth buffer when culling
+	VkAttachmentDescription attachments[2]{};
+	VkAttachmentDescription& colorAttachment = attachments[0];
 	colorAttachment.format = swapChainImageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 	// clear framebuffer and enable write
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
 	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	// set stencil buffer (if it exists) to the same
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
 	// this attachment does not care about initial fb format, and we want it in swapchain format
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.finalLayout = present ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	VkAttachmentDescription& depthAttachment = attachments[1];
+	depthAttachment.format = depthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // the culling pass reads it
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	bool depth = depthFormat != VK_FORMAT_UNDEFINED;
 	// enable a subpass with color buffer optimization
 	VkAttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.attachment = 0;
 	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 1;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	VkSubpassDescription subpass{};
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // graphics subpass, not compute.
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef; // in the frag shader, this is layout location 0
+	if(depth) subpass.pDepthStencilAttachment = &depthAttachmentRef;
 	// finally, assemble the renderpass
 	VkRenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colorAttachment;
+	renderPassInfo.attachmentCount = depth ? 2 : 1;
+	renderPassInfo.pAttachments = attachments;
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
 	// 
@@ -237,46 +1107,62 @@ void HelloTriangleApplication::createRenderPass()
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0; // dependency and subpass index
 	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0; // operations to wait on and what stage
+	dependency.srcAccessMask = clear ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; // operations to wait on and what stage
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; // operations that will wait
+	if(!clear) dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+	if(depth)
+	{
+		// the depth buffer is shared by the frames, so each one waits for the last one's depth writes
+		const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcStageMask |= depthStages;
+		dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask |= depthStages;
+		dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	}
 	renderPassInfo.dependencyCount = 1;
 	renderPassInfo.pDependencies = &dependency;
 
-	if(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass)!= VK_SUCCESS)
+	VkRenderPass created;
+	if(vkCreateRenderPass(device, &renderPassInfo, hostAllocator(), &created)!= VK_SUCCESS)
 		throw std::runtime_error("Could not create render pass!\n");
-
+	return created;
 }
 
 void HelloTriangleApplication::createGraphicsPipeline()
 {
-	auto vertShaderCode = readBinaryFile("shaders/hello.vert.spv");
-	auto fragShaderCode = readBinaryFile("shaders/hello.frag.spv");
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule; // point to the code wrapper
-	vertShaderStageInfo.pName = "main"; // entrypoint of the shader
+	// owned by the pipeline state cache, released once init is done
+	VkShaderModule vertShaderModule, fragShaderModule;
+	if(cachedShaderModule(device, *vertShader->code, vertShaderModule) != VK_SUCCESS || \
+		cachedShaderModule(device, *fragShader->code, fragShaderModule) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shader module!\n");
 
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";
+	// entry point "main", specialized by the variant's constants
+	VkPipelineShaderStageCreateInfo vertShaderStageInfo = shaderStageInfo(*vertShader, VK_SHADER_STAGE_VERTEX_BIT, vertShaderModule);
+	VkPipelineShaderStageCreateInfo fragShaderStageInfo = shaderStageInfo(*fragShader, VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderModule);
 
 	// Create a pipeline that is only vertex and fragment
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	// how are we loading the vertices? (we aren't for now)
+	// how are we loading the vertices? the triangle has them baked into the shader,
+	// meshes read packed vertices from binding 0, described by their vertex layout
+	VkVertexInputBindingDescription bindingDescription{};
+	VkVertexInputAttributeDescription attributeDescriptions[VERTEX_SEMANTIC_COUNT]{};
+	uint32_t attributeCount = 0;
+	if(meshLoaded)
+	{
+		const VertexLayout& layout = getVertexLayout(meshVertexLayout);
+		bindingDescription.binding = 0;
+		bindingDescription.stride = layout.stride;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		attributeCount = vertexInputAttributes(layout, 0, attributeDescriptions);
+	}
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 0;
-	vertexInputInfo.pVertexBindingDescriptions = nullptr;
-	vertexInputInfo.vertexAttributeDescriptionCount = 0;
-	vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+	vertexInputInfo.vertexBindingDescriptionCount = meshLoaded ? 1 : 0;
+	vertexInputInfo.pVertexBindingDescriptions = meshLoaded ? &bindingDescription : nullptr;
+	vertexInputInfo.vertexAttributeDescriptionCount = attributeCount;
+	vertexInputInfo.pVertexAttributeDescriptions = meshLoaded ? attributeDescriptions : nullptr;
 
 	// how are we going to draw the vertices?
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -284,27 +1170,11 @@ void HelloTriangleApplication::createGraphicsPipeline()
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	// set viewport to min/max bounds of framebuffer
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)swapChainExtent.width;
-	viewport.height = (float)swapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f; // framebuffer depth
-
-	// scissor/crop set to entire image
-	VkRect2D scissor{};
-	scissor.offset = {0, 0}; // start
-	scissor.extent = swapChainExtent; // end
-
-	// viewport + scissor = viewport state
+	// viewport + scissor = viewport state; both are dynamic, set per window when recording
 	VkPipelineViewportStateCreateInfo viewportState{};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
 
 	// rasterizer = depth test, culling, scissor test, and finally create fragment
 	VkPipelineRasterizationStateCreateInfo rasterizer{};
@@ -315,6 +1185,7 @@ void HelloTriangleApplication::createGraphicsPipeline()
 	rasterizer.lineWidth = 1.0f; // lines are 1 fragment in width
 	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // cull back faces
 	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; // clockwise face order
+	if(meshLoaded) rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // OBJ/glTF winding, after the y flip
 	rasterizer.depthBiasEnable = VK_FALSE; // for shadowmapping
 	//rasterizer.depthBiasConastantFactor, BiasClamp, BiasSlopeFactor
 
@@ -325,9 +1196,12 @@ void HelloTriangleApplication::createGraphicsPipeline()
 	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 	// minSampleShading, pSampleMask, alphaToCoverageEnable, alphaToOneEnable
 
-	// depth/stencil test
+	// depth/stencil test, only the culled instances have a depth buffer
 	VkPipelineDepthStencilStateCreateInfo depthtest{};
-	//depthtest = nullptr;
+	depthtest.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthtest.depthTestEnable = VK_TRUE;
+	depthtest.depthWriteEnable = VK_TRUE;
+	depthtest.depthCompareOp = VK_COMPARE_OP_LESS;
 
 	// color blending - additive or bitwise operation on framebuffer
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
@@ -348,7 +1222,7 @@ void HelloTriangleApplication::createGraphicsPipeline()
 
 	// Configure what states can be reconfigured at runtime:
 	VkDynamicState dynamicStates[] = {
-		VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_LINE_WIDTH
+		VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
 	};
 	VkPipelineDynamicStateCreateInfo dynamicState{};
 	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -359,12 +1233,27 @@ void HelloTriangleApplication::createGraphicsPipeline()
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	//setLayoutCount, pSetLayouts, pushConstantRangeCount, pPushConstantRanges
-	if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout)!=VK_SUCCESS)
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(meshConstants); // mesh transform and uv dequantization
+	if(meshLoaded)
+	{
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	}
+	// instances read their world matrix and slot list from set 0
+	VkDescriptorSetLayout drawSetLayout = culler.drawSetLayout();
+	if(occlusionEnabled)
+	{
+		pushConstantRange.size = sizeof(ScenePushConstants);
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &drawSetLayout;
+	}
+	if(cachedPipelineLayout(device, pipelineLayoutInfo, pipelineLayout)!=VK_SUCCESS)
 		throw std::runtime_error("Could not create pipeline layout!\n");
 	
-	#ifdef DEBUG 
-		printf("DEBUG: Pipeline layout created successfully.\n");
-	#endif 
+	LOG_DEBUG("Pipeline layout created successfully.\n");
 
 	// assemble pipeline from layout
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
@@ -376,52 +1265,42 @@ void HelloTriangleApplication::createGraphicsPipeline()
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pDepthStencilState = occlusionEnabled ? &depthtest : nullptr;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
+	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = pipelineLayout;
 	pipelineInfo.renderPass = renderPass;
 	pipelineInfo.subpass = 0; // subpass index
+	// without a render pass the pipeline only needs to know the attachment formats
+	VkPipelineRenderingCreateInfo renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+	renderingInfo.depthAttachmentFormat = depthFormat;
+	if(dynamicRendering)
+	{
+		pipelineInfo.pNext = &renderingInfo;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
+	}
 	// pipeline derivitive - optional:
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
-	// the null is pipline cache which can be reused to make more pipelines
-	if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline)!=VK_SUCCESS)
+	// identical state gets the pipeline built the first time
+	if(cachedGraphicsPipeline(device, pipelineInfo, graphicsPipeline)!=VK_SUCCESS)
 		throw std::runtime_error("Couldn't create graphics pipeline!\n");
 
-	#ifdef DEBUG 
-		printf("DEBUG: Graphics pipeline assembled OK!\n");
-	#endif 
-
-	// destroy the shader modules after the pipeline is done
-	vkDestroyShaderModule(device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
-}
-
-VkShaderModule HelloTriangleApplication::createShaderModule(const std::vector<char>& code)
-{
-	// need to use special function to ensure size is maintained properly when recast to uint32_t*
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	
-	VkShaderModule shaderModule;
-	if(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
-		throw std::runtime_error("Could not create shader module!\n");
-	
-	return shaderModule;
+	LOG_DEBUG("Graphics pipeline assembled OK!\n");
 }
 
-void HelloTriangleApplication::createImageViews()
+void HelloTriangleApplication::createImageViews(WindowTarget& target)
 {
 	// obviously should be the same size:
-	swapChainImageViews.resize(swapChainImages.size());
-	for(size_t i = 0; i < swapChainImages.size(); i++)
+	target.imageViews.resize(target.images.size());
+	for(size_t i = 0; i < target.images.size(); i++)
 	{
 		VkImageViewCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		createInfo.image = swapChainImages[i];
+		createInfo.image = target.images[i];
 		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; // standard type as 2d texture
 		createInfo.format = swapChainImageFormat;
 		// here we can swizzle the color channels if we want, but not yet
@@ -437,14 +1316,14 @@ void HelloTriangleApplication::createImageViews()
 		createInfo.subresourceRange.layerCount = 1;
 		// if this were stereoscopic, the swapchain would have multiple layers. then 
 		// you would make multiple image views for each image as R/L eyes via layers.
-		if(vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS)
+		if(vkCreateImageView(device, &createInfo, hostAllocator(), &target.imageViews[i]) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create image views!\n");
 	}
 }
 
-void HelloTriangleApplication::createSurface()
+void HelloTriangleApplication::createSurface(WindowTarget& target)
 {
-	if(glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+	if(glfwCreateWindowSurface(instance, target.window, hostAllocator(), &target.surface) != VK_SUCCESS)
 		throw std::runtime_error("Could not create glfw window surface!");
 	// else OK.
 }
@@ -472,13 +1351,61 @@ void HelloTriangleApplication::createLogicalDevice()
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	// optional extensions ride along with the required ones
+	std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.presentWait = VK_TRUE;
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.presentId = VK_TRUE;
+	presentIdFeatures.pNext = &presentWaitFeatures;
+	if(presentWaitEnabled)
+	{
+		enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		presentWaitFeatures.pNext = (void*)createInfo.pNext;
+		createInfo.pNext = &presentIdFeatures;
+	}
+	// dynamic rendering, from core 1.3 or the KHR extension; BENT_DYNAMIC_RENDERING=0 keeps render passes
+	bool renderingExtensionNeeded = false;
+	const char* useDynamicRendering = getenv("BENT_DYNAMIC_RENDERING");
+	dynamicRendering = (useDynamicRendering == nullptr || strcmp(useDynamicRendering, "0") != 0) && \
+		checkDynamicRenderingSupport(physicalDevice, renderingExtensionNeeded);
+	VkPhysicalDeviceDynamicRenderingFeatures renderingFeatures{};
+	renderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+	renderingFeatures.dynamicRendering = VK_TRUE;
+	if(dynamicRendering)
+	{
+		if(renderingExtensionNeeded) enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		renderingFeatures.pNext = (void*)createInfo.pNext;
+		createInfo.pNext = &renderingFeatures;
+	}
+	// timeline semaphores for queue sync, from core 1.2 or the KHR extension
+	bool timelineExtensionNeeded = false;
+	timelineSemaphores = checkTimelineSemaphoreSupport(physicalDevice, timelineExtensionNeeded);
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	if(timelineSemaphores)
+	{
+		if(timelineExtensionNeeded) enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		timelineFeatures.pNext = (void*)createInfo.pNext;
+		createInfo.pNext = &timelineFeatures;
+	}
+	// per heap budget and usage from the driver; core 1.1 is needed for the properties2 query
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	memoryBudget = deviceProperties.apiVersion >= VK_API_VERSION_1_1 && \
+		hasDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if(memoryBudget) enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 	//createInfo.pQueueCreateInfos = &queueCreateInfo;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
 	// legacy support:
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	if(enableValidationLayers){
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
 		createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -486,15 +1413,24 @@ void HelloTriangleApplication::createLogicalDevice()
 		createInfo.enabledLayerCount = 0;
 	}
 	// finally create device
-	if(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
+	if(vkCreateDevice(physicalDevice, &createInfo, hostAllocator(), &device) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create logical Vulkan device.");
 	// otherwise OK!
+	// the frame loop calls the device directly through vkd, counted per frame
+	vkd.init(device);
+	deletionQueue.init(device);
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+	if(timelineSemaphores) loadTimelineFunctions(device);
+	dynamicRendering = dynamicRendering && vkd.hasDynamicRendering();
+	LOG_INFO("Rendering: %s\n", dynamicRendering ? "dynamic rendering" : "render pass + framebuffers");
+	graphicsTimeline.init(device, graphicsQueue, timelineSemaphores);
+	LOG_INFO("Queue sync: %s\n", timelineSemaphores ? "timeline semaphores" : "fences (no timeline semaphore support)");
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
-	#ifdef DEBUG 
-		printf("DEBUG: Graphics family queue index: %d\n", indices.graphicsFamily.value());
-		printf("DEBUG: Presentation family queue index: %d\n", indices.presentFamily.value());
-	#endif
+	if(presentWaitEnabled)
+		waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+	presentWaitEnabled = waitForPresent != nullptr;
+	LOG_DEBUG("Graphics family queue index: %d\n", indices.graphicsFamily.value());
+	LOG_DEBUG("Presentation family queue index: %d\n", indices.presentFamily.value());
 }
 
 
@@ -533,19 +1469,24 @@ QueueFamilyIndices HelloTriangleApplication::findQueueFamilies(VkPhysicalDevice
 	for (const auto& queueFamily : queueFamilies)
 	{
 		if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsFamily = i;
-		// Ensure graphics queue family and physical device support Khronos Surface rendering
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		// Ensure graphics queue family and physical device support Khronos Surface rendering,
+		// to every window's surface since they are presented together
+		bool presentSupport = true;
+		for(WindowTarget& target : windows)
+		{
+			VkBool32 surfaceSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, target.surface, &surfaceSupport);
+			presentSupport = presentSupport && surfaceSupport;
+		}
 		if(presentSupport) indices.presentFamily = i;
 
 		if(indices.isComplete()) {
-			#ifdef DEBUG 
-				printf("DEBUG: KHR surface support in graphics queue family found!\n");
-			#endif 
+			LOG_DEBUG("KHR surface support in graphics queue family found!\n");
 			break;
 		}
 		i++;
 	}
+	indices.computeFamily = findComputeQueueFamily(device);
 
 	return indices;
 }
@@ -564,22 +1505,39 @@ bool HelloTriangleApplication::isDeviceSuitable(VkPhysicalDevice device)
 	// swap chain support test - 1 format and 1 present mode OK
 	bool swapChainAdequate = false;
 	if(extensionsSupported){
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
-		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-		#ifdef DEBUG 
-			printf("DEBUG: At least one framebuffer format and display mode found. Continuing...\n");
-		#endif 
+		swapChainAdequate = true;
+		for(WindowTarget& target : windows)
+		{
+			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, target.surface);
+			swapChainAdequate = swapChainAdequate && !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+		}
+		if(swapChainAdequate) LOG_DEBUG("At least one framebuffer format and display mode found. Continuing...\n");
 	}
 	
 	return indices.isComplete() && extensionsSupported && swapChainAdequate; //graphicsFamily.has_value();
 	//return true;
 }
 
-void HelloTriangleApplication::createSwapChain()
+// the first window picks the format, ahead of the swapchains so the render pass and pipelines don't wait for them
+void HelloTriangleApplication::chooseSurfaceFormat()
 {
-	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, surface);
+	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, windows[0].surface);
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+	swapChainImageFormat = surfaceFormat.format;
+	swapChainColorSpace = surfaceFormat.colorSpace;
+}
+
+void HelloTriangleApplication::createSwapChain(WindowTarget& target)
+{
+	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, target.surface);
+	// every window takes the first one's format, so the render pass and pipelines fit them all
+	auto shared = std::find_if(swapChainSupport.formats.begin(), swapChainSupport.formats.end(), \
+		[this](const VkSurfaceFormatKHR& format) { return format.format == swapChainImageFormat; });
+	if(shared == swapChainSupport.formats.end())
+		throw std::runtime_error("Windows have no surface format in common!\n");
+	VkSurfaceFormatKHR surfaceFormat = { swapChainImageFormat, shared->colorSpace };
+	if(&target == &windows[0]) surfaceFormat.colorSpace = swapChainColorSpace;
+	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, latencyPresentMode(latencyMode));
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
 	// try to get 1 extra framebuffer image, for optimization sake
@@ -590,7 +1548,7 @@ void HelloTriangleApplication::createSwapChain()
 	// tie swapchain to app's parent VkSurfaceKHR surface
 	VkSwapchainCreateInfoKHR createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	createInfo.surface = surface;
+	createInfo.surface = target.surface;
 	// populate all the good stuff 
 	createInfo.minImageCount = imageCount;
 	createInfo.imageFormat = surfaceFormat.format;
@@ -599,6 +1557,9 @@ void HelloTriangleApplication::createSwapChain()
 	createInfo.imageArrayLayers = 1; // 2 if you are making stereoscopic 3D 
 	// direct render:
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// copy out for frame capture where the surface allows it
+	target.readable = swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if(target.readable) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 	// render to separate image(post-process):
 	//createInfo.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
@@ -624,18 +1585,14 @@ void HelloTriangleApplication::createSwapChain()
 	createInfo.clipped = VK_TRUE; // unless you need to read clipped pixels for some reason!
 	createInfo.oldSwapchain = VK_NULL_HANDLE; // for later
 
-	if(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
+	if(vkCreateSwapchainKHR(device, &createInfo, hostAllocator(), &target.swapChain) != VK_SUCCESS)
 		throw std::runtime_error("Couldn't create swapchain (aka framebuffer)!\n");
 
-	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
-	swapChainImages.resize(imageCount);
-	#ifdef DEBUG 
-		printf("DEBUG: Framebuffer image count: %d\n", imageCount);
-	#endif 
-	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
-	
-	swapChainImageFormat = surfaceFormat.format;
-	swapChainExtent = extent;
+	vkGetSwapchainImagesKHR(device, target.swapChain, &imageCount, nullptr);
+	target.images.resize(imageCount);
+	LOG_DEBUG("Framebuffer image count: %d\n", imageCount);
+	vkGetSwapchainImagesKHR(device, target.swapChain, &imageCount, target.images.data());
+	target.extent = extent;
 }
 
 void HelloTriangleApplication::setupDebugMessenger()
@@ -655,7 +1612,7 @@ void HelloTriangleApplication::setupDebugMessenger()
 	createInfo.pfnUserCallback = debugCallback;
 	createInfo.pUserData = nullptr; //opt
 	*/
-	if(CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+	if(CreateDebugUtilsMessengerEXT(instance, &createInfo, hostAllocator(), &debugMessenger) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to setup debug messenger.");
 	}
@@ -666,34 +1623,79 @@ void HelloTriangleApplication::setupDebugMessenger()
 // * APP CLEANUP * // 
 void HelloTriangleApplication::cleanup()
 {
-	//vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-	//vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
+	jobs.stop();
+	// the device is idle: hand the last captured frames to the encoder and let it finish
+	frameCapture.poll(graphicsTimeline.completed());
+	frameCapture.destroy();
+	// whatever is still queued for deletion can go now, before the pools its descriptor sets came from
+	deletionQueue.flush();
+	spriteBatch.destroy();
+	textureStreamer.destroy();
+	culler.destroy();
+
+	for(WindowTarget& target : windows)
+	{
+		for(auto semaphore : target.renderFinishedSemaphores)
+			vkDestroySemaphore(device, semaphore, hostAllocator());
+		for(auto semaphore : target.imageAvailableSemaphores)
+			vkDestroySemaphore(device, semaphore, hostAllocator());
+	}
+	graphicsTimeline.destroy();
 
-	vkDestroyCommandPool(device, commandPool, nullptr);
+	for(size_t i = 0; i < transformBuffers.size(); i++)
+	{
+		vkUnmapMemory(device, transformBuffersMemory[i]);
+		vkDestroyBuffer(device, transformBuffers[i], hostAllocator());
+		freeDeviceMemory(device, transformBuffersMemory[i]);
+	}
 
-	for(auto framebuffer:swapChainFramebuffers)
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	if(meshLoaded)
+	{
+		vkDestroyBuffer(device, indexBuffer, hostAllocator());
+		freeDeviceMemory(device, indexBufferMemory);
+		vkDestroyBuffer(device, vertexBuffer, hostAllocator());
+		freeDeviceMemory(device, vertexBufferMemory);
+	}
 
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-	vkDestroyRenderPass(device, renderPass, nullptr);
+	vkDestroyCommandPool(device, commandPool, hostAllocator());
+	for(WindowTarget& target : windows)
+		vkDestroyCommandPool(device, target.commandPool, hostAllocator());
 
-	for (auto imageView:swapChainImageViews)
+	for(WindowTarget& target : windows)
 	{
-		vkDestroyImageView(device, imageView, nullptr);
+		for(auto framebuffer : target.framebuffers)
+			vkDestroyFramebuffer(device, framebuffer, hostAllocator());
+		if(target.depthImage == VK_NULL_HANDLE) continue;
+		vkDestroyImageView(device, target.depthView, hostAllocator());
+		vkDestroyImage(device, target.depthImage, hostAllocator());
+		freeDeviceMemory(device, target.depthMemory);
 	}
 
-	vkDestroySwapchainKHR(device, swapChain, nullptr); //  before device
-	vkDestroyDevice(device, nullptr); 
-	vkDestroySurfaceKHR(instance, surface, nullptr); // before instance
+	logPipelineCacheStats("exit");
+	destroyPipelineStates(device); // every pipeline, layout and module, before the render passes in their keys
+	vkDestroyRenderPass(device, renderPass, hostAllocator());
+	for(VkRenderPass pass : cullRenderPasses)
+		vkDestroyRenderPass(device, pass, hostAllocator());
+
+	for(WindowTarget& target : windows)
+	{
+		for (auto imageView : target.imageViews)
+		{
+			vkDestroyImageView(device, imageView, hostAllocator());
+		}
+		vkDestroySwapchainKHR(device, target.swapChain, hostAllocator()); //  before device
+	}
+	vkDestroyDevice(device, hostAllocator()); 
+	for(WindowTarget& target : windows)
+		vkDestroySurfaceKHR(instance, target.surface, hostAllocator()); // before instance
 	if(enableValidationLayers){
-		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator());
 	}
-	vkDestroyInstance(instance, nullptr); // after surface
+	vkDestroyInstance(instance, hostAllocator()); // after surface
 	
-	glfwDestroyWindow(window); // after vulkan
+	logHostAllocationStats("exit"); // anything still live here leaked
+	for(WindowTarget& target : windows)
+		glfwDestroyWindow(target.window); // after vulkan
 	glfwTerminate();
-	#ifdef DEBUG 
-		printf("DEBUG: Process cleaned up OK.\n");
-	#endif 
+	LOG_DEBUG("Process cleaned up OK.\n");
 }
@@ -7,12 +7,40 @@
 #include <set>
 #include <cstdint>
 #include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <memory>
+#include <string>
 
 // main app defines here:
 #include "benvulkan.hpp"
+#include "transform.hpp"
+#include "meshloader.hpp"
+#include "vertexlayout.hpp"
+#include "framepacing.hpp"
+#include "deletionqueue.hpp"
+#include "gpusync.hpp"
+#include "capture.hpp"
+#include "spritebatch.hpp"
+#include "initgraph.hpp"
+#include "jobsystem.hpp"
+#include "occlusion.hpp"
+#include "shadervariant.hpp"
+#include "pipelinestate.hpp"
+#include "texture.hpp"
+#include <glm/gtc/matrix_transform.hpp>
 
 #define WINDOW_TITLE "Bent Vulkan"
+#define MAX_SCENE_NODES 131072  // capacity of each per-frame transform upload buffer
+#define MESH_PATH "meshes/scene.bmesh" // drawn instead of the triangle when present, see tools/meshconv
+#define MAX_FRAMES_IN_FLIGHT 2  // frames the CPU may record ahead of the GPU
+#define LATENCY_MODE LATENCY_MAILBOX // default, override with BENT_LATENCY_MODE=immediate|mailbox|fifo
+#define MAX_WINDOWS 4           // BENT_WINDOWS=<count>, one per monitor where there are enough
+#define PRESENT_WAIT_TIMEOUT 100000000ull // ns, so a hidden window can't hang the frame loop
+#define SPRITE_CAPACITY 16384   // sprites per frame at least, BENT_SPRITES=<count> starts the bouncing sprite demo
+#define TEXTURE_ZOOM_SECONDS 8.0f // BENT_TEXTURE=<file.btex>: one zoom of its sprite in and out
+#define CAMERA_ORBIT_SPEED 0.2f // radians per second around the BENT_INSTANCES grid
+#define LOD_ERROR_PIXELS 1.0f   // projected error an instance's LOD may have, override with BENT_LOD_ERROR=<pixels>
 
 class HelloTriangleApplication
 {
@@ -23,44 +51,154 @@ class HelloTriangleApplication
         const uint32_t WIDTH = _WIDTH;
         const uint32_t HEIGHT = _HEIGHT;
 
-		GLFWwindow* window;         // window wrapper
-
 		VkInstance instance;        // vulkan instance
         VkDebugUtilsMessengerEXT debugMessenger; // vulkan debugger
-		VkSurfaceKHR surface;       // render surface
         VkDevice device;            // logical device
         VkPhysicalDevice physicalDevice;    // physical device
         VkQueue graphicsQueue;      // render queue
-        VkQueue presentQueue;       // display queue
-        VkSwapchainKHR swapChain;   // framebuffer contents
-        std::vector<VkImage> swapChainImages;   // image data
-        std::vector<VkImageView> swapChainImageViews; // 'views' are portions of an image
-        VkFormat swapChainImageFormat;  // pixel format
-        VkExtent2D swapChainExtent;     // display size
+        VkQueue presentQueue;       // display queue, presents every window at once
+        // one window on the shared device: its own surface and swapchain, everything else is shared
+        struct WindowTarget
+        {
+            GLFWwindow* window = nullptr;       // window wrapper
+            VkSurfaceKHR surface = VK_NULL_HANDLE; // render surface
+            VkSwapchainKHR swapChain = VK_NULL_HANDLE; // framebuffer contents
+            std::vector<VkImage> images;        // image data
+            std::vector<VkImageView> imageViews; // 'views' are portions of an image
+            std::vector<VkFramebuffer> framebuffers; // swapchain + render pass = framebuffer
+            VkExtent2D extent;                  // display size
+            VkImage depthImage = VK_NULL_HANDLE; // with occlusion culling, shared by the window's images
+            VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+            VkImageView depthView = VK_NULL_HANDLE;
+            bool readable = false;              // images can be copied from, for frame capture
+            VkCommandPool commandPool = VK_NULL_HANDLE; // own pool, so windows are recorded in parallel
+            std::vector<VkCommandBuffer> commandBuffers; // per swapchain image
+            std::vector<VkSemaphore> imageAvailableSemaphores;  // per frame in flight
+            std::vector<VkSemaphore> renderFinishedSemaphores;  // per swapchain image, held until it's presented
+            std::vector<uint64_t> imageValues;  // graphics value of the last frame using each image
+            uint32_t imageIndex = 0;            // acquired for the current frame
+        };
+        std::vector<WindowTarget> windows;      // BENT_WINDOWS, the first one takes input and captures
+        VkFormat swapChainImageFormat;          // pixel format, shared by every swapchain
+        VkColorSpaceKHR swapChainColorSpace;
         VkPipelineLayout pipelineLayout;    // shader configuration
-        VkRenderPass renderPass;        // rendering subpass definitions
+        VkRenderPass renderPass = VK_NULL_HANDLE; // rendering subpass definitions, unused with dynamic rendering
+        VkRenderPass cullRenderPasses[2] = {};  // first pass keeps the image for the second, which loads it and presents
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED; // only with occlusion culling
         VkPipeline graphicsPipeline;    // container
-        std::vector<VkFramebuffer> swapChainFramebuffers;   // swapchain + pipeline = framebuffer
         VkCommandPool commandPool;      // set command pool to graphics or present family (graphics)
-        std::vector<VkCommandBuffer> commandBuffers; // allocates and records swapchain draw commands
-        VkSemaphore imageAvailableSemaphore;
-        VkSemaphore renderFinishedSemaphore;
+        JobSystem jobs;                         // frame work, BENT_JOB_THREADS workers next to the main thread
+        bool dynamicRendering = false;          // vkCmdBeginRendering instead of renderPass + framebuffers
+        bool timelineSemaphores = false;
+        bool memoryBudget = false;              // VK_EXT_memory_budget enabled
+        QueueTimeline graphicsTimeline;         // every graphics queue submit signals the next value
+        std::vector<uint64_t> frameValues;      // graphics value of the last submit per frame in flight
+        uint64_t meshUploadValue = 0;           // frames wait for this before fetching vertices
+        size_t currentFrame = 0;
+        DeletionQueue deletionQueue;            // tagged with graphics values, destroyed once they retired
+
+        // frame pacing and latency measurement
+        LatencyMode latencyMode = LATENCY_MODE;
+        FrameLimiter frameLimiter;
+        bool presentWaitEnabled = false;        // VK_KHR_present_id + VK_KHR_present_wait
+        PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+        uint64_t presentId = 0;                 // id of the last queued present
+        struct PendingPresent { uint64_t id; FrameClock::time_point submitted; };
+        std::vector<PendingPresent> pendingPresents; // oldest first
+        LatencyStat inputToSubmit, submitToPresent;
+        FrameClock::time_point lastLatencyReport;
+        HostAllocationStats lastHostStats;      // driver host allocations at the last report
+        FrameClock::time_point startupBegin;    // run() entry, for time to first frame
+        bool firstFramePresented = false;
+        ShaderVariants shaderVariants;          // every pipeline's shaders, deduplicated by key
+        const ShaderProfile* shaderProfile = nullptr; // BENT_SHADER_PROFILE=pi|desktop, picked for the device by default
+        const ShaderVariant* vertShader = nullptr;  // the main pipeline's, chosen by a startup worker
+        const ShaderVariant* fragShader = nullptr;
+
+        FrameCapture frameCapture;              // BENT_CAPTURE stream and F12 screenshots
+        bool screenshotKeyDown = false;
+
+        SpriteBatch spriteBatch;                // 2D layer drawn after the scene, see spritebatch.hpp
+        bool spritesEnabled = false;            // command buffers are then recorded every frame
+        struct SpriteMotion { float vx, vy, spin; }; // pixels and radians per second
+        std::vector<Sprite> demoSprites;
+        std::vector<SpriteMotion> demoMotion;
+        FrameClock::time_point lastSpriteUpdate;
+        uint64_t spriteDraws = 0, spriteQuads = 0, spriteFrames = 0; // since the last report
+
+        // BENT_TEXTURE=<file.btex>: a streamed texture on a sprite zooming from a thumbnail to one texel a pixel
+        TextureStreamer textureStreamer;
+        bool textureStreaming = false;
+        uint32_t streamedTexture = 0;
+        uint16_t streamedSpriteTexture = 0;     // the same texture in the sprite batch
+        uint32_t streamedGeneration = 0;        // of the view the sprite batch has
+        Sprite zoomSprite;
+        float zoomSeconds = 0.0f;
+
+        TransformHierarchy sceneTransforms;     // scene graph, world matrices rebuilt each frame
+        std::vector<VkBuffer> transformBuffers; // per frame in flight world matrix upload buffers
+        std::vector<VkDeviceMemory> transformBuffersMemory;
+        std::vector<void*> transformBuffersMapped; // persistently mapped, host coherent
+
+        // BENT_INSTANCES=<count>: a grid of mesh instances, culled on the GPU against the frustum and a depth pyramid
+        OcclusionCuller culler;
+        bool occlusionEnabled = false;          // command buffers are then recorded every frame
+        uint32_t instanceCount = 0;
+        glm::vec3 meshCenter;                   // bounds of the mesh, for the instances' spheres
+        float meshRadius = 0.0f;
+        ScenePushConstants sceneConstants;      // instanced draws: camera and dequantization
+        CullCamera cullCamera;                  // the first window's camera, this frame
+        struct { uint64_t visible, late, frustumCulled, occluded, triangles; } cullTotals{}; // summed since the last report
+        uint64_t cullFrames = 0;
+
+        std::unique_ptr<MeshFile> meshFile;     // mapped until its sections are uploaded
+        bool meshLoaded = false;
+        VkBuffer vertexBuffer;                  // device local mesh data
+        VkDeviceMemory vertexBufferMemory;
+        VkBuffer indexBuffer;
+        VkDeviceMemory indexBufferMemory;
+        VkIndexType meshIndexType;
+        uint32_t meshIndexCount;                // LOD 0
+        std::vector<MeshLod> meshLods;          // index ranges and errors, kept after the mesh file is dropped
+        uint32_t meshVertexLayout;              // VertexLayoutId of the packed vertices
+        struct MeshPushConstants {
+            glm::mat4 transform;                // fits the mesh bounds into a square viewport, dequantizes positions
+            glm::vec4 uvTransform;              // uv dequantization: xy scale, zw offset
+        } meshConstants;
 
         // Functions
         void initWindow();
         int initVulkan();
         void createLogicalDevice();
         //VkResult createInstance();
-        void createSurface();
-        void createImageViews();
-        void createSwapChain();
+        void createSurface(WindowTarget& target);
+        void createImageViews(WindowTarget& target);
+        void chooseSurfaceFormat();
+        void createSwapChain(WindowTarget& target);
         void createRenderPass();
+        VkRenderPass createSceneRenderPass(bool clear, bool present);
+        void createDepthBuffer(WindowTarget& target);
+        void createCulling();
+        void createInstances();
+        void updateCamera();
+        void beginScenePass(VkCommandBuffer commandBuffer, WindowTarget& target, uint32_t imageIndex, bool clear, bool present);
+        void endScenePass(VkCommandBuffer commandBuffer, WindowTarget& target, uint32_t imageIndex, bool present);
         void createGraphicsPipeline();
-        VkShaderModule createShaderModule(const std::vector<char>& code);
         void createCommandPool();
+        void startJobs();
         void createCommandBuffers();
-        void createFramebuffers();
-        void createSemaphores();
+        void recordCommandBuffer(WindowTarget& target, uint32_t imageIndex);
+        void createFramebuffers(WindowTarget& target);
+        void createSyncObjects();
+        void chooseLatencyMode();
+        void createTransformBuffers();
+        void createCapture();
+        void createSprites();
+        void updateZoomSprite(float dt);
+        void updateSprites();
+        void loadMesh();
+        void loadShaders();
+        void createMeshBuffers();
 
         void pickPhysicalDevice();
         bool isDeviceSuitable(VkPhysicalDevice device);
@@ -68,6 +206,8 @@ class HelloTriangleApplication
         
         void mainLoop();
         void drawFrame();
+        void collectPresents(uint64_t timeout);
+        void reportLatency();
 
         void cleanup();
 
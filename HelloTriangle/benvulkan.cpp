@@ -8,6 +8,7 @@
 #include <cstring>
 #include <optional>
 #include <set>
+#include <algorithm>
 
 #include "benvulkan.hpp"
 
@@ -16,6 +17,16 @@
 
 std::vector<const char*> gl_extensions;
 
+// the newest instance version the loader takes, capped at wanted; a 1.0 loader has no
+// vkEnumerateInstanceVersion and fails vkCreateInstance for anything above 1.0
+uint32_t instanceApiVersion(uint32_t wanted)
+{
+	auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+	uint32_t version = VK_API_VERSION_1_0;
+	if(enumerateInstanceVersion == nullptr || enumerateInstanceVersion(&version) != VK_SUCCESS) version = VK_API_VERSION_1_0;
+	return std::min(version, wanted);
+}
+
 VkResult createInstance(VkInstance& instance)
 {
 	// validation layer check - only if debug mode
@@ -33,7 +44,9 @@ VkResult createInstance(VkInstance& instance)
 	appInfo.pEngineName = ENGINE_NAME;
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 	
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// features2 queries, timeline semaphores and dynamic rendering where the device has them
+	appInfo.apiVersion = instanceApiVersion(VK_API_VERSION_1_3);
+	LOG_DEBUG("instance api version %u.%u\n", VK_VERSION_MAJOR(appInfo.apiVersion), VK_VERSION_MINOR(appInfo.apiVersion));
 
 	// createInfo (pg 58)
 	VkInstanceCreateInfo createInfo{};
@@ -52,9 +65,7 @@ VkResult createInstance(VkInstance& instance)
 	gl_extensions = std::vector<const char*>(glfwExtensionCount);
 	for(uint8_t c = 0; c < glfwExtensionCount; c++){
 		gl_extensions[c] = glfwExtensions[c];
-		#ifdef DEBUG
-			printf("DEBUG: glfw required extension: %s\n", gl_extensions[c]);
-		#endif
+		LOG_DEBUG("glfw required extension: %s\n", gl_extensions[c]);
 	}
 	auto extensions = getRequiredExtensions();
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
@@ -77,7 +88,7 @@ VkResult createInstance(VkInstance& instance)
 	}
 
 	// finally create vulkan instance
-	VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
+	VkResult result = vkCreateInstance(&createInfo, hostAllocator(), &instance);
 	return result;
 }
 
@@ -114,7 +125,15 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(\
 	const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,\
 	void* pUserData)
 {
-	std::cerr << "DEBUG: validation layer: " << pCallbackData->pMessage << std::endl;
+	// queued for the log thread; runs on whichever thread made the Vulkan call
+	if(messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+		LOG_ERROR("validation layer: %s\n", pCallbackData->pMessage);
+	else if(messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+		LOG_WARN("validation layer: %s\n", pCallbackData->pMessage);
+	else if(messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)
+		LOG_INFO("validation layer: %s\n", pCallbackData->pMessage);
+	else
+		LOG_TRACE("validation layer: %s\n", pCallbackData->pMessage);
 	return VK_FALSE;
 }
 
@@ -122,9 +141,15 @@ void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& create
 {
     createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | \
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | \
+    // only ask the layers for severities the log level keeps, so filtered messages are never even built
+    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | \
         VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    #if LOG_LEVEL <= LOG_LEVEL_INFO
+        createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    #endif
+    #if LOG_LEVEL <= LOG_LEVEL_TRACE
+        createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    #endif
     createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | \
         VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | \
         VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
@@ -138,20 +163,18 @@ bool checkValidationLayerSupport(const std::vector<const char*> validationLayers
 	vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
 	std::vector<VkLayerProperties> availableLayers(layerCount);
 	vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-	printf("Layers: %d\n", layerCount);
+	LOG_DEBUG("Layers: %d\n", layerCount);
     
     for(const char* layerName : validationLayers) 
 	{
-		printf("validation layers required: %s\n", layerName);
+		LOG_DEBUG("validation layers required: %s\n", layerName);
 		bool layerFound = false;
 		for(const auto& layerProperties : availableLayers)
 		{
-			printf("found layers: %s\n", layerProperties.layerName);
+			LOG_TRACE("found layers: %s\n", layerProperties.layerName);
 			if (strcmp(layerName, layerProperties.layerName) == 0)
 			{
-				#ifdef DEBUG
-					printf("DEBUG: Validation layer found.\n");
-				#endif 
+				LOG_DEBUG("Validation layer found.\n");
 
 				layerFound = true;
 				break;
@@ -173,35 +196,28 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
 		if(availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && \
 			availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
 		{
-			#ifdef DEBUG 
-				printf("DEBUG: Selected priority format and colorspace: B8G8R8A8_SRGB and SRGB_NONLINEAR\n");
-			#endif
+			LOG_DEBUG("Selected priority format and colorspace: B8G8R8A8_SRGB and SRGB_NONLINEAR\n");
 			return availableFormat;
 		}
 	}
-	#ifdef DEBUG 
-		printf("DEBUG: Selected DEFAULT format and colorspace: %d, %d\n", availableFormats[0].format, availableFormats[0].colorSpace);
-	#endif
+	LOG_DEBUG("Selected DEFAULT format and colorspace: %d, %d\n", availableFormats[0].format, availableFormats[0].colorSpace);
 	return availableFormats[0];
 }
 
 // VSYNC / RELAXED VSYNC / TRIPLE BUFFERING
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+// FIFO is the only mode every implementation has to support, so it's the fallback
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred)
 {
 	for(const auto& availablePresentMode : availablePresentModes )
 	{
-		if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if(availablePresentMode == preferred)
 		{
-			#ifdef DEBUG 
-				printf("DEBUG: Selecting Mailbox presentation mode (triple buf)\n");
-			#endif 
+			LOG_DEBUG("Selecting preferred presentation mode %d\n", preferred);
 			return availablePresentMode;
 		}
 	}
 
-	#ifdef DEBUG 
-		printf("DEBUG: Selecting FIFO presentation mode (vsync)\n");
-	#endif 
+	LOG_DEBUG("Selecting FIFO presentation mode (vsync)\n");
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -210,18 +226,14 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
 {
 	if(capabilities.currentExtent.width != UINT32_MAX)
 	{
-		#ifdef DEBUG 
-			printf("DEBUG: Selected default surface resolution: %d x %d\n", capabilities.currentExtent.width, capabilities.currentExtent.height);
-		#endif 
+		LOG_DEBUG("Selected default surface resolution: %d x %d\n", capabilities.currentExtent.width, capabilities.currentExtent.height);
 		return capabilities.currentExtent;
 	} 
 	else {
 		VkExtent2D actualExtent = { _WIDTH, _HEIGHT };
 		actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
 		actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
-		#ifdef DEBUG 
-			printf("DEBUG: Selected NEW surface resolution: %d x %d\n", actualExtent.width, actualExtent.height);
-		#endif 
+		LOG_DEBUG("Selected NEW surface resolution: %d x %d\n", actualExtent.width, actualExtent.height);
 		return actualExtent;
 	}
 }
@@ -290,22 +302,48 @@ bool checkExtensions()
 		}
 		if(!ok)
 		{
-			printf("Error: Required extension %s not found.\n",gl_extensions[c]);
+			LOG_ERROR("Required extension %s not found.\n", gl_extensions[c]);
 			return false;
 		}
 	}
 	if(found < gl_extensions.size()){
-		printf("Error: All extensions not found.\n");
+		LOG_ERROR("All extensions not found.\n");
 		return false;
 	}
 
-	#ifdef DEBUG
-		printf("DEBUG: Vulkan init OK: %d extensions detected\n", extensionCount);
-	#endif 
+	LOG_DEBUG("Vulkan init OK: %d extensions detected\n", extensionCount);
 
 	return true;
 }
 
+bool hasDeviceExtension(VkPhysicalDevice device, const char* name)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+	for(const auto& extension : availableExtensions)
+		if(strcmp(extension.extensionName, name) == 0) return true;
+	return false;
+}
+
+// compute capable queue family, preferring one without graphics so compute can overlap rendering
+std::optional<uint32_t> findComputeQueueFamily(VkPhysicalDevice device)
+{
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	std::optional<uint32_t> family;
+	for(uint32_t i = 0; i < queueFamilyCount; i++)
+	{
+		if(!(queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) continue;
+		if(!(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) return i;
+		if(!family.has_value()) family = i;
+	}
+	return family;
+}
+
 bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
 	
@@ -319,11 +357,229 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 	for(const auto& extension:availableExtensions)
 	{
-		#ifdef DEBUG 
-			printf("DEBUG: Available extension: %s\n", extension.extensionName);
-		#endif 
+		LOG_TRACE("Available extension: %s\n", extension.extensionName);
 		requiredExtensions.erase(extension.extensionName);
 	}
 	// if its empty, we are good
 	return requiredExtensions.empty();
 }
+
+
+// find a memory type index allowed by typeFilter that has all requested property flags
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+	throw std::runtime_error("Failed to find suitable memory type!\n");
+}
+
+// create a buffer and bind it to its own dedicated allocation
+void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, \
+	VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, MemoryCategory category)
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // only used by the graphics queue
+	if(vkCreateBuffer(device, &bufferInfo, hostAllocator(), &buffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create buffer!\n");
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+	if(allocateDeviceMemory(device, allocInfo, category, bufferMemory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate buffer memory!\n");
+	vkBindBufferMemory(device, buffer, bufferMemory, 0);
+}
+
+// whole words and the SPIR-V magic number, so a truncated or stale file fails here and not in the driver
+std::vector<char> readSpirvFile(const std::string& path)
+{
+	auto code = readBinaryFile(path);
+	const uint32_t magic = 0x07230203;
+	if(code.size() < 5 * sizeof(uint32_t) || code.size() % sizeof(uint32_t) != 0 || memcmp(code.data(), &magic, sizeof(magic)) != 0)
+		throw std::runtime_error("Shader file is not SPIR-V: " + path + "\n");
+	return code;
+}
+
+// SPIR-V file -> shader module; destroy it once the pipelines using it exist
+VkShaderModule loadShaderModule(VkDevice device, const std::string& path)
+{
+	return createShaderModule(device, readSpirvFile(path));
+}
+
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code)
+{
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	VkShaderModule module;
+	if(vkCreateShaderModule(device, &createInfo, hostAllocator(), &module) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shader module!\n");
+	return module;
+}
+
+// allocate and begin a throwaway command buffer for uploads and layout changes
+VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+	VkCommandBuffer commandBuffer;
+	if(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate transfer command buffer!\n");
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	return commandBuffer;
+}
+
+// submit, wait for completion and free the command buffer
+void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer)
+{
+	vkEndCommandBuffer(commandBuffer);
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	if(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit transfer command buffer!\n");
+	vkQueueWaitIdle(queue);
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}
+
+// true if vkCmdBeginRendering can be used; extensionNeeded is set when it has to come
+// from VK_KHR_dynamic_rendering (device older than 1.3, its dependencies are core in 1.2)
+bool checkDynamicRenderingSupport(VkPhysicalDevice physicalDevice, bool& extensionNeeded)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	extensionNeeded = properties.apiVersion < VK_API_VERSION_1_3;
+	if(extensionNeeded && (properties.apiVersion < VK_API_VERSION_1_2 || \
+		!hasDeviceExtension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)))
+		return false;
+	VkPhysicalDeviceDynamicRenderingFeatures renderingFeatures{};
+	renderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &renderingFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+	return renderingFeatures.dynamicRendering == VK_TRUE;
+}
+
+// layout transition for one color image, with the stages and accesses on both sides spelled out
+void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, \
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, \
+	VkImageAspectFlags aspect)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	vkd.cmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// first depth-only format with these optimal tiling features, VK_FORMAT_UNDEFINED if there is none
+VkFormat findDepthFormat(VkPhysicalDevice physicalDevice, VkFormatFeatureFlags features)
+{
+	const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+	for(VkFormat format : candidates)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+		if((props.optimalTilingFeatures & features) == features) return format;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+// full chain down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	while((width | height) >> levels) levels++;
+	return levels;
+}
+
+// vkCmdBlitImage with a linear filter from and to optimal tiling images of this format
+bool supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | \
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (props.optimalTilingFeatures & needed) == needed;
+}
+
+// each level is a linear blit of the one above; every level starts in TRANSFER_DST with level 0 written,
+// and ends in SHADER_READ_ONLY for the fragment shader
+void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t layers, \
+	uint32_t levels)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layers };
+	int32_t levelWidth = (int32_t)width, levelHeight = (int32_t)height;
+	for(uint32_t level = 1; level < levels; level++)
+	{
+		// the level above is complete: read it
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkd.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, \
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, layers };
+		blit.srcOffsets[1] = { levelWidth, levelHeight, 1 };
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layers };
+		blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+		vkd.cmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, \
+			1, &blit, VK_FILTER_LINEAR);
+
+		// and done with it
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkd.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, \
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+	barrier.subresourceRange.baseMipLevel = levels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkd.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, \
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -5,15 +5,20 @@
 #define _WIDTH 800
 #define _HEIGHT 600
 
-#define DEBUG 
 //#define RASPI 
 
+#include "log.hpp"
+#include "hostalloc.hpp"
+#include "vkdispatch.hpp"
+#include "memorybudget.hpp"
+
 const std::vector<const char*> deviceExtensions = \
 {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME 
 };
 
-#ifdef DEBUG 
+// validation layers and the debug messenger, make debug builds with -DBENT_DEBUG
+#ifdef BENT_DEBUG 
     const bool enableValidationLayers = true;
 #else 
     const bool enableValidationLayers = false;
@@ -22,6 +27,7 @@ const std::vector<const char*> deviceExtensions = \
 struct QueueFamilyIndices { 
     std::optional<uint32_t> graphicsFamily; // rendering hardware
     std::optional<uint32_t> presentFamily;  // displaying hardware
+    std::optional<uint32_t> computeFamily;  // compute, a dedicated family when there is one
     
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -58,15 +64,35 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,\
 void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 bool checkValidationLayerSupport(const std::vector<const char*> validationLayers);
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred);
 VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
 std::vector<const char*> getRequiredExtensions();
 bool checkExtensions();
+uint32_t instanceApiVersion(uint32_t wanted);
 VkResult createInstance(VkInstance& instance);
 bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
+std::optional<uint32_t> findComputeQueueFamily(VkPhysicalDevice device);
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, \
+    VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, MemoryCategory category = MEMORY_OTHER);
+std::vector<char> readSpirvFile(const std::string& path);
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code);
+VkShaderModule loadShaderModule(VkDevice device, const std::string& path);
+VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool);
+void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer);
+bool checkDynamicRenderingSupport(VkPhysicalDevice physicalDevice, bool& extensionNeeded);
+void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, \
+    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, \
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+VkFormat findDepthFormat(VkPhysicalDevice physicalDevice, VkFormatFeatureFlags features);
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+bool supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format);
+void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t layers, \
+    uint32_t levels);
         
-static std::vector<char> readBinaryFile(const std::string& filename)
+inline std::vector<char> readBinaryFile(const std::string& filename)
 {
     std::ifstream file(filename, std::ios::ate | std::ios::binary); // ate = at end
     if(!file.is_open()) throw std::runtime_error("Couldn't open file!\n");
@@ -75,9 +101,7 @@ static std::vector<char> readBinaryFile(const std::string& filename)
     file.seekg(0); // back to start
     file.read(buffer.data(), filesize); // read all bytes
     file.close();
-	#ifdef DEBUG 
-		printf("DEBUG: Loaded binary file %s OK.\n", filename.data());
-	#endif 
+	LOG_DEBUG("Loaded binary file %s OK.\n", filename.data());
     return buffer;
 }
 //
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include <stdexcept>
+#include <cstring>
+#include <csignal>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <filesystem>
+
+#include "benvulkan.hpp"
+#include "capture.hpp"
+#include "png.hpp"
+
+bool FrameCapture::configure(const char* spec)
+{
+	mode = CAPTURE_OFF;
+	if(!spec || !*spec) return true;
+	if(strncmp(spec, "png:", 4) == 0) mode = CAPTURE_PNG;
+	else if(strncmp(spec, "raw:", 4) == 0) mode = CAPTURE_RAW;
+	else return false;
+	target = spec + 4;
+	if(target.empty())
+	{
+		mode = CAPTURE_OFF;
+		return false;
+	}
+	return true;
+}
+
+bool FrameCapture::supportsFormat(VkFormat format)
+{
+	switch(format)
+	{
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// the CPU reads every byte back: prefer cached memory, which then needs invalidating
+static uint32_t findReadbackMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, bool& coherent)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	const VkMemoryPropertyFlags preferred[] = {
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+	for(VkMemoryPropertyFlags flags : preferred)
+		for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+			if((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & flags) == flags)
+			{
+				coherent = memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+				return i;
+			}
+	throw std::runtime_error("Failed to find readback memory type!\n");
+}
+
+void FrameCapture::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, VkExtent2D extent, VkFormat format)
+{
+	if(!supportsFormat(format))
+	{
+		LOG_WARN("Frame capture doesn't support swapchain format %d, disabled\n", (int)format);
+		return;
+	}
+	this->device = device;
+	this->extent = extent;
+	bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+
+	// copies are re-recorded per captured frame, so buffers are reset individually
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if(vkCreateCommandPool(device, &poolInfo, hostAllocator(), &commandPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create capture command pool!\n");
+
+	VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+	for(Slot& slot : slots)
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if(vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate capture command buffer!\n");
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if(vkCreateBuffer(device, &bufferInfo, hostAllocator(), &slot.buffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create capture buffer!\n");
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, slot.buffer, &memRequirements);
+		VkMemoryAllocateInfo memoryInfo{};
+		memoryInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryInfo.allocationSize = memRequirements.size;
+		memoryInfo.memoryTypeIndex = findReadbackMemoryType(physicalDevice, memRequirements.memoryTypeBits, coherent);
+		if(allocateDeviceMemory(device, memoryInfo, MEMORY_READBACK, slot.memory) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate capture buffer memory!\n");
+		vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+		vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, (void**)&slot.mapped);
+	}
+
+	if(mode == CAPTURE_PNG)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(target, error);
+		if(error)
+		{
+			LOG_WARN("Can't create capture directory %s: %s\n", target.c_str(), error.message().c_str());
+			mode = CAPTURE_OFF;
+		}
+	}
+	else if(mode == CAPTURE_RAW)
+	{
+		rawPipe = target[0] == '|';
+		if(rawPipe) signal(SIGPIPE, SIG_IGN); // a consumer that quits shows up as a write error instead
+		rawOut = rawPipe ? popen(target.c_str() + 1, "w") : fopen(target.c_str(), "wb");
+		if(!rawOut)
+		{
+			LOG_WARN("Can't open capture output %s\n", target.c_str());
+			mode = CAPTURE_OFF;
+		}
+	}
+	if(mode != CAPTURE_OFF)
+		LOG_INFO("Capturing %ux%u %s frames as %s to %s\n", extent.width, extent.height, bgra ? "BGRA" : "RGBA", \
+			mode == CAPTURE_PNG ? "PNG" : "raw", target.c_str());
+	worker = std::thread(&FrameCapture::workerLoop, this);
+	ready = true;
+}
+
+void FrameCapture::destroy()
+{
+	if(worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+	closeRawOutput();
+	if(ready) LOG_INFO("Frame capture: %llu frames captured, %llu dropped\n", \
+		(unsigned long long)frameCount, (unsigned long long)droppedCount);
+	for(Slot& slot : slots)
+	{
+		if(slot.mapped) vkUnmapMemory(device, slot.memory);
+		if(slot.buffer != VK_NULL_HANDLE) vkDestroyBuffer(device, slot.buffer, hostAllocator());
+		freeDeviceMemory(device, slot.memory);
+		slot.mapped = nullptr;
+		slot.buffer = VK_NULL_HANDLE;
+		slot.memory = VK_NULL_HANDLE;
+	}
+	if(commandPool != VK_NULL_HANDLE) vkDestroyCommandPool(device, commandPool, hostAllocator());
+	commandPool = VK_NULL_HANDLE;
+	ready = false;
+}
+
+VkCommandBuffer FrameCapture::record(VkImage image)
+{
+	// buffers are used round robin and come back in order, so only the next one can be free
+	Slot& slot = slots[nextSlot];
+	if(slot.state.load(std::memory_order_acquire) != SLOT_FREE)
+	{
+		droppedCount++;
+		return VK_NULL_HANDLE; // a pending screenshot stays requested for the next frame
+	}
+	VkCommandBuffer commandBuffer = slot.commandBuffer;
+	vkResetCommandBuffer(commandBuffer, 0);
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkd.beginCommandBuffer(commandBuffer, &beginInfo);
+
+	// runs after the frame's draw commands in the same submit; the image goes back to
+	// PRESENT_SRC before the present (which waits on the submit's semaphore)
+	transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, \
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, \
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {extent.width, extent.height, 1};
+	vkd.cmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+	transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, \
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+	// make the copy visible to host reads once the queue value is reached
+	VkBufferMemoryBarrier hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.buffer = slot.buffer;
+	hostBarrier.offset = 0;
+	hostBarrier.size = VK_WHOLE_SIZE;
+	vkd.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, \
+		0, nullptr, 1, &hostBarrier, 0, nullptr);
+	if(vkd.endCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to record capture command buffer!\n");
+
+	slot.continuous = mode != CAPTURE_OFF;
+	slot.frame = slot.continuous ? frameCount++ : 0;
+	slot.screenshot = screenshotRequested;
+	slot.screenshotIndex = screenshotRequested ? screenshotCount++ : 0;
+	screenshotRequested = false;
+	slot.state.store(SLOT_RECORDED, std::memory_order_relaxed);
+	recordedSlot = (int)nextSlot;
+	nextSlot = (nextSlot + 1) % CAPTURE_RING_SIZE;
+	return commandBuffer;
+}
+
+void FrameCapture::submitted(uint64_t value)
+{
+	if(recordedSlot < 0) return;
+	slots[recordedSlot].value = value;
+	slots[recordedSlot].state.store(SLOT_IN_FLIGHT, std::memory_order_relaxed);
+	inFlight.push_back((uint32_t)recordedSlot);
+	recordedSlot = -1;
+}
+
+void FrameCapture::poll(uint64_t completed)
+{
+	bool queued = false;
+	while(!inFlight.empty() && slots[inFlight.front()].value <= completed)
+	{
+		Slot& slot = slots[inFlight.front()];
+		if(!coherent)
+		{
+			VkMappedMemoryRange range{};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(device, 1, &range);
+		}
+		slot.state.store(SLOT_ENCODING, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(inFlight.front());
+		}
+		inFlight.pop_front();
+		queued = true;
+	}
+	if(queued) wake.notify_one();
+}
+
+void FrameCapture::workerLoop()
+{
+	for(;;)
+	{
+		uint32_t index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if(jobs.empty()) return; // stopping, and everything handed over is written
+			index = jobs.front();
+			jobs.pop_front();
+		}
+		encode(slots[index]);
+		slots[index].state.store(SLOT_FREE, std::memory_order_release);
+	}
+}
+
+void FrameCapture::encode(Slot& slot)
+{
+	size_t stride = (size_t)extent.width * 4;
+	char path[512];
+	if(slot.continuous && mode == CAPTURE_PNG)
+	{
+		snprintf(path, sizeof(path), "%s/frame_%06llu.png", target.c_str(), (unsigned long long)slot.frame);
+		if(!writePng(path, extent.width, extent.height, slot.mapped, stride, bgra))
+			LOG_WARN("Failed to write %s\n", path);
+	}
+	else if(slot.continuous && mode == CAPTURE_RAW && rawOut)
+	{
+		if(fwrite(slot.mapped, 1, stride * extent.height, rawOut) != stride * extent.height)
+		{
+			LOG_WARN("Raw capture output failed, stopping capture\n");
+			closeRawOutput();
+		}
+	}
+	if(slot.screenshot)
+	{
+		snprintf(path, sizeof(path), CAPTURE_SCREENSHOT_PATH, slot.screenshotIndex);
+		if(writePng(path, extent.width, extent.height, slot.mapped, stride, bgra))
+			LOG_INFO("Screenshot saved to %s\n", path);
+		else
+			LOG_WARN("Failed to write %s\n", path);
+	}
+}
+
+void FrameCapture::closeRawOutput()
+{
+	if(!rawOut) return;
+	if(rawPipe) pclose(rawOut);
+	else fclose(rawOut);
+	rawOut = nullptr;
+}
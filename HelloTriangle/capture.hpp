@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Asynchronous frame capture. A frame to be captured gets a small extra command
+// buffer, submitted right behind its draw commands, that copies the swapchain
+// image into one of a ring of host visible readback buffers. Once the frame's
+// queue value has completed (polled, never waited on) the buffer goes to a
+// worker thread that encodes a PNG or appends the raw pixels to a file or pipe,
+// then returns it to the ring. When the ring is full the frame is dropped from
+// the capture, never from the screen.
+//
+// BENT_CAPTURE=png:<directory>   every frame as <directory>/frame_000000.png
+// BENT_CAPTURE=raw:<file>        raw frames appended to a file, e.g. for ffmpeg -f rawvideo
+// BENT_CAPTURE=raw:|<command>    raw frames piped into a command's stdin
+// requestScreenshot() captures a single PNG on top of that.
+
+#define CAPTURE_RING_SIZE 6     // readback buffers, frames in flight between GPU copy and the encoder
+#define CAPTURE_SCREENSHOT_PATH "screenshot_%03u.png"
+
+enum CaptureMode
+{
+	CAPTURE_OFF,
+	CAPTURE_PNG,
+	CAPTURE_RAW,
+};
+
+class FrameCapture
+{
+	public:
+		// parses a BENT_CAPTURE value; returns false if it isn't one
+		bool configure(const char* spec);
+		// true when images of this format can be copied and encoded (8 bit RGBA or BGRA)
+		static bool supportsFormat(VkFormat format);
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, VkExtent2D extent, VkFormat format);
+		// drains the worker; the copies must have completed (device idle)
+		void destroy();
+
+		void requestScreenshot() { screenshotRequested = true; }
+		bool wantsFrame() const { return ready && (mode != CAPTURE_OFF || screenshotRequested); }
+		// records the copy of image (in PRESENT_SRC layout) into a free buffer;
+		// VK_NULL_HANDLE when no buffer is free and the frame is skipped
+		VkCommandBuffer record(VkImage image);
+		// the queue value of the submit that carried the last recorded copy
+		void submitted(uint64_t value);
+		// hands every copy that completed by this value to the worker
+		void poll(uint64_t completed);
+
+	private:
+		enum SlotState : uint32_t { SLOT_FREE, SLOT_RECORDED, SLOT_IN_FLIGHT, SLOT_ENCODING };
+		struct Slot
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			uint8_t* mapped = nullptr;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			std::atomic<uint32_t> state{ SLOT_FREE };   // ENCODING -> FREE happens on the worker
+			uint64_t value = 0;             // queue value of the submit with the copy
+			bool continuous = false;        // part of the BENT_CAPTURE stream
+			uint64_t frame = 0;
+			bool screenshot = false;
+			uint32_t screenshotIndex = 0;
+		};
+
+		CaptureMode mode = CAPTURE_OFF;
+		std::string target;
+		bool ready = false;
+		bool screenshotRequested = false;
+		uint32_t screenshotCount = 0;
+		uint64_t frameCount = 0;
+		uint64_t droppedCount = 0;
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		bool coherent = true;
+		VkExtent2D extent;
+		bool bgra = false;
+		Slot slots[CAPTURE_RING_SIZE];
+		uint32_t nextSlot = 0;
+		int recordedSlot = -1;
+		std::deque<uint32_t> inFlight;  // submission order
+
+		// worker side
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<uint32_t> jobs;
+		bool stopping = false;
+		FILE* rawOut = nullptr;
+		bool rawPipe = false;
+		void workerLoop();
+		void encode(Slot& slot);
+		void closeRawOutput();
+};
@@ -0,0 +1,414 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+
+#include "benvulkan.hpp"
+#include "compute.hpp"
+
+// BENT_COMPUTE_DEVICE picks a device by name, e.g. "llvmpipe" for lavapipe
+static int scoreComputeDevice(VkPhysicalDevice device, const char* wanted)
+{
+	if(!findComputeQueueFamily(device).has_value()) return -1;
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if(properties.apiVersion < VK_API_VERSION_1_1) return -1;
+	if(wanted && *wanted) return strstr(properties.deviceName, wanted) ? 1 : -1;
+	switch(properties.deviceType)
+	{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+		default: return 1; // CPU implementations such as lavapipe still work, just last
+	}
+}
+
+void ComputeContext::initHeadless(bool enableValidation)
+{
+	if(enableValidation && !checkValidationLayerSupport(validationLayers))
+	{
+		LOG_WARN("Validation layers not found, compute runs without them\n");
+		enableValidation = false;
+	}
+	VkApplicationInfo appInfo{};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Bentgine compute";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.pEngineName = "Bentgine";
+	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.apiVersion = instanceApiVersion(VK_API_VERSION_1_2);
+
+	// no surface, so no window system extensions
+	std::vector<const char*> extensions;
+	VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+	VkInstanceCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo = &appInfo;
+	if(enableValidation)
+	{
+		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+		createInfo.ppEnabledLayerNames = validationLayers.data();
+		populateDebugMessengerCreateInfo(debugCreateInfo);
+		createInfo.pNext = &debugCreateInfo;
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
+	if(vkCreateInstance(&createInfo, hostAllocator(), &instance) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute instance!\n");
+	if(enableValidation && CreateDebugUtilsMessengerEXT(instance, &debugCreateInfo, hostAllocator(), &debugMessenger) != VK_SUCCESS)
+		throw std::runtime_error("Failed to set up debug messenger!\n");
+
+	uint32_t deviceCount = 0;
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+	std::vector<VkPhysicalDevice> devices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+	const char* wanted = getenv("BENT_COMPUTE_DEVICE");
+	int bestScore = -1;
+	for(VkPhysicalDevice device : devices)
+	{
+		int score = scoreComputeDevice(device, wanted);
+		if(score > bestScore)
+		{
+			bestScore = score;
+			physicalDevice = device;
+		}
+	}
+	if(physicalDevice == VK_NULL_HANDLE) throw std::runtime_error("Failed to find a compute capable device!\n");
+	queueFamily = *findComputeQueueFamily(physicalDevice);
+
+	bool timelineExtension = false;
+	bool timelineSemaphores = checkTimelineSemaphoreSupport(physicalDevice, timelineExtension);
+	std::vector<const char*> deviceExtensionList;
+	if(timelineSemaphores && timelineExtension) deviceExtensionList.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+	float queuePriority = 1.0f;
+	VkDeviceQueueCreateInfo queueCreateInfo{};
+	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueCreateInfo.queueFamilyIndex = queueFamily;
+	queueCreateInfo.queueCount = 1;
+	queueCreateInfo.pQueuePriorities = &queuePriority;
+	VkDeviceCreateInfo deviceInfo{};
+	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.pNext = timelineSemaphores ? &timelineFeatures : nullptr;
+	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos = &queueCreateInfo;
+	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensionList.size());
+	deviceInfo.ppEnabledExtensionNames = deviceExtensionList.data();
+	if(vkCreateDevice(physicalDevice, &deviceInfo, hostAllocator(), &device) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute device!\n");
+	ownsDevice = true;
+	vkd.init(device);
+	if(timelineSemaphores) loadTimelineFunctions(device);
+	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+	timeline.init(device, queue, timelineSemaphores);
+	createQueueObjects();
+}
+
+void ComputeContext::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, bool timelineSemaphores)
+{
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->queueFamily = queueFamily;
+	ownsDevice = false;
+	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+	timeline.init(device, queue, timelineSemaphores);
+	createQueueObjects();
+}
+
+void ComputeContext::createQueueObjects()
+{
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	LOG_INFO("Compute device: %s, queue family %u\n", properties.deviceName, queueFamily);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if(vkCreateCommandPool(device, &poolInfo, hostAllocator(), &commandPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute command pool!\n");
+
+	// kernel times come from timestamps when the queue has them, callers fall back to wall time
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+	timestampBits = queueFamilies[queueFamily].timestampValidBits;
+	if(timestampBits == 0 || properties.limits.timestampPeriod == 0.0f) return;
+	VkQueryPoolCreateInfo queryInfo{};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = COMPUTE_TIMESTAMPS;
+	if(vkCreateQueryPool(device, &queryInfo, hostAllocator(), &timestampQueries) != VK_SUCCESS)
+		timestampQueries = VK_NULL_HANDLE;
+}
+
+void ComputeContext::destroy()
+{
+	if(device == VK_NULL_HANDLE) return;
+	vkDeviceWaitIdle(device);
+	if(timestampQueries != VK_NULL_HANDLE) vkDestroyQueryPool(device, timestampQueries, hostAllocator());
+	vkDestroyCommandPool(device, commandPool, hostAllocator());
+	timeline.destroy();
+	timestampQueries = VK_NULL_HANDLE;
+	commandPool = VK_NULL_HANDLE;
+	if(ownsDevice) vkDestroyDevice(device, hostAllocator());
+	device = VK_NULL_HANDLE;
+	if(debugMessenger != VK_NULL_HANDLE) DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator());
+	if(instance != VK_NULL_HANDLE) vkDestroyInstance(instance, hostAllocator());
+	debugMessenger = VK_NULL_HANDLE;
+	instance = VK_NULL_HANDLE;
+}
+
+ComputeBuffer ComputeContext::createBuffer(VkDeviceSize size, bool hostVisible, VkBufferUsageFlags extraUsage)
+{
+	ComputeBuffer result;
+	result.size = size;
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | \
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsage;
+	VkMemoryPropertyFlags memoryFlags = hostVisible ? \
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	::createBuffer(physicalDevice, device, size, usage, memoryFlags, result.buffer, result.memory, \
+		hostVisible ? MEMORY_STAGING : MEMORY_OTHER);
+	if(hostVisible) vkMapMemory(device, result.memory, 0, size, 0, &result.mapped);
+	return result;
+}
+
+void ComputeContext::destroyBuffer(ComputeBuffer& buffer)
+{
+	if(buffer.mapped) vkUnmapMemory(device, buffer.memory);
+	vkDestroyBuffer(device, buffer.buffer, hostAllocator());
+	freeDeviceMemory(device, buffer.memory);
+	buffer = ComputeBuffer();
+}
+
+void ComputeContext::upload(ComputeBuffer& buffer, const void* data, VkDeviceSize size)
+{
+	if(buffer.mapped)
+	{
+		memcpy(buffer.mapped, data, size);
+		return;
+	}
+	ComputeBuffer staging = createBuffer(size, true);
+	memcpy(staging.mapped, data, size);
+	VkCommandBuffer commandBuffer = beginCommands();
+	VkBufferCopy region{ 0, 0, size };
+	vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer.buffer, 1, &region);
+	submitAndWait(commandBuffer);
+	destroyBuffer(staging);
+}
+
+void ComputeContext::download(const ComputeBuffer& buffer, void* data, VkDeviceSize size)
+{
+	if(buffer.mapped)
+	{
+		memcpy(data, buffer.mapped, size);
+		return;
+	}
+	ComputeBuffer staging = createBuffer(size, true);
+	VkCommandBuffer commandBuffer = beginCommands();
+	VkBufferCopy region{ 0, 0, size };
+	vkCmdCopyBuffer(commandBuffer, buffer.buffer, staging.buffer, 1, &region);
+	submitAndWait(commandBuffer);
+	memcpy(data, staging.mapped, size);
+	destroyBuffer(staging);
+}
+
+VkCommandBuffer ComputeContext::beginCommands()
+{
+	return beginSingleTimeCommands(device, commandPool);
+}
+
+void ComputeContext::submitAndWait(VkCommandBuffer commandBuffer)
+{
+	vkEndCommandBuffer(commandBuffer);
+	TimelineSubmit submit;
+	submit.commandBufferCount = 1;
+	submit.commandBuffers = &commandBuffer;
+	timeline.wait(timeline.submit(submit));
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}
+
+void ComputeContext::resetTimestamps(VkCommandBuffer commandBuffer)
+{
+	if(hasTimestamps()) vkCmdResetQueryPool(commandBuffer, timestampQueries, 0, COMPUTE_TIMESTAMPS);
+}
+
+void ComputeContext::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if(hasTimestamps()) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueries, slot);
+}
+
+double ComputeContext::timestampMilliseconds(uint32_t from, uint32_t to)
+{
+	if(!hasTimestamps()) return 0.0;
+	uint64_t ticks[2];
+	VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT;
+	if(vkGetQueryPoolResults(device, timestampQueries, from, 1, sizeof(uint64_t), &ticks[0], sizeof(uint64_t), flags) != VK_SUCCESS || \
+		vkGetQueryPoolResults(device, timestampQueries, to, 1, sizeof(uint64_t), &ticks[1], sizeof(uint64_t), flags) != VK_SUCCESS)
+		return 0.0;
+	uint64_t mask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+	uint64_t elapsed = (ticks[1] - ticks[0]) & mask;
+	return elapsed * (double)properties.limits.timestampPeriod / 1e6;
+}
+
+void ComputePipeline::create(ComputeContext& context, const std::string& spirvPath, uint32_t bindingCount, uint32_t pushConstantSize)
+{
+	if(bindingCount > COMPUTE_MAX_BINDINGS) throw std::runtime_error("Too many compute bindings!\n");
+	this->context = &context;
+	this->bindingCount = bindingCount;
+	this->pushConstantSize = pushConstantSize;
+	VkDevice device = context.device;
+
+	VkDescriptorSetLayoutBinding bindings[COMPUTE_MAX_BINDINGS];
+	for(uint32_t i = 0; i < bindingCount; i++)
+	{
+		bindings[i] = {};
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = bindingCount;
+	setLayoutInfo.pBindings = bindings;
+	if(vkCreateDescriptorSetLayout(device, &setLayoutInfo, hostAllocator(), &setLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute descriptor set layout!\n");
+
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = pushConstantSize;
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &setLayout;
+	layoutInfo.pushConstantRangeCount = pushConstantSize ? 1 : 0;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	if(vkCreatePipelineLayout(device, &layoutInfo, hostAllocator(), &layout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute pipeline layout!\n");
+
+	VkShaderModule module = loadShaderModule(device, spirvPath);
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = module;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator(), &pipeline);
+	vkDestroyShaderModule(device, module, hostAllocator());
+	if(result != VK_SUCCESS) throw std::runtime_error("Failed to create compute pipeline!\n");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = COMPUTE_MAX_SETS * (bindingCount ? bindingCount : 1);
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = COMPUTE_MAX_SETS;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	if(vkCreateDescriptorPool(device, &poolInfo, hostAllocator(), &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute descriptor pool!\n");
+	LOG_DEBUG("Compute pipeline %s: %u buffers, %u push constant bytes\n", spirvPath.c_str(), bindingCount, pushConstantSize);
+}
+
+void ComputePipeline::destroy()
+{
+	if(!context) return;
+	VkDevice device = context->device;
+	vkDestroyDescriptorPool(device, descriptorPool, hostAllocator());
+	vkDestroyPipeline(device, pipeline, hostAllocator());
+	vkDestroyPipelineLayout(device, layout, hostAllocator());
+	vkDestroyDescriptorSetLayout(device, setLayout, hostAllocator());
+	*this = ComputePipeline();
+}
+
+VkDescriptorSet ComputePipeline::makeSet(std::initializer_list<const ComputeBuffer*> buffers)
+{
+	if(buffers.size() != bindingCount) throw std::runtime_error("Compute buffer count doesn't match the pipeline!\n");
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+	VkDescriptorSet set;
+	if(vkAllocateDescriptorSets(context->device, &allocInfo, &set) != VK_SUCCESS)
+		throw std::runtime_error("Out of compute descriptor sets!\n");
+
+	VkDescriptorBufferInfo bufferInfos[COMPUTE_MAX_BINDINGS];
+	VkWriteDescriptorSet writes[COMPUTE_MAX_BINDINGS];
+	uint32_t i = 0;
+	for(const ComputeBuffer* buffer : buffers)
+	{
+		bufferInfos[i] = { buffer->buffer, 0, VK_WHOLE_SIZE };
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+		i++;
+	}
+	vkUpdateDescriptorSets(context->device, bindingCount, writes, 0, nullptr);
+	return set;
+}
+
+void ComputePipeline::dispatch(VkCommandBuffer commandBuffer, VkDescriptorSet set, ComputeDispatchSize groups, const void* pushConstants)
+{
+	vkd.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkd.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+	if(pushConstantSize && pushConstants)
+		vkd.cmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize, pushConstants);
+	vkd.cmdDispatch(commandBuffer, groups.x, groups.y, groups.z);
+}
+
+ComputeDispatchSize computeDispatchSize(const ComputeContext& context, uint64_t items, uint32_t groupSize)
+{
+	uint64_t groups = (items + groupSize - 1) / groupSize;
+	if(groups == 0) groups = 1;
+	uint64_t maxX = context.properties.limits.maxComputeWorkGroupCount[0];
+	if(groups <= maxX) return { (uint32_t)groups, 1, 1 };
+	// spread over y and shrink x again so few groups are wasted on the bounds check
+	uint64_t y = (groups + maxX - 1) / maxX;
+	if(y > context.properties.limits.maxComputeWorkGroupCount[1])
+		throw std::runtime_error("Compute dispatch too large!\n");
+	uint64_t x = (groups + y - 1) / y;
+	return { (uint32_t)x, (uint32_t)y, 1 };
+}
+
+static void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, \
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	vkd.cmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void computeBarrier(VkCommandBuffer commandBuffer)
+{
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, \
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void computeToTransferBarrier(VkCommandBuffer commandBuffer)
+{
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, \
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+void transferToComputeBarrier(VkCommandBuffer commandBuffer)
+{
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, \
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "gpusync.hpp"
+
+// General purpose compute on the same Vulkan stack as the renderer:
+//  - ComputeContext owns (or borrows) a device, a compute queue and a command pool,
+//  - ComputeBuffer is a storage buffer, device local or host visible,
+//  - ComputePipeline wraps a SPIR-V compute shader whose bindings are all storage
+//    buffers (binding i = i-th buffer) plus an optional push constant block.
+// Dispatches too big for one dimension are folded into y (see computeDispatchSize),
+// so kernels compute their group as gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x.
+
+#define COMPUTE_MAX_BINDINGS 8
+#define COMPUTE_MAX_SETS 64          // descriptor sets per pipeline
+#define COMPUTE_TIMESTAMPS 64        // timestamp queries per context
+
+struct ComputeBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;     // set for host visible buffers
+};
+
+struct ComputeDispatchSize
+{
+	uint32_t x, y, z;
+};
+
+class ComputeContext
+{
+	public:
+		// own instance and device, no window or surface; picks a GPU over a CPU device
+		void initHeadless(bool enableValidation);
+		// share a device created elsewhere, e.g. the renderer's, which has already set up vkd for it
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, bool timelineSemaphores);
+		void destroy();
+
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t queueFamily = 0;
+		QueueTimeline timeline;                 // compute queue submissions
+		VkPhysicalDeviceProperties properties;
+
+		ComputeBuffer createBuffer(VkDeviceSize size, bool hostVisible, VkBufferUsageFlags extraUsage = 0);
+		void destroyBuffer(ComputeBuffer& buffer);
+		// copies through a staging buffer unless the buffer is mapped
+		void upload(ComputeBuffer& buffer, const void* data, VkDeviceSize size);
+		void download(const ComputeBuffer& buffer, void* data, VkDeviceSize size);
+
+		VkCommandBuffer beginCommands();
+		// submits on the compute timeline and waits for it
+		void submitAndWait(VkCommandBuffer commandBuffer);
+
+		bool hasTimestamps() const { return timestampQueries != VK_NULL_HANDLE; }
+		void resetTimestamps(VkCommandBuffer commandBuffer);
+		void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t slot);
+		// milliseconds between two timestamps of the last completed submit
+		double timestampMilliseconds(uint32_t from, uint32_t to);
+
+	private:
+		VkInstance instance = VK_NULL_HANDLE;   // only when headless
+		VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
+		bool ownsDevice = false;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkQueryPool timestampQueries = VK_NULL_HANDLE;
+		uint32_t timestampBits = 0;
+		void createQueueObjects();
+};
+
+class ComputePipeline
+{
+	public:
+		void create(ComputeContext& context, const std::string& spirvPath, uint32_t bindingCount, uint32_t pushConstantSize = 0);
+		void destroy();
+		// descriptor set with buffers[i] at binding i; sets live as long as the pipeline
+		VkDescriptorSet makeSet(std::initializer_list<const ComputeBuffer*> buffers);
+		void dispatch(VkCommandBuffer commandBuffer, VkDescriptorSet set, ComputeDispatchSize groups, const void* pushConstants = nullptr);
+
+	private:
+		ComputeContext* context = nullptr;
+		uint32_t bindingCount = 0;
+		uint32_t pushConstantSize = 0;
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+};
+
+// workgroups for items work items, folded into y once x would exceed the device limit
+ComputeDispatchSize computeDispatchSize(const ComputeContext& context, uint64_t items, uint32_t groupSize);
+// make shader writes of the previous dispatch visible to the next dispatch / transfer
+void computeBarrier(VkCommandBuffer commandBuffer);
+void computeToTransferBarrier(VkCommandBuffer commandBuffer);
+void transferToComputeBarrier(VkCommandBuffer commandBuffer);
@@ -0,0 +1,63 @@
+#include <stdexcept>
+
+#include "deletionqueue.hpp"
+#include "hostalloc.hpp"
+#include "memorybudget.hpp"
+#include "log.hpp"
+
+void DeletionQueue::push(DeleteType type, uint64_t handle, uint64_t owner)
+{
+	if(handle == 0) return; // VK_NULL_HANDLE
+	if(!entries.empty() && entries.back().retire > current)
+		throw std::runtime_error("Deletion queue values must not go backwards!\n");
+	entries.push_back({ current, type, handle, owner });
+}
+
+void DeletionQueue::collect(uint64_t completed)
+{
+	size_t count = 0;
+	while(!entries.empty() && entries.front().retire <= completed)
+	{
+		destroy(entries.front());
+		entries.pop_front();
+		count++;
+	}
+	if(count) LOG_TRACE("Deletion queue: destroyed %zu objects up to %llu\n", count, (unsigned long long)completed);
+}
+
+void DeletionQueue::flush()
+{
+	for(const Entry& entry : entries) destroy(entry);
+	entries.clear();
+}
+
+void DeletionQueue::destroy(const Entry& e)
+{
+	switch(e.type)
+	{
+		case DELETE_BUFFER: vkDestroyBuffer(device, (VkBuffer)e.handle, hostAllocator()); break;
+		case DELETE_IMAGE: vkDestroyImage(device, (VkImage)e.handle, hostAllocator()); break;
+		case DELETE_IMAGE_VIEW: vkDestroyImageView(device, (VkImageView)e.handle, hostAllocator()); break;
+		case DELETE_SAMPLER: vkDestroySampler(device, (VkSampler)e.handle, hostAllocator()); break;
+		case DELETE_MEMORY: freeDeviceMemory(device, (VkDeviceMemory)e.handle); break;
+		case DELETE_PIPELINE: vkDestroyPipeline(device, (VkPipeline)e.handle, hostAllocator()); break;
+		case DELETE_PIPELINE_LAYOUT: vkDestroyPipelineLayout(device, (VkPipelineLayout)e.handle, hostAllocator()); break;
+		case DELETE_SHADER_MODULE: vkDestroyShaderModule(device, (VkShaderModule)e.handle, hostAllocator()); break;
+		case DELETE_FRAMEBUFFER: vkDestroyFramebuffer(device, (VkFramebuffer)e.handle, hostAllocator()); break;
+		case DELETE_SEMAPHORE: vkDestroySemaphore(device, (VkSemaphore)e.handle, hostAllocator()); break;
+		case DELETE_FENCE: vkDestroyFence(device, (VkFence)e.handle, hostAllocator()); break;
+		case DELETE_DESCRIPTOR_POOL: vkDestroyDescriptorPool(device, (VkDescriptorPool)e.handle, hostAllocator()); break;
+		case DELETE_DESCRIPTOR_SET:
+		{
+			VkDescriptorSet set = (VkDescriptorSet)e.handle;
+			vkFreeDescriptorSets(device, (VkDescriptorPool)e.owner, 1, &set);
+			break;
+		}
+		case DELETE_COMMAND_BUFFER:
+		{
+			VkCommandBuffer commandBuffer = (VkCommandBuffer)e.handle;
+			vkFreeCommandBuffers(device, (VkCommandPool)e.owner, 1, &commandBuffer);
+			break;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <deque>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Destroys Vulkan objects once the GPU can no longer be using them.
+// Everything released while frame N is being built is tagged N; when the
+// app knows frame N has retired (its fence signalled, or its timeline value
+// was reached) it calls collect(N) and the objects are destroyed then.
+// Frame numbers must only ever grow, which keeps the queue sorted.
+// The release() overloads need distinct handle types, i.e. a 64-bit build.
+
+class DeletionQueue
+{
+	public:
+		void init(VkDevice device) { this->device = device; }
+		// tag for releases from now on, usually the frame being recorded
+		void setCurrent(uint64_t value) { current = value; }
+		uint64_t currentValue() const { return current; }
+
+		void release(VkBuffer buffer)                   { push(DELETE_BUFFER, (uint64_t)buffer); }
+		void release(VkImage image)                     { push(DELETE_IMAGE, (uint64_t)image); }
+		void release(VkImageView view)                  { push(DELETE_IMAGE_VIEW, (uint64_t)view); }
+		void release(VkSampler sampler)                 { push(DELETE_SAMPLER, (uint64_t)sampler); }
+		void release(VkDeviceMemory memory)             { push(DELETE_MEMORY, (uint64_t)memory); }
+		void release(VkPipeline pipeline)               { push(DELETE_PIPELINE, (uint64_t)pipeline); }
+		void release(VkPipelineLayout layout)           { push(DELETE_PIPELINE_LAYOUT, (uint64_t)layout); }
+		void release(VkShaderModule module)             { push(DELETE_SHADER_MODULE, (uint64_t)module); }
+		void release(VkFramebuffer framebuffer)         { push(DELETE_FRAMEBUFFER, (uint64_t)framebuffer); }
+		void release(VkSemaphore semaphore)             { push(DELETE_SEMAPHORE, (uint64_t)semaphore); }
+		void release(VkFence fence)                     { push(DELETE_FENCE, (uint64_t)fence); }
+		void release(VkDescriptorPool pool)             { push(DELETE_DESCRIPTOR_POOL, (uint64_t)pool); }
+		void release(VkCommandPool pool, VkCommandBuffer commandBuffer) { push(DELETE_COMMAND_BUFFER, (uint64_t)commandBuffer, (uint64_t)pool); }
+		// the pool must have been created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+		void release(VkDescriptorPool pool, VkDescriptorSet set) { push(DELETE_DESCRIPTOR_SET, (uint64_t)set, (uint64_t)pool); }
+
+		// destroy everything tagged <= completed
+		void collect(uint64_t completed);
+		// destroy everything; only once the device is idle
+		void flush();
+		size_t pending() const { return entries.size(); }
+
+	private:
+		enum DeleteType : uint32_t
+		{
+			DELETE_BUFFER, DELETE_IMAGE, DELETE_IMAGE_VIEW, DELETE_SAMPLER, DELETE_MEMORY, DELETE_PIPELINE,
+			DELETE_PIPELINE_LAYOUT, DELETE_SHADER_MODULE, DELETE_FRAMEBUFFER, DELETE_SEMAPHORE, DELETE_FENCE,
+			DELETE_DESCRIPTOR_POOL, DELETE_DESCRIPTOR_SET, DELETE_COMMAND_BUFFER,
+		};
+		struct Entry
+		{
+			uint64_t retire;
+			DeleteType type;
+			uint64_t handle;
+			uint64_t owner;     // descriptor pool of a set, command pool of a command buffer
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		uint64_t current = 0;
+		std::deque<Entry> entries;
+
+		void push(DeleteType type, uint64_t handle, uint64_t owner = 0);
+		void destroy(const Entry& entry);
+};
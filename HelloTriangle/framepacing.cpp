@@ -0,0 +1,76 @@
+#include <cstring>
+#include <cmath>
+#include <thread>
+
+#include "framepacing.hpp"
+
+static const char* latencyModeNames[] = { "immediate", "mailbox", "fifo" };
+
+const char* latencyModeName(LatencyMode mode)
+{
+	return mode <= LATENCY_FIFO ? latencyModeNames[mode] : "unknown";
+}
+
+bool findLatencyMode(const char* name, LatencyMode& mode)
+{
+	for(uint32_t m = 0; m <= LATENCY_FIFO; m++)
+		if(strcmp(name, latencyModeNames[m]) == 0)
+		{
+			mode = (LatencyMode)m;
+			return true;
+		}
+	return false;
+}
+
+VkPresentModeKHR latencyPresentMode(LatencyMode mode)
+{
+	switch(mode)
+	{
+		case LATENCY_IMMEDIATE: return VK_PRESENT_MODE_IMMEDIATE_KHR;
+		case LATENCY_MAILBOX: return VK_PRESENT_MODE_MAILBOX_KHR;
+		default: return VK_PRESENT_MODE_FIFO_KHR;
+	}
+}
+
+void FrameLimiter::setInterval(double seconds)
+{
+	intervalSeconds = seconds > 0.0 ? seconds : 0.0;
+	started = false;
+}
+
+void FrameLimiter::wait()
+{
+	if(intervalSeconds <= 0.0) return;
+	FrameClock::time_point now = FrameClock::now();
+	auto step = std::chrono::duration_cast<FrameClock::duration>(std::chrono::duration<double>(intervalSeconds));
+	if(!started)
+	{
+		deadline = now + step;
+		started = true;
+		return;
+	}
+	auto spin = std::chrono::microseconds(FRAME_LIMITER_SPIN_US);
+	if(deadline - now > spin) std::this_thread::sleep_for(deadline - now - spin);
+	while(FrameClock::now() < deadline) {}
+	// a frame that ran long restarts the schedule instead of bursting to catch up
+	now = FrameClock::now();
+	deadline += step;
+	if(deadline < now) deadline = now + step;
+}
+
+void LatencyStat::add(double ms)
+{
+	if(count == 0 || ms < min) min = ms;
+	if(count == 0 || ms > max) max = ms;
+	count++;
+	sum += ms;
+	sumSquares += ms * ms;
+}
+
+double LatencyStat::deviation() const
+{
+	if(count < 2) return 0.0;
+	double m = mean();
+	double variance = sumSquares / count - m * m;
+	return variance > 0.0 ? sqrt(variance) : 0.0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Presentation latency modes and the CPU side of frame pacing.
+//  IMMEDIATE  no vsync, lowest latency, tears
+//  MAILBOX    newest frame replaces the queued one, no tearing, GPU renders flat out
+//  FIFO       vsync; frames are paced by the limiter (and present wait when available)
+//             so the swapchain queue stays empty and input is sampled late
+
+enum LatencyMode : uint32_t
+{
+	LATENCY_IMMEDIATE = 0,
+	LATENCY_MAILBOX = 1,
+	LATENCY_FIFO = 2,
+};
+
+#define LATENCY_REPORT_SECONDS 2.0  // how often latency statistics are logged
+
+typedef std::chrono::steady_clock FrameClock;
+
+const char* latencyModeName(LatencyMode mode);
+bool findLatencyMode(const char* name, LatencyMode& mode);
+VkPresentModeKHR latencyPresentMode(LatencyMode mode);
+
+// Sleeps until the next frame deadline. Most of the wait is a sleep, the last
+// FRAME_LIMITER_SPIN_US are spun because sleep wakeups overshoot.
+#define FRAME_LIMITER_SPIN_US 500
+class FrameLimiter
+{
+	public:
+		void setInterval(double seconds);   // 0 disables the limiter
+		double interval() const { return intervalSeconds; }
+		void wait();
+
+	private:
+		double intervalSeconds = 0.0;
+		FrameClock::time_point deadline;
+		bool started = false;
+};
+
+// min / mean / max / standard deviation of one latency, in milliseconds
+struct LatencyStat
+{
+	uint32_t count = 0;
+	double sum = 0.0, sumSquares = 0.0;
+	double min = 0.0, max = 0.0;
+
+	void add(double ms);
+	void reset() { *this = LatencyStat(); }
+	double mean() const { return count ? sum / count : 0.0; }
+	double deviation() const;
+};
+
+inline double millisecondsBetween(FrameClock::time_point from, FrameClock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
@@ -0,0 +1,221 @@
+#include <stdexcept>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+
+#include "benvulkan.hpp"
+#include "gpusync.hpp"
+
+// core 1.2 names, or the KHR aliases on older devices; waits go through vkd
+static PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+
+void TimelineSubmit::wait(QueueTimeline& timeline, uint64_t value, VkPipelineStageFlags stage)
+{
+	if(value == 0) return; // nothing was ever signalled
+	if(waitCount == SYNC_MAX_WAITS) throw std::runtime_error("Too many timeline waits in one submit!\n");
+	waits[waitCount++] = { &timeline, value, stage };
+}
+
+void TimelineSubmit::waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage)
+{
+	if(binaryWaitCount == SYNC_MAX_WAITS) throw std::runtime_error("Too many binary waits in one submit!\n");
+	binaryWaits[binaryWaitCount] = semaphore;
+	binaryWaitStages[binaryWaitCount++] = stage;
+}
+
+void TimelineSubmit::signalBinary(VkSemaphore semaphore)
+{
+	if(binarySignalCount == SYNC_MAX_SIGNALS) throw std::runtime_error("Too many binary signals in one submit!\n");
+	binarySignals[binarySignalCount++] = semaphore;
+}
+
+bool checkTimelineSemaphoreSupport(VkPhysicalDevice physicalDevice, bool& extensionNeeded)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	extensionNeeded = properties.apiVersion < VK_API_VERSION_1_2;
+	if(extensionNeeded && !hasDeviceExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+		return false;
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+void loadTimelineFunctions(VkDevice device)
+{
+	getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+	if(!getSemaphoreCounterValue) getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+}
+
+void QueueTimeline::init(VkDevice device, VkQueue queue, bool useTimeline)
+{
+	this->device = device;
+	submitQueue = queue;
+	if(!useTimeline) return;
+	if(!vkd.hasTimelineWaits() || !getSemaphoreCounterValue)
+		throw std::runtime_error("Timeline semaphore functions not loaded!\n");
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if(vkCreateSemaphore(device, &semaphoreInfo, hostAllocator(), &timeline) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create timeline semaphore!\n");
+}
+
+void QueueTimeline::destroy()
+{
+	if(timeline != VK_NULL_HANDLE) vkDestroySemaphore(device, timeline, hostAllocator());
+	for(auto& pending : pendingFences) vkDestroyFence(device, pending.fence, hostAllocator());
+	for(auto fence : freeFences) vkDestroyFence(device, fence, hostAllocator());
+	timeline = VK_NULL_HANDLE;
+	pendingFences.clear();
+	freeFences.clear();
+}
+
+VkFence QueueTimeline::takeFence()
+{
+	VkFence fence;
+	if(!freeFences.empty())
+	{
+		fence = freeFences.back();
+		freeFences.pop_back();
+		vkResetFences(device, 1, &fence);
+		return fence;
+	}
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if(vkCreateFence(device, &fenceInfo, hostAllocator(), &fence) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create submit fence!\n");
+	return fence;
+}
+
+uint64_t QueueTimeline::submit(const TimelineSubmit& s)
+{
+	uint64_t value = submitted + 1;
+	VkSemaphore waitSemaphoreList[SYNC_MAX_WAITS * 2];
+	VkPipelineStageFlags waitStageList[SYNC_MAX_WAITS * 2];
+	uint64_t waitValues[SYNC_MAX_WAITS * 2];
+	uint32_t waitCount = 0;
+	VkSemaphore signalSemaphoreList[SYNC_MAX_SIGNALS + 1];
+	uint64_t signalValues[SYNC_MAX_SIGNALS + 1];
+	uint32_t signalCount = 0;
+
+	for(uint32_t i = 0; i < s.waitCount; i++)
+	{
+		QueueTimeline* other = s.waits[i].timeline;
+		if(other->isTimeline())
+		{
+			waitSemaphoreList[waitCount] = other->timeline;
+			waitStageList[waitCount] = s.waits[i].stage;
+			waitValues[waitCount++] = s.waits[i].value;
+		}
+		// without timelines there's nothing to wait on GPU side: finish the work first
+		else if(other != this) other->wait(s.waits[i].value);
+		// same queue: submission order plus the wait stage still needs the earlier work done
+		else wait(s.waits[i].value);
+	}
+	for(uint32_t i = 0; i < s.binaryWaitCount; i++)
+	{
+		waitSemaphoreList[waitCount] = s.binaryWaits[i];
+		waitStageList[waitCount] = s.binaryWaitStages[i];
+		waitValues[waitCount++] = 0; // ignored for binary semaphores
+	}
+	for(uint32_t i = 0; i < s.binarySignalCount; i++)
+	{
+		signalSemaphoreList[signalCount] = s.binarySignals[i];
+		signalValues[signalCount++] = 0;
+	}
+	if(isTimeline())
+	{
+		signalSemaphoreList[signalCount] = timeline;
+		signalValues[signalCount++] = value;
+	}
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = signalCount;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = isTimeline() ? &timelineInfo : nullptr;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphoreList;
+	submitInfo.pWaitDstStageMask = waitStageList;
+	submitInfo.commandBufferCount = s.commandBufferCount;
+	submitInfo.pCommandBuffers = s.commandBuffers;
+	submitInfo.signalSemaphoreCount = signalCount;
+	submitInfo.pSignalSemaphores = signalSemaphoreList;
+
+	VkFence fence = isTimeline() ? VK_NULL_HANDLE : takeFence();
+	if(vkd.queueSubmit(submitQueue, 1, &submitInfo, fence) != VK_SUCCESS)
+	{
+		if(fence != VK_NULL_HANDLE) freeFences.push_back(fence);
+		throw std::runtime_error("Failed to submit to queue!\n");
+	}
+	if(fence != VK_NULL_HANDLE) pendingFences.push_back({ value, fence });
+	submitted = value;
+	return value;
+}
+
+uint64_t QueueTimeline::completed()
+{
+	if(isTimeline())
+	{
+		uint64_t value = 0;
+		if(getSemaphoreCounterValue(device, timeline, &value) != VK_SUCCESS)
+			throw std::runtime_error("Failed to read timeline semaphore!\n");
+		completedValue = std::max(completedValue, value);
+		return completedValue;
+	}
+	while(!pendingFences.empty() && vkGetFenceStatus(device, pendingFences.front().fence) == VK_SUCCESS)
+	{
+		completedValue = pendingFences.front().value;
+		freeFences.push_back(pendingFences.front().fence);
+		pendingFences.pop_front();
+	}
+	return completedValue;
+}
+
+bool QueueTimeline::wait(uint64_t value, uint64_t timeout)
+{
+	if(value == 0 || value <= completedValue) return true;
+	if(value > submitted) throw std::runtime_error("Waiting for a queue value that was never submitted!\n");
+	VkResult result = VK_SUCCESS;
+	if(isTimeline())
+	{
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &value;
+		result = vkd.waitSemaphores(device, &waitInfo, timeout);
+	}
+	else
+	{
+		// submits retire in order: the fence of the requested value covers all earlier ones
+		for(auto& pending : pendingFences)
+			if(pending.value >= value)
+			{
+				result = vkd.waitForFences(device, 1, &pending.fence, VK_TRUE, timeout);
+				break;
+			}
+	}
+	// only a completed wait moves completedValue; a lost device is not completion
+	if(result == VK_TIMEOUT) return false;
+	if(result != VK_SUCCESS) throw std::runtime_error("Failed to wait for a queue value!\n");
+	if(isTimeline()) completedValue = std::max(completedValue, value);
+	else completed();
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// One monotonically increasing value per queue. Every submit through a
+// QueueTimeline signals the next value; the CPU waits on values instead of
+// fences, and other submits (on any queue) wait on values instead of ad hoc
+// semaphores. Backed by a timeline semaphore (core 1.2 or
+// VK_KHR_timeline_semaphore); without one it falls back to a fence per
+// submit, and GPU waits on other queues' values become CPU waits.
+// Swapchain acquire/present still need binary semaphores, which submit()
+// waits on and signals alongside the timeline.
+
+#define SYNC_MAX_WAITS 4
+#define SYNC_MAX_SIGNALS 4     // one present semaphore per window
+
+class QueueTimeline;
+
+struct TimelineWait
+{
+	QueueTimeline* timeline;
+	uint64_t value;
+	VkPipelineStageFlags stage;
+};
+
+struct TimelineSubmit
+{
+	uint32_t commandBufferCount = 0;
+	const VkCommandBuffer* commandBuffers = nullptr;
+	uint32_t waitCount = 0;
+	TimelineWait waits[SYNC_MAX_WAITS];
+	uint32_t binaryWaitCount = 0;
+	VkSemaphore binaryWaits[SYNC_MAX_WAITS];
+	VkPipelineStageFlags binaryWaitStages[SYNC_MAX_WAITS];
+	uint32_t binarySignalCount = 0;
+	VkSemaphore binarySignals[SYNC_MAX_SIGNALS];
+
+	void wait(QueueTimeline& timeline, uint64_t value, VkPipelineStageFlags stage);
+	void waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage);
+	void signalBinary(VkSemaphore semaphore);
+};
+
+// true if the device can use timeline semaphores; extensionNeeded is set when
+// it has to be enabled through VK_KHR_timeline_semaphore (device older than 1.2)
+bool checkTimelineSemaphoreSupport(VkPhysicalDevice physicalDevice, bool& extensionNeeded);
+// load the entry points once the device exists
+void loadTimelineFunctions(VkDevice device);
+
+class QueueTimeline
+{
+	public:
+		void init(VkDevice device, VkQueue queue, bool useTimeline);
+		void destroy();
+
+		// returns the value this submission signals
+		uint64_t submit(const TimelineSubmit& submit);
+		uint64_t nextValue() const { return submitted + 1; }
+		uint64_t lastSubmitted() const { return submitted; }
+		uint64_t completed();   // never blocks
+		// true once value has completed, false if the timeout ran out first; throws on device loss
+		bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+		bool isTimeline() const { return timeline != VK_NULL_HANDLE; }
+		VkQueue queue() const { return submitQueue; }
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue submitQueue = VK_NULL_HANDLE;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		uint64_t submitted = 0;
+		uint64_t completedValue = 0;
+
+		// fallback: fence per submitted value, oldest first
+		struct PendingFence { uint64_t value; VkFence fence; };
+		std::deque<PendingFence> pendingFences;
+		std::vector<VkFence> freeFences;
+		VkFence takeFence();
+};
@@ -0,0 +1,271 @@
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+
+#include "hostalloc.hpp"
+#include "log.hpp"
+
+// every block starts with padding so the user pointer is aligned; the 16 bytes
+// right before the user pointer describe the block
+struct BlockHeader
+{
+	uint64_t size;          // requested bytes
+	uint32_t offset;        // user pointer - block start
+	uint8_t sizeClass;      // HOST_ALLOC_LARGE for aligned_alloc blocks
+	uint8_t scope;
+	uint16_t magic;
+};
+static_assert(sizeof(BlockHeader) == 16, "BlockHeader layout");
+
+#define HOST_ALLOC_MAGIC 0xA11C
+#define HOST_ALLOC_LARGE 0xFF
+#define HOST_ALLOC_CLASS_COUNT 9    // 32 .. 8192
+static_assert((HOST_ALLOC_MIN_CLASS << (HOST_ALLOC_CLASS_COUNT - 1)) == HOST_ALLOC_MAX_CLASS, "size class count");
+
+struct ScopeCounters
+{
+	std::atomic<uint64_t> allocations{ 0 }, frees{ 0 }, liveCount{ 0 }, liveBytes{ 0 }, peakBytes{ 0 }, internalBytes{ 0 };
+};
+static ScopeCounters scopeCounters[HOST_ALLOC_SCOPE_COUNT];
+static std::atomic<uint64_t> pooledBlocks{ 0 }, largeBlocks{ 0 }, chunkBytes{ 0 };
+
+// shared pools: intrusive free list per size class, refilled by carving chunks
+struct SizeClassPool
+{
+	std::mutex lock;
+	void* freeList = nullptr;
+};
+static SizeClassPool pools[HOST_ALLOC_CLASS_COUNT];
+
+static inline size_t classSize(uint32_t c) { return (size_t)HOST_ALLOC_MIN_CLASS << c; }
+
+// moves up to count blocks of class c from the shared pool into out[], returns how many
+static uint32_t takeBlocks(uint32_t c, void** out, uint32_t count)
+{
+	SizeClassPool& pool = pools[c];
+	std::lock_guard<std::mutex> guard(pool.lock);
+	if(pool.freeList == nullptr)
+	{
+		char* chunk = (char*)aligned_alloc(HOST_ALLOC_CHUNK_SIZE, HOST_ALLOC_CHUNK_SIZE);
+		if(chunk == nullptr) return 0;
+		chunkBytes.fetch_add(HOST_ALLOC_CHUNK_SIZE, std::memory_order_relaxed);
+		// blocks sit at multiples of their size, which keeps them aligned to it
+		for(size_t offset = HOST_ALLOC_CHUNK_SIZE; offset >= classSize(c); offset -= classSize(c))
+		{
+			void* block = chunk + offset - classSize(c);
+			*(void**)block = pool.freeList;
+			pool.freeList = block;
+		}
+	}
+	uint32_t n = 0;
+	while(n < count && pool.freeList != nullptr)
+	{
+		out[n++] = pool.freeList;
+		pool.freeList = *(void**)pool.freeList;
+	}
+	return n;
+}
+
+static void returnBlocks(uint32_t c, void** blocks, uint32_t count)
+{
+	SizeClassPool& pool = pools[c];
+	std::lock_guard<std::mutex> guard(pool.lock);
+	for(uint32_t i = 0; i < count; i++)
+	{
+		*(void**)blocks[i] = pool.freeList;
+		pool.freeList = blocks[i];
+	}
+}
+
+// per-thread stack of free blocks per class, so most driver allocations never take a lock
+struct ThreadCache
+{
+	void* blocks[HOST_ALLOC_CLASS_COUNT][HOST_ALLOC_THREAD_CACHE];
+	uint32_t count[HOST_ALLOC_CLASS_COUNT] = {};
+
+	~ThreadCache()
+	{
+		for(uint32_t c = 0; c < HOST_ALLOC_CLASS_COUNT; c++)
+			if(count[c]) returnBlocks(c, blocks[c], count[c]);
+	}
+	void* pop(uint32_t c)
+	{
+		if(count[c] == 0) count[c] = takeBlocks(c, blocks[c], HOST_ALLOC_THREAD_CACHE / 2);
+		return count[c] ? blocks[c][--count[c]] : nullptr;
+	}
+	void push(uint32_t c, void* block)
+	{
+		if(count[c] == HOST_ALLOC_THREAD_CACHE)
+		{
+			// hand back the older half, keep the recently used (cache warm) blocks
+			returnBlocks(c, blocks[c], HOST_ALLOC_THREAD_CACHE / 2);
+			memmove(blocks[c], blocks[c] + HOST_ALLOC_THREAD_CACHE / 2, sizeof(void*) * (HOST_ALLOC_THREAD_CACHE / 2));
+			count[c] -= HOST_ALLOC_THREAD_CACHE / 2;
+		}
+		blocks[c][count[c]++] = block;
+	}
+};
+static thread_local ThreadCache threadCache;
+
+static inline BlockHeader* headerOf(void* p) { return (BlockHeader*)p - 1; }
+
+static void countAllocation(uint32_t scope, uint64_t size)
+{
+	ScopeCounters& s = scopeCounters[scope < HOST_ALLOC_SCOPE_COUNT ? scope : 0];
+	s.allocations.fetch_add(1, std::memory_order_relaxed);
+	s.liveCount.fetch_add(1, std::memory_order_relaxed);
+	uint64_t live = s.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peak = s.peakBytes.load(std::memory_order_relaxed);
+	while(live > peak && !s.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+static void countFree(uint32_t scope, uint64_t size)
+{
+	ScopeCounters& s = scopeCounters[scope < HOST_ALLOC_SCOPE_COUNT ? scope : 0];
+	s.frees.fetch_add(1, std::memory_order_relaxed);
+	s.liveCount.fetch_sub(1, std::memory_order_relaxed);
+	s.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static void* allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if(alignment < sizeof(BlockHeader)) alignment = sizeof(BlockHeader);
+	size_t offset = alignment; // room for the header, keeps the user pointer aligned
+	size_t total = offset + size;
+	char* block;
+	uint8_t sizeClass;
+	if(total <= HOST_ALLOC_MAX_CLASS)
+	{
+		uint32_t c = 0;
+		while(classSize(c) < total) c++;
+		block = (char*)threadCache.pop(c);
+		sizeClass = (uint8_t)c;
+		pooledBlocks.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		block = (char*)aligned_alloc(alignment, (total + alignment - 1) / alignment * alignment);
+		sizeClass = HOST_ALLOC_LARGE;
+		largeBlocks.fetch_add(1, std::memory_order_relaxed);
+	}
+	if(block == nullptr) return nullptr;
+	void* user = block + offset;
+	BlockHeader* header = headerOf(user);
+	header->size = size;
+	header->offset = (uint32_t)offset;
+	header->sizeClass = sizeClass;
+	header->scope = (uint8_t)scope;
+	header->magic = HOST_ALLOC_MAGIC;
+	countAllocation(scope, size);
+	return user;
+}
+
+static void VKAPI_CALL hostFree(void* pUserData, void* pMemory)
+{
+	if(pMemory == nullptr) return;
+	BlockHeader* header = headerOf(pMemory);
+	if(header->magic != HOST_ALLOC_MAGIC)
+	{
+		LOG_ERROR("host allocator: freeing a block it didn't allocate\n");
+		return;
+	}
+	countFree(header->scope, header->size);
+	header->magic = 0;
+	char* block = (char*)pMemory - header->offset;
+	if(header->sizeClass == HOST_ALLOC_LARGE) free(block);
+	else threadCache.push(header->sizeClass, block);
+}
+
+static void* VKAPI_CALL hostAllocation(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+	if(size == 0) return nullptr;
+	return allocateBlock(size, alignment, allocationScope);
+}
+
+static void* VKAPI_CALL hostReallocation(void* pUserData, void* pOriginal, size_t size, size_t alignment, \
+	VkSystemAllocationScope allocationScope)
+{
+	if(pOriginal == nullptr) return hostAllocation(pUserData, size, alignment, allocationScope);
+	if(size == 0)
+	{
+		hostFree(pUserData, pOriginal);
+		return nullptr;
+	}
+	BlockHeader* header = headerOf(pOriginal);
+	// grow or shrink in place while the pooled block still fits
+	if(header->sizeClass != HOST_ALLOC_LARGE && header->offset >= alignment && header->offset % alignment == 0 && \
+		header->offset + size <= classSize(header->sizeClass))
+	{
+		countFree(header->scope, header->size);
+		countAllocation(header->scope, size);
+		header->size = size;
+		return pOriginal;
+	}
+	void* moved = allocateBlock(size, alignment, (VkSystemAllocationScope)header->scope);
+	if(moved == nullptr) return nullptr; // original stays valid, as the spec requires
+	memcpy(moved, pOriginal, header->size < size ? header->size : size);
+	hostFree(pUserData, pOriginal);
+	return moved;
+}
+
+static void VKAPI_CALL hostInternalAllocation(void* pUserData, size_t size, VkInternalAllocationType allocationType, \
+	VkSystemAllocationScope allocationScope)
+{
+	scopeCounters[allocationScope < HOST_ALLOC_SCOPE_COUNT ? allocationScope : 0].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void VKAPI_CALL hostInternalFree(void* pUserData, size_t size, VkInternalAllocationType allocationType, \
+	VkSystemAllocationScope allocationScope)
+{
+	scopeCounters[allocationScope < HOST_ALLOC_SCOPE_COUNT ? allocationScope : 0].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static const VkAllocationCallbacks callbacks = { nullptr, hostAllocation, hostReallocation, hostFree, \
+	hostInternalAllocation, hostInternalFree };
+
+const VkAllocationCallbacks* hostAllocator()
+{
+	return &callbacks;
+}
+
+HostAllocationStats getHostAllocationStats()
+{
+	HostAllocationStats stats{};
+	for(uint32_t s = 0; s < HOST_ALLOC_SCOPE_COUNT; s++)
+	{
+		stats.scopes[s].allocations = scopeCounters[s].allocations.load(std::memory_order_relaxed);
+		stats.scopes[s].frees = scopeCounters[s].frees.load(std::memory_order_relaxed);
+		stats.scopes[s].liveCount = scopeCounters[s].liveCount.load(std::memory_order_relaxed);
+		stats.scopes[s].liveBytes = scopeCounters[s].liveBytes.load(std::memory_order_relaxed);
+		stats.scopes[s].peakBytes = scopeCounters[s].peakBytes.load(std::memory_order_relaxed);
+		stats.scopes[s].internalBytes = scopeCounters[s].internalBytes.load(std::memory_order_relaxed);
+	}
+	stats.pooledBlocks = pooledBlocks.load(std::memory_order_relaxed);
+	stats.largeBlocks = largeBlocks.load(std::memory_order_relaxed);
+	stats.chunkBytes = chunkBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+const char* hostAllocationScopeName(uint32_t scope)
+{
+	static const char* names[HOST_ALLOC_SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+	return scope < HOST_ALLOC_SCOPE_COUNT ? names[scope] : "unknown";
+}
+
+void logHostAllocationStats(const char* label, const HostAllocationStats* since)
+{
+	HostAllocationStats now = getHostAllocationStats();
+	for(uint32_t s = 0; s < HOST_ALLOC_SCOPE_COUNT; s++)
+	{
+		const HostAllocationScopeStats& st = now.scopes[s];
+		if(st.allocations == 0 && st.internalBytes == 0) continue;
+		LOG_INFO("host alloc %s %-8s: %llu allocs (+%llu), %llu frees, %llu live / %llu bytes, peak %llu, internal %llu\n", \
+			label, hostAllocationScopeName(s), (unsigned long long)st.allocations, \
+			(unsigned long long)(since ? st.allocations - since->scopes[s].allocations : st.allocations), \
+			(unsigned long long)st.frees, (unsigned long long)st.liveCount, (unsigned long long)st.liveBytes, \
+			(unsigned long long)st.peakBytes, (unsigned long long)st.internalBytes);
+	}
+	LOG_INFO("host alloc %s: %llu pooled, %llu large blocks, %llu KiB of chunks\n", label, \
+		(unsigned long long)now.pooledBlocks, (unsigned long long)now.largeBlocks, (unsigned long long)(now.chunkBytes / 1024));
+}
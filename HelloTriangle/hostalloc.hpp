@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Host memory for the Vulkan driver. Every vkCreate*/vkDestroy*/vkAllocateMemory
+// call passes hostAllocator() so driver heap traffic is visible and cheap:
+//  - small requests come from power-of-two size classes carved out of chunks,
+//    with a per-thread cache of free blocks in front of the shared pools,
+//  - big ones go straight to aligned_alloc,
+//  - everything is counted per VkSystemAllocationScope.
+
+#define HOST_ALLOC_MIN_CLASS 32         // smallest block, header included
+#define HOST_ALLOC_MAX_CLASS 8192       // larger blocks bypass the pools
+#define HOST_ALLOC_CHUNK_SIZE 65536     // pools grow by this much, aligned to it
+#define HOST_ALLOC_THREAD_CACHE 32      // free blocks kept per thread and class
+#define HOST_ALLOC_SCOPE_COUNT 5        // VK_SYSTEM_ALLOCATION_SCOPE_COMMAND .. INSTANCE
+
+struct HostAllocationScopeStats
+{
+	uint64_t allocations;       // total, including reallocations
+	uint64_t frees;
+	uint64_t liveCount;
+	uint64_t liveBytes;         // as requested by the driver
+	uint64_t peakBytes;
+	uint64_t internalBytes;     // driver-reported internal (non callback) allocations
+};
+
+struct HostAllocationStats
+{
+	HostAllocationScopeStats scopes[HOST_ALLOC_SCOPE_COUNT];
+	uint64_t pooledBlocks;      // served from size classes
+	uint64_t largeBlocks;       // served by aligned_alloc
+	uint64_t chunkBytes;        // reserved for the pools
+};
+
+const VkAllocationCallbacks* hostAllocator();
+HostAllocationStats getHostAllocationStats();
+const char* hostAllocationScopeName(uint32_t scope);
+// one log line per scope; since != nullptr also reports the allocations made after that snapshot
+void logHostAllocationStats(const char* label, const HostAllocationStats* since = nullptr);
@@ -0,0 +1,145 @@
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+
+#include "initgraph.hpp"
+#include "log.hpp"
+
+static double millisecondsBetween(InitGraph::Clock::time_point from, InitGraph::Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+uint32_t InitGraph::add(const char* name, std::function<void()> stage, std::initializer_list<uint32_t> dependencies, \
+	InitThread thread)
+{
+	uint32_t id = (uint32_t)stages.size();
+	// only earlier stages can be depended on, which keeps the graph acyclic
+	for(uint32_t dependency : dependencies)
+		if(dependency >= id) throw std::runtime_error("Init stages can only depend on earlier stages!\n");
+	stages.push_back({ name, std::move(stage), dependencies, thread, {}, {} });
+	return id;
+}
+
+void InitGraph::run(bool serialRun)
+{
+	serial = serialRun;
+	start = Clock::now();
+	if(serial)
+	{
+		for(Stage& stage : stages)
+		{
+			stage.start = Clock::now();
+			stage.run();
+			stage.end = Clock::now();
+		}
+		end = Clock::now();
+		return;
+	}
+
+	enum : uint8_t { PENDING, RUNNING, DONE };
+	std::vector<uint8_t> state(stages.size(), PENDING);
+	std::mutex lock;
+	std::condition_variable changed;
+	std::vector<std::thread> workers;
+	std::exception_ptr failure;
+	size_t done = 0, runningWorkers = 0;
+	auto ready = [&](uint32_t i) {
+		if(state[i] != PENDING) return false;
+		for(uint32_t dependency : stages[i].dependencies)
+			if(state[dependency] != DONE) return false;
+		return true;
+	};
+	// called with the lock held
+	auto finish = [&](uint32_t i, std::exception_ptr error) {
+		stages[i].end = Clock::now();
+		state[i] = DONE;
+		done++;
+		if(error && !failure) failure = error;
+	};
+
+	std::unique_lock<std::mutex> guard(lock);
+	while(done < stages.size() && !failure)
+	{
+		for(uint32_t i = 0; i < stages.size(); i++)
+		{
+			if(stages[i].thread != INIT_WORKER || !ready(i)) continue;
+			state[i] = RUNNING;
+			stages[i].start = Clock::now();
+			runningWorkers++;
+			workers.emplace_back([&, i]() {
+				std::exception_ptr error;
+				try { stages[i].run(); }
+				catch(...) { error = std::current_exception(); }
+				std::lock_guard<std::mutex> workerGuard(lock);
+				finish(i, error);
+				runningWorkers--;
+				changed.notify_all();
+			});
+		}
+		uint32_t next = 0;
+		while(next < stages.size() && (stages[next].thread != INIT_MAIN || !ready(next))) next++;
+		if(next == stages.size())
+		{
+			changed.wait(guard); // everything left waits on a worker stage
+			continue;
+		}
+		state[next] = RUNNING;
+		stages[next].start = Clock::now();
+		guard.unlock();
+		std::exception_ptr error;
+		try { stages[next].run(); }
+		catch(...) { error = std::current_exception(); }
+		guard.lock();
+		finish(next, error);
+	}
+	// after a failure the stages already running still have to finish before anything is torn down
+	changed.wait(guard, [&]() { return runningWorkers == 0; });
+	guard.unlock();
+	for(std::thread& worker : workers) worker.join();
+	end = Clock::now();
+	if(failure) std::rethrow_exception(failure);
+}
+
+double InitGraph::milliseconds() const
+{
+	return millisecondsBetween(start, end);
+}
+
+void InitGraph::log() const
+{
+	double busy = 0.0;
+	for(const Stage& stage : stages) busy += millisecondsBetween(stage.start, stage.end);
+	LOG_INFO("Startup: %.1f ms for %.1f ms of stages%s\n", milliseconds(), busy, serial ? " (serial)" : "");
+	for(const Stage& stage : stages)
+		LOG_INFO("  %-18s %7.1f .. %7.1f ms (%6.1f ms) %s\n", stage.name.c_str(), millisecondsBetween(start, stage.start), \
+			millisecondsBetween(start, stage.end), millisecondsBetween(stage.start, stage.end), \
+			stage.thread == INIT_WORKER && !serial ? "worker" : "main");
+
+	// walk back from the last stage to finish: each stage waited on whichever dependency,
+	// or for main stages the main stage before it, finished last
+	if(stages.empty()) return;
+	uint32_t current = 0;
+	for(uint32_t i = 1; i < stages.size(); i++)
+		if(stages[i].end > stages[current].end) current = i;
+	std::string path = stages[current].name;
+	while(true)
+	{
+		const Stage& stage = stages[current];
+		int32_t blocker = -1;
+		auto consider = [&](uint32_t candidate) {
+			if(stages[candidate].end > stage.start) return;
+			if(blocker < 0 || stages[candidate].end > stages[blocker].end) blocker = (int32_t)candidate;
+		};
+		for(uint32_t dependency : stage.dependencies) consider(dependency);
+		if(stage.thread == INIT_MAIN || serial)
+			for(uint32_t i = 0; i < stages.size(); i++)
+				if(i != current && (stages[i].thread == INIT_MAIN || serial)) consider(i);
+		if(blocker < 0) break;
+		current = (uint32_t)blocker;
+		path = stages[current].name + " > " + path;
+	}
+	LOG_INFO("  critical path: %s\n", path.c_str());
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+
+// Startup as a dependency graph. Each stage names the stages it needs; a stage
+// starts as soon as those are done, so file loading and pipeline compilation
+// overlap device and swapchain creation instead of waiting their turn.
+// Main stages run on the calling thread in the order they were added (GLFW
+// and the queue want that); worker stages get a thread of their own. Every
+// stage is timed, and log() prints the timeline and the critical path.
+
+enum InitThread
+{
+	INIT_MAIN,
+	INIT_WORKER,
+};
+
+class InitGraph
+{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		// dependencies are ids returned by earlier add() calls
+		uint32_t add(const char* name, std::function<void()> stage, std::initializer_list<uint32_t> dependencies = {}, \
+			InitThread thread = INIT_MAIN);
+		// serial: every stage on this thread in add order, to compare against
+		// rethrows the first failure once the running worker stages are done
+		void run(bool serial = false);
+		void log() const;
+		double milliseconds() const;
+
+	private:
+		struct Stage
+		{
+			std::string name;
+			std::function<void()> run;
+			std::vector<uint32_t> dependencies;
+			InitThread thread;
+			Clock::time_point start, end;
+		};
+		std::vector<Stage> stages;
+		Clock::time_point start, end;
+		bool serial = false;
+};
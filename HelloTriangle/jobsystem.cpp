@@ -0,0 +1,177 @@
+#include <algorithm>
+
+#include "jobsystem.hpp"
+
+// queue index of this thread: 0 on the main thread, -1 on threads the scheduler doesn't own
+static thread_local int32_t jobThread = -1;
+
+void JobSystem::start(uint32_t workerCount)
+{
+	workerCount = std::min<uint32_t>(workerCount, JOB_MAX_THREADS - 1);
+	jobThread = 0;
+	queues.clear();
+	for(uint32_t i = 0; i <= workerCount; i++) queues.emplace_back(new Queue());
+	running = true;
+	for(uint32_t i = 1; i <= workerCount; i++)
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::stop()
+{
+	if(!running) return;
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		running = false;
+	}
+	wake.notify_all();
+	for(std::thread& worker : workers) worker.join();
+	workers.clear();
+}
+
+void JobSystem::submit(const Job& job, JobAffinity affinity)
+{
+	job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+	if(affinity == JOB_MAIN_THREAD)
+	{
+		std::lock_guard<std::mutex> guard(mainQueue.lock);
+		mainQueue.jobs.push_back(job);
+		return;
+	}
+	Queue& queue = *queues[std::max(jobThread, 0)];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.jobs.push_back(job);
+	}
+	queued.fetch_add(1, std::memory_order_release);
+	wakeWorkers(1);
+}
+
+void JobSystem::submitRange(void (*function)(void*, uint32_t, uint32_t), void* data, uint32_t count, uint32_t grain, \
+	JobCounter& counter)
+{
+	if(count == 0) return;
+	grain = std::max(grain, 1u);
+	uint32_t ranges = std::min((count + grain - 1) / grain, threadCount() * JOB_SPLIT_PER_THREAD);
+	ranges = std::max(ranges, 1u);
+	counter.pending.fetch_add(ranges, std::memory_order_relaxed);
+	Queue& queue = *queues[std::max(jobThread, 0)];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		for(uint32_t r = 0; r < ranges; r++)
+		{
+			// even split, the first count % ranges ranges get one more
+			uint32_t begin = (uint32_t)((uint64_t)count * r / ranges);
+			uint32_t end = (uint32_t)((uint64_t)count * (r + 1) / ranges);
+			queue.jobs.push_back({ function, data, begin, end, &counter });
+		}
+	}
+	queued.fetch_add(ranges, std::memory_order_release);
+	wakeWorkers(ranges);
+}
+
+void JobSystem::wakeWorkers(uint32_t count)
+{
+	if(workers.empty()) return;
+	// taking the lock orders this with a worker that is about to sleep, so the wakeup isn't lost
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	if(count > 1) wake.notify_all();
+	else wake.notify_one();
+}
+
+// own jobs newest first, then the main thread's pinned ones, then the oldest job of another thread
+bool JobSystem::runOne(int32_t self)
+{
+	Job job;
+	if(self >= 0)
+	{
+		Queue& own = *queues[self];
+		std::unique_lock<std::mutex> guard(own.lock);
+		if(!own.jobs.empty())
+		{
+			job = own.jobs.back();
+			own.jobs.pop_back();
+			guard.unlock();
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			execute(job);
+			return true;
+		}
+	}
+	if(self == 0)
+	{
+		std::unique_lock<std::mutex> guard(mainQueue.lock);
+		if(!mainQueue.jobs.empty())
+		{
+			job = mainQueue.jobs.front();
+			mainQueue.jobs.pop_front();
+			guard.unlock();
+			execute(job);
+			return true;
+		}
+	}
+	if(queued.load(std::memory_order_acquire) == 0) return false;
+	uint32_t count = threadCount();
+	for(uint32_t k = 1; k <= count; k++)
+	{
+		uint32_t victim = (uint32_t)(self + (int32_t)k) % count;
+		if((int32_t)victim == self) continue;
+		Queue& other = *queues[victim];
+		std::unique_lock<std::mutex> guard(other.lock);
+		if(other.jobs.empty()) continue;
+		job = other.jobs.front();
+		other.jobs.pop_front();
+		guard.unlock();
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		stealCount.fetch_add(1, std::memory_order_relaxed);
+		execute(job);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::execute(const Job& job)
+{
+	try
+	{
+		job.function(job.data, job.begin, job.end);
+	}
+	catch(...)
+	{
+		if(!job.counter->failed.exchange(true)) job.counter->error = std::current_exception();
+	}
+	jobCount.fetch_add(1, std::memory_order_relaxed);
+	job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	while(counter.pending.load(std::memory_order_acquire) != 0)
+	{
+		if(!runOne(jobThread)) std::this_thread::yield();
+	}
+	if(counter.failed.load(std::memory_order_acquire))
+	{
+		std::exception_ptr error = counter.error;
+		counter.error = nullptr;
+		counter.failed = false;
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+	jobThread = (int32_t)index;
+	while(true)
+	{
+		if(runOne((int32_t)index)) continue;
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wake.wait(guard, [this]() { return !running || queued.load(std::memory_order_acquire) > 0; });
+		if(!running) return;
+	}
+}
+
+JobStats JobSystem::takeStats()
+{
+	return { jobCount.exchange(0, std::memory_order_relaxed), stealCount.exchange(0, std::memory_order_relaxed) };
+}
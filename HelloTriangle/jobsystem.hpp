@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <condition_variable>
+#include <cstdint>
+
+// Work-stealing job scheduler for the frame loop. Every thread owns a deque:
+// it pushes and pops its own jobs at the back (newest first, still warm in
+// cache) and idle threads steal from the front of the others. A job is a
+// function pointer over an index range, so submitting one allocates nothing;
+// its body must outlive the wait on its counter. The thread that called
+// start() is the main thread: it runs jobs while waiting, and it alone takes
+// JOB_MAIN_THREAD jobs, for GLFW and anything else that must stay on it.
+// With no workers every job runs on the main thread inside wait().
+
+#define JOB_MAX_THREADS 16
+#define JOB_SPLIT_PER_THREAD 4      // parallelFor ranges per thread, so stealing can even out the load
+
+enum JobAffinity
+{
+	JOB_ANY,
+	JOB_MAIN_THREAD,
+};
+
+// jobs left in a group; wait() on it rethrows the first exception a job threw
+struct JobCounter
+{
+	std::atomic<uint32_t> pending{ 0 };
+	std::atomic<bool> failed{ false };
+	std::exception_ptr error;
+};
+
+struct JobStats
+{
+	uint64_t jobs;
+	uint64_t steals;            // jobs run by a thread other than the one that queued them
+};
+
+class JobSystem
+{
+	public:
+		~JobSystem() { stop(); }
+		// workers: threads besides the calling one, which becomes the main thread
+		void start(uint32_t workers);
+		void stop();
+		uint32_t threadCount() const { return (uint32_t)queues.size(); }
+
+		template<typename F> void run(F& body, JobCounter& counter, JobAffinity affinity = JOB_ANY)
+		{
+			submit({ &invoke<F>, &body, 0, 1, &counter }, affinity);
+		}
+		// body(begin, end) over [0, count), in ranges of at least grain
+		template<typename F> void parallelFor(uint32_t count, uint32_t grain, F& body, JobCounter& counter)
+		{
+			submitRange(&invoke<F>, &body, count, grain, counter);
+		}
+		// runs queued jobs on this thread until the counter is done
+		void wait(JobCounter& counter);
+		// totals since the last call
+		JobStats takeStats();
+
+	private:
+		struct Job
+		{
+			void (*function)(void* data, uint32_t begin, uint32_t end);
+			void* data;
+			uint32_t begin, end;
+			JobCounter* counter;
+		};
+		struct Queue
+		{
+			std::mutex lock;
+			std::deque<Job> jobs;
+		};
+		template<typename F> static void invoke(void* data, uint32_t begin, uint32_t end) { (*(F*)data)(begin, end); }
+
+		void submit(const Job& job, JobAffinity affinity);
+		void submitRange(void (*function)(void*, uint32_t, uint32_t), void* data, uint32_t count, uint32_t grain, \
+			JobCounter& counter);
+		bool runOne(int32_t self);
+		void execute(const Job& job);
+		void workerLoop(uint32_t index);
+		void wakeWorkers(uint32_t count);
+
+		std::vector<std::unique_ptr<Queue>> queues;  // [0] is the main thread's
+		Queue mainQueue;                            // JOB_MAIN_THREAD jobs
+		std::vector<std::thread> workers;
+		std::atomic<bool> running{ false };
+		std::atomic<uint32_t> queued{ 0 };          // jobs any thread may take
+		std::mutex sleepLock;
+		std::condition_variable wake;
+		std::atomic<uint64_t> jobCount{ 0 }, stealCount{ 0 };
+};
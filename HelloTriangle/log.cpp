@@ -0,0 +1,237 @@
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "log.hpp"
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+// bounded MPSC queue (Vyukov): a slot is writable when sequence == ticket,
+// readable when sequence == ticket + 1, and recycled as ticket + LOG_RING_SIZE
+struct alignas(64) LogSlot
+{
+	std::atomic<uint64_t> sequence;
+	int16_t level;
+	int16_t file;           // -1 for log messages, else an index from logOpenFile
+	uint32_t length;
+	char text[LOG_MESSAGE_SIZE];
+};
+
+static LogSlot ring[LOG_RING_SIZE];
+alignas(64) static std::atomic<uint64_t> writePos{ 0 };  // shared by producers
+alignas(64) static uint64_t readPos = 0;                 // under drainLock
+static std::atomic<uint64_t> dropped{ 0 };
+static std::atomic<bool> running{ false };
+static std::atomic<bool> stopped{ false };              // after logStop callers write their own messages
+static std::mutex drainLock;                            // the writer thread, or those callers
+static std::atomic<bool> writerSleeping{ false };       // the ring was empty, the next producer wakes the writer
+static std::mutex wakeLock;
+static std::condition_variable wake;
+static std::thread writer;
+static FILE* out = nullptr;
+static FILE* files[LOG_MAX_FILES];                      // logOpenFile outputs, under drainLock
+static int fileCount = 0;
+
+static const char* levelNames[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+
+static bool ringInit()
+{
+	for(uint64_t i = 0; i < LOG_RING_SIZE; i++) ring[i].sequence.store(i, std::memory_order_relaxed);
+	return true;
+}
+static bool ringReady = ringInit();
+
+static bool drain();
+static void writeMessage(int level, int file, const char* text, uint32_t length);
+
+static void enqueue(int level, int file, const char* format, va_list args)
+{
+	// after logStop nobody drains the ring: format here and write it out, behind whatever is still queued
+	if(stopped.load(std::memory_order_acquire))
+	{
+		char text[LOG_MESSAGE_SIZE];
+		int n = vsnprintf(text, LOG_MESSAGE_SIZE, format, args);
+		std::lock_guard<std::mutex> guard(drainLock);
+		drain();
+		writeMessage(level, file, text, n < 0 ? 0 : (n >= LOG_MESSAGE_SIZE ? LOG_MESSAGE_SIZE - 1 : (uint32_t)n));
+		fflush(out);
+		return;
+	}
+
+	// claim a ticket; if the slot is still unread the ring is full and we drop
+	uint64_t ticket = writePos.load(std::memory_order_relaxed);
+	LogSlot* slot;
+	for(;;)
+	{
+		slot = &ring[ticket & (LOG_RING_SIZE - 1)];
+		uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+		if(seq == ticket)
+		{
+			if(writePos.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) break;
+		}
+		else if(seq < ticket)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else ticket = writePos.load(std::memory_order_relaxed);
+	}
+
+	int n = vsnprintf(slot->text, LOG_MESSAGE_SIZE, format, args);
+	slot->level = (int16_t)level;
+	slot->file = (int16_t)file;
+	slot->length = n < 0 ? 0 : (n >= LOG_MESSAGE_SIZE ? LOG_MESSAGE_SIZE - 1 : (uint32_t)n);
+	slot->sequence.store(ticket + 1, std::memory_order_release);
+
+	// the fence pairs with the writer's before it sleeps: either it sees this message or we see it sleeping.
+	// Only the producer that flips the flag back pays for the wakeup
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(writerSleeping.load(std::memory_order_relaxed) && writerSleeping.exchange(false))
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);
+		wake.notify_one();
+	}
+	// logStop may have come in while this was queued. The same fence pairs with the one in logStop, so
+	// either this sees stopped or logStop's last drain sees the message
+	if(stopped.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> guard(drainLock);
+		drain();
+	}
+}
+
+void logWrite(int level, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	enqueue(level, -1, format, args);
+	va_end(args);
+}
+
+void logWriteFile(int file, const char* format, ...)
+{
+	if(file < 0 || file >= LOG_MAX_FILES) return;
+	va_list args;
+	va_start(args, format);
+	enqueue(0, file, format, args);
+	va_end(args);
+}
+
+int logOpenFile(const char* path)
+{
+	std::lock_guard<std::mutex> guard(drainLock);
+	if(fileCount == LOG_MAX_FILES) return -1;
+	FILE* file = fopen(path, "w");
+	if(file == nullptr) return -1;
+	files[fileCount] = file;
+	return fileCount++;
+}
+
+static void writeMessage(int level, int file, const char* text, uint32_t length)
+{
+	// file output is written as it came, closed files (after logStop) swallow it
+	if(file >= 0)
+	{
+		if(files[file] != nullptr) fwrite(text, 1, length, files[file]);
+		return;
+	}
+	// messages already end in \n like the printfs they replaced; add one if not
+	bool newline = length > 0 && text[length - 1] == '\n';
+	fprintf(out, "%s: %.*s%s", levelNames[level], (int)length, text, newline ? "" : "\n");
+}
+
+// writes out everything that is ready, returns false if there was nothing; drainLock held
+static bool drain()
+{
+	bool any = false;
+	for(;;)
+	{
+		LogSlot& slot = ring[readPos & (LOG_RING_SIZE - 1)];
+		if(slot.sequence.load(std::memory_order_acquire) != readPos + 1) break;
+		writeMessage(slot.level, slot.file, slot.text, slot.length);
+		slot.sequence.store(readPos + LOG_RING_SIZE, std::memory_order_release);
+		readPos++;
+		any = true;
+	}
+	if(any) fflush(out);
+	return any;
+}
+
+static void writerLoop()
+{
+	uint64_t reported = 0;
+	while(running.load(std::memory_order_acquire))
+	{
+		bool wrote;
+		{
+			std::lock_guard<std::mutex> guard(drainLock);
+			wrote = drain();
+		}
+		uint64_t d = dropped.load(std::memory_order_relaxed);
+		if(d != reported)
+		{
+			fprintf(out, "WARN: log ring full, %llu messages dropped\n", (unsigned long long)(d - reported));
+			reported = d;
+		}
+		if(wrote) continue;
+		// nothing queued: sleep until a producer publishes, instead of polling
+		std::unique_lock<std::mutex> lock(wakeLock);
+		writerSleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(ring[readPos & (LOG_RING_SIZE - 1)].sequence.load(std::memory_order_acquire) == readPos + 1)
+		{
+			writerSleeping.store(false, std::memory_order_relaxed);
+			continue;
+		}
+		wake.wait(lock, [] { return !writerSleeping.load() || !running.load(); });
+	}
+}
+
+void logStart(const char* path)
+{
+	if(running.load()) return;
+	out = stderr;
+	if(path != nullptr)
+	{
+		out = fopen(path, "w");
+		if(out == nullptr) throw std::runtime_error(std::string("Couldn't open log file ") + path + "\n");
+	}
+	stopped.store(false);
+	writerSleeping.store(false);
+	running.store(true, std::memory_order_release);
+	writer = std::thread(writerLoop);
+}
+
+void logStop()
+{
+	if(!running.load()) return;
+	running.store(false, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);
+		wake.notify_one();
+	}
+	writer.join();
+	std::lock_guard<std::mutex> guard(drainLock);
+	drain(); // what the writer thread left, into the file it was going to
+	if(out != stderr) fclose(out);
+	out = stderr; // the file is closed, later messages go to stderr
+	stopped.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	drain(); // anything queued while the file was closing
+	for(int i = 0; i < fileCount; i++)
+	{
+		fclose(files[i]);
+		files[i] = nullptr;
+	}
+}
+
+uint64_t logDroppedCount()
+{
+	return dropped.load(std::memory_order_relaxed);
+}
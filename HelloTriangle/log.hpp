@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+// Asynchronous logging. Levels below LOG_LEVEL compile to nothing; enabled
+// messages are formatted by the caller into a lock-free ring buffer and a
+// background thread writes them out, so a validation message storm never
+// blocks the render thread on stderr. When the ring is full messages are
+// dropped (and counted) instead of waiting.
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF   5
+
+// pick with -DLOG_LEVEL=LOG_LEVEL_TRACE etc., see the Makefile
+#ifndef LOG_LEVEL
+	#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_RING_SIZE 1024      // slots, power of two
+#define LOG_MESSAGE_SIZE 496    // bytes of text per slot, longer messages are truncated
+#define LOG_MAX_FILES 4         // outputs opened with logOpenFile
+
+// starts the writer thread; path == nullptr logs to stderr. Messages logged earlier are kept.
+void logStart(const char* path = nullptr);
+// drains everything queued so far and joins the writer thread
+void logStop();
+void logWrite(int level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+uint64_t logDroppedCount();
+// extra outputs written by the writer thread, such as per-frame CSV traces. Text goes through the ring
+// like messages, without a level prefix or an added newline, and is not compiled out by LOG_LEVEL.
+// logOpenFile returns -1 if the file can't be opened; logStop closes them all.
+int logOpenFile(const char* path);
+void logWriteFile(int file, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#if LOG_LEVEL <= LOG_LEVEL_TRACE
+	#define LOG_TRACE(...) logWrite(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+	#define LOG_TRACE(...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+	#define LOG_DEBUG(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+	#define LOG_DEBUG(...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+	#define LOG_INFO(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+	#define LOG_INFO(...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+	#define LOG_WARN(...) logWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+	#define LOG_WARN(...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+	#define LOG_ERROR(...) logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+	#define LOG_ERROR(...) ((void)0)
+#endif
@@ -11,6 +11,7 @@
 int main()
 {
 	HelloTriangleApplication app;
+	logStart(getenv("BENT_LOG_FILE")); // stderr unless set
 
 	try
 	{
@@ -18,9 +19,11 @@ int main()
 	}
 	catch (const std::exception& e)
 	{
+		logStop(); // flush queued messages before the error
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
 
+	logStop();
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include <mutex>
+#include <unordered_map>
+#include <cstdio>
+#include <string>
+
+#include "memorybudget.hpp"
+#include "hostalloc.hpp"
+#include "log.hpp"
+
+struct AllocationRecord
+{
+	VkDeviceSize size;
+	uint32_t typeIndex;
+	MemoryCategory category;
+};
+
+// per memory type, heaps are only known once a physical device is queried
+static std::mutex trackerLock;
+static std::unordered_map<VkDeviceMemory, AllocationRecord> records;
+static VkDeviceSize typeBytes[VK_MAX_MEMORY_TYPES][MEMORY_CATEGORY_COUNT];
+static uint32_t typeCounts[VK_MAX_MEMORY_TYPES][MEMORY_CATEGORY_COUNT];
+static uint64_t allocationTotal = 0, freeTotal = 0, failureTotal = 0;
+
+static const char* categoryNames[MEMORY_CATEGORY_COUNT] = {
+	"other", "mesh", "texture", "render_target", "staging", "stream", "readback",
+};
+
+const char* memoryCategoryName(uint32_t category)
+{
+	return category < MEMORY_CATEGORY_COUNT ? categoryNames[category] : "unknown";
+}
+
+VkResult allocateDeviceMemory(VkDevice device, const VkMemoryAllocateInfo& allocInfo, MemoryCategory category, \
+	VkDeviceMemory& memory)
+{
+	VkResult result = vkAllocateMemory(device, &allocInfo, hostAllocator(), &memory);
+	std::lock_guard<std::mutex> guard(trackerLock);
+	if(result != VK_SUCCESS)
+	{
+		failureTotal++;
+		return result;
+	}
+	uint32_t type = allocInfo.memoryTypeIndex;
+	records[memory] = AllocationRecord{ allocInfo.allocationSize, type, category };
+	typeBytes[type][category] += allocInfo.allocationSize;
+	typeCounts[type][category]++;
+	allocationTotal++;
+	return result;
+}
+
+void freeDeviceMemory(VkDevice device, VkDeviceMemory memory)
+{
+	if(memory == VK_NULL_HANDLE) return;
+	// forget the record before the handle is freed: once it is, another thread's allocation can get the same value
+	{
+		std::lock_guard<std::mutex> guard(trackerLock);
+		auto it = records.find(memory);
+		if(it != records.end())
+		{
+			const AllocationRecord& record = it->second;
+			typeBytes[record.typeIndex][record.category] -= record.size;
+			typeCounts[record.typeIndex][record.category]--;
+			records.erase(it);
+			freeTotal++;
+		}
+	}
+	vkFreeMemory(device, memory, hostAllocator());
+}
+
+MemoryReport queryMemoryBudget(VkPhysicalDevice physicalDevice, bool budgetExtension)
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	VkPhysicalDeviceMemoryProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	// properties2 is core 1.1, which the extension implies; 1.0 devices take the plain query
+	if(budgetExtension)
+	{
+		properties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+	}
+	else vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties2.memoryProperties);
+	const VkPhysicalDeviceMemoryProperties& properties = properties2.memoryProperties;
+
+	MemoryReport report{};
+	report.fromExtension = budgetExtension;
+	report.heapCount = properties.memoryHeapCount;
+	{
+		std::lock_guard<std::mutex> guard(trackerLock);
+		for(uint32_t type = 0; type < properties.memoryTypeCount; type++)
+		{
+			MemoryHeapReport& heap = report.heaps[properties.memoryTypes[type].heapIndex];
+			for(uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++)
+			{
+				heap.categoryBytes[c] += typeBytes[type][c];
+				heap.categoryCounts[c] += typeCounts[type][c];
+				heap.tracked += typeBytes[type][c];
+			}
+		}
+		report.allocations = allocationTotal;
+		report.frees = freeTotal;
+		report.failures = failureTotal;
+	}
+	for(uint32_t i = 0; i < properties.memoryHeapCount; i++)
+	{
+		MemoryHeapReport& heap = report.heaps[i];
+		heap.size = properties.memoryHeaps[i].size;
+		heap.deviceLocal = (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		heap.budget = budgetExtension ? budgetProperties.heapBudget[i] : heap.size;
+		heap.usage = budgetExtension ? budgetProperties.heapUsage[i] : heap.tracked;
+	}
+	return report;
+}
+
+VkDeviceSize deviceLocalHeadroom(const MemoryReport& report)
+{
+	VkDeviceSize headroom = ~(VkDeviceSize)0;
+	for(uint32_t i = 0; i < report.heapCount; i++)
+	{
+		const MemoryHeapReport& heap = report.heaps[i];
+		if(!heap.deviceLocal) continue;
+		VkDeviceSize left = heap.usage < heap.budget ? heap.budget - heap.usage : 0;
+		if(left < headroom) headroom = left;
+	}
+	return headroom;
+}
+
+static double toMiB(VkDeviceSize bytes) { return bytes / (1024.0 * 1024.0); }
+
+void logMemoryReport(const MemoryReport& report)
+{
+	for(uint32_t i = 0; i < report.heapCount; i++)
+	{
+		const MemoryHeapReport& heap = report.heaps[i];
+		if(heap.tracked == 0 && !heap.deviceLocal) continue;
+		std::string categories;
+		for(uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++)
+		{
+			if(heap.categoryCounts[c] == 0) continue;
+			char part[64];
+			snprintf(part, sizeof(part), " %s %.2f", categoryNames[c], toMiB(heap.categoryBytes[c]));
+			categories += part;
+		}
+		LOG_INFO("Heap %u%s: %.1f/%.1f MiB used (%s), %.2f MiB ours:%s\n", i, heap.deviceLocal ? " (device)" : "", \
+			toMiB(heap.usage), toMiB(heap.budget), report.fromExtension ? "budget" : "heap size", \
+			toMiB(heap.tracked), categories.c_str());
+		if(heap.deviceLocal && heap.usage > heap.budget * MEMORY_BUDGET_WARN)
+			LOG_WARN("Heap %u is at %.0f%% of its budget\n", i, 100.0 * heap.usage / heap.budget);
+	}
+	if(report.failures != 0) LOG_WARN("%llu device memory allocations failed\n", (unsigned long long)report.failures);
+}
+
+// written to path.tmp first and renamed, so readers never see half a file
+bool writeMemoryReportJson(const MemoryReport& report, const char* path)
+{
+	std::string temporary = std::string(path) + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+	if(file == nullptr) return false;
+	fprintf(file, "{\n  \"source\": \"%s\",\n", report.fromExtension ? "VK_EXT_memory_budget" : "heap_size");
+	fprintf(file, "  \"allocations\": %llu,\n  \"frees\": %llu,\n  \"failures\": %llu,\n  \"heaps\": [", \
+		(unsigned long long)report.allocations, (unsigned long long)report.frees, (unsigned long long)report.failures);
+	for(uint32_t i = 0; i < report.heapCount; i++)
+	{
+		const MemoryHeapReport& heap = report.heaps[i];
+		fprintf(file, "%s\n    { \"index\": %u, \"device_local\": %s, \"size\": %llu, \"budget\": %llu, " \
+			"\"usage\": %llu, \"tracked\": %llu,\n      \"categories\": {", i == 0 ? "" : ",", i, \
+			heap.deviceLocal ? "true" : "false", (unsigned long long)heap.size, (unsigned long long)heap.budget, \
+			(unsigned long long)heap.usage, (unsigned long long)heap.tracked);
+		for(uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++)
+			fprintf(file, "%s \"%s\": { \"bytes\": %llu, \"count\": %u }", c == 0 ? "" : ",", categoryNames[c], \
+				(unsigned long long)heap.categoryBytes[c], heap.categoryCounts[c]);
+		fprintf(file, " } }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+	bool ok = fclose(file) == 0;
+	return ok && rename(temporary.c_str(), path) == 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Device memory bookkeeping. Every vkAllocateMemory/vkFreeMemory goes through
+// allocateDeviceMemory/freeDeviceMemory, which remember the size, memory type
+// and category of each allocation. queryMemoryBudget() combines that with the
+// driver's view of each heap: VK_EXT_memory_budget when the device has it
+// (usage includes other processes, budget is what we can use before the
+// driver starts paging or failing), otherwise the heap size is the budget and
+// our own allocations are the usage.
+
+#define MEMORY_BUDGET_WARN 0.9f     // warn when a device local heap is this full
+
+enum MemoryCategory : uint8_t
+{
+	MEMORY_OTHER,
+	MEMORY_MESH,                // vertex and index buffers
+	MEMORY_TEXTURE,
+	MEMORY_RENDER_TARGET,       // attachments we allocate ourselves
+	MEMORY_STAGING,             // upload buffers
+	MEMORY_STREAM,              // per frame host visible data
+	MEMORY_READBACK,            // GPU -> CPU copies
+	MEMORY_CATEGORY_COUNT,
+};
+
+struct MemoryHeapReport
+{
+	VkDeviceSize size;
+	VkDeviceSize budget;
+	VkDeviceSize usage;         // whole process (or system), from the driver when it can tell
+	VkDeviceSize tracked;       // our allocations only
+	bool deviceLocal;
+	VkDeviceSize categoryBytes[MEMORY_CATEGORY_COUNT];
+	uint32_t categoryCounts[MEMORY_CATEGORY_COUNT];
+};
+
+struct MemoryReport
+{
+	bool fromExtension;         // false: budget = heap size, usage = tracked
+	uint32_t heapCount;
+	MemoryHeapReport heaps[VK_MAX_MEMORY_HEAPS];
+	uint64_t allocations;       // totals since start
+	uint64_t frees;
+	uint64_t failures;
+};
+
+VkResult allocateDeviceMemory(VkDevice device, const VkMemoryAllocateInfo& allocInfo, MemoryCategory category, \
+	VkDeviceMemory& memory);
+void freeDeviceMemory(VkDevice device, VkDeviceMemory memory);
+
+const char* memoryCategoryName(uint32_t category);
+// fromExtension needs VK_EXT_memory_budget enabled on the device
+MemoryReport queryMemoryBudget(VkPhysicalDevice physicalDevice, bool budgetExtension);
+// bytes left before the fullest device local heap reaches its budget
+VkDeviceSize deviceLocalHeadroom(const MemoryReport& report);
+void logMemoryReport(const MemoryReport& report);
+bool writeMemoryReportJson(const MemoryReport& report, const char* path);
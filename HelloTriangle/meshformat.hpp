@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+
+// Binary mesh blob (.bmesh), written offline by tools/meshconv and mmapped at runtime.
+// Layout: MeshFileHeader | MeshSection[sectionCount] | section payloads.
+// Every payload starts on a MESH_SECTION_ALIGN boundary so it can be copied straight
+// into a staging buffer (or used in place) without any parsing. All values little endian.
+// Vertices are stored packed in one of the layouts from vertexlayout.hpp.
+
+#define MESH_MAGIC 0x48534D42u     // "BMSH"
+#define MESH_VERSION 2
+#define MESH_SECTION_ALIGN 64
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESH_MAX_LODS 8             // LOD 0 and up to 7 simplified levels
+
+enum MeshSectionType : uint32_t
+{
+	MESH_SECTION_VERTICES = 1,          // vertexCount * vertexStride bytes, packed per vertexLayout
+	MESH_SECTION_INDICES = 2,           // uint16_t or uint32_t [indexCount], see indexSize
+	MESH_SECTION_LODS = 3,              // MeshLod[lodCount], LOD 0 first
+	MESH_SECTION_MESHLETS = 4,          // Meshlet[], grouped per LOD
+	MESH_SECTION_MESHLET_VERTICES = 5,  // uint32_t[], meshlet local -> mesh vertex index
+	MESH_SECTION_MESHLET_TRIANGLES = 6, // uint8_t[3 * triangles], meshlet local vertex indices
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;        // sizeof(MeshFileHeader), for forward compatibility
+	uint32_t sectionCount;
+	uint64_t fileSize;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t vertexLayout;      // VertexLayoutId
+	uint32_t indexCount;        // LOD 0 plus every coarser LOD
+	uint32_t indexSize;         // 2 or 4 bytes
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	float positionScale[3];     // dequantization: position = stored * scale + offset
+	float positionOffset[3];
+	float uvScale[2];           // uv = stored * scale + offset
+	float uvOffset[2];
+	uint32_t reserved;
+};
+
+struct MeshSection
+{
+	uint32_t type;              // MeshSectionType
+	uint32_t reserved;
+	uint64_t offset;            // from start of file, multiple of MESH_SECTION_ALIGN
+	uint64_t size;              // bytes
+};
+
+// unpacked vertex the offline tools work with; packed by vertexlayout before writing
+struct MeshVertex
+{
+	float position[3];
+	float normal[3];
+	float uv[2];
+	float color[4];
+};
+
+struct MeshLod
+{
+	uint32_t indexOffset;       // first index of this LOD in the index section
+	uint32_t indexCount;
+	uint32_t meshletOffset;     // first meshlet of this LOD
+	uint32_t meshletCount;
+	float error;                // simplification error in mesh units, 0 for LOD 0
+	uint32_t reserved;
+};
+
+struct Meshlet
+{
+	uint32_t vertexOffset;      // into the meshlet vertex section
+	uint32_t triangleOffset;    // into the meshlet triangle section, in bytes
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	float center[3];            // bounding sphere, for culling
+	float radius;
+};
+
+static_assert(sizeof(MeshFileHeader) == 120, "MeshFileHeader layout changed");
+static_assert(sizeof(MeshSection) == 24, "MeshSection layout changed");
+static_assert(sizeof(MeshVertex) == 48, "MeshVertex layout changed");
+static_assert(sizeof(MeshLod) == 24, "MeshLod layout changed");
+static_assert(sizeof(Meshlet) == 32, "Meshlet layout changed");
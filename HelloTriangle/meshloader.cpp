@@ -0,0 +1,82 @@
+#include <stdexcept>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "meshloader.hpp"
+#include "log.hpp"
+
+MeshFile::MeshFile(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw std::runtime_error("Couldn't open mesh file " + path + "\n");
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshFileHeader))
+	{
+		close(fd);
+		throw std::runtime_error("Mesh file too small: " + path + "\n");
+	}
+	mappedSize = (size_t)st.st_size;
+	data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+	if(data == MAP_FAILED)
+	{
+		data = nullptr;
+		throw std::runtime_error("Couldn't map mesh file " + path + "\n");
+	}
+	// sections are read front to back exactly once, let the kernel read ahead
+	madvise(data, mappedSize, MADV_SEQUENTIAL);
+	madvise(data, mappedSize, MADV_WILLNEED);
+
+	// validate everything up front so section() can hand out raw pointers
+	const MeshFileHeader& h = header();
+	const char* error = nullptr;
+	if(h.magic != MESH_MAGIC) error = "not a .bmesh file";
+	else if(h.version != MESH_VERSION) error = "unsupported .bmesh version";
+	else if(h.headerSize != sizeof(MeshFileHeader)) error = "unexpected header size";
+	else if(h.fileSize != mappedSize) error = "truncated file";
+	else if(h.indexSize != 2 && h.indexSize != 4) error = "bad index size";
+	else if(h.headerSize + (uint64_t)h.sectionCount * sizeof(MeshSection) > mappedSize) error = "truncated section table";
+	if(!error)
+	{
+		sections = (const MeshSection*)((const char*)data + h.headerSize);
+		for(uint32_t i = 0; i < h.sectionCount && !error; i++)
+		{
+			const MeshSection& s = sections[i];
+			if(s.offset % MESH_SECTION_ALIGN != 0) error = "misaligned section";
+			else if(s.offset > mappedSize || s.size > mappedSize - s.offset) error = "section out of bounds";
+			// draws index into these by count, so they must hold every element the header promises
+			else if(s.type == MESH_SECTION_VERTICES && s.size < (uint64_t)h.vertexCount * h.vertexStride)
+				error = "vertex section smaller than its vertices";
+			else if(s.type == MESH_SECTION_INDICES && s.size < (uint64_t)h.indexCount * h.indexSize)
+				error = "index section smaller than its indices";
+		}
+	}
+	if(error)
+	{
+		munmap(data, mappedSize);
+		data = nullptr;
+		throw std::runtime_error("Invalid mesh file " + path + ": " + error + "\n");
+	}
+	LOG_DEBUG("Mapped mesh %s: %u vertices, %u indices, %u LODs, %u meshlets.\n", path.c_str(), \
+		h.vertexCount, h.indexCount, h.lodCount, h.meshletCount);
+}
+
+MeshFile::~MeshFile()
+{
+	if(data) munmap(data, mappedSize);
+}
+
+const void* MeshFile::section(MeshSectionType type, uint64_t* size) const
+{
+	for(uint32_t i = 0; i < header().sectionCount; i++)
+	{
+		if(sections[i].type != type) continue;
+		if(size) *size = sections[i].size;
+		return (const char*)data + sections[i].offset;
+	}
+	if(size) *size = 0;
+	return nullptr;
+}
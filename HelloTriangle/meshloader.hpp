@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "meshformat.hpp"
+
+// Read-only view of a .bmesh blob. The file is mmapped and validated once;
+// section() hands back pointers into the mapping, so nothing is parsed or copied
+// until the caller memcpys a section into its staging buffer.
+class MeshFile
+{
+	public:
+		explicit MeshFile(const std::string& path);
+		~MeshFile();
+		MeshFile(const MeshFile&) = delete;
+		MeshFile& operator=(const MeshFile&) = delete;
+
+		const MeshFileHeader& header() const { return *(const MeshFileHeader*)data; }
+		// nullptr if the blob has no section of that type
+		const void* section(MeshSectionType type, uint64_t* size = nullptr) const;
+
+	private:
+		void* data = nullptr;
+		size_t mappedSize = 0;
+		const MeshSection* sections = nullptr;
+};
@@ -0,0 +1,441 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+
+#include "benvulkan.hpp"
+#include "occlusion.hpp"
+#include "pipelinestate.hpp"
+
+struct CullPushConstants
+{
+	glm::mat4 viewProjection;
+	glm::vec4 camera;           // position, w: CullCamera::lodScale
+	float lodErrors[MESH_MAX_LODS]; // two vec4 in the shader
+	uint32_t objectCount;
+	uint32_t phase;             // 0 before the first pass, 1 after it
+	uint32_t lodCount;
+	float lodThreshold;         // pixels
+};
+static_assert(sizeof(CullPushConstants) <= 128, "cull push constants exceed the guaranteed size");
+
+static void createComputePipeline(VkDevice device, const ShaderVariant& variant, VkPipelineLayout layout, VkPipeline& pipeline)
+{
+	VkShaderModule module;
+	if(cachedShaderModule(device, *variant.code, module) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shader module!\n");
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = shaderStageInfo(variant, VK_SHADER_STAGE_COMPUTE_BIT, module);
+	pipelineInfo.layout = layout;
+	if(cachedComputePipeline(device, pipelineInfo, pipeline) != VK_SUCCESS) throw std::runtime_error("Failed to create culling pipeline!\n");
+}
+
+static VkDescriptorSetLayout createSetLayout(VkDevice device, const VkDescriptorType* types, uint32_t count, VkShaderStageFlags stages)
+{
+	VkDescriptorSetLayoutBinding bindings[8]{};
+	for(uint32_t i = 0; i < count; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = types[i];
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = stages;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = count;
+	layoutInfo.pBindings = bindings;
+	VkDescriptorSetLayout layout;
+	if(vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator(), &layout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create culling descriptor set layout!\n");
+	return layout;
+}
+
+static void allocateSets(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout, std::vector<VkDescriptorSet>& sets)
+{
+	std::vector<VkDescriptorSetLayout> layouts(sets.size(), layout);
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = pool;
+	setInfo.descriptorSetCount = (uint32_t)sets.size();
+	setInfo.pSetLayouts = layouts.data();
+	if(vkAllocateDescriptorSets(device, &setInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate culling descriptor sets!\n");
+}
+
+static VkWriteDescriptorSet bufferWrite(VkDescriptorSet set, uint32_t binding, const VkDescriptorBufferInfo* info)
+{
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = info;
+	return write;
+}
+
+static VkWriteDescriptorSet imageWrite(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo* info)
+{
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pImageInfo = info;
+	return write;
+}
+
+static void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, \
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	vkd.cmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool commandPool, \
+	uint32_t frameCount, ShaderVariants& shaders, uint32_t groupSize)
+{
+	this->groupSize = groupSize;
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->queue = queue;
+	this->commandPool = commandPool;
+	this->frameCount = frameCount;
+
+	const VkDescriptorType cullTypes[] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, \
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, \
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+	const VkDescriptorType hizTypes[] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE };
+	const VkDescriptorType drawTypes[] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	cullLayout = createSetLayout(device, cullTypes, 6, VK_SHADER_STAGE_COMPUTE_BIT);
+	hizLayout = createSetLayout(device, hizTypes, 2, VK_SHADER_STAGE_COMPUTE_BIT);
+	drawLayout = createSetLayout(device, drawTypes, 2, VK_SHADER_STAGE_VERTEX_BIT);
+
+	VkDescriptorPoolSize poolSizes[3]{};
+	poolSizes[0] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount * 7 };
+	poolSizes[1] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount + HIZ_MAX_LEVELS };
+	poolSizes[2] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, HIZ_MAX_LEVELS };
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = frameCount * 2 + HIZ_MAX_LEVELS;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes = poolSizes;
+	if(vkCreateDescriptorPool(device, &poolInfo, hostAllocator(), &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create culling descriptor pool!\n");
+
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(CullPushConstants);
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &cullLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	if(cachedPipelineLayout(device, layoutInfo, cullPipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create culling pipeline layout!\n");
+	layoutInfo.pSetLayouts = &hizLayout;
+	layoutInfo.pushConstantRangeCount = 0;
+	if(cachedPipelineLayout(device, layoutInfo, hizPipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create culling pipeline layout!\n");
+	ShaderVariantKey cullKey("shaders/cull.comp.spv");
+	cullKey.set(SHADER_CONSTANT_GROUP_SIZE, groupSize).set(SHADER_CONSTANT_LOD_HYSTERESIS, LOD_HYSTERESIS);
+	createComputePipeline(device, shaders.request(cullKey), cullPipelineLayout, cullPipeline);
+	createComputePipeline(device, shaders.request(ShaderVariantKey("shaders/hiz.comp.spv")), hizPipelineLayout, hizPipeline);
+
+	// texelFetch only, the filter never applies
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = (float)HIZ_MAX_LEVELS;
+	if(vkCreateSampler(device, &samplerInfo, hostAllocator(), &sampler) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create culling sampler!\n");
+}
+
+void OcclusionCuller::setObjects(const std::vector<CullObject>& objects, const std::vector<MeshLod>& lods)
+{
+	objectTotal = objects.size();
+	this->lods.assign(lods.begin(), lods.begin() + std::min(lods.size(), (size_t)MESH_MAX_LODS));
+	uint32_t drawCount = 2 * (uint32_t)this->lods.size();
+	VkDeviceSize objectSize = sizeof(CullObject) * objects.size();
+	VkDeviceSize flagSize = sizeof(uint32_t) * objects.size();
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, objectSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, \
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, \
+		MEMORY_STAGING);
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, objectSize, 0, &data);
+	memcpy(data, objects.data(), objectSize);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	createBuffer(physicalDevice, device, objectSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, \
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, objectBuffer, objectMemory, MEMORY_MESH);
+	createBuffer(physicalDevice, device, flagSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, \
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibilityBuffer, visibilityMemory);
+	createBuffer(physicalDevice, device, sizeof(VkDrawIndexedIndirectCommand) * drawCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | \
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, \
+		drawBuffer, drawMemory);
+	createBuffer(physicalDevice, device, flagSize * drawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, \
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, listBuffer, listMemory);
+
+	// nothing counts as visible yet, so the first frame draws everything it finds in the second pass;
+	// everything starts at LOD 0 and coarsens from there
+	std::vector<VkDrawIndexedIndirectCommand> draws(drawCount);
+	for(uint32_t d = 0; d < drawCount; d++)
+	{
+		const MeshLod& lod = this->lods[d % this->lods.size()];
+		draws[d] = { lod.indexCount, 0, lod.indexOffset, 0, 0 };
+	}
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	VkBufferCopy region{ 0, 0, objectSize };
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, objectBuffer, 1, &region);
+	vkCmdFillBuffer(commandBuffer, visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+	vkCmdUpdateBuffer(commandBuffer, drawBuffer, 0, sizeof(VkDrawIndexedIndirectCommand) * drawCount, draws.data());
+	endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+	vkDestroyBuffer(device, stagingBuffer, hostAllocator());
+	freeDeviceMemory(device, stagingBufferMemory);
+
+	statsBuffers.resize(frameCount);
+	statsMemory.resize(frameCount);
+	statsMapped.resize(frameCount);
+	cullSets.resize(frameCount);
+	allocateSets(device, descriptorPool, cullLayout, cullSets);
+	for(uint32_t i = 0; i < frameCount; i++)
+	{
+		createBuffer(physicalDevice, device, sizeof(OcclusionStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | \
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, \
+			statsBuffers[i], statsMemory[i], MEMORY_READBACK);
+		vkMapMemory(device, statsMemory[i], 0, sizeof(OcclusionStats), 0, (void**)&statsMapped[i]);
+		memset(statsMapped[i], 0, sizeof(OcclusionStats));
+		// the pyramid goes into binding 5 once it exists
+		VkDescriptorBufferInfo buffers[5] = { { objectBuffer, 0, VK_WHOLE_SIZE }, { visibilityBuffer, 0, VK_WHOLE_SIZE }, \
+			{ drawBuffer, 0, VK_WHOLE_SIZE }, { listBuffer, 0, VK_WHOLE_SIZE }, { statsBuffers[i], 0, VK_WHOLE_SIZE } };
+		VkWriteDescriptorSet writes[5];
+		for(uint32_t b = 0; b < 5; b++) writes[b] = bufferWrite(cullSets[i], b, &buffers[b]);
+		vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+	}
+	LOG_DEBUG("Occlusion culling: %zu objects, %zu LODs\n", objectTotal, this->lods.size());
+}
+
+void OcclusionCuller::createPyramid(VkExtent2D extent, VkImageView depthView)
+{
+	// level 0 is half the depth buffer, rounded up, and each level halves again down to 1x1
+	VkExtent2D size = { std::max((extent.width + 1) / 2, 1u), std::max((extent.height + 1) / 2, 1u) };
+	levelExtents.clear();
+	while(levelExtents.size() < HIZ_MAX_LEVELS)
+	{
+		levelExtents.push_back(size);
+		if(size.width == 1 && size.height == 1) break;
+		size = { std::max((size.width + 1) / 2, 1u), std::max((size.height + 1) / 2, 1u) };
+	}
+	uint32_t levels = (uint32_t)levelExtents.size();
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.extent = { levelExtents[0].width, levelExtents[0].height, 1 };
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if(vkCreateImage(device, &imageInfo, hostAllocator(), &pyramid) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid!\n");
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, pyramid, &memRequirements);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if(allocateDeviceMemory(device, allocInfo, MEMORY_RENDER_TARGET, pyramidMemory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate depth pyramid memory!\n");
+	vkBindImageMemory(device, pyramid, pyramidMemory, 0);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = pyramid;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+	if(vkCreateImageView(device, &viewInfo, hostAllocator(), &pyramidView) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid view!\n");
+	levelViews.resize(levels);
+	for(uint32_t level = 0; level < levels; level++)
+	{
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		if(vkCreateImageView(device, &viewInfo, hostAllocator(), &levelViews[level]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create depth pyramid view!\n");
+	}
+
+	// every level stays in GENERAL: written as a storage image, then read by the next level and the cull pass
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	transitionImageLayout(commandBuffer, pyramid, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, \
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+	hizSets.resize(levels);
+	allocateSets(device, descriptorPool, hizLayout, hizSets);
+	for(uint32_t level = 0; level < levels; level++)
+	{
+		VkDescriptorImageInfo source{ sampler, level == 0 ? depthView : levelViews[level - 1], \
+			level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo target{ VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+		VkWriteDescriptorSet writes[2] = { imageWrite(hizSets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &source), \
+			imageWrite(hizSets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &target) };
+		vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+	}
+	VkDescriptorImageInfo pyramidInfo{ sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+	for(VkDescriptorSet set : cullSets)
+	{
+		VkWriteDescriptorSet write = imageWrite(set, 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &pyramidInfo);
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+	LOG_DEBUG("Depth pyramid: %ux%u, %u levels\n", levelExtents[0].width, levelExtents[0].height, levels);
+}
+
+void OcclusionCuller::createDrawSets(const std::vector<VkBuffer>& transformBuffers)
+{
+	drawSets.resize(transformBuffers.size());
+	allocateSets(device, descriptorPool, drawLayout, drawSets);
+	for(size_t i = 0; i < drawSets.size(); i++)
+	{
+		VkDescriptorBufferInfo buffers[2] = { { transformBuffers[i], 0, VK_WHOLE_SIZE }, { listBuffer, 0, VK_WHOLE_SIZE } };
+		VkWriteDescriptorSet writes[2] = { bufferWrite(drawSets[i], 0, &buffers[0]), bufferWrite(drawSets[i], 1, &buffers[1]) };
+		vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+	}
+}
+
+void OcclusionCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const CullCamera& camera, uint32_t phase)
+{
+	CullPushConstants constants{};
+	constants.viewProjection = camera.viewProjection;
+	constants.camera = glm::vec4(camera.position, camera.lodScale);
+	for(size_t l = 0; l < lods.size(); l++) constants.lodErrors[l] = lods[l].error;
+	constants.objectCount = (uint32_t)objectTotal;
+	constants.phase = phase;
+	constants.lodCount = (uint32_t)lods.size();
+	constants.lodThreshold = lodThreshold;
+	vkd.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkd.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSets[frame], 0, nullptr);
+	vkd.cmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkd.cmdDispatch(commandBuffer, ((uint32_t)objectTotal + groupSize - 1) / groupSize, 1, 1);
+}
+
+void OcclusionCuller::recordEarly(VkCommandBuffer commandBuffer, uint32_t frame, const CullCamera& camera)
+{
+	// the previous frame's draws and culling are done with the lists before the counts restart
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | \
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | \
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	const VkDeviceSize instanceCount = offsetof(VkDrawIndexedIndirectCommand, instanceCount);
+	for(size_t d = 0; d < 2 * lods.size(); d++)
+		vkd.cmdFillBuffer(commandBuffer, drawBuffer, sizeof(VkDrawIndexedIndirectCommand) * d + instanceCount, sizeof(uint32_t), 0);
+	vkd.cmdFillBuffer(commandBuffer, statsBuffers[frame], 0, VK_WHOLE_SIZE, 0);
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, \
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	recordCull(commandBuffer, frame, camera, 0);
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, \
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, \
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void OcclusionCuller::recordLate(VkCommandBuffer commandBuffer, uint32_t frame, const CullCamera& camera, VkImage depthImage)
+{
+	transitionImageLayout(commandBuffer, depthImage, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, \
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, \
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, \
+		VK_IMAGE_ASPECT_DEPTH_BIT);
+	// one dispatch per level, each reading the one before
+	vkd.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipeline);
+	for(uint32_t level = 0; level < levelExtents.size(); level++)
+	{
+		vkd.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipelineLayout, 0, 1, &hizSets[level], 0, nullptr);
+		vkd.cmdDispatch(commandBuffer, (levelExtents[level].width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, \
+			(levelExtents[level].height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+		memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, \
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+	recordCull(commandBuffer, frame, camera, 1);
+	// the second list feeds the next pass, the counters go to the host once the frame retires
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, \
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, \
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+	transitionImageLayout(commandBuffer, depthImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, \
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, \
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, \
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+void OcclusionCuller::recordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t list)
+{
+	// unused LODs draw zero instances, which costs less than reading the counts back
+	for(uint32_t lod = 0; lod < lods.size(); lod++)
+	{
+		uint32_t draw = list * (uint32_t)lods.size() + lod;
+		uint32_t listBase = draw * (uint32_t)objectTotal;
+		vkd.cmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(ScenePushConstants, listBase), \
+			sizeof(listBase), &listBase);
+		vkd.cmdDrawIndexedIndirect(commandBuffer, drawBuffer, draw * sizeof(VkDrawIndexedIndirectCommand), 1, \
+			sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+OcclusionStats OcclusionCuller::readStats(uint32_t frame) const
+{
+	return *statsMapped[frame];
+}
+
+void OcclusionCuller::destroy()
+{
+	if(device == VK_NULL_HANDLE) return;
+	for(VkImageView view : levelViews) vkDestroyImageView(device, view, hostAllocator());
+	levelViews.clear();
+	if(pyramid != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(device, pyramidView, hostAllocator());
+		vkDestroyImage(device, pyramid, hostAllocator());
+		freeDeviceMemory(device, pyramidMemory);
+	}
+	for(size_t i = 0; i < statsBuffers.size(); i++)
+	{
+		vkUnmapMemory(device, statsMemory[i]);
+		vkDestroyBuffer(device, statsBuffers[i], hostAllocator());
+		freeDeviceMemory(device, statsMemory[i]);
+	}
+	statsBuffers.clear();
+	if(objectTotal > 0)
+	{
+		VkBuffer buffers[] = { objectBuffer, visibilityBuffer, drawBuffer, listBuffer };
+		VkDeviceMemory memory[] = { objectMemory, visibilityMemory, drawMemory, listMemory };
+		for(uint32_t i = 0; i < 4; i++)
+		{
+			vkDestroyBuffer(device, buffers[i], hostAllocator());
+			freeDeviceMemory(device, memory[i]);
+		}
+	}
+	vkDestroySampler(device, sampler, hostAllocator());
+	// the pipelines and their layouts belong to the pipeline state cache
+	vkDestroyDescriptorPool(device, descriptorPool, hostAllocator());
+	vkDestroyDescriptorSetLayout(device, drawLayout, hostAllocator());
+	vkDestroyDescriptorSetLayout(device, hizLayout, hostAllocator());
+	vkDestroyDescriptorSetLayout(device, cullLayout, hostAllocator());
+	device = VK_NULL_HANDLE;
+}
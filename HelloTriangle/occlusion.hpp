@@ -0,0 +1,135 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "meshformat.hpp"
+#include "shadervariant.hpp"
+
+// Two-phase occlusion culling on the GPU for instances of one mesh.
+//  1. recordEarly: objects visible last frame and inside the frustum go to list 0,
+//     which the first pass draws (clearing color and depth).
+//  2. recordLate: the depth of that pass is reduced into a Hi-Z pyramid (farthest
+//     depth per texel, one compute dispatch per level), then every object is tested
+//     against the frustum and the pyramid. Visible ones that were not drawn yet go to
+//     list 1 for the second pass, so objects coming out from behind others show up
+//     the same frame instead of popping in one frame late.
+// Every drawn object also picks a LOD: the coarsest one whose simplification error,
+// projected at the object's distance, stays under the pixel threshold. Objects only
+// move to a coarser LOD once a stricter threshold (LOD_HYSTERESIS) allows it, so they
+// don't flicker between two levels at the boundary.
+// Each list has one indirect draw per LOD; instances read their transform slot from
+// the list. Counters of each frame are written to a host-visible buffer per frame in
+// flight, readStats() returns them once the frame has retired.
+
+#define HIZ_GROUP_SIZE 8            // hiz.comp local size, in x and y
+#define HIZ_MAX_LEVELS 16
+#define LOD_HYSTERESIS 0.75f        // a coarser LOD must pass this fraction of the threshold, a cull.comp constant
+
+struct CullObject
+{
+	glm::vec4 sphere;           // world space centre, radius
+	uint32_t slot;              // transform slot
+	uint32_t pad[3];
+};
+
+struct OcclusionStats
+{
+	uint32_t frustumCulled;
+	uint32_t occluded;
+	uint32_t visible;
+	uint32_t late;              // of the visible ones, drawn by the second pass
+	uint32_t triangles;         // drawn by both passes, at the selected LODs
+};
+
+struct CullCamera
+{
+	glm::mat4 viewProjection;
+	glm::vec3 position;         // world space, for LOD distances
+	float lodScale;             // pixels per unit at distance 1: viewport height / (2 tan(fov / 2))
+};
+
+struct ScenePushConstants
+{
+	glm::mat4 transform;        // world -> clip
+	glm::vec4 uvTransform;
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+	uint32_t listBase;          // first slot of the drawn list
+};
+
+class OcclusionCuller
+{
+	public:
+		// layouts and compute pipelines, cull.comp specialized for groupSize threads per workgroup;
+		// the draw set layout is needed by the scene pipeline
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool commandPool, \
+			uint32_t frameCount, ShaderVariants& shaders, uint32_t groupSize);
+		// object buffers, uploaded once; each list gets one draw command per LOD of the mesh
+		void setObjects(const std::vector<CullObject>& objects, const std::vector<MeshLod>& lods);
+		// pyramid for a depth buffer of this size, sampled through depthView; after setObjects
+		void createPyramid(VkExtent2D extent, VkImageView depthView);
+		// per frame: the transform buffer the vertex shader reads that frame
+		void createDrawSets(const std::vector<VkBuffer>& transformBuffers);
+		void destroy();
+
+		VkDescriptorSetLayout drawSetLayout() const { return drawLayout; }
+		VkDescriptorSet drawSet(uint32_t frame) const { return drawSets[frame]; }
+		uint32_t objectCount() const { return (uint32_t)objectTotal; }
+		// largest projected error in pixels a LOD may have
+		void setLodThreshold(float pixels) { lodThreshold = pixels; }
+
+		// outside a render pass, before the first one
+		void recordEarly(VkCommandBuffer commandBuffer, uint32_t frame, const CullCamera& camera);
+		// outside a render pass; depthImage holds the first pass's depth in DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		// and is back in it afterwards, ready for the second pass to load
+		void recordLate(VkCommandBuffer commandBuffer, uint32_t frame, const CullCamera& camera, VkImage depthImage);
+		// inside a pass with the scene pipeline bound; one draw per LOD, each pushing its list base at offsetof(listBase)
+		void recordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t list);
+		OcclusionStats readStats(uint32_t frame) const;
+
+	private:
+		void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const CullCamera& camera, uint32_t phase);
+
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		uint32_t frameCount = 0;
+		uint32_t groupSize = 0;
+		size_t objectTotal = 0;
+		std::vector<MeshLod> lods;
+		float lodThreshold = 1.0f;
+
+		VkBuffer objectBuffer = VK_NULL_HANDLE;         // CullObject per object
+		VkDeviceMemory objectMemory = VK_NULL_HANDLE;
+		VkBuffer visibilityBuffer = VK_NULL_HANDLE;     // uint per object: visible in the last test, LOD << 1
+		VkDeviceMemory visibilityMemory = VK_NULL_HANDLE;
+		VkBuffer drawBuffer = VK_NULL_HANDLE;           // VkDrawIndexedIndirectCommand per list and LOD
+		VkDeviceMemory drawMemory = VK_NULL_HANDLE;
+		VkBuffer listBuffer = VK_NULL_HANDLE;           // per list and LOD, objectCount slots each
+		VkDeviceMemory listMemory = VK_NULL_HANDLE;
+		std::vector<VkBuffer> statsBuffers;             // per frame in flight, host visible
+		std::vector<VkDeviceMemory> statsMemory;
+		std::vector<OcclusionStats*> statsMapped;
+
+		VkImage pyramid = VK_NULL_HANDLE;               // R32F, farthest depth, level 0 is half the depth size
+		VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+		VkImageView pyramidView = VK_NULL_HANDLE;       // all levels, for the cull pass
+		std::vector<VkImageView> levelViews;
+		std::vector<VkExtent2D> levelExtents;
+		VkSampler sampler = VK_NULL_HANDLE;             // nearest, texelFetch only
+
+		VkDescriptorSetLayout cullLayout = VK_NULL_HANDLE, hizLayout = VK_NULL_HANDLE, drawLayout = VK_NULL_HANDLE;
+		VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE, hizPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline cullPipeline = VK_NULL_HANDLE, hizPipeline = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> cullSets;          // per frame in flight
+		std::vector<VkDescriptorSet> hizSets;           // per level
+		std::vector<VkDescriptorSet> drawSets;          // per frame in flight
+};
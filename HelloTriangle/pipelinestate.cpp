@@ -0,0 +1,453 @@
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+
+#include "pipelinestate.hpp"
+#include "hostalloc.hpp"
+#include "log.hpp"
+
+struct CacheEntry
+{
+	std::string key;
+	uint64_t handle;            // 0 once a module is released
+	uint32_t moduleId;          // modules: stands in for the handle in pipeline keys
+};
+
+struct StateCache
+{
+	std::unordered_map<uint64_t, std::vector<CacheEntry>> buckets; // by key hash, collisions side by side
+	uint64_t requests, hits;
+	uint32_t entries, uncached;
+};
+
+static std::mutex cacheLock;
+static StateCache caches[PIPELINE_STATE_KIND_COUNT];
+static std::unordered_map<uint64_t, uint32_t> moduleIds;   // live module handle -> content id
+static uint32_t moduleIdCount = 0;
+static std::vector<uint64_t> uncachedPipelines;
+
+static const char* kindNames[PIPELINE_STATE_KIND_COUNT] = { "shader modules", "pipeline layouts", "pipelines" };
+
+// state is appended field by field in a fixed order; the Vulkan structs appended whole
+// are all 32 bit members, so there are no padding bytes in the key
+struct KeyWriter
+{
+	std::string bytes;
+	template<typename T> void put(const T& value) { bytes.append((const char*)&value, sizeof(T)); }
+	void put(const void* data, size_t size) { if(size) bytes.append((const char*)data, size); }
+	template<typename T> void putSorted(const T* items, uint32_t count, bool (*less)(const T&, const T&))
+	{
+		std::vector<T> sorted(items, items + (items ? count : 0));
+		std::sort(sorted.begin(), sorted.end(), less);
+		put((uint32_t)sorted.size());
+		put(sorted.data(), sorted.size() * sizeof(T));
+	}
+};
+
+static uint64_t keyHash(const std::string& key)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for(unsigned char c : key)
+	{
+		h ^= c;
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+// the cached handle for key, 0 when it has to be created; under the lock
+static uint64_t findState(PipelineStateKind kind, uint64_t hash, const std::string& key)
+{
+	StateCache& cache = caches[kind];
+	cache.requests++;
+	auto it = cache.buckets.find(hash);
+	if(it == cache.buckets.end()) return 0;
+	for(const CacheEntry& entry : it->second)
+		if(entry.handle != 0 && entry.key == key)
+		{
+			cache.hits++;
+			return entry.handle;
+		}
+	return 0;
+}
+
+// first one in wins: returns the handle to use, which differs from handle if another thread got there first
+static uint64_t insertState(PipelineStateKind kind, uint64_t hash, const std::string& key, uint64_t handle)
+{
+	std::vector<CacheEntry>& bucket = caches[kind].buckets[hash];
+	for(const CacheEntry& entry : bucket)
+		if(entry.handle != 0 && entry.key == key) return entry.handle;
+	bucket.push_back(CacheEntry{ key, handle, 0 });
+	caches[kind].entries++;
+	return handle;
+}
+
+VkResult cachedShaderModule(VkDevice device, const std::vector<char>& code, VkShaderModule& module)
+{
+	std::string key(code.begin(), code.end());
+	uint64_t hash = keyHash(key);
+	{
+		std::lock_guard<std::mutex> guard(cacheLock);
+		uint64_t found = findState(PIPELINE_STATE_MODULE, hash, key);
+		if(found != 0)
+		{
+			module = (VkShaderModule)found;
+			return VK_SUCCESS;
+		}
+	}
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	VkResult result = vkCreateShaderModule(device, &createInfo, hostAllocator(), &module);
+	if(result != VK_SUCCESS) return result;
+
+	std::lock_guard<std::mutex> guard(cacheLock);
+	StateCache& cache = caches[PIPELINE_STATE_MODULE];
+	std::vector<CacheEntry>& bucket = cache.buckets[hash];
+	for(CacheEntry& entry : bucket)
+	{
+		if(entry.key != key) continue;
+		if(entry.handle != 0)
+		{
+			vkDestroyShaderModule(device, module, hostAllocator());
+			module = (VkShaderModule)entry.handle;
+			return VK_SUCCESS;
+		}
+		// released earlier: same code, same id, so its pipelines still match
+		entry.handle = (uint64_t)module;
+		moduleIds[entry.handle] = entry.moduleId;
+		cache.entries++;
+		return VK_SUCCESS;
+	}
+	bucket.push_back(CacheEntry{ std::move(key), (uint64_t)module, moduleIdCount++ });
+	moduleIds[(uint64_t)module] = bucket.back().moduleId;
+	cache.entries++;
+	return VK_SUCCESS;
+}
+
+static bool lessPushRange(const VkPushConstantRange& a, const VkPushConstantRange& b)
+{
+	return a.offset != b.offset ? a.offset < b.offset : a.stageFlags < b.stageFlags;
+}
+
+VkResult cachedPipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo& createInfo, VkPipelineLayout& layout)
+{
+	KeyWriter key;
+	key.put(createInfo.flags);
+	key.put(createInfo.setLayoutCount);
+	for(uint32_t i = 0; i < createInfo.setLayoutCount; i++) key.put((uint64_t)createInfo.pSetLayouts[i]);
+	key.putSorted(createInfo.pPushConstantRanges, createInfo.pushConstantRangeCount, lessPushRange);
+	uint64_t hash = keyHash(key.bytes);
+	{
+		std::lock_guard<std::mutex> guard(cacheLock);
+		uint64_t found = findState(PIPELINE_STATE_LAYOUT, hash, key.bytes);
+		if(found != 0)
+		{
+			layout = (VkPipelineLayout)found;
+			return VK_SUCCESS;
+		}
+	}
+	VkResult result = vkCreatePipelineLayout(device, &createInfo, hostAllocator(), &layout);
+	if(result != VK_SUCCESS) return result;
+	std::lock_guard<std::mutex> guard(cacheLock);
+	uint64_t kept = insertState(PIPELINE_STATE_LAYOUT, hash, key.bytes, (uint64_t)layout);
+	if(kept != (uint64_t)layout)
+	{
+		vkDestroyPipelineLayout(device, layout, hostAllocator());
+		layout = (VkPipelineLayout)kept;
+	}
+	return VK_SUCCESS;
+}
+
+static bool lessMapEntry(const VkSpecializationMapEntry& a, const VkSpecializationMapEntry& b) { return a.constantID < b.constantID; }
+static bool lessBinding(const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b) { return a.binding < b.binding; }
+static bool lessAttribute(const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) { return a.location < b.location; }
+
+// shaders by module content id; specialization by constant id and value, so offsets and entry order don't matter
+static bool putStage(KeyWriter& key, const VkPipelineShaderStageCreateInfo& stage)
+{
+	auto id = moduleIds.find((uint64_t)stage.module);
+	if(stage.pNext != nullptr || id == moduleIds.end()) return false;
+	key.put(stage.flags);
+	key.put(stage.stage);
+	key.put(id->second);
+	key.put(stage.pName, strlen(stage.pName) + 1);
+	const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+	std::vector<VkSpecializationMapEntry> entries;
+	if(specialization) entries.assign(specialization->pMapEntries, specialization->pMapEntries + specialization->mapEntryCount);
+	std::sort(entries.begin(), entries.end(), lessMapEntry);
+	key.put((uint32_t)entries.size());
+	for(const VkSpecializationMapEntry& entry : entries)
+	{
+		key.put(entry.constantID);
+		key.put((uint32_t)entry.size);
+		key.put((const char*)specialization->pData + entry.offset, entry.size);
+	}
+	return true;
+}
+
+// false when the state can't be keyed: unknown extension structures or modules the cache didn't create
+static bool graphicsKey(const VkGraphicsPipelineCreateInfo& info, KeyWriter& key)
+{
+	// dynamic rendering is the only extension structure the renderer chains
+	for(const VkBaseInStructure* next = (const VkBaseInStructure*)info.pNext; next != nullptr; next = next->pNext)
+	{
+		if(next->sType != VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO) return false;
+		const VkPipelineRenderingCreateInfo& rendering = *(const VkPipelineRenderingCreateInfo*)next;
+		key.put(next->sType);
+		key.put(rendering.viewMask);
+		key.put(rendering.colorAttachmentCount);
+		key.put(rendering.pColorAttachmentFormats, sizeof(VkFormat) * rendering.colorAttachmentCount);
+		key.put(rendering.depthAttachmentFormat);
+		key.put(rendering.stencilAttachmentFormat);
+	}
+	key.put(info.flags);
+	key.put(info.stageCount);
+	for(uint32_t i = 0; i < info.stageCount; i++)
+		if(!putStage(key, info.pStages[i])) return false;
+
+	std::vector<VkDynamicState> dynamic;
+	if(info.pDynamicState)
+		dynamic.assign(info.pDynamicState->pDynamicStates, info.pDynamicState->pDynamicStates + info.pDynamicState->dynamicStateCount);
+	std::sort(dynamic.begin(), dynamic.end());
+	key.put((uint32_t)dynamic.size());
+	key.put(dynamic.data(), dynamic.size() * sizeof(VkDynamicState));
+	auto isDynamic = [&dynamic](VkDynamicState state) { return std::binary_search(dynamic.begin(), dynamic.end(), state); };
+
+	const VkPipelineVertexInputStateCreateInfo* vertexInput = info.pVertexInputState;
+	key.put(vertexInput != nullptr);
+	if(vertexInput)
+	{
+		key.putSorted(vertexInput->pVertexBindingDescriptions, vertexInput->vertexBindingDescriptionCount, lessBinding);
+		key.putSorted(vertexInput->pVertexAttributeDescriptions, vertexInput->vertexAttributeDescriptionCount, lessAttribute);
+	}
+	const VkPipelineInputAssemblyStateCreateInfo* inputAssembly = info.pInputAssemblyState;
+	key.put(inputAssembly != nullptr);
+	if(inputAssembly)
+	{
+		key.put(inputAssembly->topology);
+		key.put(inputAssembly->primitiveRestartEnable);
+	}
+	key.put(info.pTessellationState != nullptr);
+	if(info.pTessellationState) key.put(info.pTessellationState->patchControlPoints);
+	const VkPipelineViewportStateCreateInfo* viewport = info.pViewportState;
+	key.put(viewport != nullptr);
+	if(viewport)
+	{
+		key.put(viewport->viewportCount);
+		key.put(viewport->scissorCount);
+		if(!isDynamic(VK_DYNAMIC_STATE_VIEWPORT) && viewport->pViewports)
+			key.put(viewport->pViewports, sizeof(VkViewport) * viewport->viewportCount);
+		if(!isDynamic(VK_DYNAMIC_STATE_SCISSOR) && viewport->pScissors)
+			key.put(viewport->pScissors, sizeof(VkRect2D) * viewport->scissorCount);
+	}
+	const VkPipelineRasterizationStateCreateInfo* raster = info.pRasterizationState;
+	key.put(raster != nullptr);
+	if(raster)
+	{
+		key.put(raster->depthClampEnable);
+		key.put(raster->rasterizerDiscardEnable);
+		key.put(raster->polygonMode);
+		key.put(raster->cullMode);
+		key.put(raster->frontFace);
+		key.put(raster->depthBiasEnable);
+		if(raster->depthBiasEnable && !isDynamic(VK_DYNAMIC_STATE_DEPTH_BIAS))
+		{
+			key.put(raster->depthBiasConstantFactor);
+			key.put(raster->depthBiasClamp);
+			key.put(raster->depthBiasSlopeFactor);
+		}
+		if(!isDynamic(VK_DYNAMIC_STATE_LINE_WIDTH)) key.put(raster->lineWidth);
+	}
+	const VkPipelineMultisampleStateCreateInfo* multisample = info.pMultisampleState;
+	key.put(multisample != nullptr);
+	if(multisample)
+	{
+		key.put(multisample->rasterizationSamples);
+		key.put(multisample->sampleShadingEnable);
+		if(multisample->sampleShadingEnable) key.put(multisample->minSampleShading);
+		key.put(multisample->pSampleMask != nullptr);
+		if(multisample->pSampleMask)
+			key.put(multisample->pSampleMask, sizeof(VkSampleMask) * ((multisample->rasterizationSamples + 31) / 32));
+		key.put(multisample->alphaToCoverageEnable);
+		key.put(multisample->alphaToOneEnable);
+	}
+	const VkPipelineDepthStencilStateCreateInfo* depth = info.pDepthStencilState;
+	key.put(depth != nullptr);
+	if(depth)
+	{
+		key.put(depth->depthTestEnable);
+		key.put(depth->depthWriteEnable);
+		if(depth->depthTestEnable) key.put(depth->depthCompareOp);
+		key.put(depth->depthBoundsTestEnable);
+		if(depth->depthBoundsTestEnable && !isDynamic(VK_DYNAMIC_STATE_DEPTH_BOUNDS))
+		{
+			key.put(depth->minDepthBounds);
+			key.put(depth->maxDepthBounds);
+		}
+		key.put(depth->stencilTestEnable);
+		if(depth->stencilTestEnable)
+		{
+			key.put(depth->front);
+			key.put(depth->back);
+		}
+	}
+	const VkPipelineColorBlendStateCreateInfo* blend = info.pColorBlendState;
+	key.put(blend != nullptr);
+	if(blend)
+	{
+		key.put(blend->logicOpEnable);
+		if(blend->logicOpEnable) key.put(blend->logicOp);
+		key.put(blend->attachmentCount);
+		for(uint32_t i = 0; i < blend->attachmentCount; i++)
+		{
+			const VkPipelineColorBlendAttachmentState& attachment = blend->pAttachments[i];
+			key.put(attachment.blendEnable);
+			if(attachment.blendEnable)
+			{
+				key.put(attachment.srcColorBlendFactor);
+				key.put(attachment.dstColorBlendFactor);
+				key.put(attachment.colorBlendOp);
+				key.put(attachment.srcAlphaBlendFactor);
+				key.put(attachment.dstAlphaBlendFactor);
+				key.put(attachment.alphaBlendOp);
+			}
+			key.put(attachment.colorWriteMask);
+		}
+		if(!isDynamic(VK_DYNAMIC_STATE_BLEND_CONSTANTS)) key.put(blend->blendConstants);
+	}
+	key.put((uint64_t)info.layout);
+	key.put((uint64_t)info.renderPass);
+	key.put(info.subpass);
+	return true;
+}
+
+static bool computeKey(const VkComputePipelineCreateInfo& info, KeyWriter& key)
+{
+	if(info.pNext != nullptr) return false;
+	key.put(info.flags);
+	if(!putStage(key, info.stage)) return false;
+	key.put((uint64_t)info.layout);
+	return true;
+}
+
+// after creating a pipeline for a request that missed: keep it under its key, or as uncached without one
+static void storePipeline(VkDevice device, bool keyed, uint64_t hash, const std::string& key, VkPipeline& pipeline)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+	if(!keyed)
+	{
+		uncachedPipelines.push_back((uint64_t)pipeline);
+		caches[PIPELINE_STATE_PIPELINE].uncached++;
+		return;
+	}
+	uint64_t kept = insertState(PIPELINE_STATE_PIPELINE, hash, key, (uint64_t)pipeline);
+	if(kept != (uint64_t)pipeline)
+	{
+		vkDestroyPipeline(device, pipeline, hostAllocator());
+		pipeline = (VkPipeline)kept;
+	}
+}
+
+VkResult cachedGraphicsPipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline)
+{
+	KeyWriter key;
+	bool keyed;
+	uint64_t hash = 0;
+	{
+		std::lock_guard<std::mutex> guard(cacheLock);
+		keyed = graphicsKey(createInfo, key);
+		if(keyed) hash = keyHash(key.bytes);
+		uint64_t found = keyed ? findState(PIPELINE_STATE_PIPELINE, hash, key.bytes) : 0;
+		if(!keyed) caches[PIPELINE_STATE_PIPELINE].requests++;
+		if(found != 0)
+		{
+			pipeline = (VkPipeline)found;
+			return VK_SUCCESS;
+		}
+	}
+	VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, hostAllocator(), &pipeline);
+	if(result == VK_SUCCESS) storePipeline(device, keyed, hash, key.bytes, pipeline);
+	return result;
+}
+
+VkResult cachedComputePipeline(VkDevice device, const VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline)
+{
+	KeyWriter key;
+	bool keyed;
+	uint64_t hash = 0;
+	{
+		std::lock_guard<std::mutex> guard(cacheLock);
+		keyed = computeKey(createInfo, key);
+		if(keyed) hash = keyHash(key.bytes);
+		uint64_t found = keyed ? findState(PIPELINE_STATE_PIPELINE, hash, key.bytes) : 0;
+		if(!keyed) caches[PIPELINE_STATE_PIPELINE].requests++;
+		if(found != 0)
+		{
+			pipeline = (VkPipeline)found;
+			return VK_SUCCESS;
+		}
+	}
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &createInfo, hostAllocator(), &pipeline);
+	if(result == VK_SUCCESS) storePipeline(device, keyed, hash, key.bytes, pipeline);
+	return result;
+}
+
+void releaseShaderModules(VkDevice device)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+	StateCache& cache = caches[PIPELINE_STATE_MODULE];
+	for(auto& bucket : cache.buckets)
+		for(CacheEntry& entry : bucket.second)
+		{
+			if(entry.handle == 0) continue;
+			vkDestroyShaderModule(device, (VkShaderModule)entry.handle, hostAllocator());
+			moduleIds.erase(entry.handle);
+			entry.handle = 0;
+			cache.entries--;
+		}
+}
+
+void destroyPipelineStates(VkDevice device)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+	for(uint64_t pipeline : uncachedPipelines) vkDestroyPipeline(device, (VkPipeline)pipeline, hostAllocator());
+	uncachedPipelines.clear();
+	for(uint32_t kind = 0; kind < PIPELINE_STATE_KIND_COUNT; kind++)
+	{
+		for(auto& bucket : caches[kind].buckets)
+			for(const CacheEntry& entry : bucket.second)
+			{
+				if(entry.handle == 0) continue;
+				if(kind == PIPELINE_STATE_PIPELINE) vkDestroyPipeline(device, (VkPipeline)entry.handle, hostAllocator());
+				else if(kind == PIPELINE_STATE_LAYOUT) vkDestroyPipelineLayout(device, (VkPipelineLayout)entry.handle, hostAllocator());
+				else vkDestroyShaderModule(device, (VkShaderModule)entry.handle, hostAllocator());
+			}
+		caches[kind].buckets.clear();
+		caches[kind].entries = 0;
+		caches[kind].uncached = 0;
+	}
+	moduleIds.clear();
+}
+
+PipelineCacheStats pipelineCacheStats(PipelineStateKind kind)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+	const StateCache& cache = caches[kind];
+	return PipelineCacheStats{ cache.requests, cache.hits, cache.entries, cache.uncached };
+}
+
+void logPipelineCacheStats(const char* scope)
+{
+	for(uint32_t kind = 0; kind < PIPELINE_STATE_KIND_COUNT; kind++)
+	{
+		PipelineCacheStats stats = pipelineCacheStats((PipelineStateKind)kind);
+		if(stats.requests == 0) continue;
+		LOG_INFO("%s: %s %llu requests, %.1f%% hits, %u live, %u uncached\n", scope, kindNames[kind], \
+			(unsigned long long)stats.requests, 100.0 * stats.hits / stats.requests, stats.entries, stats.uncached);
+	}
+}
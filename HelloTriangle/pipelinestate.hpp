@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Deduplicating caches for shader modules, pipeline layouts and pipelines. A
+// request is normalized into a byte key: the state that can change the result,
+// in a fixed order. Viewports under dynamic state, blend factors of disabled
+// blending, map entry offsets and pointers are left out. The key is hashed and
+// looked up, so identical state gets the handle created the first time in O(1).
+// The caches own everything they create; callers never destroy these handles,
+// destroyPipelineStates() does before the device goes.
+// Pipelines key their shaders by content, not by module handle, so
+// releaseShaderModules() can drop the modules once startup is done; a later
+// request creates the module again and still finds its pipelines.
+// Handles inside a key (set layouts, render passes) must stay alive while the
+// cache may be asked for that state. Requests with pNext structures the cache
+// doesn't know are created uncached and destroyed with the rest.
+
+enum PipelineStateKind
+{
+	PIPELINE_STATE_MODULE,
+	PIPELINE_STATE_LAYOUT,
+	PIPELINE_STATE_PIPELINE,    // graphics and compute
+	PIPELINE_STATE_KIND_COUNT,
+};
+
+struct PipelineCacheStats
+{
+	uint64_t requests;
+	uint64_t hits;
+	uint32_t entries;           // live handles
+	uint32_t uncached;          // created without a key, see above
+};
+
+VkResult cachedShaderModule(VkDevice device, const std::vector<char>& code, VkShaderModule& module);
+VkResult cachedPipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo& createInfo, VkPipelineLayout& layout);
+VkResult cachedGraphicsPipeline(VkDevice device, const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline);
+VkResult cachedComputePipeline(VkDevice device, const VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline);
+
+void releaseShaderModules(VkDevice device);
+void destroyPipelineStates(VkDevice device);
+
+PipelineCacheStats pipelineCacheStats(PipelineStateKind kind);
+void logPipelineCacheStats(const char* scope);
@@ -0,0 +1,260 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "png.hpp"
+
+static uint32_t crcTable[256];
+
+static bool crcInit()
+{
+	for(uint32_t n = 0; n < 256; n++)
+	{
+		uint32_t c = n;
+		for(int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		crcTable[n] = c;
+	}
+	return true;
+}
+static bool crcReady = crcInit();
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+	crc = ~crc;
+	for(size_t i = 0; i < size; i++) crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size)
+{
+	uint32_t a = 1, b = 0;
+	while(size)
+	{
+		size_t block = size < 5552 ? size : 5552; // largest run without overflowing 32 bits
+		size -= block;
+		while(block--)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+// deflate writes bits LSB first, Huffman codes MSB first
+struct BitWriter
+{
+	std::vector<uint8_t>& out;
+	uint64_t bits = 0;
+	uint32_t count = 0;
+
+	void write(uint32_t value, uint32_t length)
+	{
+		bits |= (uint64_t)value << count;
+		count += length;
+		while(count >= 8)
+		{
+			out.push_back((uint8_t)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+	void writeCode(uint32_t code, uint32_t length)
+	{
+		uint32_t reversed = 0;
+		for(uint32_t i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+		write(reversed, length);
+	}
+	void flush()
+	{
+		if(count) out.push_back((uint8_t)bits);
+		bits = 0;
+		count = 0;
+	}
+};
+
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, \
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, \
+	513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// fixed literal/length code (RFC 1951 3.2.6)
+static void writeSymbol(BitWriter& writer, uint32_t symbol)
+{
+	if(symbol < 144) writer.writeCode(0x30 + symbol, 8);
+	else if(symbol < 256) writer.writeCode(0x190 + symbol - 144, 9);
+	else if(symbol < 280) writer.writeCode(symbol - 256, 7);
+	else writer.writeCode(0xC0 + symbol - 280, 8);
+}
+
+static void writeMatch(BitWriter& writer, uint32_t length, uint32_t distance)
+{
+	uint32_t l = 28;
+	while(lengthBase[l] > length) l--;
+	writeSymbol(writer, 257 + l);
+	writer.write(length - lengthBase[l], lengthExtra[l]);
+	uint32_t d = 29;
+	while(distanceBase[d] > distance) d--;
+	writer.writeCode(d, 5);
+	writer.write(distance - distanceBase[d], distanceExtra[d]);
+}
+
+// zlib stream of one fixed-Huffman block
+static void deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+	out.push_back(0x78); // 32K window, deflate
+	out.push_back(0x01); // fastest level, check bits
+	BitWriter writer{ out };
+	writer.write(1, 1); // final block
+	writer.write(1, 2); // fixed Huffman codes
+
+	const uint32_t hashSize = 1 << 15;
+	std::vector<int32_t> head(hashSize, -1);
+	std::vector<int32_t> previous(PNG_DEFLATE_WINDOW, -1);
+	auto hash = [&](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & (hashSize - 1); };
+	auto insert = [&](size_t i) {
+		uint32_t h = hash(i);
+		previous[i & (PNG_DEFLATE_WINDOW - 1)] = head[h];
+		head[h] = (int32_t)i;
+	};
+
+	size_t i = 0;
+	while(i < size)
+	{
+		uint32_t bestLength = 0, bestDistance = 0;
+		if(i + 3 <= size)
+		{
+			size_t maxLength = size - i < 258 ? size - i : 258;
+			int32_t candidate = head[hash(i)];
+			for(int chain = 0; candidate >= 0 && chain < PNG_DEFLATE_CHAIN; chain++)
+			{
+				size_t distance = i - candidate;
+				if(distance > PNG_DEFLATE_WINDOW - 1) break;
+				uint32_t length = 0;
+				while(length < maxLength && data[candidate + length] == data[i + length]) length++;
+				if(length > bestLength)
+				{
+					bestLength = length;
+					bestDistance = (uint32_t)distance;
+					if(length == maxLength) break;
+				}
+				int32_t next = previous[candidate & (PNG_DEFLATE_WINDOW - 1)];
+				if(next >= candidate) break; // slot recycled by a newer position
+				candidate = next;
+			}
+		}
+		if(bestLength >= 3)
+		{
+			writeMatch(writer, bestLength, bestDistance);
+			for(size_t end = i + bestLength; i < end; i++)
+				if(i + 3 <= size) insert(i);
+		}
+		else
+		{
+			writeSymbol(writer, data[i]);
+			if(i + 3 <= size) insert(i);
+			i++;
+		}
+	}
+	writeSymbol(writer, 256); // end of block
+	writer.flush();
+
+	uint32_t check = adler32(data, size);
+	for(int shift = 24; shift >= 0; shift -= 8) out.push_back((uint8_t)(check >> shift));
+}
+
+static void writeChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t size)
+{
+	for(int shift = 24; shift >= 0; shift -= 8) png.push_back((uint8_t)(size >> shift));
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data, data + size);
+	uint32_t crc = crc32(0, &png[start], size + 4);
+	for(int shift = 24; shift >= 0; shift -= 8) png.push_back((uint8_t)(crc >> shift));
+}
+
+static uint8_t paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if(pa <= pb && pa <= pc) return (uint8_t)a;
+	return (uint8_t)(pb <= pc ? b : c);
+}
+
+std::vector<uint8_t> encodePng(uint32_t width, uint32_t height, const uint8_t* pixels, size_t stride, bool bgra)
+{
+	// each row: filter type byte, then the filtered RGBA bytes; the filter with the
+	// smallest sum of absolute (signed) values usually compresses best
+	size_t rowBytes = (size_t)width * 4;
+	std::vector<uint8_t> filtered((rowBytes + 1) * height);
+	std::vector<uint8_t> current(rowBytes), above(rowBytes, 0);
+	std::vector<uint8_t> candidates[5];
+	for(auto& c : candidates) c.resize(rowBytes);
+	for(uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* row = pixels + y * stride;
+		for(size_t x = 0; x < rowBytes; x += 4)
+		{
+			current[x + 0] = row[x + (bgra ? 2 : 0)];
+			current[x + 1] = row[x + 1];
+			current[x + 2] = row[x + (bgra ? 0 : 2)];
+			current[x + 3] = row[x + 3];
+		}
+		uint64_t bestScore = UINT64_MAX;
+		int best = 0;
+		for(int filter = 0; filter < 5; filter++)
+		{
+			uint8_t* out = candidates[filter].data();
+			uint64_t score = 0;
+			for(size_t x = 0; x < rowBytes; x++)
+			{
+				int a = x >= 4 ? current[x - 4] : 0;
+				int b = above[x];
+				int c = x >= 4 ? above[x - 4] : 0;
+				uint8_t predicted = filter == 0 ? 0 : filter == 1 ? a : filter == 2 ? b : \
+					filter == 3 ? (uint8_t)((a + b) / 2) : paeth(a, b, c);
+				out[x] = (uint8_t)(current[x] - predicted);
+				score += (uint64_t)abs((int8_t)out[x]);
+			}
+			if(score < bestScore)
+			{
+				bestScore = score;
+				best = filter;
+			}
+		}
+		uint8_t* dst = &filtered[y * (rowBytes + 1)];
+		dst[0] = (uint8_t)best;
+		memcpy(dst + 1, candidates[best].data(), rowBytes);
+		std::swap(current, above);
+	}
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	uint8_t header[13] = {
+		(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+		(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+		8,      // bit depth
+		6,      // RGBA
+		0, 0, 0 // deflate, adaptive filtering, no interlace
+	};
+	writeChunk(png, "IHDR", header, sizeof(header));
+	std::vector<uint8_t> compressed;
+	compressed.reserve(filtered.size() / 2);
+	deflate(filtered.data(), filtered.size(), compressed);
+	writeChunk(png, "IDAT", compressed.data(), compressed.size());
+	writeChunk(png, "IEND", nullptr, 0);
+	return png;
+}
+
+bool writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels, size_t stride, bool bgra)
+{
+	std::vector<uint8_t> png = encodePng(width, height, pixels, stride, bgra);
+	FILE* file = fopen(path.c_str(), "wb");
+	if(!file) return false;
+	bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+// Minimal PNG writer for frame captures: 8-bit RGBA, adaptive row filters and
+// a single fixed-Huffman deflate block with greedy LZ77 matching. Not the
+// smallest files, but no zlib dependency and fast enough for a worker thread.
+
+#define PNG_DEFLATE_WINDOW 32768
+#define PNG_DEFLATE_CHAIN 16    // match candidates tried per position
+
+// pixels are 4 bytes each, rows stride bytes apart; bgra swaps to RGBA on the way out
+std::vector<uint8_t> encodePng(uint32_t width, uint32_t height, const uint8_t* pixels, size_t stride, bool bgra);
+bool writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels, size_t stride, bool bgra);
@@ -0,0 +1,65 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// vertex inputs and decodeVertex(), generated per layout by tools/layoutgen
+#include "vertex_layout.glsl"
+
+// specialization constants, ids from shadervariant.hpp; the shader profile sets them per device
+layout(constant_id = 0) const uint SHADING_QUALITY = 1u;   // 0 vertex colour, 1 shaded by normal, 2 lit
+layout(constant_id = 1) const uint LIGHT_COUNT = 0u;       // directional lights at quality 2, up to 4
+
+const vec3 lightDirections[4] = vec3[](
+    vec3(0.36, 0.9, 0.24), vec3(-0.6, 0.3, -0.74), vec3(0.0, -1.0, 0.0), vec3(0.8, 0.0, -0.6)
+);
+const vec3 lightColors[4] = vec3[](
+    vec3(0.9, 0.85, 0.8), vec3(0.25, 0.3, 0.4), vec3(0.1, 0.1, 0.08), vec3(0.2, 0.15, 0.1)
+);
+
+#ifdef INSTANCED
+// instances come from the culling pass: a list of transform slots, read from listBase on
+layout(std430, set = 0, binding = 0) readonly buffer Transforms { mat4 world[]; };
+layout(std430, set = 0, binding = 1) readonly buffer VisibleSlots { uint slots[]; };
+
+layout(push_constant) uniform PushConstants {
+    mat4 transform;     // world -> clip
+    vec4 uvTransform;   // xy scale, zw offset
+    vec4 positionScale; // position dequantization, xyz
+    vec4 positionOffset;
+    uint listBase;
+} pc;
+#else
+layout(push_constant) uniform PushConstants {
+    mat4 transform;     // model -> clip, position dequantization folded in
+    vec4 uvTransform;   // xy scale, zw offset
+} pc;
+#endif
+
+layout(location = 0) out vec3 fragColor;
+
+// the constants are known when the pipeline is built, so only one of these paths is compiled
+vec3 shade(vec3 color, vec3 normal)
+{
+    if(SHADING_QUALITY == 0u) return color;
+    if(SHADING_QUALITY == 1u) return (normal * 0.5 + 0.5) * color;
+    vec3 n = normalize(normal);
+    vec3 light = vec3(0.15);
+    for(uint i = 0u; i < min(LIGHT_COUNT, 4u); i++)
+        light += lightColors[i] * max(dot(n, normalize(lightDirections[i])), 0.0);
+    return light * color;
+}
+
+void main()
+{
+    Vertex v = decodeVertex(pc.uvTransform);
+#ifdef INSTANCED
+    mat4 model = world[slots[pc.listBase + gl_InstanceIndex]];
+    vec3 position = v.position * pc.positionScale.xyz + pc.positionOffset.xyz;
+    gl_Position = pc.transform * model * vec4(position, 1.0);
+    vec3 normal = mat3(model) * v.normal;
+#else
+    gl_Position = pc.transform * vec4(v.position, 1.0);
+    vec3 normal = v.normal;
+#endif
+    fragColor = shade(v.color.rgb, normal);
+}
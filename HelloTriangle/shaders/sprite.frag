@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform sampler2DArray sprites;
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) in vec4 fragColor;
+layout(location = 2) flat in uint fragLayer;
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    color = texture(sprites, vec3(fragTexCoord, float(fragLayer))) * fragColor;
+}
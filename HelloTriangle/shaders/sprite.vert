@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// see spritebatch.hpp, SpriteVertex
+layout(location = 0) in vec2 inPosition;   // pixels
+layout(location = 1) in vec2 inTexCoord;   // unorm16
+layout(location = 2) in vec4 inColor;      // unorm8
+layout(location = 3) in uint inLayer;
+
+layout(push_constant) uniform SpritePushConstants
+{
+    vec2 scale;
+    vec2 offset;
+} pc;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec4 fragColor;
+layout(location = 2) flat out uint fragLayer;
+
+void main()
+{
+    gl_Position = vec4(inPosition * pc.scale + pc.offset, 0.0, 1.0);
+    fragTexCoord = inTexCoord;
+    fragColor = inColor;
+    fragLayer = inLayer;
+}
@@ -0,0 +1,119 @@
+#include <stdexcept>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+
+#include "benvulkan.hpp"
+#include "shadervariant.hpp"
+
+#define VENDOR_BROADCOM 0x14E4      // V3D, the Raspberry Pi 4 and 5
+
+static const ShaderProfile shaderProfiles[] = {
+	{ "desktop", 2, 4, 64 },
+	{ "pi", 1, 0, 16 },             // no lighting; V3D runs 16 wide
+};
+
+const ShaderProfile& chooseShaderProfile(VkPhysicalDevice physicalDevice, const char* requested)
+{
+	if(requested != nullptr && strcmp(requested, "auto") != 0)
+	{
+		for(const ShaderProfile& profile : shaderProfiles)
+			if(strcmp(profile.name, requested) == 0) return profile;
+		LOG_WARN("Unknown shader profile %s, picking one for the device\n", requested);
+	}
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	return properties.vendorID == VENDOR_BROADCOM ? shaderProfiles[1] : shaderProfiles[0];
+}
+
+ShaderVariantKey& ShaderVariantKey::set(uint32_t id, uint32_t value)
+{
+	auto it = std::lower_bound(constants.begin(), constants.end(), std::make_pair(id, 0u), \
+		[](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) { return a.first < b.first; });
+	if(it != constants.end() && it->first == id) it->second = value;
+	else
+	{
+		if(constants.size() >= SHADER_MAX_CONSTANTS) throw std::runtime_error("Too many specialization constants!\n");
+		constants.insert(it, std::make_pair(id, value));
+	}
+	return *this;
+}
+
+ShaderVariantKey& ShaderVariantKey::set(uint32_t id, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return set(id, bits);
+}
+
+// FNV-1a over the path and the sorted constants, so equal keys hash equal whatever order they were set in
+uint64_t ShaderVariantKey::hash() const
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	auto mix = [&h](const void* data, size_t size)
+	{
+		for(size_t i = 0; i < size; i++)
+		{
+			h ^= ((const uint8_t*)data)[i];
+			h *= 0x100000001b3ull;
+		}
+	};
+	mix(path.data(), path.size());
+	for(const auto& constant : constants)
+	{
+		mix(&constant.first, sizeof(constant.first));
+		mix(&constant.second, sizeof(constant.second));
+	}
+	return h;
+}
+
+const ShaderVariant& ShaderVariants::request(const ShaderVariantKey& key)
+{
+	uint64_t hash = key.hash();
+	std::lock_guard<std::mutex> guard(lock);
+	requests++;
+	std::vector<std::unique_ptr<ShaderVariant>>& bucket = variants[hash];
+	for(const auto& variant : bucket)
+		if(variant->key == key) return *variant;
+
+	auto& file = files[key.path];
+	if(!file) file.reset(new std::vector<char>(readSpirvFile(key.path)));
+	std::unique_ptr<ShaderVariant> variant(new ShaderVariant{ key, hash, file.get(), {}, {}, {} });
+	for(const auto& constant : key.constants)
+	{
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constant.first;
+		entry.offset = (uint32_t)(variant->data.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		variant->entries.push_back(entry);
+		variant->data.push_back(constant.second);
+	}
+	variant->specialization.mapEntryCount = (uint32_t)variant->entries.size();
+	variant->specialization.pMapEntries = variant->entries.data();
+	variant->specialization.dataSize = variant->data.size() * sizeof(uint32_t);
+	variant->specialization.pData = variant->data.data();
+	unique++;
+	LOG_DEBUG("Shader variant %s %016llx: %zu constants\n", key.path.c_str(), (unsigned long long)hash, key.constants.size());
+	bucket.push_back(std::move(variant));
+	return *bucket.back();
+}
+
+void ShaderVariants::log()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	LOG_INFO("Shader variants: %u requested, %u unique from %zu SPIR-V files\n", requests, unique, files.size());
+}
+
+VkPipelineShaderStageCreateInfo shaderStageInfo(const ShaderVariant& variant, VkShaderStageFlagBits stage, VkShaderModule module)
+{
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.stage = stage;
+	stageInfo.module = module;
+	stageInfo.pName = "main";
+	stageInfo.pSpecializationInfo = variant.entries.empty() ? nullptr : &variant.specialization;
+	return stageInfo;
+}
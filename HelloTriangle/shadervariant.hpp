@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Shader permutations. Structural permutations (vertex layout, instancing) are
+// #defines, compiled ahead of time by the Makefile into their own SPIR-V files.
+// Feature toggles and tuning constants are specialization constants: a variant is
+// a SPIR-V file plus the values of its constants, and the driver folds them in
+// when it builds the pipeline, so a disabled feature leaves no branch behind.
+// Variants are keyed by a hash of the file and the constants; identical requests
+// get the same entry, and every file is read once.
+// The values come from a ShaderProfile per deployment target, picked from the
+// device (the Pi's V3D, or anything else) or set with BENT_SHADER_PROFILE.
+
+#define SHADER_MAX_CONSTANTS 8
+
+// constant_id of each specialization constant, the same in every shader that declares it
+enum ShaderConstant : uint32_t
+{
+	SHADER_CONSTANT_QUALITY = 0,        // mesh.vert: 0 vertex colour, 1 shaded by normal, 2 lit
+	SHADER_CONSTANT_LIGHT_COUNT = 1,    // mesh.vert: directional lights at quality 2, up to 4
+	SHADER_CONSTANT_GROUP_SIZE = 2,     // cull.comp: local_size_x
+	SHADER_CONSTANT_LOD_HYSTERESIS = 3, // cull.comp: float
+};
+
+struct ShaderProfile
+{
+	const char* name;
+	uint32_t quality;
+	uint32_t lightCount;
+	uint32_t cullGroupSize;
+};
+
+// requested is auto (or nullptr), pi or desktop; auto goes by the device's vendor
+const ShaderProfile& chooseShaderProfile(VkPhysicalDevice physicalDevice, const char* requested);
+
+class ShaderVariantKey
+{
+	public:
+		explicit ShaderVariantKey(const std::string& path) : path(path) {}
+		// 32 bit values, booleans as VkBool32; setting an id twice keeps the last value
+		ShaderVariantKey& set(uint32_t id, uint32_t value);
+		ShaderVariantKey& set(uint32_t id, float value);
+
+		uint64_t hash() const;
+		bool operator==(const ShaderVariantKey& other) const { return path == other.path && constants == other.constants; }
+
+		std::string path;
+		std::vector<std::pair<uint32_t, uint32_t>> constants; // sorted by id
+};
+
+struct ShaderVariant
+{
+	ShaderVariantKey key;
+	uint64_t hash;
+	const std::vector<char>* code;              // SPIR-V, shared by every variant of the file
+	std::vector<VkSpecializationMapEntry> entries;
+	std::vector<uint32_t> data;
+	VkSpecializationInfo specialization;        // points into entries and data
+};
+
+class ShaderVariants
+{
+	public:
+		// the variant for key, reading the file on first use; thread safe, entries live as long as this
+		const ShaderVariant& request(const ShaderVariantKey& key);
+		void log();
+
+	private:
+		std::mutex lock;
+		std::unordered_map<std::string, std::unique_ptr<std::vector<char>>> files;
+		std::unordered_map<uint64_t, std::vector<std::unique_ptr<ShaderVariant>>> variants; // by hash, collisions side by side
+		uint32_t requests = 0, unique = 0;
+};
+
+// stage create info for a module built from variant.code, specialized by the variant
+VkPipelineShaderStageCreateInfo shaderStageInfo(const ShaderVariant& variant, VkShaderStageFlagBits stage, VkShaderModule module);
@@ -0,0 +1,504 @@
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+
+#include "benvulkan.hpp"
+#include "spritebatch.hpp"
+#include "pipelinestate.hpp"
+
+struct SpritePushConstants
+{
+	float scale[2];     // pixels -> NDC
+	float offset[2];
+};
+
+void SpriteBatch::init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool commandPool, \
+	uint32_t frameCount, uint32_t capacity)
+{
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->queue = queue;
+	this->commandPool = commandPool;
+	this->capacity = capacity;
+	sprites.reserve(capacity);
+
+	// host coherent and mapped for good: the CPU writes each quad exactly once per frame
+	VkDeviceSize streamSize = (VkDeviceSize)capacity * 4 * sizeof(SpriteVertex);
+	vertexBuffers.resize(frameCount);
+	vertexBuffersMemory.resize(frameCount);
+	vertexBuffersMapped.resize(frameCount);
+	for(uint32_t i = 0; i < frameCount; i++)
+	{
+		createBuffer(physicalDevice, device, streamSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, \
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffers[i], vertexBuffersMemory[i], \
+			MEMORY_STREAM);
+		vkMapMemory(device, vertexBuffersMemory[i], 0, streamSize, 0, (void**)&vertexBuffersMapped[i]);
+	}
+
+	// every quad is 0 1 2, 2 3 0 of its four vertices; written once
+	VkDeviceSize indexSize = (VkDeviceSize)capacity * 6 * sizeof(uint32_t);
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, \
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, \
+		MEMORY_STAGING);
+	uint32_t* indices;
+	vkMapMemory(device, stagingBufferMemory, 0, indexSize, 0, (void**)&indices);
+	for(uint32_t quad = 0; quad < capacity; quad++)
+	{
+		uint32_t v = quad * 4;
+		uint32_t* index = indices + quad * 6;
+		index[0] = v; index[1] = v + 1; index[2] = v + 2;
+		index[3] = v + 2; index[4] = v + 3; index[5] = v;
+	}
+	vkUnmapMemory(device, stagingBufferMemory);
+	createBuffer(physicalDevice, device, indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, \
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, MEMORY_MESH);
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	VkBufferCopy region{ 0, 0, indexSize };
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &region);
+	endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+	vkDestroyBuffer(device, stagingBuffer, hostAllocator());
+	freeDeviceMemory(device, stagingBufferMemory);
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // views decide which levels there are
+	if(vkCreateSampler(device, &samplerInfo, hostAllocator(), &sampler) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create sprite sampler!\n");
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = 1;
+	setLayoutInfo.pBindings = &binding;
+	if(vkCreateDescriptorSetLayout(device, &setLayoutInfo, hostAllocator(), &setLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create sprite descriptor set layout!\n");
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = SPRITE_DESCRIPTOR_SETS;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT; // setTextureView retires sets
+	poolInfo.maxSets = SPRITE_DESCRIPTOR_SETS;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	if(vkCreateDescriptorPool(device, &poolInfo, hostAllocator(), &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create sprite descriptor pool!\n");
+
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(SpritePushConstants);
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	if(cachedPipelineLayout(device, layoutInfo, pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create sprite pipeline layout!\n");
+	LOG_DEBUG("Sprite batch: %u sprites per frame, %u byte vertices\n", capacity, (uint32_t)sizeof(SpriteVertex));
+}
+
+void SpriteBatch::createPipelines(VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat)
+{
+	VkShaderModule vertShaderModule, fragShaderModule;
+	if(cachedShaderModule(device, readSpirvFile("shaders/sprite.vert.spv"), vertShaderModule) != VK_SUCCESS || \
+		cachedShaderModule(device, readSpirvFile("shaders/sprite.frag.spv"), fragShaderModule) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shader module!\n");
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(SpriteVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	VkVertexInputAttributeDescription attributes[4]{};
+	attributes[0] = { 0, 0, VK_FORMAT_R32G32_SFLOAT, (uint32_t)offsetof(SpriteVertex, x) };
+	attributes[1] = { 1, 0, VK_FORMAT_R16G16_UNORM, (uint32_t)offsetof(SpriteVertex, u) };
+	attributes[2] = { 2, 0, VK_FORMAT_R8G8B8A8_UNORM, (uint32_t)offsetof(SpriteVertex, color) };
+	attributes[3] = { 3, 0, VK_FORMAT_R32_UINT, (uint32_t)offsetof(SpriteVertex, layer) };
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = 4;
+	vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_NONE; // mirrored sprites flip their winding
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | \
+		VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO; // test and write off
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	if(depthFormat != VK_FORMAT_UNDEFINED) pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+	VkPipelineRenderingCreateInfo renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &colorFormat;
+	renderingInfo.depthAttachmentFormat = depthFormat;
+	if(renderPass == VK_NULL_HANDLE) pipelineInfo.pNext = &renderingInfo;
+	pipelineInfo.basePipelineIndex = -1;
+
+	// the blend modes only differ in the destination factor
+	const VkBlendFactor dstFactors[SPRITE_BLEND_COUNT] = { VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_FACTOR_ONE };
+	for(uint32_t blend = 0; blend < SPRITE_BLEND_COUNT; blend++)
+	{
+		colorBlendAttachment.dstColorBlendFactor = dstFactors[blend];
+		if(cachedGraphicsPipeline(device, pipelineInfo, pipelines[blend]) != VK_SUCCESS)
+			throw std::runtime_error("Couldn't create sprite pipeline!\n");
+	}
+}
+
+void SpriteBatch::destroy()
+{
+	if(device == VK_NULL_HANDLE) return;
+	for(auto& texture : textures)
+	{
+		if(texture.image == VK_NULL_HANDLE) continue; // from addTexture, not ours
+		vkDestroyImageView(device, texture.view, hostAllocator());
+		vkDestroyImage(device, texture.image, hostAllocator());
+		freeDeviceMemory(device, texture.memory);
+	}
+	textures.clear();
+	// the pipelines and their layout belong to the pipeline state cache
+	vkDestroyDescriptorPool(device, descriptorPool, hostAllocator());
+	vkDestroyDescriptorSetLayout(device, setLayout, hostAllocator());
+	vkDestroySampler(device, sampler, hostAllocator());
+	vkDestroyBuffer(device, indexBuffer, hostAllocator());
+	freeDeviceMemory(device, indexBufferMemory);
+	for(size_t i = 0; i < vertexBuffers.size(); i++)
+	{
+		vkUnmapMemory(device, vertexBuffersMemory[i]);
+		vkDestroyBuffer(device, vertexBuffers[i], hostAllocator());
+		freeDeviceMemory(device, vertexBuffersMemory[i]);
+	}
+	vertexBuffers.clear();
+	device = VK_NULL_HANDLE;
+}
+
+uint16_t SpriteBatch::createTextureArray(uint32_t width, uint32_t height, uint32_t layers, const uint8_t* pixels)
+{
+	if(textures.size() == SPRITE_MAX_TEXTURES) throw std::runtime_error("Too many sprite textures!\n");
+	Texture texture;
+	// sprites are drawn at any size, so minified ones want mips; without linear blits there is only level 0
+	uint32_t levels = supportsLinearBlit(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM) ? mipLevelCount(width, height) : 1;
+	VkDeviceSize size = (VkDeviceSize)width * height * layers * 4;
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, \
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, \
+		MEMORY_STAGING);
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+	memcpy(data, pixels, size);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = layers;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if(vkCreateImage(device, &imageInfo, hostAllocator(), &texture.image) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create sprite texture!\n");
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, texture.image, &memRequirements);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if(allocateDeviceMemory(device, allocInfo, MEMORY_TEXTURE, texture.memory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate sprite texture memory!\n");
+	vkBindImageMemory(device, texture.image, texture.memory, 0);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, \
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	VkBufferImageCopy region{};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = layers;
+	region.imageExtent = { width, height, 1 };
+	vkd.cmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	generateMipmaps(commandBuffer, texture.image, width, height, layers, levels);
+	endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+	vkDestroyBuffer(device, stagingBuffer, hostAllocator());
+	freeDeviceMemory(device, stagingBufferMemory);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = texture.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, layers };
+	if(vkCreateImageView(device, &viewInfo, hostAllocator(), &texture.view) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create sprite texture view!\n");
+	texture.set = allocateSet(texture.view);
+	textures.push_back(texture);
+	LOG_DEBUG("Sprite texture %zu: %ux%u, %u layers, %u levels\n", textures.size() - 1, width, height, layers, levels);
+	return (uint16_t)(textures.size() - 1);
+}
+
+uint16_t SpriteBatch::addTexture(VkImageView view)
+{
+	if(textures.size() == SPRITE_MAX_TEXTURES) throw std::runtime_error("Too many sprite textures!\n");
+	textures.push_back(Texture{ VK_NULL_HANDLE, VK_NULL_HANDLE, view, allocateSet(view) });
+	return (uint16_t)(textures.size() - 1);
+}
+
+// frames already recorded keep binding the old set, so it goes once they retire
+void SpriteBatch::setTextureView(uint16_t texture, VkImageView view, DeletionQueue& deletionQueue)
+{
+	Texture& entry = textures.at(texture);
+	if(entry.image != VK_NULL_HANDLE) throw std::runtime_error("Sprite texture is not external!\n");
+	deletionQueue.release(descriptorPool, entry.set);
+	entry.view = view;
+	entry.set = allocateSet(view);
+}
+
+VkDescriptorSet SpriteBatch::allocateSet(VkImageView view)
+{
+	VkDescriptorSet set;
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = descriptorPool;
+	setInfo.descriptorSetCount = 1;
+	setInfo.pSetLayouts = &setLayout;
+	if(vkAllocateDescriptorSets(device, &setInfo, &set) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate sprite descriptor set!\n");
+	VkDescriptorImageInfo imageDescriptor{ sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageDescriptor;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return set;
+}
+
+void SpriteBatch::begin()
+{
+	sprites.clear();
+}
+
+void SpriteBatch::add(const Sprite& sprite)
+{
+	if(sprites.size() == capacity)
+	{
+		dropped++;
+		return;
+	}
+	sprites.push_back(sprite);
+}
+
+void SpriteBatch::add(const Sprite* added, uint32_t count)
+{
+	uint32_t room = capacity - (uint32_t)sprites.size();
+	if(count > room)
+	{
+		dropped += count - room;
+		count = room;
+	}
+	sprites.insert(sprites.end(), added, added + count);
+}
+
+static inline uint32_t spriteKey(const Sprite& sprite)
+{
+	return ((uint32_t)sprite.order << 24) | ((uint32_t)sprite.blend << 16) | sprite.texture;
+}
+
+static inline uint16_t toUnorm16(float v)
+{
+	return (uint16_t)(v * 65535.0f + 0.5f);
+}
+
+static inline void writeQuad(SpriteVertex* out, const Sprite& s)
+{
+	float hw = s.width * 0.5f, hh = s.height * 0.5f;
+	// corner offsets rotated: x' = x cos - y sin, y' = x sin + y cos
+	float c = 1.0f, sn = 0.0f;
+	if(s.rotation != 0.0f)
+	{
+		c = cosf(s.rotation);
+		sn = sinf(s.rotation);
+	}
+	float ax = hw * c, ay = hw * sn;    // half width axis
+	float bx = -hh * sn, by = hh * c;   // half height axis
+	uint16_t u0 = toUnorm16(s.u0), v0 = toUnorm16(s.v0), u1 = toUnorm16(s.u1), v1 = toUnorm16(s.v1);
+	out[0] = { s.x - ax - bx, s.y - ay - by, u0, v0, s.color, s.layer };
+	out[1] = { s.x + ax - bx, s.y + ay - by, u1, v0, s.color, s.layer };
+	out[2] = { s.x + ax + bx, s.y + ay + by, u1, v1, s.color, s.layer };
+	out[3] = { s.x - ax + bx, s.y - ay + by, u0, v1, s.color, s.layer };
+}
+
+void SpriteBatch::end(uint32_t frame, JobSystem* jobs)
+{
+	draws.clear();
+	quadsWritten = (uint32_t)sprites.size();
+	if(sprites.empty()) return;
+
+	// counting sort over the few distinct keys: count, order the keys, scatter
+	bucketKeys.clear();
+	bucketCounts.clear();
+	spriteSlots.resize(sprites.size());
+	uint32_t lastKey = UINT32_MAX, lastBucket = 0;
+	for(size_t i = 0; i < sprites.size(); i++)
+	{
+		uint32_t key = spriteKey(sprites[i]);
+		if(key != lastKey)
+		{
+			auto found = std::find(bucketKeys.begin(), bucketKeys.end(), key);
+			lastBucket = (uint32_t)(found - bucketKeys.begin());
+			if(found == bucketKeys.end())
+			{
+				bucketKeys.push_back(key);
+				bucketCounts.push_back(0);
+			}
+			lastKey = key;
+		}
+		bucketCounts[lastBucket]++;
+		spriteSlots[i] = lastBucket;
+	}
+	std::vector<uint32_t> sorted(bucketKeys.size());
+	for(uint32_t b = 0; b < sorted.size(); b++) sorted[b] = b;
+	std::sort(sorted.begin(), sorted.end(), [this](uint32_t a, uint32_t b) { return bucketKeys[a] < bucketKeys[b]; });
+	std::vector<uint32_t> offsets(bucketKeys.size());
+	uint32_t offset = 0;
+	for(uint32_t b : sorted)
+	{
+		offsets[b] = offset;
+		uint8_t blend = (uint8_t)(bucketKeys[b] >> 16);
+		uint16_t texture = (uint16_t)bucketKeys[b];
+		// a different order with the same state continues the previous draw
+		if(!draws.empty() && draws.back().blend == blend && draws.back().texture == texture)
+			draws.back().quadCount += bucketCounts[b];
+		else
+			draws.push_back({ blend, texture, offset, bucketCounts[b] });
+		offset += bucketCounts[b];
+	}
+
+	// the scatter order is fixed up front, then every quad can be written independently
+	for(size_t i = 0; i < sprites.size(); i++)
+		spriteSlots[i] = offsets[spriteSlots[i]]++;
+	SpriteVertex* stream = vertexBuffersMapped[frame];
+	auto writeQuads = [this, stream](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+			writeQuad(stream + (size_t)spriteSlots[i] * 4, sprites[i]);
+	};
+	if(jobs == nullptr)
+	{
+		writeQuads(0, (uint32_t)sprites.size());
+		return;
+	}
+	JobCounter written;
+	jobs->parallelFor((uint32_t)sprites.size(), SPRITE_JOB_GRAIN, writeQuads, written);
+	jobs->wait(written);
+}
+
+void SpriteBatch::record(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D extent)
+{
+	if(draws.empty()) return;
+	VkViewport viewport{ 0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f };
+	VkRect2D scissor{ {0, 0}, extent };
+	vkd.cmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkd.cmdSetScissor(commandBuffer, 0, 1, &scissor);
+	VkDeviceSize vertexOffset = 0;
+	vkd.cmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffers[frame], &vertexOffset);
+	vkd.cmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	SpritePushConstants constants = { { 2.0f / extent.width, 2.0f / extent.height }, { -1.0f, -1.0f } };
+	vkd.cmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+	int boundBlend = -1, boundTexture = -1;
+	for(const Draw& draw : draws)
+	{
+		if(draw.blend != boundBlend)
+		{
+			vkd.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[draw.blend]);
+			boundBlend = draw.blend;
+		}
+		if(draw.texture != boundTexture)
+		{
+			vkd.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, \
+				&textures[draw.texture].set, 0, nullptr);
+			boundTexture = draw.texture;
+		}
+		vkd.cmdDrawIndexed(commandBuffer, draw.quadCount * 6, 1, draw.firstQuad * 6, 0, 0);
+	}
+}
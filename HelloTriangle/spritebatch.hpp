@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "jobsystem.hpp"
+#include "deletionqueue.hpp"
+
+// 2D sprites in as few draws as possible. Sprites are collected on the CPU
+// each frame, bucketed by (order, blend mode, texture array) with a counting
+// sort, and written as quads straight into a persistently mapped vertex stream
+// (one region per frame in flight). A static index buffer holds the quad
+// pattern, so each bucket is one vkCmdDrawIndexed; neighbouring buckets with
+// the same pipeline and texture merge. Textures are 2D arrays: sprites pick a
+// layer per quad, and regions within a layer act as an atlas, so switching
+// images never costs a descriptor rebind.
+// Coordinates are pixels, origin top left. Within a bucket sprites keep their
+// submission order; across buckets only `order` is honoured.
+
+#define SPRITE_MAX_TEXTURES 16
+#define SPRITE_DESCRIPTOR_SETS (SPRITE_MAX_TEXTURES * 4) // room for sets retired by setTextureView, until their frames finish
+#define SPRITE_JOB_GRAIN 1024     // quads written per job at least
+
+enum SpriteBlend : uint8_t
+{
+	SPRITE_BLEND_ALPHA,
+	SPRITE_BLEND_ADDITIVE,
+	SPRITE_BLEND_COUNT,
+};
+
+struct Sprite
+{
+	float x, y;                 // centre, pixels
+	float width, height;
+	float rotation;             // radians, clockwise on screen
+	float u0, v0, u1, v1;       // region of the layer, 0..1
+	uint32_t color;             // RGBA8 (R in the low byte), multiplies the texel
+	uint16_t texture;           // from createTextureArray
+	uint16_t layer;
+	uint8_t blend;              // SpriteBlend
+	uint8_t order;              // lower orders are drawn first
+};
+
+struct SpriteVertex
+{
+	float x, y;
+	uint16_t u, v;              // unorm
+	uint32_t color;
+	uint32_t layer;
+};
+
+class SpriteBatch
+{
+	public:
+		// capacity: sprites per frame, extra ones are dropped (and counted)
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool commandPool, \
+			uint32_t frameCount, uint32_t capacity);
+		// renderPass == VK_NULL_HANDLE means dynamic rendering into colorFormat; viewport and scissor are dynamic.
+		// With a depthFormat the pass has a depth attachment, which sprites neither test nor write
+		void createPipelines(VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat = VK_FORMAT_UNDEFINED);
+		void destroy();
+
+		// layers * width * height RGBA8 texels, layer after layer; mipmapped here. Returns the texture id
+		uint16_t createTextureArray(uint32_t width, uint32_t height, uint32_t layers, const uint8_t* pixels);
+		// a 2D array view owned by someone else, e.g. a streamed texture
+		uint16_t addTexture(VkImageView view);
+		// for an added texture whose view changed; call before recording with it
+		void setTextureView(uint16_t texture, VkImageView view, DeletionQueue& deletionQueue);
+
+		void begin();
+		void add(const Sprite& sprite);
+		void add(const Sprite* sprites, uint32_t count);
+		// sorts and writes this frame's quads into its stream region; the GPU must be done with it.
+		// With jobs the quads are written in parallel, the sort stays on this thread
+		void end(uint32_t frame, JobSystem* jobs = nullptr);
+		// inside the render pass, for a target of this size; may be recorded for several targets
+		void record(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D extent);
+
+		bool empty() const { return sprites.empty(); }
+		uint32_t drawCount() const { return (uint32_t)draws.size(); }
+		uint32_t quadCount() const { return quadsWritten; }
+		uint64_t droppedCount() const { return dropped; }
+
+	private:
+		struct Draw
+		{
+			uint8_t blend;
+			uint16_t texture;
+			uint32_t firstQuad, quadCount;
+		};
+		struct Texture
+		{
+			VkImage image;              // VK_NULL_HANDLE for added views
+			VkDeviceMemory memory;
+			VkImageView view;
+			VkDescriptorSet set;
+		};
+
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		uint32_t capacity = 0;
+
+		std::vector<VkBuffer> vertexBuffers;        // per frame in flight
+		std::vector<VkDeviceMemory> vertexBuffersMemory;
+		std::vector<SpriteVertex*> vertexBuffersMapped;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;      // quad pattern, capacity quads
+		VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipelines[SPRITE_BLEND_COUNT] = {};
+		std::vector<Texture> textures;
+
+		std::vector<Sprite> sprites;
+		std::vector<Draw> draws;
+		uint32_t quadsWritten = 0;
+		uint64_t dropped = 0;
+		// counting sort scratch
+		std::vector<uint32_t> bucketKeys, bucketCounts;
+		std::vector<uint32_t> spriteSlots;          // bucket, then quad index of each sprite
+
+		VkDescriptorSet allocateSet(VkImageView view);
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+// Binary texture blob (.btex), written offline by tools/texconv and mmapped at runtime.
+// Layout: TextureFileHeader | TextureLevel[levelCount] | level payloads, finest first.
+// A level holds every layer back to back, tightly packed in the header's format (rows of
+// blocks for block compressed formats), and starts on a TEXTURE_LEVEL_ALIGN boundary so
+// it can be copied straight into a staging buffer. The whole mip chain is stored: the runtime streams single levels in and out,
+// which a GPU mip generation pass could not do once level 0 is gone. All values little endian.
+
+#define TEXTURE_MAGIC 0x58455442u  // "BTEX"
+#define TEXTURE_VERSION 1
+#define TEXTURE_LEVEL_ALIGN 64
+#define TEXTURE_MAX_LEVELS 16       // up to 32768 texels a side
+
+struct TextureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;        // sizeof(TextureFileHeader), for forward compatibility
+	uint32_t format;            // VkFormat of every level, or a universal format (transcode.hpp)
+	uint64_t fileSize;
+	uint32_t width;             // level 0
+	uint32_t height;
+	uint32_t layers;
+	uint32_t levelCount;        // down to 1x1
+};
+
+struct TextureLevel
+{
+	uint64_t offset;            // from start of file, multiple of TEXTURE_LEVEL_ALIGN
+	uint64_t size;              // bytes, all layers
+	uint32_t width;
+	uint32_t height;
+};
@@ -0,0 +1,484 @@
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "benvulkan.hpp"
+#include "texture.hpp"
+
+#define TEXTURE_STAGING_ALIGN 16    // buffer offsets of a copy: 4 bytes and the format's block size
+
+TextureFile::TextureFile(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw std::runtime_error("Couldn't open texture file " + path + "\n");
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TextureFileHeader))
+	{
+		close(fd);
+		throw std::runtime_error("Texture file too small: " + path + "\n");
+	}
+	mappedSize = (size_t)st.st_size;
+	data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+	if(data == MAP_FAILED)
+	{
+		data = nullptr;
+		throw std::runtime_error("Couldn't map texture file " + path + "\n");
+	}
+	// levels are read when they are streamed in, which is rarely in file order
+	madvise(data, mappedSize, MADV_RANDOM);
+
+	fileHeader = (const TextureFileHeader*)data;
+	payload = (const char*)data;
+	const TextureFileHeader& h = header();
+	const char* error = nullptr;
+	if(h.magic != TEXTURE_MAGIC) error = "not a .btex file";
+	else if(h.version != TEXTURE_VERSION) error = "unsupported .btex version";
+	else if(h.headerSize != sizeof(TextureFileHeader)) error = "unexpected header size";
+	else if(h.fileSize != mappedSize) error = "truncated file";
+	else if(h.levelCount == 0 || h.levelCount > TEXTURE_MAX_LEVELS || h.layers == 0) error = "bad level or layer count";
+	else if(textureFormatInfo(h.format).blockBytes == 0) error = "unknown format";
+	else if(h.headerSize + (uint64_t)h.levelCount * sizeof(TextureLevel) > mappedSize) error = "truncated level table";
+	if(!error)
+	{
+		levels = (const TextureLevel*)((const char*)data + h.headerSize);
+		for(uint32_t i = 0; i < h.levelCount && !error; i++)
+		{
+			const TextureLevel& l = levels[i];
+			if(l.offset % TEXTURE_LEVEL_ALIGN != 0) error = "misaligned level";
+			else if(l.offset > mappedSize || l.size > mappedSize - l.offset || l.size == 0) error = "level out of bounds";
+			else if(l.width != std::max(h.width >> i, 1u) || l.height != std::max(h.height >> i, 1u)) error = "bad level size";
+			else if(l.size != textureLevelSize(h.format, l.width, l.height, h.layers)) error = "level size doesn't match the format";
+		}
+	}
+	if(error)
+	{
+		munmap(data, mappedSize);
+		data = nullptr;
+		throw std::runtime_error("Invalid texture file " + path + ": " + error + "\n");
+	}
+}
+
+TextureFile::~TextureFile()
+{
+	if(data) munmap(data, mappedSize);
+}
+
+void TextureFile::prefetch(uint32_t first, uint32_t end) const
+{
+	if(first >= end || data == nullptr) return;
+	// finer levels come first in the file
+	uintptr_t begin = (uintptr_t)data + levels[first].offset;
+	uintptr_t last = (uintptr_t)data + levels[end - 1].offset + levels[end - 1].size;
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	begin &= ~(page - 1);
+	madvise((void*)begin, last - begin, MADV_WILLNEED);
+}
+
+void TextureFile::transcode(VkFormat target, JobSystem* jobs)
+{
+	TextureFileHeader source = header();
+	transcodedHeader = source;
+	transcodedHeader.format = target;
+	fileHeader = &transcodedHeader;
+	if(universalTargetIsCopy(source.format, target)) return; // same blocks, keep streaming from the mapping
+
+	transcodedLevels.resize(source.levelCount);
+	uint64_t offset = 0;
+	for(uint32_t level = 0; level < source.levelCount; level++)
+	{
+		TextureLevel& out = transcodedLevels[level];
+		out = levels[level];
+		out.offset = offset;
+		out.size = textureLevelSize(target, out.width, out.height, source.layers);
+		offset = (offset + out.size + TEXTURE_LEVEL_ALIGN - 1) / TEXTURE_LEVEL_ALIGN * TEXTURE_LEVEL_ALIGN;
+	}
+	transcodedData.resize(offset);
+
+	// rows are independent, so every level and layer is split the same way
+	struct Row
+	{
+		uint32_t level, layer, row;
+	};
+	std::vector<Row> rows;
+	for(uint32_t level = 0; level < source.levelCount; level++)
+		for(uint32_t layer = 0; layer < source.layers; layer++)
+			for(uint32_t row = 0; row < (levels[level].height + 3) / 4; row++) rows.push_back(Row{ level, layer, row });
+	auto transcodeRows = [&](uint32_t begin, uint32_t end)
+	{
+		for(uint32_t i = begin; i < end; i++)
+		{
+			const TextureLevel& from = levels[rows[i].level];
+			const TextureLevel& to = transcodedLevels[rows[i].level];
+			transcodeBlockRow(source.format, target, (const uint8_t*)payload + from.offset + from.size / source.layers * rows[i].layer, \
+				(uint8_t*)transcodedData.data() + to.offset + to.size / source.layers * rows[i].layer, from.width, from.height, \
+				rows[i].row);
+		}
+	};
+	if(jobs != nullptr)
+	{
+		JobCounter transcoded;
+		jobs->parallelFor((uint32_t)rows.size(), TEXTURE_TRANSCODE_GRAIN, transcodeRows, transcoded);
+		jobs->wait(transcoded);
+	}
+	else transcodeRows(0, (uint32_t)rows.size());
+
+	munmap(data, mappedSize);
+	data = nullptr;
+	levels = transcodedLevels.data();
+	payload = transcodedData.data();
+}
+
+uint32_t textureLevelForFootprint(uint32_t texels, float pixels)
+{
+	if(pixels < 1.0f) pixels = 1.0f;
+	float ratio = (float)texels / pixels;
+	return ratio <= 1.0f ? 0 : (uint32_t)floorf(log2f(ratio));
+}
+
+void TextureStreamer::init(VkPhysicalDevice physicalDevice, VkDevice device, QueueTimeline& timeline, VkCommandPool commandPool, \
+	DeletionQueue& deletionQueue, VkDeviceSize budgetCap, JobSystem* jobs)
+{
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->timeline = &timeline;
+	this->commandPool = commandPool;
+	this->deletionQueue = &deletionQueue;
+	this->budgetCap = budgetCap;
+	this->jobs = jobs;
+	headroomLimit = VK_WHOLE_SIZE;
+}
+
+void TextureStreamer::destroy()
+{
+	if(device == VK_NULL_HANDLE) return;
+	for(Texture& texture : textures)
+	{
+		vkDestroyImageView(device, texture.view, hostAllocator());
+		vkDestroyImage(device, texture.image, hostAllocator());
+		freeDeviceMemory(device, texture.memory);
+	}
+	textures.clear();
+	residentBytes = 0;
+	device = VK_NULL_HANDLE;
+}
+
+uint32_t TextureStreamer::load(const std::string& path)
+{
+	Texture texture{};
+	texture.file.reset(new TextureFile(path));
+	uint32_t fileFormat = texture.file->header().format;
+	if(textureFormatUniversal(fileFormat))
+	{
+		VkFormat targets[TEXTURE_MAX_UNIVERSAL_TARGETS];
+		uint32_t count = universalTargets(fileFormat, targets), choice = 0;
+		while(choice < count && !samplable(targets[choice])) choice++;
+		if(choice == count) throw std::runtime_error("The device can't sample any format " + path + " transcodes to\n");
+		auto start = std::chrono::steady_clock::now();
+		texture.file->transcode(targets[choice], jobs);
+		LOG_INFO("Texture %s: %s transcoded to %s in %.1f ms\n", path.c_str(), textureFormatInfo(fileFormat).name, \
+			textureFormatInfo(targets[choice]).name, \
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	const TextureFileHeader& header = texture.file->header();
+	if(!samplable((VkFormat)header.format))
+		throw std::runtime_error("The device can't sample the " + std::string(textureFormatInfo(header.format).name) + \
+			" format of " + path + "\n");
+
+	texture.tailLevel = header.levelCount - 1;
+	while(texture.tailLevel > 0 && std::max(texture.file->level(texture.tailLevel - 1).width, \
+		texture.file->level(texture.tailLevel - 1).height) <= TEXTURE_TAIL_SIZE)
+		texture.tailLevel--;
+	texture.residentLevel = header.levelCount; // nothing yet
+	texture.wantedLevel = header.levelCount;
+	texture.targetLevel = texture.tailLevel;
+	texture.prefetchedLevel = texture.tailLevel;
+	texture.lastRequest = updates;
+	textures.push_back(std::move(texture));
+	uint32_t id = (uint32_t)textures.size() - 1;
+	apply({ Change{ id, textures[id].tailLevel } });
+	LOG_INFO("Texture %s: %ux%u, %u layers, %u levels, %s, levels %u.. resident\n", path.c_str(), header.width, \
+		header.height, header.layers, header.levelCount, textureFormatInfo(header.format).name, textures[id].tailLevel);
+	return id;
+}
+
+void TextureStreamer::request(uint32_t texture, uint32_t level)
+{
+	Texture& entry = textures[texture];
+	entry.wantedLevel = std::min(entry.wantedLevel, std::min(level, entry.file->header().levelCount - 1));
+}
+
+// the resident bytes that leave the reserve free
+void TextureStreamer::setHeadroom(VkDeviceSize headroom)
+{
+	VkDeviceSize available = residentBytes + headroom;
+	headroomLimit = available > TEXTURE_HEADROOM_RESERVE ? available - TEXTURE_HEADROOM_RESERVE : 0;
+}
+
+VkDeviceSize TextureStreamer::budget() const
+{
+	return budgetCap != 0 ? std::min(budgetCap, headroomLimit) : headroomLimit;
+}
+
+// a texture image of the format can be filtered, compressed formats included
+bool TextureStreamer::samplable(VkFormat format) const
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (props.optimalTilingFeatures & needed) == needed;
+}
+
+// as stored in the file, or after transcoding; the images round up a little
+VkDeviceSize TextureStreamer::levelBytes(const Texture& texture, uint32_t first, uint32_t end) const
+{
+	VkDeviceSize bytes = 0;
+	for(uint32_t level = first; level < end; level++) bytes += texture.file->level(level).size;
+	return bytes;
+}
+
+void TextureStreamer::update()
+{
+	updates++;
+	for(Texture& texture : textures)
+	{
+		uint32_t levelCount = texture.file->header().levelCount;
+		if(texture.wantedLevel < levelCount)
+		{
+			texture.targetLevel = std::min(texture.wantedLevel, texture.tailLevel);
+			texture.lastRequest = updates;
+		}
+		else if(updates - texture.lastRequest > TEXTURE_IDLE_FRAMES)
+			texture.targetLevel = texture.tailLevel;
+		texture.wantedLevel = levelCount;
+	}
+
+	// plan on file sizes: every texture's resident level after this update
+	VkDeviceSize limit = budget();
+	std::vector<uint32_t> planned(textures.size());
+	VkDeviceSize plannedBytes = 0;
+	for(size_t i = 0; i < textures.size(); i++)
+	{
+		planned[i] = textures[i].residentLevel;
+		plannedBytes += levelBytes(textures[i], planned[i], textures[i].file->header().levelCount);
+	}
+	// evict: levels nobody wants any more first, then the least recently requested textures a level at a time
+	while(plannedBytes > limit)
+	{
+		int victim = -1;
+		bool victimSurplus = false;
+		for(size_t i = 0; i < textures.size(); i++)
+		{
+			if(planned[i] >= textures[i].tailLevel) continue;
+			bool surplus = planned[i] < textures[i].targetLevel;
+			if(victim < 0 || (surplus && !victimSurplus) || (surplus == victimSurplus && \
+				textures[i].lastRequest < textures[victim].lastRequest))
+			{
+				victim = (int)i;
+				victimSurplus = surplus;
+			}
+		}
+		if(victim < 0) break; // only mip tails left
+		uint32_t level = victimSurplus ? textures[victim].targetLevel : planned[victim] + 1;
+		plannedBytes -= levelBytes(textures[victim], planned[victim], level);
+		planned[victim] = level;
+	}
+	// stream in: the most recently requested first, as far as the budget and the frame's staging allow
+	std::vector<uint32_t> order;
+	for(size_t i = 0; i < textures.size(); i++)
+		if(textures[i].targetLevel < planned[i]) order.push_back((uint32_t)i);
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return textures[a].lastRequest > textures[b].lastRequest; });
+	VkDeviceSize staged = 0;
+	for(uint32_t i : order)
+	{
+		Texture& texture = textures[i];
+		// read the levels ahead now and upload them at a later update, so the copy doesn't fault the pages in
+		if(texture.prefetchedLevel > texture.targetLevel)
+		{
+			texture.file->prefetch(texture.targetLevel, texture.prefetchedLevel);
+			texture.prefetchedLevel = texture.targetLevel;
+			continue;
+		}
+		while(planned[i] > texture.targetLevel)
+		{
+			VkDeviceSize bytes = levelBytes(texture, planned[i] - 1, planned[i]);
+			if(plannedBytes + bytes > limit || (staged > 0 && staged + bytes > TEXTURE_STREAM_BYTES)) break;
+			staged += bytes;
+			plannedBytes += bytes;
+			planned[i]--;
+		}
+	}
+
+	std::vector<Change> changes;
+	for(size_t i = 0; i < textures.size(); i++)
+		if(planned[i] != textures[i].residentLevel) changes.push_back(Change{ (uint32_t)i, planned[i] });
+	if(!changes.empty()) apply(changes);
+}
+
+// one new image per change, filled from the old one and the file in one submit
+void TextureStreamer::apply(const std::vector<Change>& changes)
+{
+	auto align = [](VkDeviceSize v) { return (v + TEXTURE_STAGING_ALIGN - 1) / TEXTURE_STAGING_ALIGN * TEXTURE_STAGING_ALIGN; };
+	VkDeviceSize stagingSize = 0;
+	for(const Change& change : changes)
+		for(uint32_t level = change.level; level < textures[change.texture].residentLevel; level++)
+			stagingSize += align(textures[change.texture].file->level(level).size);
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	char* staging = nullptr;
+	if(stagingSize > 0)
+	{
+		createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, \
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, \
+			MEMORY_STAGING);
+		vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, (void**)&staging);
+	}
+
+	// the old images are read by this submit, so they go once it retires
+	deletionQueue->setCurrent(timeline->nextValue());
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	VkDeviceSize stagingOffset = 0;
+	for(const Change& change : changes)
+	{
+		Texture& texture = textures[change.texture];
+		const TextureFileHeader& header = texture.file->header();
+		const TextureLevel& top = texture.file->level(change.level);
+		uint32_t levels = header.levelCount - change.level;
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = (VkFormat)header.format;
+		imageInfo.extent = { top.width, top.height, 1 };
+		imageInfo.mipLevels = levels;
+		imageInfo.arrayLayers = header.layers;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImage image;
+		if(vkCreateImage(device, &imageInfo, hostAllocator(), &image) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create texture image!\n");
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, image, &memRequirements);
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VkDeviceMemory memory;
+		if(allocateDeviceMemory(device, allocInfo, MEMORY_TEXTURE, memory) != VK_SUCCESS)
+		{
+			vkDestroyImage(device, image, hostAllocator());
+			if(texture.image == VK_NULL_HANDLE) throw std::runtime_error("Failed to allocate texture memory!\n");
+			// the budget was optimistic: hold on to what is resident, and no more until the next memory report
+			stats.failedAllocations++;
+			headroomLimit = std::min(headroomLimit, residentBytes);
+			for(uint32_t level = change.level; level < texture.residentLevel; level++)
+				stagingOffset += align(texture.file->level(level).size);
+			continue;
+		}
+		vkBindImageMemory(device, image, memory, 0);
+		transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, \
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		// the levels both images hold move over on the GPU; the barrier waits for frames still sampling them
+		if(texture.image != VK_NULL_HANDLE)
+		{
+			transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, \
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, \
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+			std::vector<VkImageCopy> copies;
+			for(uint32_t level = std::max(change.level, texture.residentLevel); level < header.levelCount; level++)
+			{
+				const TextureLevel& source = texture.file->level(level);
+				VkImageCopy copy{};
+				copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.residentLevel, 0, header.layers };
+				copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - change.level, 0, header.layers };
+				copy.extent = { source.width, source.height, 1 };
+				copies.push_back(copy);
+			}
+			vkd.cmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, \
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)copies.size(), copies.data());
+		}
+		// and the finer ones from the file
+		for(uint32_t level = change.level; level < texture.residentLevel; level++)
+		{
+			const TextureLevel& source = texture.file->level(level);
+			memcpy(staging + stagingOffset, texture.file->levelData(level), source.size);
+			VkBufferImageCopy region{};
+			region.bufferOffset = stagingOffset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - change.level, 0, header.layers };
+			region.imageExtent = { source.width, source.height, 1 };
+			vkd.cmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			stagingOffset += align(source.size);
+			stats.uploadedBytes += source.size;
+			if(texture.image != VK_NULL_HANDLE) stats.streamedLevels++;
+		}
+		transitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, \
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = (VkFormat)header.format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, header.layers };
+		VkImageView view;
+		if(vkCreateImageView(device, &viewInfo, hostAllocator(), &view) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create texture view!\n");
+
+		if(texture.image != VK_NULL_HANDLE)
+		{
+			if(change.level > texture.residentLevel)
+			{
+				stats.evictedLevels += change.level - texture.residentLevel;
+				texture.prefetchedLevel = std::max(texture.prefetchedLevel, change.level); // the pages may go too
+			}
+			deletionQueue->release(texture.view);
+			deletionQueue->release(texture.image);
+			deletionQueue->release(texture.memory);
+		}
+		residentBytes = residentBytes - texture.bytes + memRequirements.size;
+		texture.image = image;
+		texture.memory = memory;
+		texture.view = view;
+		texture.bytes = memRequirements.size;
+		texture.residentLevel = change.level;
+		texture.generation++;
+	}
+	vkd.endCommandBuffer(commandBuffer);
+	if(staging) vkUnmapMemory(device, stagingBufferMemory);
+
+	// same queue as the frames, which come after it: no semaphore, the barriers order the sampling
+	TimelineSubmit submit;
+	submit.commandBufferCount = 1;
+	submit.commandBuffers = &commandBuffer;
+	timeline->submit(submit);
+	deletionQueue->release(commandPool, commandBuffer);
+	if(stagingBuffer != VK_NULL_HANDLE)
+	{
+		deletionQueue->release(stagingBuffer);
+		deletionQueue->release(stagingBufferMemory);
+	}
+	// releases from here on belong to the frame's submit
+	deletionQueue->setCurrent(timeline->nextValue());
+}
+
+TextureStreamStats TextureStreamer::takeStats()
+{
+	TextureStreamStats result = stats;
+	result.residentBytes = residentBytes;
+	result.budget = budget();
+	stats = TextureStreamStats{};
+	return result;
+}
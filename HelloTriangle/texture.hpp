@@ -0,0 +1,148 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "texformat.hpp"
+#include "transcode.hpp"
+#include "deletionqueue.hpp"
+#include "gpusync.hpp"
+#include "jobsystem.hpp"
+
+// Streamed mip residency for .btex textures. A texture's image holds a suffix of
+// its mip chain, [residentLevel, levelCount): the mip tail (levels no larger than
+// TEXTURE_TAIL_SIZE) is uploaded at load and always stays, finer levels come and
+// go. Each frame the renderer asks for the finest level it would sample, by
+// on-screen footprint or distance; update() then
+//  - evicts fine levels while the textures are over their budget, levels nobody
+//    asks for first, then the least recently asked for,
+//  - streams wanted levels in, most recently asked for first, staging at most
+//    TEXTURE_STREAM_BYTES of them per frame.
+// Without sparse residency a level change means a new image: the levels both
+// images hold are copied on the GPU, the new ones come from the file. The copy is
+// submitted on the graphics timeline ahead of the frame, and the old image is
+// released to the deletion queue, so nothing waits on the CPU. Levels are read
+// from the mapped file, which was asked to read them ahead a frame earlier.
+// The budget is the device local headroom at the last memory report, less
+// TEXTURE_HEADROOM_RESERVE, optionally capped (BENT_TEXTURE_BUDGET).
+// Files may hold any block compressed format the device samples. Universal files
+// are transcoded at load, on the job system, to the first of ETC2, BC and RGBA8
+// the device samples; as ETC2 they stay mapped and need no transcoding at all.
+
+#define TEXTURE_TAIL_SIZE 64                    // texels on the longer side
+#define TEXTURE_STREAM_BYTES (4u << 20)         // staged per update, at least one level
+#define TEXTURE_HEADROOM_RESERVE (64ull << 20)  // left free for everything else
+#define TEXTURE_IDLE_FRAMES 120                 // unrequested this long, only the tail is wanted
+#define TEXTURE_TRANSCODE_GRAIN 16              // block rows per transcode job
+
+// Read-only view of a .btex blob, mapped and validated once like MeshFile
+class TextureFile
+{
+	public:
+		explicit TextureFile(const std::string& path);
+		~TextureFile();
+		TextureFile(const TextureFile&) = delete;
+		TextureFile& operator=(const TextureFile&) = delete;
+
+		const TextureFileHeader& header() const { return *fileHeader; }
+		const TextureLevel& level(uint32_t level) const { return levels[level]; }
+		const void* levelData(uint32_t level) const { return payload + levels[level].offset; }
+		// start reading these levels in the background
+		void prefetch(uint32_t first, uint32_t end) const;
+		// a universal file becomes `target`, a row of blocks per job; the levels then live in memory
+		void transcode(VkFormat target, JobSystem* jobs);
+
+	private:
+		void* data = nullptr;           // the mapping, until a transcode replaces it
+		size_t mappedSize = 0;
+		const TextureFileHeader* fileHeader = nullptr;
+		const TextureLevel* levels = nullptr;
+		const char* payload = nullptr;  // level offsets are from here
+		TextureFileHeader transcodedHeader{};
+		std::vector<TextureLevel> transcodedLevels;
+		std::vector<char> transcodedData;
+};
+
+struct TextureStreamStats
+{
+	uint64_t streamedLevels;
+	uint64_t evictedLevels;
+	uint64_t uploadedBytes;
+	uint64_t failedAllocations;
+	VkDeviceSize residentBytes;
+	VkDeviceSize budget;
+};
+
+// level whose texels come closest to one per pixel when `texels` of level 0 span `pixels` on screen
+uint32_t textureLevelForFootprint(uint32_t texels, float pixels);
+
+class TextureStreamer
+{
+	public:
+		// budgetCap: most bytes the textures may hold, 0 for the headroom alone
+		// jobs transcode universal files, nullptr to do it on the calling thread
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, QueueTimeline& timeline, VkCommandPool commandPool, \
+			DeletionQueue& deletionQueue, VkDeviceSize budgetCap, JobSystem* jobs = nullptr);
+		void destroy();
+
+		// maps the file, transcodes it if it is universal and uploads its mip tail; returns the texture id
+		uint32_t load(const std::string& path);
+		// the finest level wanted this frame; any number of calls, the finest wins
+		void request(uint32_t texture, uint32_t level);
+		// device local bytes still free, from the latest memory report
+		void setHeadroom(VkDeviceSize headroom);
+		// once a frame, after the deletion queue is tagged for it and before anything records with the views
+		void update();
+
+		// a 2D array view of the resident levels; replaced whenever they change, see generation()
+		VkImageView view(uint32_t texture) const { return textures[texture].view; }
+		uint32_t generation(uint32_t texture) const { return textures[texture].generation; }
+		uint32_t residentLevel(uint32_t texture) const { return textures[texture].residentLevel; }
+		const TextureFileHeader& header(uint32_t texture) const { return textures[texture].file->header(); }
+		// totals since the last call, resident bytes and budget as of now
+		TextureStreamStats takeStats();
+
+	private:
+		struct Texture
+		{
+			std::unique_ptr<TextureFile> file;
+			uint32_t tailLevel;         // first level that always stays
+			uint32_t residentLevel;
+			uint32_t wantedLevel;       // finest requested since the last update, levelCount if none
+			uint32_t targetLevel;       // finest requested lately
+			uint32_t prefetchedLevel;   // levels from here on were read ahead
+			uint64_t lastRequest;       // update count
+			VkImage image;
+			VkDeviceMemory memory;
+			VkImageView view;
+			VkDeviceSize bytes;
+			uint32_t generation;
+		};
+		struct Change
+		{
+			uint32_t texture;
+			uint32_t level;             // the new residentLevel
+		};
+
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		QueueTimeline* timeline = nullptr;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		DeletionQueue* deletionQueue = nullptr;
+		JobSystem* jobs = nullptr;
+		VkDeviceSize budgetCap = 0;
+		VkDeviceSize headroomLimit = 0;     // resident bytes the last headroom allows, 0 before the first report
+		uint64_t updates = 0;
+		std::vector<Texture> textures;
+		VkDeviceSize residentBytes = 0;
+		TextureStreamStats stats{};
+
+		VkDeviceSize budget() const;
+		VkDeviceSize levelBytes(const Texture& texture, uint32_t first, uint32_t end) const;
+		bool samplable(VkFormat format) const;
+		void apply(const std::vector<Change>& changes);
+};
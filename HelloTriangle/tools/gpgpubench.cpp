@@ -0,0 +1,432 @@
+// gpgpubench: compute kernels (saxpy, reduction, prefix scan, histogram) against a multithreaded CPU reference
+// usage: gpgpubench [elements]   (run from HelloTriangle/, BENT_COMPUTE_DEVICE=llvmpipe picks lavapipe)
+#include <iostream>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+#include "../benvulkan.hpp"
+#include "../compute.hpp"
+
+#define BENCH_ELEMENTS (1u << 24)
+#define BENCH_ITERATIONS 10
+#define SHADER_DIR "shaders/compute/"
+#define GROUP_SIZE 256
+#define SCAN_BLOCK 512          // elements per scan workgroup
+#define REDUCE_ITEMS 8          // ITEMS_PER_THREAD in reduce.comp
+#define HISTOGRAM_WORDS 4       // WORDS_PER_THREAD in histogram.comp
+
+using BenchClock = std::chrono::steady_clock;
+
+static double millisecondsSince(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static unsigned cpuThreads()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n ? n : 1;
+}
+
+typedef std::function<void(size_t begin, size_t end, unsigned thread)> ChunkBody;
+
+// CPU reference threads, started once in main so the timed loops don't pay for thread creation;
+// the calling thread takes chunk 0
+class CpuWorkers
+{
+	public:
+		explicit CpuWorkers(unsigned threads) : threadCount(threads)
+		{
+			for(unsigned t = 1; t < threads; t++) workers.emplace_back([this, t] { workerLoop(t); });
+		}
+		~CpuWorkers()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			wake.notify_all();
+			for(auto& worker : workers) worker.join();
+		}
+		// splits [0, count) into one contiguous chunk per thread and returns when all are done
+		void parallelFor(size_t count, const ChunkBody& body)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				job = &body;
+				jobCount = count;
+				pending = threadCount - 1;
+				generation++;
+			}
+			wake.notify_all();
+			runChunk(0);
+			std::unique_lock<std::mutex> guard(lock);
+			done.wait(guard, [this] { return pending == 0; });
+		}
+
+	private:
+		void runChunk(unsigned t)
+		{
+			size_t chunk = (jobCount + threadCount - 1) / threadCount;
+			size_t begin = std::min(jobCount, t * chunk);
+			size_t end = std::min(jobCount, begin + chunk);
+			(*job)(begin, end, t);
+		}
+		void workerLoop(unsigned t)
+		{
+			uint64_t seen = 0;
+			for(;;)
+			{
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [&] { return stopping || generation != seen; });
+					if(stopping) return;
+					seen = generation;
+				}
+				runChunk(t);
+				std::lock_guard<std::mutex> guard(lock);
+				if(--pending == 0) done.notify_one();
+			}
+		}
+
+		unsigned threadCount;
+		std::vector<std::thread> workers;
+		std::mutex lock;
+		std::condition_variable wake, done;
+		const ChunkBody* job = nullptr;
+		size_t jobCount = 0;
+		unsigned pending = 0;
+		uint64_t generation = 0;
+		bool stopping = false;
+};
+
+static CpuWorkers* cpuWorkers = nullptr;
+
+static void parallelFor(size_t count, const ChunkBody& body)
+{
+	cpuWorkers->parallelFor(count, body);
+}
+
+// records the kernel iterations times into one submit; per iteration milliseconds,
+// from timestamps when the queue has them, otherwise wall time around the submit
+static double timeGpu(ComputeContext& context, int iterations, const std::function<void(VkCommandBuffer)>& record)
+{
+	VkCommandBuffer commandBuffer = context.beginCommands();
+	context.resetTimestamps(commandBuffer);
+	context.writeTimestamp(commandBuffer, 0);
+	for(int i = 0; i < iterations; i++)
+	{
+		record(commandBuffer);
+		computeBarrier(commandBuffer);
+	}
+	context.writeTimestamp(commandBuffer, 1);
+	auto start = BenchClock::now();
+	context.submitAndWait(commandBuffer);
+	double wall = millisecondsSince(start);
+	double ms = context.hasTimestamps() ? context.timestampMilliseconds(0, 1) : wall;
+	return ms / iterations;
+}
+
+static double timeCpu(int iterations, const std::function<void()>& run)
+{
+	auto start = BenchClock::now();
+	for(int i = 0; i < iterations; i++) run();
+	return millisecondsSince(start) / iterations;
+}
+
+// one-off single iteration, used to get results for validation (and as warm-up)
+static void runOnce(ComputeContext& context, const std::function<void(VkCommandBuffer)>& record)
+{
+	VkCommandBuffer commandBuffer = context.beginCommands();
+	record(commandBuffer);
+	context.submitAndWait(commandBuffer);
+}
+
+static bool report(const char* name, double bytes, double gpuMs, double cpuMs, bool valid)
+{
+	auto gbs = [bytes](double ms) { return ms > 0.0 ? bytes / (ms * 1e6) : 0.0; };
+	printf("%-10s GPU %9.3f ms %8.2f GB/s | CPU %9.3f ms %8.2f GB/s | %s\n", \
+		name, gpuMs, gbs(gpuMs), cpuMs, gbs(cpuMs), valid ? "ok" : "MISMATCH");
+	return valid;
+}
+
+static bool benchSaxpy(ComputeContext& context, uint32_t count)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	std::vector<float> x(count), y(count);
+	for(uint32_t i = 0; i < count; i++) { x[i] = dist(rng); y[i] = dist(rng); }
+	const float a = 2.0f;
+
+	ComputeBuffer xBuffer = context.createBuffer(count * sizeof(float), false);
+	ComputeBuffer yBuffer = context.createBuffer(count * sizeof(float), false);
+	context.upload(xBuffer, x.data(), xBuffer.size);
+	context.upload(yBuffer, y.data(), yBuffer.size);
+	ComputePipeline pipeline;
+	pipeline.create(context, SHADER_DIR "saxpy.comp.spv", 2, 8);
+	VkDescriptorSet set = pipeline.makeSet({ &xBuffer, &yBuffer });
+	struct { float a; uint32_t count; } params = { a, count };
+	ComputeDispatchSize groups = computeDispatchSize(context, count, GROUP_SIZE);
+	auto record = [&](VkCommandBuffer commandBuffer) { pipeline.dispatch(commandBuffer, set, groups, &params); };
+
+	runOnce(context, record);
+	std::vector<float> result(count);
+	context.download(yBuffer, result.data(), yBuffer.size);
+	bool valid = true;
+	for(uint32_t i = 0; i < count && valid; i++)
+		valid = fabsf(result[i] - (a * x[i] + y[i])) <= 1e-5f * fabsf(a * x[i] + y[i]) + 1e-6f;
+
+	double gpuMs = timeGpu(context, BENCH_ITERATIONS, record);
+	double cpuMs = timeCpu(BENCH_ITERATIONS, [&]() {
+		parallelFor(count, [&](size_t begin, size_t end, unsigned) {
+			for(size_t i = begin; i < end; i++) y[i] = a * x[i] + y[i];
+		});
+	});
+
+	pipeline.destroy();
+	context.destroyBuffer(xBuffer);
+	context.destroyBuffer(yBuffer);
+	return report("saxpy", 3.0 * sizeof(float) * count, gpuMs, cpuMs, valid);
+}
+
+static bool benchReduce(ComputeContext& context, uint32_t count)
+{
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	std::vector<float> data(count);
+	for(auto& v : data) v = dist(rng);
+
+	const uint32_t perGroup = GROUP_SIZE * REDUCE_ITEMS;
+	uint32_t partialCount = (count + perGroup - 1) / perGroup;
+	ComputeBuffer input = context.createBuffer(count * sizeof(float), false);
+	ComputeBuffer partials[2] = {
+		context.createBuffer(partialCount * sizeof(float), false),
+		context.createBuffer(partialCount * sizeof(float), false) };
+	context.upload(input, data.data(), input.size);
+	ComputePipeline pipeline;
+	pipeline.create(context, SHADER_DIR "reduce.comp.spv", 2, 8);
+	VkDescriptorSet first = pipeline.makeSet({ &input, &partials[0] });
+	VkDescriptorSet pingPong[2] = { pipeline.makeSet({ &partials[0], &partials[1] }), pipeline.makeSet({ &partials[1], &partials[0] }) };
+
+	// passes until a single value is left, which ends up in partials[resultIndex]
+	uint32_t resultIndex = 0;
+	auto record = [&](VkCommandBuffer commandBuffer) {
+		uint32_t n = count;
+		VkDescriptorSet set = first;
+		resultIndex = 0;
+		while(true)
+		{
+			// the group count bounds the partials written, the dispatch may round it up
+			struct { uint32_t count, groupCount; } params = { n, (n + perGroup - 1) / perGroup };
+			pipeline.dispatch(commandBuffer, set, computeDispatchSize(context, n, perGroup), &params);
+			n = params.groupCount;
+			if(n == 1) break;
+			computeBarrier(commandBuffer);
+			set = pingPong[resultIndex];
+			resultIndex ^= 1;
+		}
+	};
+
+	runOnce(context, record);
+	std::vector<float> result(partialCount);
+	context.download(partials[resultIndex], result.data(), partials[resultIndex].size);
+
+	std::vector<double> threadSums(cpuThreads());
+	double cpuSum = 0.0;
+	double cpuMs = timeCpu(BENCH_ITERATIONS, [&]() {
+		parallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+			double sum = 0.0;
+			for(size_t i = begin; i < end; i++) sum += data[i];
+			threadSums[t] = sum;
+		});
+		cpuSum = 0.0;
+		for(double s : threadSums) cpuSum += s;
+	});
+	bool valid = fabs(result[0] - cpuSum) <= 1e-4 * fabs(cpuSum) + 1e-3;
+	double gpuMs = timeGpu(context, BENCH_ITERATIONS, record);
+
+	pipeline.destroy();
+	context.destroyBuffer(input);
+	context.destroyBuffer(partials[0]);
+	context.destroyBuffer(partials[1]);
+	return report("reduce", (double)sizeof(float) * count, gpuMs, cpuMs, valid);
+}
+
+static bool benchScan(ComputeContext& context, uint32_t count)
+{
+	std::mt19937 rng(3);
+	std::vector<uint32_t> data(count);
+	for(auto& v : data) v = rng() & 15;
+
+	ComputePipeline scan, add;
+	scan.create(context, SHADER_DIR "scan.comp.spv", 3, 8);
+	add.create(context, SHADER_DIR "scanadd.comp.spv", 2, 8);
+
+	// level 0 scans the data in blocks, every further level scans the block totals of the one below;
+	// the block count bounds the sums written, the dispatch may round it up
+	struct ScanParams { uint32_t count, groupCount; };
+	struct Level { ScanParams params; ComputeBuffer input, output; VkDescriptorSet scanSet; };
+	std::vector<Level> levels;
+	std::vector<ComputeBuffer> buffers;
+	ComputeBuffer input = context.createBuffer(count * sizeof(uint32_t), false);
+	ComputeBuffer output = context.createBuffer(count * sizeof(uint32_t), false);
+	buffers.push_back(input);
+	buffers.push_back(output);
+	context.upload(input, data.data(), input.size);
+	uint32_t n = count;
+	while(true)
+	{
+		uint32_t blocks = (n + SCAN_BLOCK - 1) / SCAN_BLOCK;
+		ComputeBuffer sums = context.createBuffer(blocks * sizeof(uint32_t), false);
+		buffers.push_back(sums);
+		levels.push_back({ { n, blocks }, input, output, scan.makeSet({ &input, &output, &sums }) });
+		if(blocks == 1) break;
+		input = sums;
+		output = context.createBuffer(blocks * sizeof(uint32_t), false);
+		buffers.push_back(output);
+		n = blocks;
+	}
+	std::vector<VkDescriptorSet> addSets;
+	for(size_t i = 0; i + 1 < levels.size(); i++) addSets.push_back(add.makeSet({ &levels[i].output, &levels[i + 1].output }));
+
+	auto record = [&](VkCommandBuffer commandBuffer) {
+		for(auto& level : levels)
+		{
+			scan.dispatch(commandBuffer, level.scanSet, computeDispatchSize(context, level.params.count, SCAN_BLOCK), &level.params);
+			computeBarrier(commandBuffer);
+		}
+		for(size_t i = levels.size() - 1; i-- > 0;)
+		{
+			add.dispatch(commandBuffer, addSets[i], computeDispatchSize(context, levels[i].params.count, SCAN_BLOCK), \
+				&levels[i].params);
+			computeBarrier(commandBuffer);
+		}
+	};
+
+	runOnce(context, record);
+	std::vector<uint32_t> result(count);
+	context.download(levels[0].output, result.data(), levels[0].output.size);
+
+	// exclusive scan in two passes: chunk totals, then each chunk from its offset
+	std::vector<uint32_t> expected(count);
+	std::vector<uint32_t> chunkOffsets(cpuThreads());
+	double cpuMs = timeCpu(BENCH_ITERATIONS, [&]() {
+		parallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+			uint32_t sum = 0;
+			for(size_t i = begin; i < end; i++) sum += data[i];
+			chunkOffsets[t] = sum;
+		});
+		uint32_t running = 0;
+		for(auto& offset : chunkOffsets) { uint32_t sum = offset; offset = running; running += sum; }
+		parallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+			uint32_t sum = chunkOffsets[t];
+			for(size_t i = begin; i < end; i++) { expected[i] = sum; sum += data[i]; }
+		});
+	});
+	bool valid = result == expected;
+	double gpuMs = timeGpu(context, BENCH_ITERATIONS, record);
+
+	scan.destroy();
+	add.destroy();
+	for(auto& buffer : buffers) context.destroyBuffer(buffer);
+	return report("scan", 2.0 * sizeof(uint32_t) * count, gpuMs, cpuMs, valid);
+}
+
+static bool benchHistogram(ComputeContext& context, uint32_t count)
+{
+	std::mt19937 rng(4);
+	std::vector<uint32_t> words(count);
+	for(auto& w : words) w = rng();
+
+	ComputeBuffer input = context.createBuffer(count * sizeof(uint32_t), false);
+	ComputeBuffer bins = context.createBuffer(256 * sizeof(uint32_t), false);
+	context.upload(input, words.data(), input.size);
+	ComputePipeline pipeline;
+	pipeline.create(context, SHADER_DIR "histogram.comp.spv", 2, 4);
+	VkDescriptorSet set = pipeline.makeSet({ &input, &bins });
+	ComputeDispatchSize groups = computeDispatchSize(context, count, GROUP_SIZE * HISTOGRAM_WORDS);
+	auto record = [&](VkCommandBuffer commandBuffer) {
+		vkCmdFillBuffer(commandBuffer, bins.buffer, 0, VK_WHOLE_SIZE, 0);
+		transferToComputeBarrier(commandBuffer);
+		pipeline.dispatch(commandBuffer, set, groups, &count);
+		computeToTransferBarrier(commandBuffer);
+	};
+
+	runOnce(context, record);
+	std::vector<uint32_t> result(256);
+	context.download(bins, result.data(), bins.size);
+
+	std::vector<uint32_t> threadBins(cpuThreads() * 256);
+	std::vector<uint32_t> expected(256);
+	double cpuMs = timeCpu(BENCH_ITERATIONS, [&]() {
+		parallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+			uint32_t* local = &threadBins[t * 256];
+			memset(local, 0, 256 * sizeof(uint32_t));
+			for(size_t i = begin; i < end; i++)
+			{
+				uint32_t w = words[i];
+				local[w & 0xFF]++;
+				local[(w >> 8) & 0xFF]++;
+				local[(w >> 16) & 0xFF]++;
+				local[w >> 24]++;
+			}
+		});
+		std::fill(expected.begin(), expected.end(), 0);
+		for(size_t i = 0; i < threadBins.size(); i++) expected[i & 255] += threadBins[i];
+	});
+	bool valid = result == expected;
+	double gpuMs = timeGpu(context, BENCH_ITERATIONS, record);
+
+	pipeline.destroy();
+	context.destroyBuffer(input);
+	context.destroyBuffer(bins);
+	return report("histogram", (double)sizeof(uint32_t) * count, gpuMs, cpuMs, valid);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : BENCH_ELEMENTS;
+	if(count == 0)
+	{
+		std::cerr << "usage: gpgpubench [elements]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	logStart(getenv("BENT_LOG_FILE"));
+	CpuWorkers workers(cpuThreads());
+	cpuWorkers = &workers;
+	bool valid = true;
+	ComputeContext context;
+	try
+	{
+		context.initHeadless(enableValidationLayers);
+		printf("%s: %u elements, %d iterations, %u CPU threads, %s\n", context.properties.deviceName, count, \
+			BENCH_ITERATIONS, cpuThreads(), context.hasTimestamps() ? "GPU timestamps" : "wall clock timing");
+		valid &= benchSaxpy(context, count);
+		valid &= benchReduce(context, count);
+		valid &= benchScan(context, count);
+		valid &= benchHistogram(context, count);
+		context.destroy();
+	}
+	catch (const std::exception& e)
+	{
+		logStop();
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	logStop();
+	return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+#include "json.hpp"
+
+static const JsonValue jsonNull;
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+	if(type != Object) return jsonNull;
+	auto it = object.find(key);
+	return it == object.end() ? jsonNull : it->second;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if(type != Array || index >= array.size()) return jsonNull;
+	return array[index];
+}
+
+struct JsonParser
+{
+	const char* p;
+	const char* end;
+	const char* begin;
+
+	[[noreturn]] void fail(const char* what)
+	{
+		throw std::runtime_error(std::string("JSON error at byte ") + std::to_string(p - begin) + ": " + what + "\n");
+	}
+	void skipSpace()
+	{
+		while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+	}
+	void expect(char c)
+	{
+		skipSpace();
+		if(p >= end || *p != c) fail("unexpected character");
+		p++;
+	}
+	static void appendUtf8(std::string& out, unsigned cp)
+	{
+		if(cp < 0x80) out += (char)cp;
+		else if(cp < 0x800) { out += (char)(0xC0 | (cp >> 6)); out += (char)(0x80 | (cp & 0x3F)); }
+		else if(cp < 0x10000) { out += (char)(0xE0 | (cp >> 12)); out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+		else { out += (char)(0xF0 | (cp >> 18)); out += (char)(0x80 | ((cp >> 12) & 0x3F)); out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+	}
+	unsigned hex4()
+	{
+		if(end - p < 4) fail("short unicode escape");
+		char buf[5] = { p[0], p[1], p[2], p[3], 0 };
+		p += 4;
+		return (unsigned)strtoul(buf, nullptr, 16);
+	}
+	std::string parseString()
+	{
+		expect('"');
+		std::string out;
+		while(p < end && *p != '"')
+		{
+			char c = *p++;
+			if(c != '\\') { out += c; continue; }
+			if(p >= end) fail("unterminated escape");
+			c = *p++;
+			switch(c)
+			{
+				case 'n': out += '\n'; break;
+				case 't': out += '\t'; break;
+				case 'r': out += '\r'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'u':
+				{
+					unsigned cp = hex4();
+					// surrogate pair
+					if(cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+					{
+						p += 2;
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (hex4() - 0xDC00);
+					}
+					appendUtf8(out, cp);
+					break;
+				}
+				default: out += c; break; // \" \\ \/
+			}
+		}
+		if(p >= end) fail("unterminated string");
+		p++;
+		return out;
+	}
+	JsonValue parseValue()
+	{
+		skipSpace();
+		if(p >= end) fail("unexpected end of input");
+		JsonValue v;
+		if(*p == '{')
+		{
+			p++;
+			v.type = JsonValue::Object;
+			skipSpace();
+			if(p < end && *p == '}') { p++; return v; }
+			for(;;)
+			{
+				std::string key = parseString();
+				expect(':');
+				v.object[key] = parseValue();
+				skipSpace();
+				if(p < end && *p == ',') { p++; continue; }
+				expect('}');
+				return v;
+			}
+		}
+		if(*p == '[')
+		{
+			p++;
+			v.type = JsonValue::Array;
+			skipSpace();
+			if(p < end && *p == ']') { p++; return v; }
+			for(;;)
+			{
+				v.array.push_back(parseValue());
+				skipSpace();
+				if(p < end && *p == ',') { p++; continue; }
+				expect(']');
+				return v;
+			}
+		}
+		if(*p == '"')
+		{
+			v.type = JsonValue::String;
+			v.string = parseString();
+			return v;
+		}
+		if(end - p >= 4 && strncmp(p, "true", 4) == 0) { p += 4; v.type = JsonValue::Bool; v.boolean = true; return v; }
+		if(end - p >= 5 && strncmp(p, "false", 5) == 0) { p += 5; v.type = JsonValue::Bool; return v; }
+		if(end - p >= 4 && strncmp(p, "null", 4) == 0) { p += 4; return v; }
+		// number: copy the token so strtod can't run past the buffer
+		const char* start = p;
+		while(p < end && strchr("+-0123456789.eE", *p)) p++;
+		if(p == start) fail("unexpected character");
+		std::string token(start, p);
+		v.type = JsonValue::Number;
+		v.number = strtod(token.c_str(), nullptr);
+		return v;
+	}
+};
+
+JsonValue parseJson(const char* text, size_t length)
+{
+	JsonParser parser{ text, text + length, text };
+	JsonValue root = parser.parseValue();
+	parser.skipSpace();
+	if(parser.p != parser.end) parser.fail("trailing characters");
+	return root;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+// Minimal JSON DOM, just enough for reading glTF in the offline tools.
+// Never used at runtime.
+struct JsonValue
+{
+	enum Type { Null, Bool, Number, String, Array, Object };
+	Type type = Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+
+	bool has(const std::string& key) const { return type == Object && object.count(key) != 0; }
+	// missing keys and out of range indices return a shared null value
+	const JsonValue& operator[](const std::string& key) const;
+	const JsonValue& operator[](size_t index) const;
+	size_t size() const { return type == Array ? array.size() : object.size(); }
+	double num(double fallback = 0.0) const { return type == Number ? number : fallback; }
+	int integer(int fallback = -1) const { return type == Number ? (int)number : fallback; }
+};
+
+// throws std::runtime_error with the byte offset on malformed input
+JsonValue parseJson(const char* text, size_t length);
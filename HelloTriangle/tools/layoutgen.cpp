@@ -0,0 +1,17 @@
+// layoutgen: emits the GLSL vertex inputs and decodeVertex() for one layout from vertexlayout.cpp
+// usage: layoutgen <layout name>  (GLSL goes to stdout)
+#include <iostream>
+
+#include "../vertexlayout.hpp"
+
+int main(int argc, char** argv)
+{
+	uint32_t id;
+	if(argc != 2 || !findVertexLayout(argv[1], id))
+	{
+		std::cerr << "usage: layoutgen <full|compact|half>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << generateVertexLayoutGlsl(getVertexLayout(id));
+	return EXIT_SUCCESS;
+}
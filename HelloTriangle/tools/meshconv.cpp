@@ -0,0 +1,243 @@
+// meshconv: offline OBJ/glTF -> .bmesh converter
+// usage: meshconv [--layout full|compact|half] <input.obj|input.gltf|input.glb> <output.bmesh>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "meshimport.hpp"
+#include "meshopt.hpp"
+#include "meshsimplify.hpp"
+#include "../vertexlayout.hpp"
+
+#define LOD_REDUCTION 0.5f      // each LOD aims for this fraction of the previous one's triangles
+#define LOD_MIN_TRIANGLES 64    // no LOD below this
+#define LOD_MIN_SHRINK 0.9f     // stop once a level keeps more than this fraction, simplification is stuck
+#define LOD_MAX_ERROR 0.1f      // per level, relative to the bounding sphere radius
+
+// collects section payloads, then lays them out aligned behind the header and section table
+struct MeshBlobWriter
+{
+	struct Pending { uint32_t type; std::vector<char> bytes; };
+	std::vector<Pending> pending;
+
+	void add(MeshSectionType type, const void* data, size_t size)
+	{
+		Pending p{ type, std::vector<char>((const char*)data, (const char*)data + size) };
+		pending.push_back(std::move(p));
+	}
+
+	void write(const std::string& path, MeshFileHeader header)
+	{
+		auto align = [](uint64_t v) { return (v + MESH_SECTION_ALIGN - 1) / MESH_SECTION_ALIGN * MESH_SECTION_ALIGN; };
+		std::vector<MeshSection> table(pending.size());
+		uint64_t offset = align(sizeof(MeshFileHeader) + sizeof(MeshSection) * pending.size());
+		for(size_t i = 0; i < pending.size(); i++)
+		{
+			table[i].type = pending[i].type;
+			table[i].reserved = 0;
+			table[i].offset = offset;
+			table[i].size = pending[i].bytes.size();
+			offset = align(offset + table[i].size);
+		}
+		header.magic = MESH_MAGIC;
+		header.version = MESH_VERSION;
+		header.headerSize = sizeof(MeshFileHeader);
+		header.sectionCount = (uint32_t)pending.size();
+		header.fileSize = offset;
+
+		std::vector<char> blob(offset, 0);
+		memcpy(blob.data(), &header, sizeof(header));
+		memcpy(blob.data() + sizeof(header), table.data(), sizeof(MeshSection) * table.size());
+		for(size_t i = 0; i < pending.size(); i++)
+			memcpy(blob.data() + table[i].offset, pending[i].bytes.data(), pending[i].bytes.size());
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if(!file.is_open()) throw std::runtime_error("Couldn't write " + path + "\n");
+		file.write(blob.data(), blob.size());
+	}
+};
+
+// greedy meshlet split in index order: close a meshlet when either limit would overflow
+static void buildMeshlets(const std::vector<MeshVertex>& vertices, const uint32_t* indices, size_t indexCount, \
+	std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles)
+{
+	std::vector<int> local(vertices.size(), -1); // mesh vertex -> slot in the open meshlet
+	Meshlet current{};
+	current.vertexOffset = (uint32_t)meshletVertices.size();
+	current.triangleOffset = (uint32_t)meshletTriangles.size();
+
+	auto finish = [&]()
+	{
+		if(current.triangleCount == 0) return;
+		// bounding sphere: AABB center, radius to the farthest vertex
+		float lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for(uint32_t i = 0; i < current.vertexCount; i++)
+		{
+			const float* p = vertices[meshletVertices[current.vertexOffset + i]].position;
+			for(int k = 0; k < 3; k++) { lo[k] = std::min(lo[k], p[k]); hi[k] = std::max(hi[k], p[k]); }
+		}
+		for(int k = 0; k < 3; k++) current.center[k] = (lo[k] + hi[k]) * 0.5f;
+		float r2 = 0.0f;
+		for(uint32_t i = 0; i < current.vertexCount; i++)
+		{
+			const float* p = vertices[meshletVertices[current.vertexOffset + i]].position;
+			float d[3] = { p[0] - current.center[0], p[1] - current.center[1], p[2] - current.center[2] };
+			r2 = std::max(r2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		}
+		current.radius = sqrtf(r2);
+		for(uint32_t i = 0; i < current.vertexCount; i++) local[meshletVertices[current.vertexOffset + i]] = -1;
+		meshlets.push_back(current);
+		current = Meshlet{};
+		current.vertexOffset = (uint32_t)meshletVertices.size();
+		current.triangleOffset = (uint32_t)meshletTriangles.size();
+	};
+
+	for(size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		uint32_t newVerts = 0;
+		for(int k = 0; k < 3; k++) if(local[indices[t + k]] < 0) newVerts++;
+		if(current.vertexCount + newVerts > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+			finish();
+		for(int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t + k];
+			if(local[v] < 0)
+			{
+				local[v] = (int)current.vertexCount++;
+				meshletVertices.push_back(v);
+			}
+			meshletTriangles.push_back((uint8_t)local[v]);
+		}
+		current.triangleCount++;
+	}
+	finish();
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t layoutId = VERTEX_LAYOUT_COMPACT;
+	int arg = 1;
+	if(argc == 5 && strcmp(argv[1], "--layout") == 0)
+	{
+		if(!findVertexLayout(argv[2], layoutId))
+		{
+			std::cerr << "meshconv: unknown vertex layout " << argv[2] << std::endl;
+			return EXIT_FAILURE;
+		}
+		arg = 3;
+	}
+	else if(argc != 3)
+	{
+		std::cerr << "usage: meshconv [--layout full|compact|half] <input.obj|input.gltf|input.glb> <output.bmesh>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const char* input = argv[arg];
+	const char* output = argv[arg + 1];
+	try
+	{
+		ImportedMesh mesh = importMesh(input);
+		if(mesh.indices.empty()) throw std::runtime_error("Mesh has no triangles\n");
+
+		// reorder for the post-transform cache, then overdraw, then renumber vertices for fetch locality
+		VertexCacheStats before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices);
+		optimizeVertexFetch(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+		VertexCacheStats after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		printf("meshconv: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (FIFO %d)\n", before.acmr, after.acmr, \
+			before.atvr, after.atvr, MESHOPT_CACHE_SIZE);
+
+		const VertexLayout& layout = getVertexLayout(layoutId);
+		VertexQuantization quant = computeVertexQuantization(layout, mesh.vertices.data(), mesh.vertices.size());
+
+		MeshFileHeader header{};
+		header.vertexCount = (uint32_t)mesh.vertices.size();
+		header.vertexStride = layout.stride;
+		header.vertexLayout = layoutId;
+		memcpy(header.positionScale, quant.positionScale, sizeof(header.positionScale));
+		memcpy(header.positionOffset, quant.positionOffset, sizeof(header.positionOffset));
+		memcpy(header.uvScale, quant.uvScale, sizeof(header.uvScale));
+		memcpy(header.uvOffset, quant.uvOffset, sizeof(header.uvOffset));
+		header.indexSize = header.vertexCount <= 65536 ? 2 : 4;
+		for(int k = 0; k < 3; k++) { header.boundsMin[k] = INFINITY; header.boundsMax[k] = -INFINITY; }
+		for(const auto& v : mesh.vertices)
+			for(int k = 0; k < 3; k++)
+			{
+				header.boundsMin[k] = std::min(header.boundsMin[k], v.position[k]);
+				header.boundsMax[k] = std::max(header.boundsMax[k], v.position[k]);
+			}
+
+		// LOD chain: each level simplified from the one before, so errors add up along the chain;
+		// the coarser levels reuse LOD 0's vertices and only add indices
+		float radius = 0.0f;
+		for(int k = 0; k < 3; k++) radius += (header.boundsMax[k] - header.boundsMin[k]) * (header.boundsMax[k] - header.boundsMin[k]);
+		radius = sqrtf(radius) * 0.5f;
+		std::vector<std::vector<uint32_t>> lodIndices(1, mesh.indices);
+		std::vector<float> lodErrors(1, 0.0f);
+		while(lodIndices.size() < MESH_MAX_LODS)
+		{
+			const std::vector<uint32_t>& previous = lodIndices.back();
+			size_t target = (size_t)(previous.size() / 3 * LOD_REDUCTION) * 3;
+			if(target < LOD_MIN_TRIANGLES * 3) break;
+			float error = 0.0f;
+			std::vector<uint32_t> simplified = simplifyMesh(mesh.vertices, previous.data(), previous.size(), target, \
+				radius * LOD_MAX_ERROR, &error);
+			if(simplified.empty() || simplified.size() > previous.size() * LOD_MIN_SHRINK) break;
+			optimizeVertexCache(simplified.data(), simplified.size(), mesh.vertices.size());
+			optimizeOverdraw(simplified.data(), simplified.size(), mesh.vertices);
+			lodErrors.push_back(lodErrors.back() + error);
+			lodIndices.push_back(std::move(simplified));
+		}
+
+		std::vector<uint32_t> indices;
+		std::vector<MeshLod> lods(lodIndices.size());
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		for(size_t l = 0; l < lods.size(); l++)
+		{
+			lods[l].indexOffset = (uint32_t)indices.size();
+			lods[l].indexCount = (uint32_t)lodIndices[l].size();
+			lods[l].meshletOffset = (uint32_t)meshlets.size();
+			buildMeshlets(mesh.vertices, lodIndices[l].data(), lodIndices[l].size(), meshlets, meshletVertices, meshletTriangles);
+			lods[l].meshletCount = (uint32_t)meshlets.size() - lods[l].meshletOffset;
+			lods[l].error = lodErrors[l];
+			indices.insert(indices.end(), lodIndices[l].begin(), lodIndices[l].end());
+			printf("meshconv: LOD %zu: %u triangles, error %g\n", l, lods[l].indexCount / 3, lods[l].error);
+		}
+		header.indexCount = (uint32_t)indices.size();
+		header.lodCount = (uint32_t)lods.size();
+		header.meshletCount = (uint32_t)meshlets.size();
+
+		MeshBlobWriter writer;
+		std::vector<char> packed((size_t)layout.stride * mesh.vertices.size());
+		for(size_t i = 0; i < mesh.vertices.size(); i++)
+			packVertex(layout, quant, mesh.vertices[i], &packed[i * layout.stride]);
+		writer.add(MESH_SECTION_VERTICES, packed.data(), packed.size());
+		if(header.indexSize == 2)
+		{
+			std::vector<uint16_t> narrow(indices.begin(), indices.end());
+			writer.add(MESH_SECTION_INDICES, narrow.data(), narrow.size() * sizeof(uint16_t));
+		}
+		else
+			writer.add(MESH_SECTION_INDICES, indices.data(), indices.size() * sizeof(uint32_t));
+		writer.add(MESH_SECTION_LODS, lods.data(), lods.size() * sizeof(MeshLod));
+		writer.add(MESH_SECTION_MESHLETS, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+		writer.add(MESH_SECTION_MESHLET_VERTICES, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+		writer.add(MESH_SECTION_MESHLET_TRIANGLES, meshletTriangles.data(), meshletTriangles.size());
+		writer.write(output, header);
+
+		printf("meshconv: %s -> %s: %u vertices (%s, %u bytes each), %u triangles, %u LODs, %u meshlets\n", input, \
+			output, header.vertexCount, layout.name, layout.stride, lods[0].indexCount / 3, header.lodCount, header.meshletCount);
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
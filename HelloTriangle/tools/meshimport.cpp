@@ -0,0 +1,527 @@
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+#include "meshimport.hpp"
+#include "json.hpp"
+
+static std::vector<char> readFile(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	if(!file.is_open()) throw std::runtime_error("Couldn't open file " + filename + "\n");
+	size_t filesize = (size_t)file.tellg();
+	std::vector<char> buffer(filesize);
+	file.seekg(0);
+	file.read(buffer.data(), filesize);
+	return buffer;
+}
+
+static std::string directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// smooth normals from area weighted face normals for the vertices that came without one;
+// imported normals stay as they are
+static void generateNormals(ImportedMesh& mesh, const std::vector<bool>& missing)
+{
+	for(size_t i = 0; i < mesh.vertices.size(); i++)
+		if(missing[i]) mesh.vertices[i].normal[0] = mesh.vertices[i].normal[1] = mesh.vertices[i].normal[2] = 0.0f;
+	for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const float* a = mesh.vertices[mesh.indices[i + 0]].position;
+		const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+		const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		for(int k = 0; k < 3; k++)
+			if(missing[mesh.indices[i + k]])
+				for(int j = 0; j < 3; j++) mesh.vertices[mesh.indices[i + k]].normal[j] += n[j];
+	}
+	for(size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		if(!missing[i]) continue;
+		MeshVertex& v = mesh.vertices[i];
+		float len = sqrtf(v.normal[0] * v.normal[0] + v.normal[1] * v.normal[1] + v.normal[2] * v.normal[2]);
+		if(len > 0.0f) for(int j = 0; j < 3; j++) v.normal[j] /= len;
+		else { v.normal[0] = 0.0f; v.normal[1] = 1.0f; v.normal[2] = 0.0f; }
+	}
+}
+
+// * OBJ * //
+
+// resolve a 1-based (or negative, relative) OBJ index
+static int objIndex(const char* s, int count)
+{
+	int i = atoi(s);
+	if(i < 0) return count + i;
+	return i - 1;
+}
+
+ImportedMesh importObj(const std::string& path)
+{
+	std::ifstream file(path);
+	if(!file.is_open()) throw std::runtime_error("Couldn't open file " + path + "\n");
+
+	std::vector<float> positions, normals, uvs, colors;
+	ImportedMesh mesh;
+	std::vector<bool> missingNormals; // per output vertex
+	// identical v/vt/vn triples share one output vertex
+	struct Key { int v, t, n; bool operator==(const Key& o) const { return v == o.v && t == o.t && n == o.n; } };
+	struct KeyHash { size_t operator()(const Key& k) const { return ((size_t)k.v * 73856093u) ^ ((size_t)k.t * 19349663u) ^ ((size_t)k.n * 83492791u); } };
+	std::unordered_map<Key, uint32_t, KeyHash> lookup;
+
+	std::string line;
+	std::vector<uint32_t> face;
+	while(std::getline(file, line))
+	{
+		const char* s = line.c_str();
+		while(*s == ' ' || *s == '\t') s++;
+		if(s[0] == 'v' && s[1] == ' ')
+		{
+			// "v x y z [r g b]", vertex colors are a common extension
+			float x = 0, y = 0, z = 0, r = 1, g = 1, b = 1;
+			sscanf(s + 2, "%f %f %f %f %f %f", &x, &y, &z, &r, &g, &b);
+			positions.insert(positions.end(), { x, y, z });
+			colors.insert(colors.end(), { r, g, b });
+		}
+		else if(s[0] == 'v' && s[1] == 'n')
+		{
+			float x = 0, y = 0, z = 0;
+			sscanf(s + 3, "%f %f %f", &x, &y, &z);
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if(s[0] == 'v' && s[1] == 't')
+		{
+			float u = 0, v = 0;
+			sscanf(s + 3, "%f %f", &u, &v);
+			uvs.insert(uvs.end(), { u, v });
+		}
+		else if(s[0] == 'f' && s[1] == ' ')
+		{
+			face.clear();
+			std::istringstream tokens(s + 2);
+			std::string token;
+			while(tokens >> token)
+			{
+				Key k{ -1, -1, -1 };
+				k.v = objIndex(token.c_str(), (int)positions.size() / 3);
+				size_t slash = token.find('/');
+				if(slash != std::string::npos)
+				{
+					if(slash + 1 < token.size() && token[slash + 1] != '/')
+						k.t = objIndex(token.c_str() + slash + 1, (int)uvs.size() / 2);
+					size_t slash2 = token.find('/', slash + 1);
+					if(slash2 != std::string::npos && slash2 + 1 < token.size())
+						k.n = objIndex(token.c_str() + slash2 + 1, (int)normals.size() / 3);
+				}
+				if(k.v < 0 || k.v >= (int)positions.size() / 3)
+					throw std::runtime_error("OBJ face references a missing vertex in " + path + "\n");
+
+				auto it = lookup.find(k);
+				if(it != lookup.end()) { face.push_back(it->second); continue; }
+				MeshVertex vertex{};
+				memcpy(vertex.position, &positions[k.v * 3], sizeof(vertex.position));
+				memcpy(vertex.color, &colors[k.v * 3], 3 * sizeof(float));
+				vertex.color[3] = 1.0f;
+				if(k.n >= 0 && k.n < (int)normals.size() / 3) memcpy(vertex.normal, &normals[k.n * 3], sizeof(vertex.normal));
+				if(k.t >= 0 && k.t < (int)uvs.size() / 2)
+				{
+					vertex.uv[0] = uvs[k.t * 2];
+					vertex.uv[1] = 1.0f - uvs[k.t * 2 + 1]; // OBJ has v pointing up, Vulkan samples top down
+				}
+				uint32_t index = (uint32_t)mesh.vertices.size();
+				mesh.vertices.push_back(vertex);
+				missingNormals.push_back(k.n < 0 || k.n >= (int)normals.size() / 3);
+				lookup.emplace(k, index);
+				face.push_back(index);
+			}
+			// triangulate polygons as a fan
+			for(size_t i = 2; i < face.size(); i++)
+				mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+		}
+	}
+	if(std::find(missingNormals.begin(), missingNormals.end(), true) != missingNormals.end())
+		generateNormals(mesh, missingNormals);
+	return mesh;
+}
+
+// * glTF * //
+
+#define GLB_MAGIC 0x46546C67u      // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+
+struct GltfDocument
+{
+	JsonValue json;
+	std::vector<std::vector<char>> buffers;
+};
+
+static std::vector<char> decodeBase64(const std::string& text)
+{
+	static int8_t table[256];
+	static bool init = false;
+	if(!init)
+	{
+		memset(table, -1, sizeof(table));
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		for(int i = 0; i < 64; i++) table[(uint8_t)alphabet[i]] = (int8_t)i;
+		init = true;
+	}
+	std::vector<char> out;
+	uint32_t accum = 0;
+	int bits = 0;
+	for(char c : text)
+	{
+		int8_t v = table[(uint8_t)c];
+		if(v < 0) continue; // padding and whitespace
+		accum = (accum << 6) | (uint32_t)v;
+		bits += 6;
+		if(bits >= 8)
+		{
+			bits -= 8;
+			out.push_back((char)((accum >> bits) & 0xFF));
+		}
+	}
+	return out;
+}
+
+static GltfDocument loadGltfDocument(const std::string& path)
+{
+	GltfDocument doc;
+	std::vector<char> file = readFile(path);
+	std::vector<char> binChunk;
+	bool haveBin = false;
+
+	uint32_t magic = 0;
+	if(file.size() >= 4) memcpy(&magic, file.data(), 4);
+	if(magic == GLB_MAGIC)
+	{
+		// 12 byte header, then JSON chunk, then optional BIN chunk
+		size_t offset = 12;
+		bool haveJson = false;
+		while(offset + 8 <= file.size())
+		{
+			uint32_t chunkLength, chunkType;
+			memcpy(&chunkLength, &file[offset], 4);
+			memcpy(&chunkType, &file[offset + 4], 4);
+			offset += 8;
+			if(offset + chunkLength > file.size()) throw std::runtime_error("Truncated GLB chunk in " + path + "\n");
+			if(chunkType == GLB_CHUNK_JSON && !haveJson)
+			{
+				doc.json = parseJson(&file[offset], chunkLength);
+				haveJson = true;
+			}
+			else if(chunkType == GLB_CHUNK_BIN && !haveBin)
+			{
+				binChunk.assign(file.begin() + offset, file.begin() + offset + chunkLength);
+				haveBin = true;
+			}
+			offset += chunkLength;
+		}
+		if(!haveJson) throw std::runtime_error("GLB without JSON chunk: " + path + "\n");
+	}
+	else
+		doc.json = parseJson(file.data(), file.size());
+
+	const JsonValue& buffers = doc.json["buffers"];
+	for(size_t i = 0; i < buffers.size(); i++)
+	{
+		const JsonValue& uri = buffers[i]["uri"];
+		if(uri.type != JsonValue::String)
+		{
+			if(!haveBin) throw std::runtime_error("glTF buffer without uri outside a GLB: " + path + "\n");
+			doc.buffers.push_back(binChunk);
+		}
+		else if(uri.string.compare(0, 5, "data:") == 0)
+		{
+			size_t comma = uri.string.find(',');
+			if(comma == std::string::npos || uri.string.rfind(";base64", comma) == std::string::npos)
+				throw std::runtime_error("Unsupported glTF data uri in " + path + "\n");
+			doc.buffers.push_back(decodeBase64(uri.string.substr(comma + 1)));
+		}
+		else
+		{
+			// relative path, undo percent encoding
+			std::string name;
+			for(size_t c = 0; c < uri.string.size(); c++)
+			{
+				if(uri.string[c] == '%' && c + 2 < uri.string.size())
+				{
+					name += (char)strtol(uri.string.substr(c + 1, 2).c_str(), nullptr, 16);
+					c += 2;
+				}
+				else name += uri.string[c];
+			}
+			doc.buffers.push_back(readFile(directoryOf(path) + name));
+		}
+	}
+	return doc;
+}
+
+static int componentCount(const std::string& type)
+{
+	if(type == "SCALAR") return 1;
+	if(type == "VEC2") return 2;
+	if(type == "VEC3") return 3;
+	if(type == "VEC4") return 4;
+	if(type == "MAT4") return 16;
+	return 0;
+}
+
+static int componentSize(int componentType)
+{
+	switch(componentType)
+	{
+		case 5120: case 5121: return 1; // (unsigned) byte
+		case 5122: case 5123: return 2; // (unsigned) short
+		case 5125: case 5126: return 4; // unsigned int, float
+	}
+	return 0;
+}
+
+// typed view over one accessor; element() converts any component type to float
+struct GltfAccessor
+{
+	const char* data = nullptr;
+	size_t count = 0;
+	size_t stride = 0;
+	int components = 0;
+	int componentType = 0;
+	bool normalized = false;
+
+	float component(size_t i, int c) const
+	{
+		const char* p = data + i * stride + c * componentSize(componentType);
+		switch(componentType)
+		{
+			case 5126: { float f; memcpy(&f, p, 4); return f; }
+			case 5125: { uint32_t u; memcpy(&u, p, 4); return (float)u; }
+			case 5123: { uint16_t u; memcpy(&u, p, 2); return normalized ? u / 65535.0f : (float)u; }
+			case 5122: { int16_t s; memcpy(&s, p, 2); return normalized ? std::max(s / 32767.0f, -1.0f) : (float)s; }
+			case 5121: { uint8_t u = (uint8_t)*p; return normalized ? u / 255.0f : (float)u; }
+			case 5120: { int8_t s = (int8_t)*p; return normalized ? std::max(s / 127.0f, -1.0f) : (float)s; }
+		}
+		return 0.0f;
+	}
+	uint32_t index(size_t i) const
+	{
+		const char* p = data + i * stride;
+		switch(componentType)
+		{
+			case 5125: { uint32_t u; memcpy(&u, p, 4); return u; }
+			case 5123: { uint16_t u; memcpy(&u, p, 2); return u; }
+			case 5121: return (uint8_t)*p;
+		}
+		throw std::runtime_error("Unsupported glTF index component type\n");
+	}
+};
+
+static GltfAccessor getAccessor(const GltfDocument& doc, int accessorIndex)
+{
+	const JsonValue& acc = doc.json["accessors"][(size_t)accessorIndex];
+	if(acc.type != JsonValue::Object) throw std::runtime_error("Missing glTF accessor\n");
+	if(acc.has("sparse")) throw std::runtime_error("Sparse glTF accessors are not supported\n");
+	GltfAccessor a;
+	a.count = (size_t)acc["count"].num();
+	a.components = componentCount(acc["type"].string);
+	a.componentType = acc["componentType"].integer();
+	a.normalized = acc["normalized"].boolean;
+	size_t elementSize = (size_t)a.components * componentSize(a.componentType);
+	if(elementSize == 0) throw std::runtime_error("Unsupported glTF accessor type\n");
+
+	const JsonValue& view = doc.json["bufferViews"][(size_t)acc["bufferView"].integer()];
+	int bufferIndex = view["buffer"].integer();
+	if(bufferIndex < 0 || bufferIndex >= (int)doc.buffers.size()) throw std::runtime_error("Bad glTF buffer view\n");
+	const std::vector<char>& buffer = doc.buffers[bufferIndex];
+	size_t offset = (size_t)view["byteOffset"].num() + (size_t)acc["byteOffset"].num();
+	a.stride = view.has("byteStride") ? (size_t)view["byteStride"].num() : elementSize;
+	if(a.count && offset + (a.count - 1) * a.stride + elementSize > buffer.size())
+		throw std::runtime_error("glTF accessor runs past the end of its buffer\n");
+	a.data = buffer.data() + offset;
+	return a;
+}
+
+// column-major 4x4 helpers for node transforms
+static void mat4Multiply(const float* a, const float* b, float* out)
+{
+	float r[16];
+	for(int c = 0; c < 4; c++)
+		for(int row = 0; row < 4; row++)
+			r[c * 4 + row] = a[0 * 4 + row] * b[c * 4 + 0] + a[1 * 4 + row] * b[c * 4 + 1] + \
+				a[2 * 4 + row] * b[c * 4 + 2] + a[3 * 4 + row] * b[c * 4 + 3];
+	memcpy(out, r, sizeof(r));
+}
+
+static void nodeLocalMatrix(const JsonValue& node, float* m)
+{
+	const JsonValue& matrix = node["matrix"];
+	if(matrix.size() == 16)
+	{
+		for(int i = 0; i < 16; i++) m[i] = (float)matrix[i].num();
+		return;
+	}
+	float t[3] = { 0, 0, 0 }, q[4] = { 0, 0, 0, 1 }, s[3] = { 1, 1, 1 };
+	for(int i = 0; i < 3; i++) t[i] = (float)node["translation"][i].num(t[i]);
+	for(int i = 0; i < 4; i++) q[i] = (float)node["rotation"][i].num(q[i]);
+	for(int i = 0; i < 3; i++) s[i] = (float)node["scale"][i].num(s[i]);
+	float x = q[0], y = q[1], z = q[2], w = q[3];
+	float r[16] = {
+		1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0,
+		2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0,
+		2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0,
+		0, 0, 0, 1 };
+	for(int c = 0; c < 3; c++)
+		for(int row = 0; row < 3; row++)
+			r[c * 4 + row] *= s[c];
+	r[12] = t[0]; r[13] = t[1]; r[14] = t[2];
+	memcpy(m, r, sizeof(r));
+}
+
+static void appendPrimitive(const GltfDocument& doc, const JsonValue& prim, const float* world, ImportedMesh& mesh, \
+	std::vector<bool>& missingNormals)
+{
+	int mode = prim["mode"].integer(4);
+	if(mode != 4)
+	{
+		printf("meshconv: skipping non triangle-list primitive (mode %d)\n", mode);
+		return;
+	}
+	const JsonValue& attributes = prim["attributes"];
+	if(!attributes.has("POSITION")) return;
+	GltfAccessor pos = getAccessor(doc, attributes["POSITION"].integer());
+	GltfAccessor nrm, uv, col;
+	bool hasNormal = attributes.has("NORMAL"), hasUv = attributes.has("TEXCOORD_0"), hasColor = attributes.has("COLOR_0");
+	if(hasNormal) nrm = getAccessor(doc, attributes["NORMAL"].integer());
+	if(hasUv) uv = getAccessor(doc, attributes["TEXCOORD_0"].integer());
+	if(hasColor) col = getAccessor(doc, attributes["COLOR_0"].integer());
+
+	// normals go through the inverse transpose, i.e. the cofactor matrix of the upper 3x3
+	const float* m = world;
+	auto A = [m](int r, int c) { return m[c * 4 + r]; };
+	float n[9];
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++)
+			n[r * 3 + c] = A((r + 1) % 3, (c + 1) % 3) * A((r + 2) % 3, (c + 2) % 3) - \
+				A((r + 1) % 3, (c + 2) % 3) * A((r + 2) % 3, (c + 1) % 3);
+	float det = A(0, 0) * n[0] + A(0, 1) * n[1] + A(0, 2) * n[2];
+
+	uint32_t base = (uint32_t)mesh.vertices.size();
+	for(size_t i = 0; i < pos.count; i++)
+	{
+		MeshVertex v{};
+		float p[3] = { pos.component(i, 0), pos.component(i, 1), pos.component(i, 2) };
+		for(int r = 0; r < 3; r++)
+			v.position[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+		bool imported = hasNormal && i < nrm.count;
+		if(imported)
+		{
+			float a[3] = { nrm.component(i, 0), nrm.component(i, 1), nrm.component(i, 2) };
+			float len = 0.0f;
+			for(int r = 0; r < 3; r++)
+			{
+				v.normal[r] = n[r * 3 + 0] * a[0] + n[r * 3 + 1] * a[1] + n[r * 3 + 2] * a[2];
+				len += v.normal[r] * v.normal[r];
+			}
+			len = sqrtf(len);
+			if(len > 0.0f) for(int r = 0; r < 3; r++) v.normal[r] /= len;
+		}
+		if(hasUv && i < uv.count)
+		{
+			v.uv[0] = uv.component(i, 0);
+			v.uv[1] = uv.component(i, 1);
+		}
+		v.color[0] = v.color[1] = v.color[2] = v.color[3] = 1.0f;
+		if(hasColor && i < col.count)
+			for(int c = 0; c < col.components && c < 4; c++) v.color[c] = col.component(i, c);
+		mesh.vertices.push_back(v);
+		missingNormals.push_back(!imported);
+	}
+
+	size_t first = mesh.indices.size();
+	if(prim.has("indices"))
+	{
+		GltfAccessor idx = getAccessor(doc, prim["indices"].integer());
+		for(size_t i = 0; i < idx.count; i++)
+		{
+			uint32_t index = idx.index(i);
+			if(index >= pos.count) throw std::runtime_error("glTF index out of range\n");
+			mesh.indices.push_back(base + index);
+		}
+	}
+	else
+		for(size_t i = 0; i < pos.count; i++) mesh.indices.push_back(base + (uint32_t)i);
+	mesh.indices.resize(first + (mesh.indices.size() - first) / 3 * 3);
+
+	// mirrored transforms flip the winding
+	if(det < 0.0f)
+		for(size_t i = first; i < mesh.indices.size(); i += 3)
+			std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+}
+
+static void appendNode(const GltfDocument& doc, int nodeIndex, const float* parent, ImportedMesh& mesh, \
+	std::vector<bool>& missingNormals, int depth)
+{
+	if(depth > 64) throw std::runtime_error("glTF node hierarchy too deep (cycle?)\n");
+	const JsonValue& node = doc.json["nodes"][(size_t)nodeIndex];
+	float local[16], world[16];
+	nodeLocalMatrix(node, local);
+	mat4Multiply(parent, local, world);
+	if(node.has("mesh"))
+	{
+		const JsonValue& prims = doc.json["meshes"][(size_t)node["mesh"].integer()]["primitives"];
+		for(size_t p = 0; p < prims.size(); p++)
+			appendPrimitive(doc, prims[p], world, mesh, missingNormals);
+	}
+	const JsonValue& children = node["children"];
+	for(size_t c = 0; c < children.size(); c++)
+		appendNode(doc, children[c].integer(), world, mesh, missingNormals, depth + 1);
+}
+
+ImportedMesh importGltf(const std::string& path)
+{
+	GltfDocument doc = loadGltfDocument(path);
+	ImportedMesh mesh;
+	std::vector<bool> missingNormals; // per vertex, set for primitives without NORMAL
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	const JsonValue& scenes = doc.json["scenes"];
+	if(scenes.size() > 0)
+	{
+		// bake the default scene, node transforms included
+		const JsonValue& roots = scenes[(size_t)doc.json["scene"].integer(0)]["nodes"];
+		for(size_t r = 0; r < roots.size(); r++)
+			appendNode(doc, roots[r].integer(), identity, mesh, missingNormals, 0);
+	}
+	else
+	{
+		// no scene graph, take every mesh as is
+		const JsonValue& meshes = doc.json["meshes"];
+		for(size_t m = 0; m < meshes.size(); m++)
+			for(size_t p = 0; p < meshes[m]["primitives"].size(); p++)
+				appendPrimitive(doc, meshes[m]["primitives"][p], identity, mesh, missingNormals);
+	}
+	if(mesh.vertices.empty()) throw std::runtime_error("No triangle meshes found in " + path + "\n");
+	if(std::find(missingNormals.begin(), missingNormals.end(), true) != missingNormals.end())
+		generateNormals(mesh, missingNormals);
+	return mesh;
+}
+
+ImportedMesh importMesh(const std::string& path)
+{
+	std::string ext = path.substr(path.find_last_of('.') + 1);
+	for(auto& c : ext) c = (char)tolower(c);
+	if(ext == "obj") return importObj(path);
+	if(ext == "gltf" || ext == "glb") return importGltf(path);
+	throw std::runtime_error("Unknown mesh file type: " + path + "\n");
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../meshformat.hpp"
+
+// Source mesh as read from OBJ/glTF: one indexed triangle list, all primitives merged
+// and baked into mesh space. Only the offline converter deals with text formats.
+struct ImportedMesh
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+ImportedMesh importObj(const std::string& path);
+ImportedMesh importGltf(const std::string& path); // .gltf (external or data: buffers) and .glb
+// picks the importer from the file extension
+ImportedMesh importMesh(const std::string& path);
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "meshopt.hpp"
+
+// * ANALYSIS * //
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+	// FIFO cache: a vertex is resident if it was inserted less than cacheSize misses ago
+	std::vector<uint32_t> insertedAt(vertexCount, 0);
+	uint32_t misses = 0;
+	for(size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if(insertedAt[v] == 0 || misses + 1 - insertedAt[v] >= cacheSize + 1)
+		{
+			misses++;
+			insertedAt[v] = misses;
+		}
+	}
+	VertexCacheStats stats;
+	stats.acmr = indexCount ? (float)misses / (float)(indexCount / 3) : 0.0f;
+	stats.atvr = vertexCount ? (float)misses / (float)vertexCount : 0.0f;
+	return stats;
+}
+
+// * VERTEX CACHE (Forsyth) * //
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+static float forsythVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	if(remainingTriangles == 0) return -1.0f; // no triangles left, never pick it
+	float score = 0.0f;
+	if(cachePosition >= 0)
+	{
+		// the three most recent vertices belong to the last triangle; fixed score so
+		// strips don't keep reusing the same edge
+		if(cachePosition < 3) score = FORSYTH_LAST_TRI_SCORE;
+		else
+		{
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+	// prefer vertices with few triangles left, to finish them off early
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if(triangleCount == 0) return;
+
+	// vertex -> triangle adjacency, as one flat array
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for(size_t i = 0; i < triangleCount * 3; i++) remaining[indices[i]]++;
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for(size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for(size_t t = 0; t < triangleCount; t++)
+			for(int k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(size_t v = 0; v < vertexCount; v++) vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+	std::vector<float> triangleScore(triangleCount);
+	for(size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	std::vector<uint8_t> emitted(triangleCount, 0);
+
+	std::vector<uint32_t> output(triangleCount * 3);
+	std::vector<uint32_t> cache, newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	// start with the best triangle overall
+	size_t best = 0;
+	for(size_t t = 1; t < triangleCount; t++)
+		if(triangleScore[t] > triangleScore[best]) best = t;
+	size_t cursor = 0; // fallback scan position for disconnected pieces
+
+	for(size_t out = 0; out < triangleCount; out++)
+	{
+		const uint32_t* tri = &indices[best * 3];
+		memcpy(&output[out * 3], tri, 3 * sizeof(uint32_t));
+		emitted[best] = 1;
+
+		// remove the triangle from its vertices' adjacency lists
+		for(int k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			uint32_t* list = &adjacency[adjacencyOffset[v]];
+			for(uint32_t a = 0; a < remaining[v]; a++)
+				if(list[a] == best) { list[a] = list[remaining[v] - 1]; break; }
+			remaining[v]--;
+		}
+
+		// the emitted triangle's vertices move to the front of the LRU cache
+		newCache.clear();
+		newCache.insert(newCache.end(), tri, tri + 3);
+		for(uint32_t v : cache)
+			if(v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+		for(size_t c = FORSYTH_CACHE_SIZE; c < newCache.size(); c++)
+		{
+			// evicted
+			cachePosition[newCache[c]] = -1;
+			vertexScore[newCache[c]] = forsythVertexScore(-1, remaining[newCache[c]]);
+		}
+		if(newCache.size() > FORSYTH_CACHE_SIZE) newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+		for(size_t c = 0; c < cache.size(); c++)
+		{
+			cachePosition[cache[c]] = (int)c;
+			vertexScore[cache[c]] = forsythVertexScore((int)c, remaining[cache[c]]);
+		}
+
+		// only triangles touching the cache can have changed; pick the next one among them
+		float bestScore = -1.0f;
+		size_t next = SIZE_MAX;
+		for(uint32_t v : cache)
+		{
+			const uint32_t* list = &adjacency[adjacencyOffset[v]];
+			for(uint32_t a = 0; a < remaining[v]; a++)
+			{
+				uint32_t t = list[a];
+				const uint32_t* tv = &indices[t * 3];
+				float score = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+				triangleScore[t] = score;
+				if(score > bestScore) { bestScore = score; next = t; }
+			}
+		}
+		if(next == SIZE_MAX)
+		{
+			// dead end: continue with the next triangle not emitted yet
+			while(cursor < triangleCount && emitted[cursor]) cursor++;
+			next = cursor;
+		}
+		best = next;
+	}
+	memcpy(indices, output.data(), triangleCount * 3 * sizeof(uint32_t));
+}
+
+// * OVERDRAW * //
+
+// FIFO cache simulation like analyzeVertexCache, which can restart cold in O(1): vertices
+// stamped with an older generation count as not resident, so nothing is cleared per cluster
+struct CacheSimulation
+{
+	std::vector<uint32_t> insertedAt, generationOf;
+	uint32_t generation = 1, misses = 0;
+
+	CacheSimulation(size_t vertexCount) : insertedAt(vertexCount, 0), generationOf(vertexCount, 0) {}
+	void restart()
+	{
+		generation++;
+		misses = 0;
+	}
+	// true on a miss
+	bool access(uint32_t v)
+	{
+		if(generationOf[v] == generation && misses + 1 - insertedAt[v] < MESHOPT_CACHE_SIZE + 1) return false;
+		misses++;
+		insertedAt[v] = misses;
+		generationOf[v] = generation;
+		return true;
+	}
+};
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<MeshVertex>& vertices, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if(triangleCount < 2) return;
+	CacheSimulation cache(vertices.size());
+
+	// hard boundaries: triangles that miss on all three vertices start from a cold cache anyway,
+	// so cutting there costs nothing
+	std::vector<size_t> hard;
+	for(size_t t = 0; t < triangleCount; t++)
+	{
+		int triMisses = 0;
+		for(int k = 0; k < 3; k++) triMisses += cache.access(indices[t * 3 + k]);
+		if(t == 0 || triMisses == 3) hard.push_back(t);
+	}
+	hard.push_back(triangleCount);
+
+	// soft boundaries: inside each hard cluster, cut wherever the running ACMR since the last cut
+	// is within threshold of the whole cluster's ACMR
+	std::vector<size_t> clusters;
+	for(size_t h = 0; h + 1 < hard.size(); h++)
+	{
+		size_t start = hard[h], end = hard[h + 1];
+		cache.restart();
+		for(size_t i = start * 3; i < end * 3; i++) cache.access(indices[i]);
+		float clusterAcmr = (float)cache.misses / (float)(end - start);
+
+		cache.restart();
+		size_t subStart = start;
+		clusters.push_back(start);
+		for(size_t t = start; t < end; t++)
+		{
+			for(int k = 0; k < 3; k++) cache.access(indices[t * 3 + k]);
+			float running = (float)cache.misses / (float)(t - subStart + 1);
+			if(t + 1 < end && running <= clusterAcmr * threshold)
+			{
+				// cut, and restart the simulation cold like the GPU would after a cluster jump
+				clusters.push_back(t + 1);
+				subStart = t + 1;
+				cache.restart();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+	size_t clusterCount = clusters.size() - 1;
+	if(clusterCount < 2) return;
+
+	// occlusion potential: how far the cluster sits out along its own normal from the mesh center
+	double meshCenter[3] = { 0, 0, 0 };
+	double meshArea = 0;
+	std::vector<float> sortKey(clusterCount);
+	std::vector<double> clusterCenter(clusterCount * 3, 0.0), clusterNormal(clusterCount * 3, 0.0), clusterArea(clusterCount, 0.0);
+	for(size_t c = 0; c < clusterCount; c++)
+	{
+		for(size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const float* a = vertices[indices[t * 3 + 0]].position;
+			const float* b = vertices[indices[t * 3 + 1]].position;
+			const float* d = vertices[indices[t * 3 + 2]].position;
+			double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			double e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+			double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			double area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for(int k = 0; k < 3; k++)
+			{
+				double centroid = (a[k] + b[k] + d[k]) / 3.0;
+				clusterCenter[c * 3 + k] += centroid * area;
+				clusterNormal[c * 3 + k] += n[k];
+				meshCenter[k] += centroid * area;
+			}
+			clusterArea[c] += area;
+			meshArea += area;
+		}
+	}
+	for(int k = 0; k < 3; k++) meshCenter[k] = meshArea > 0 ? meshCenter[k] / meshArea : 0.0;
+	for(size_t c = 0; c < clusterCount; c++)
+	{
+		double* n = &clusterNormal[c * 3];
+		double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		double key = 0.0;
+		for(int k = 0; k < 3; k++)
+		{
+			double center = clusterArea[c] > 0 ? clusterCenter[c * 3 + k] / clusterArea[c] : 0.0;
+			key += (center - meshCenter[k]) * (len > 0 ? n[k] / len : 0.0);
+		}
+		sortKey[c] = (float)key;
+	}
+
+	// outermost clusters first, they are the likeliest occluders
+	std::vector<uint32_t> order(clusterCount);
+	for(size_t c = 0; c < clusterCount; c++) order[c] = (uint32_t)c;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for(uint32_t c : order)
+		output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+// * VERTEX FETCH * //
+
+void optimizeVertexFetch(std::vector<MeshVertex>& vertices, uint32_t* indices, size_t indexCount)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<MeshVertex> ordered;
+	ordered.reserve(vertices.size());
+	for(size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t& r = remap[indices[i]];
+		if(r == UINT32_MAX)
+		{
+			r = (uint32_t)ordered.size();
+			ordered.push_back(vertices[indices[i]]);
+		}
+		indices[i] = r;
+	}
+	vertices.swap(ordered);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "../meshformat.hpp"
+
+// Offline index/vertex reordering so the GPU does less vertex work per frame.
+// Run in this order: vertex cache, then overdraw (which keeps cache friendly
+// clusters intact), then vertex fetch (which renumbers vertices by first use).
+
+#define MESHOPT_CACHE_SIZE 16 // FIFO size used when simulating the post-transform cache
+
+struct VertexCacheStats
+{
+	float acmr;   // average cache miss ratio: transformed vertices per triangle, 0.5 .. 3
+	float atvr;   // average transformed vertex ratio: transformed vertices per vertex, 1.0 is optimal
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = MESHOPT_CACHE_SIZE);
+
+// Forsyth's linear-speed vertex cache optimization, in place
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+// Sander et al. style: split into cache clusters, draw outward facing clusters first, in place.
+// threshold is the ACMR degradation allowed when cutting clusters, e.g. 1.05
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<MeshVertex>& vertices, float threshold = 1.05f);
+// reorder vertices by first use and drop unreferenced ones, rewrites the indices
+void optimizeVertexFetch(std::vector<MeshVertex>& vertices, uint32_t* indices, size_t indexCount);
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+
+#include "meshsimplify.hpp"
+
+enum VertexKind : uint8_t
+{
+	VERTEX_FREE,        // interior of a manifold patch, may collapse onto a neighbour
+	VERTEX_BORDER,      // open or non-manifold edge: stays, but takes collapses
+	VERTEX_SEAM,        // several wedges at one position: stays, and nothing collapses onto it
+};
+
+// sum of w * (n.p + d)^2 over planes, symmetric so 10 coefficients; w is the total weight
+struct Quadric
+{
+	double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+	double w;
+};
+
+static void addQuadric(Quadric& q, const Quadric& r)
+{
+	q.a2 += r.a2; q.b2 += r.b2; q.c2 += r.c2;
+	q.ab += r.ab; q.ac += r.ac; q.bc += r.bc;
+	q.ad += r.ad; q.bd += r.bd; q.cd += r.cd;
+	q.d2 += r.d2; q.w += r.w;
+}
+
+// the triangle's plane, weighted by area so slivers barely count
+static Quadric planeQuadric(const float* p0, const float* p1, const float* p2)
+{
+	double e1[3], e2[3];
+	for(int k = 0; k < 3; k++) { e1[k] = p1[k] - p0[k]; e2[k] = p2[k] - p0[k]; }
+	double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+	double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	Quadric q{};
+	if(length == 0.0) return q;
+	for(int k = 0; k < 3; k++) n[k] /= length;
+	double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+	double w = length * 0.5;
+	q.a2 = w * n[0] * n[0]; q.b2 = w * n[1] * n[1]; q.c2 = w * n[2] * n[2];
+	q.ab = w * n[0] * n[1]; q.ac = w * n[0] * n[2]; q.bc = w * n[1] * n[2];
+	q.ad = w * n[0] * d; q.bd = w * n[1] * d; q.cd = w * n[2] * d;
+	q.d2 = w * d * d;
+	q.w = w;
+	return q;
+}
+
+// mean squared distance from p to the planes
+static double quadricError(const Quadric& q, const float* p)
+{
+	if(q.w <= 0.0) return 0.0;
+	double x = p[0], y = p[1], z = p[2];
+	double e = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z + 2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z + \
+		q.ad * x + q.bd * y + q.cd * z) + q.d2;
+	return std::max(e, 0.0) / q.w;
+}
+
+static void triangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+{
+	float e1[3], e2[3];
+	for(int k = 0; k < 3; k++) { e1[k] = p1[k] - p0[k]; e2[k] = p2[k] - p0[k]; }
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<MeshVertex>& vertices, const uint32_t* indices, size_t indexCount, \
+	size_t targetIndexCount, float maxError, float* error)
+{
+	std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+	size_t vertexCount = vertices.size();
+	double errorLimit = (double)maxError * maxError;
+	double worst = 0.0;
+
+	// vertices at the same position are wedges of one corner; topology and quadrics use the lowest of them
+	std::vector<uint32_t> order(vertexCount);
+	for(size_t i = 0; i < vertexCount; i++) order[i] = (uint32_t)i;
+	auto less = [&](uint32_t a, uint32_t b)
+	{
+		const float* pa = vertices[a].position;
+		const float* pb = vertices[b].position;
+		return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+	};
+	std::sort(order.begin(), order.end(), less);
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> kind(vertexCount, VERTEX_FREE);
+	for(size_t i = 0; i < vertexCount; )
+	{
+		size_t j = i + 1;
+		while(j < vertexCount && !less(order[i], order[j])) j++;
+		uint32_t canonical = *std::min_element(order.begin() + i, order.begin() + j);
+		for(size_t k = i; k < j; k++) remap[order[k]] = canonical;
+		if(j - i > 1) kind[canonical] = VERTEX_SEAM;
+		i = j;
+	}
+
+	// on a closed manifold every edge shows up once in each direction; anything else pins its ends
+	std::vector<uint64_t> edges;
+	edges.reserve(result.size());
+	for(size_t t = 0; t < result.size(); t += 3)
+		for(int k = 0; k < 3; k++)
+		{
+			uint32_t a = remap[result[t + k]], b = remap[result[t + (k + 1) % 3]];
+			if(a != b) edges.push_back((uint64_t)a << 32 | b);
+		}
+	std::sort(edges.begin(), edges.end());
+	for(size_t e = 0; e < edges.size(); e++)
+	{
+		uint32_t a = (uint32_t)(edges[e] >> 32), b = (uint32_t)edges[e];
+		bool repeated = (e > 0 && edges[e - 1] == edges[e]) || (e + 1 < edges.size() && edges[e + 1] == edges[e]);
+		auto twins = std::equal_range(edges.begin(), edges.end(), (uint64_t)b << 32 | a);
+		if(!repeated && twins.second - twins.first == 1) continue;
+		if(kind[a] == VERTEX_FREE) kind[a] = VERTEX_BORDER;
+		if(kind[b] == VERTEX_FREE) kind[b] = VERTEX_BORDER;
+	}
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for(size_t t = 0; t < result.size(); t += 3)
+	{
+		Quadric q = planeQuadric(vertices[result[t]].position, vertices[result[t + 1]].position, vertices[result[t + 2]].position);
+		for(int k = 0; k < 3; k++) addQuadric(quadrics[remap[result[t + k]]], q);
+	}
+
+	struct Candidate { uint32_t source, target; double cost; };
+	std::vector<Candidate> candidates;
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1), adjacency;
+	std::vector<uint32_t> collapse(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	size_t triangleCount = result.size() / 3;
+	size_t targetTriangles = targetIndexCount / 3;
+	for(int pass = 0; pass < SIMPLIFY_MAX_PASSES && triangleCount > targetTriangles; pass++)
+	{
+		// corner -> triangle adjacency of what is left, by canonical vertex
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for(uint32_t v : result) adjacencyOffset[remap[v] + 1]++;
+		for(size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for(size_t i = 0; i < result.size(); i++) adjacency[fill[remap[result[i]]]++] = (uint32_t)(i / 3);
+		}
+
+		// every edge from a free vertex (its own canonical) to one with a single wedge, cheapest first
+		candidates.clear();
+		for(size_t t = 0; t < result.size(); t += 3)
+			for(int k = 0; k < 3; k++)
+				for(int j = 1; j < 3; j++)
+				{
+					uint32_t source = result[t + k], target = result[t + (k + j) % 3];
+					if(kind[remap[source]] != VERTEX_FREE || kind[remap[target]] == VERTEX_SEAM) continue;
+					if(remap[source] == remap[target]) continue;
+					Quadric q = quadrics[source];
+					addQuadric(q, quadrics[target]);
+					candidates.push_back({ source, target, quadricError(q, vertices[target].position) });
+				}
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+
+		std::fill(touched.begin(), touched.end(), 0);
+		for(size_t v = 0; v < vertexCount; v++) collapse[v] = (uint32_t)v;
+		size_t collapsed = 0;
+		for(const Candidate& c : candidates)
+		{
+			if(triangleCount <= targetTriangles || c.cost > errorLimit) break;
+			if(touched[c.source] || touched[c.target]) continue;
+			// moving the source onto the target must not fold any of its remaining triangles over
+			bool flips = false;
+			size_t removed = 0;
+			for(uint32_t a = adjacencyOffset[c.source]; a < adjacencyOffset[c.source + 1] && !flips; a++)
+			{
+				const uint32_t* tri = &result[(size_t)adjacency[a] * 3];
+				if(remap[tri[0]] == c.target || remap[tri[1]] == c.target || remap[tri[2]] == c.target)
+				{
+					removed++;
+					continue;
+				}
+				const float* p[3] = { vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position };
+				float before[3], after[3];
+				triangleNormal(p[0], p[1], p[2], before);
+				for(int k = 0; k < 3; k++) if(tri[k] == c.source) p[k] = vertices[c.target].position;
+				triangleNormal(p[0], p[1], p[2], after);
+				flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f;
+			}
+			if(flips) continue;
+			// the neighbourhood changes shape, so none of it collapses again this pass
+			for(uint32_t a = adjacencyOffset[c.source]; a < adjacencyOffset[c.source + 1]; a++)
+				for(int k = 0; k < 3; k++) touched[remap[result[(size_t)adjacency[a] * 3 + k]]] = 1;
+			collapse[c.source] = c.target;
+			addQuadric(quadrics[c.target], quadrics[c.source]);
+			worst = std::max(worst, c.cost);
+			triangleCount -= std::min(removed, triangleCount);
+			collapsed++;
+		}
+		if(collapsed == 0) break;
+
+		// rewrite the collapsed corners and drop the triangles that went degenerate
+		size_t write = 0;
+		for(size_t t = 0; t < result.size(); t += 3)
+		{
+			uint32_t a = collapse[result[t]], b = collapse[result[t + 1]], c = collapse[result[t + 2]];
+			if(remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c]) continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+		triangleCount = write / 3;
+	}
+	if(error) *error = (float)sqrt(worst);
+	return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "../meshformat.hpp"
+
+// Offline simplification for the LOD chain: Garland-Heckbert quadric error metric.
+// Edges collapse onto one of their endpoints, so every LOD indexes the same vertex
+// buffer and only adds indices to the blob. Open borders and attribute seams
+// (several vertices at one position) never move; they only take collapses from
+// the inside, which keeps silhouettes of open meshes and UV charts intact.
+
+#define SIMPLIFY_MAX_PASSES 64 // each pass collapses an independent set of the cheapest edges
+
+// indices of a coarser version with about targetIndexCount indices, fewer collapses if the
+// next one would move the surface by more than maxError (mesh units).
+// error receives the largest surface distance introduced, in mesh units
+std::vector<uint32_t> simplifyMesh(const std::vector<MeshVertex>& vertices, const uint32_t* indices, size_t indexCount, \
+	size_t targetIndexCount, float maxError, float* error);
@@ -0,0 +1,250 @@
+// texconv: offline PPM/PAM -> .btex converter with a full mip chain
+// usage: texconv [--srgb] [--format universal|etc2|bc|rgba] <layer0.ppm|layer0.pam> [more layers...] <output.btex>
+// universal (the default) is transcoded at load to whatever the device samples; etc2 and bc are the same
+// blocks already transcoded, for builds that know their GPU; rgba keeps every texel as it is
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vulkan/vulkan.h> // format enums only
+
+#include "../texformat.hpp"
+#include "../transcode.hpp"
+
+struct Image
+{
+	uint32_t width = 0, height = 0;
+	std::vector<uint8_t> rgba;
+};
+
+// binary PPM (P6) or PAM (P7) with RGB or RGB_ALPHA tuples, 8 bits per channel
+static Image readImage(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if(!file.is_open()) throw std::runtime_error("Couldn't open " + path + "\n");
+	std::string magic;
+	file >> magic;
+	uint32_t channels = 0, maxValue = 0;
+	Image image;
+	auto token = [&file]()
+	{
+		std::string word;
+		while(file >> word && word[0] == '#') std::getline(file, word);
+		return word;
+	};
+	if(magic == "P6")
+	{
+		image.width = (uint32_t)std::stoul(token());
+		image.height = (uint32_t)std::stoul(token());
+		maxValue = (uint32_t)std::stoul(token());
+		channels = 3;
+	}
+	else if(magic == "P7")
+	{
+		for(std::string key = token(); key != "ENDHDR"; key = token())
+		{
+			if(key.empty()) throw std::runtime_error("Unterminated PAM header in " + path + "\n");
+			std::string value = token();
+			if(key == "WIDTH") image.width = (uint32_t)std::stoul(value);
+			else if(key == "HEIGHT") image.height = (uint32_t)std::stoul(value);
+			else if(key == "DEPTH") channels = (uint32_t)std::stoul(value);
+			else if(key == "MAXVAL") maxValue = (uint32_t)std::stoul(value);
+		}
+	}
+	else throw std::runtime_error(path + " is not a binary PPM or PAM file\n");
+	if(maxValue != 255 || (channels != 3 && channels != 4) || image.width == 0 || image.height == 0)
+		throw std::runtime_error(path + ": only 8 bit RGB or RGBA images\n");
+	file.get(); // the single whitespace before the raster
+
+	std::vector<uint8_t> raster((size_t)image.width * image.height * channels);
+	if(!file.read((char*)raster.data(), raster.size())) throw std::runtime_error(path + " is truncated\n");
+	image.rgba.resize((size_t)image.width * image.height * 4);
+	for(size_t i = 0; i < (size_t)image.width * image.height; i++)
+	{
+		for(uint32_t c = 0; c < 3; c++) image.rgba[i * 4 + c] = raster[i * channels + c];
+		image.rgba[i * 4 + 3] = channels == 4 ? raster[i * channels + 3] : 255;
+	}
+	return image;
+}
+
+static float toLinear(uint8_t value)
+{
+	float c = value / 255.0f;
+	return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t fromLinear(float c)
+{
+	c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+	return (uint8_t)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+// 2x2 box filter; odd edges reuse their last row or column. sRGB colour is averaged as light, alpha as is
+static Image downsample(const Image& source, bool srgb)
+{
+	Image result;
+	result.width = std::max(source.width / 2, 1u);
+	result.height = std::max(source.height / 2, 1u);
+	result.rgba.resize((size_t)result.width * result.height * 4);
+	for(uint32_t y = 0; y < result.height; y++)
+		for(uint32_t x = 0; x < result.width; x++)
+		{
+			uint32_t xs[2] = { std::min(x * 2, source.width - 1), std::min(x * 2 + 1, source.width - 1) };
+			uint32_t ys[2] = { std::min(y * 2, source.height - 1), std::min(y * 2 + 1, source.height - 1) };
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				float sum = 0.0f;
+				for(uint32_t sy : ys)
+					for(uint32_t sx : xs)
+					{
+						uint8_t value = source.rgba[((size_t)sy * source.width + sx) * 4 + c];
+						sum += srgb && c < 3 ? toLinear(value) : value / 255.0f;
+					}
+				sum *= 0.25f;
+				result.rgba[((size_t)y * result.width + x) * 4 + c] = srgb && c < 3 ? fromLinear(sum) : \
+					(uint8_t)(sum * 255.0f + 0.5f);
+			}
+		}
+	return result;
+}
+
+// one layer of one level as universal blocks; edge blocks repeat the last row and column
+static std::vector<uint8_t> encodeUniversal(const Image& image, bool alpha)
+{
+	uint32_t blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+	uint32_t blockBytes = alpha ? 16 : 8;
+	std::vector<uint8_t> blocks((size_t)blocksX * blocksY * blockBytes);
+	uint8_t texels[64];
+	for(uint32_t by = 0; by < blocksY; by++)
+		for(uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			for(uint32_t y = 0; y < 4; y++)
+				for(uint32_t x = 0; x < 4; x++)
+				{
+					uint32_t sx = std::min(bx * 4 + x, image.width - 1), sy = std::min(by * 4 + y, image.height - 1);
+					memcpy(texels + (y * 4 + x) * 4, &image.rgba[((size_t)sy * image.width + sx) * 4], 4);
+				}
+			encodeUniversalBlock(texels, alpha, &blocks[((size_t)by * blocksX + bx) * blockBytes]);
+		}
+	return blocks;
+}
+
+int main(int argc, char** argv)
+{
+	int arg = 1;
+	bool srgb = false;
+	std::string target = "universal";
+	for(; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++)
+	{
+		if(strcmp(argv[arg], "--srgb") == 0) srgb = true;
+		else if(strcmp(argv[arg], "--format") == 0 && arg + 1 < argc) target = argv[++arg];
+		else break;
+	}
+	bool knownTarget = target == "universal" || target == "etc2" || target == "bc" || target == "rgba";
+	if(argc - arg < 2 || !knownTarget)
+	{
+		std::cerr << "usage: texconv [--srgb] [--format universal|etc2|bc|rgba] <layer0.ppm|layer0.pam> [more layers...] " \
+			"<output.btex>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const char* output = argv[argc - 1];
+	try
+	{
+		// levels[level][layer]
+		std::vector<std::vector<Image>> levels(1);
+		for(int i = arg; i < argc - 1; i++)
+		{
+			levels[0].push_back(readImage(argv[i]));
+			if(levels[0].back().width != levels[0][0].width || levels[0].back().height != levels[0][0].height)
+				throw std::runtime_error(std::string(argv[i]) + ": every layer must be the same size\n");
+		}
+		uint32_t width = levels[0][0].width, height = levels[0][0].height;
+		while(levels.back()[0].width > 1 || levels.back()[0].height > 1)
+		{
+			if(levels.size() == TEXTURE_MAX_LEVELS) throw std::runtime_error("Image too large\n");
+			std::vector<Image> next;
+			for(const Image& layer : levels.back()) next.push_back(downsample(layer, srgb));
+			levels.push_back(std::move(next));
+		}
+
+		// the blocks of every level and layer; BC and ETC2 start from the same universal blocks
+		bool alpha = false;
+		for(const Image& layer : levels[0])
+			for(size_t i = 3; i < layer.rgba.size(); i += 4) alpha = alpha || layer.rgba[i] != 255;
+		uint32_t format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		if(target != "rgba")
+		{
+			uint32_t universal = TEXTURE_FORMAT_UNIVERSAL | (alpha ? TEXTURE_UNIVERSAL_ALPHA : 0) | \
+				(srgb ? TEXTURE_UNIVERSAL_SRGB : 0);
+			VkFormat targets[TEXTURE_MAX_UNIVERSAL_TARGETS];
+			universalTargets(universal, targets);
+			format = target == "etc2" ? (uint32_t)targets[0] : target == "bc" ? (uint32_t)targets[1] : universal;
+			for(std::vector<Image>& level : levels)
+				for(Image& layer : level)
+				{
+					std::vector<uint8_t> blocks = encodeUniversal(layer, alpha);
+					if(target == "bc")
+					{
+						std::vector<uint8_t> transcoded(textureLevelSize(format, layer.width, layer.height, 1));
+						for(uint32_t row = 0; row < (layer.height + 3) / 4; row++)
+							transcodeBlockRow(universal, (VkFormat)format, blocks.data(), transcoded.data(), layer.width, \
+								layer.height, row);
+						blocks.swap(transcoded);
+					}
+					layer.rgba.swap(blocks); // the level's payload from here on
+				}
+		}
+
+		auto align = [](uint64_t v) { return (v + TEXTURE_LEVEL_ALIGN - 1) / TEXTURE_LEVEL_ALIGN * TEXTURE_LEVEL_ALIGN; };
+		std::vector<TextureLevel> table(levels.size());
+		uint64_t offset = align(sizeof(TextureFileHeader) + sizeof(TextureLevel) * levels.size());
+		for(size_t level = 0; level < levels.size(); level++)
+		{
+			table[level].offset = offset;
+			table[level].size = levels[level][0].rgba.size() * levels[level].size();
+			table[level].width = levels[level][0].width;
+			table[level].height = levels[level][0].height;
+			offset = align(offset + table[level].size);
+		}
+		TextureFileHeader header{};
+		header.magic = TEXTURE_MAGIC;
+		header.version = TEXTURE_VERSION;
+		header.headerSize = sizeof(TextureFileHeader);
+		header.format = format;
+		header.fileSize = offset;
+		header.width = width;
+		header.height = height;
+		header.layers = (uint32_t)levels[0].size();
+		header.levelCount = (uint32_t)levels.size();
+
+		std::vector<char> blob(offset, 0);
+		memcpy(blob.data(), &header, sizeof(header));
+		memcpy(blob.data() + sizeof(header), table.data(), sizeof(TextureLevel) * table.size());
+		for(size_t level = 0; level < levels.size(); level++)
+		{
+			char* out = blob.data() + table[level].offset;
+			for(const Image& layer : levels[level])
+			{
+				memcpy(out, layer.rgba.data(), layer.rgba.size());
+				out += layer.rgba.size();
+			}
+		}
+		std::ofstream file(output, std::ios::binary | std::ios::trunc);
+		if(!file.is_open()) throw std::runtime_error(std::string("Couldn't write ") + output + "\n");
+		file.write(blob.data(), blob.size());
+
+		printf("texconv: %ux%u, %u layers, %u levels, %s%s -> %s (%.1f MiB)\n", width, height, header.layers, \
+			header.levelCount, textureFormatInfo(format).name, srgb && target == "universal" ? " sRGB" : "", output, \
+			offset / (1024.0 * 1024.0));
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
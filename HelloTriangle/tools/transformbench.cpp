@@ -0,0 +1,102 @@
+// transformbench: per-frame cost of TransformHierarchy::update() + upload() on a large scene
+// usage: transformbench [nodes]   (default 100000)
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "../transform.hpp"
+
+#define BENCH_NODES 100000
+#define BENCH_FRAMES 200
+#define BENCH_FANOUT 8              // children per node, breadth first
+#define BENCH_UPLOAD_TARGETS 3      // one per swapchain image, as in the app
+#define BENCH_FRAME_BUDGET_MS 16.7
+
+using BenchClock = std::chrono::steady_clock;
+
+static double millisecondsSince(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static glm::quat rotationZ(float angle)
+{
+	return glm::quat(cosf(angle * 0.5f), 0.0f, 0.0f, sinf(angle * 0.5f));
+}
+
+struct Timings
+{
+	double update = 0.0, upload = 0.0, worst = 0.0;
+	uint64_t recomputed = 0, written = 0;
+};
+
+// `moving` nodes get a new rotation every frame; every one of them dirties its subtree
+static Timings run(TransformHierarchy& scene, const std::vector<TransformHandle>& moving, std::vector<glm::mat4>& buffer)
+{
+	Timings t;
+	for(uint32_t frame = 0; frame < BENCH_FRAMES; frame++)
+	{
+		for(size_t i = 0; i < moving.size(); i++) scene.setRotation(moving[i], rotationZ(frame * 0.01f + i));
+		auto start = BenchClock::now();
+		t.recomputed += scene.update();
+		double updated = millisecondsSince(start);
+		auto uploadStart = BenchClock::now();
+		t.written += scene.upload(frame % BENCH_UPLOAD_TARGETS, buffer.data());
+		double uploaded = millisecondsSince(uploadStart);
+		t.update += updated;
+		t.upload += uploaded;
+		t.worst = std::max(t.worst, updated + uploaded);
+	}
+	return t;
+}
+
+static void report(const char* name, const Timings& t)
+{
+	double frame = (t.update + t.upload) / BENCH_FRAMES;
+	printf("%-12s update %6.3f ms, upload %6.3f ms, frame %6.3f ms (worst %6.3f, %4.1f%% of %.1f ms), %8.0f recomputed, " \
+		"%8.0f written per frame\n", name, t.update / BENCH_FRAMES, t.upload / BENCH_FRAMES, frame, t.worst, \
+		frame / BENCH_FRAME_BUDGET_MS * 100.0, BENCH_FRAME_BUDGET_MS, (double)t.recomputed / BENCH_FRAMES, \
+		(double)t.written / BENCH_FRAMES);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : BENCH_NODES;
+	if(nodes == 0)
+	{
+		fprintf(stderr, "usage: transformbench [nodes]\n");
+		return EXIT_FAILURE;
+	}
+
+	// a wide tree, built breadth first so parents come before children as in a loaded scene
+	TransformHierarchy scene;
+	std::vector<TransformHandle> handles;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	for(uint32_t i = 0; i < nodes; i++)
+	{
+		TransformHandle parent = i == 0 ? TRANSFORM_NO_PARENT : handles[(i - 1) / BENCH_FANOUT];
+		handles.push_back(scene.addNode(parent));
+		scene.setLocal(handles.back(), glm::vec3(offset(random), offset(random), offset(random)), rotationZ(offset(random)), \
+			glm::vec3(1.0f));
+	}
+	std::vector<glm::mat4> buffer(nodes);
+	scene.setUploadTargets(BENCH_UPLOAD_TARGETS, buffer.size());
+	scene.update();
+	for(uint32_t target = 0; target < BENCH_UPLOAD_TARGETS; target++) scene.upload(target, buffer.data());
+	printf("transformbench: %u nodes, fanout %u, %u frames\n", nodes, BENCH_FANOUT, BENCH_FRAMES);
+
+	// the root moves: every world matrix changes
+	report("all dirty", run(scene, { handles[0] }, buffer));
+	// 1% of the nodes animate, leaves scattered over the tree
+	std::vector<TransformHandle> some;
+	for(uint32_t i = nodes / 2; i < nodes; i += 50) some.push_back(handles[i]);
+	report("1% moving", run(scene, some, buffer));
+	// nothing moves: the cost of finding that out
+	report("static", run(scene, {}, buffer));
+	return EXIT_SUCCESS;
+}
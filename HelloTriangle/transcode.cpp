@@ -0,0 +1,450 @@
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "transcode.hpp"
+
+struct FormatEntry
+{
+	VkFormat format;
+	TextureFormatInfo info;
+};
+
+static const FormatEntry formats[] =
+{
+	{ VK_FORMAT_R8G8B8A8_UNORM, { 1, 1, 4, "RGBA8" } },
+	{ VK_FORMAT_R8G8B8A8_SRGB, { 1, 1, 4, "RGBA8 sRGB" } },
+	{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, { 4, 4, 8, "BC1" } },
+	{ VK_FORMAT_BC1_RGB_SRGB_BLOCK, { 4, 4, 8, "BC1 sRGB" } },
+	{ VK_FORMAT_BC1_RGBA_UNORM_BLOCK, { 4, 4, 8, "BC1 RGBA" } },
+	{ VK_FORMAT_BC1_RGBA_SRGB_BLOCK, { 4, 4, 8, "BC1 RGBA sRGB" } },
+	{ VK_FORMAT_BC2_UNORM_BLOCK, { 4, 4, 16, "BC2" } },
+	{ VK_FORMAT_BC2_SRGB_BLOCK, { 4, 4, 16, "BC2 sRGB" } },
+	{ VK_FORMAT_BC3_UNORM_BLOCK, { 4, 4, 16, "BC3" } },
+	{ VK_FORMAT_BC3_SRGB_BLOCK, { 4, 4, 16, "BC3 sRGB" } },
+	{ VK_FORMAT_BC4_UNORM_BLOCK, { 4, 4, 8, "BC4" } },
+	{ VK_FORMAT_BC4_SNORM_BLOCK, { 4, 4, 8, "BC4 snorm" } },
+	{ VK_FORMAT_BC5_UNORM_BLOCK, { 4, 4, 16, "BC5" } },
+	{ VK_FORMAT_BC5_SNORM_BLOCK, { 4, 4, 16, "BC5 snorm" } },
+	{ VK_FORMAT_BC6H_UFLOAT_BLOCK, { 4, 4, 16, "BC6H" } },
+	{ VK_FORMAT_BC6H_SFLOAT_BLOCK, { 4, 4, 16, "BC6H signed" } },
+	{ VK_FORMAT_BC7_UNORM_BLOCK, { 4, 4, 16, "BC7" } },
+	{ VK_FORMAT_BC7_SRGB_BLOCK, { 4, 4, 16, "BC7 sRGB" } },
+	{ VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, { 4, 4, 8, "ETC2 RGB8" } },
+	{ VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, { 4, 4, 8, "ETC2 RGB8 sRGB" } },
+	{ VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK, { 4, 4, 8, "ETC2 RGB8A1" } },
+	{ VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK, { 4, 4, 8, "ETC2 RGB8A1 sRGB" } },
+	{ VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, { 4, 4, 16, "ETC2 RGBA8" } },
+	{ VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, { 4, 4, 16, "ETC2 RGBA8 sRGB" } },
+	{ VK_FORMAT_EAC_R11_UNORM_BLOCK, { 4, 4, 8, "EAC R11" } },
+	{ VK_FORMAT_EAC_R11_SNORM_BLOCK, { 4, 4, 8, "EAC R11 snorm" } },
+	{ VK_FORMAT_EAC_R11G11_UNORM_BLOCK, { 4, 4, 16, "EAC RG11" } },
+	{ VK_FORMAT_EAC_R11G11_SNORM_BLOCK, { 4, 4, 16, "EAC RG11 snorm" } },
+	{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, { 4, 4, 16, "ASTC 4x4" } },
+	{ VK_FORMAT_ASTC_4x4_SRGB_BLOCK, { 4, 4, 16, "ASTC 4x4 sRGB" } },
+	{ VK_FORMAT_ASTC_5x4_UNORM_BLOCK, { 5, 4, 16, "ASTC 5x4" } },
+	{ VK_FORMAT_ASTC_5x4_SRGB_BLOCK, { 5, 4, 16, "ASTC 5x4 sRGB" } },
+	{ VK_FORMAT_ASTC_5x5_UNORM_BLOCK, { 5, 5, 16, "ASTC 5x5" } },
+	{ VK_FORMAT_ASTC_5x5_SRGB_BLOCK, { 5, 5, 16, "ASTC 5x5 sRGB" } },
+	{ VK_FORMAT_ASTC_6x5_UNORM_BLOCK, { 6, 5, 16, "ASTC 6x5" } },
+	{ VK_FORMAT_ASTC_6x5_SRGB_BLOCK, { 6, 5, 16, "ASTC 6x5 sRGB" } },
+	{ VK_FORMAT_ASTC_6x6_UNORM_BLOCK, { 6, 6, 16, "ASTC 6x6" } },
+	{ VK_FORMAT_ASTC_6x6_SRGB_BLOCK, { 6, 6, 16, "ASTC 6x6 sRGB" } },
+	{ VK_FORMAT_ASTC_8x5_UNORM_BLOCK, { 8, 5, 16, "ASTC 8x5" } },
+	{ VK_FORMAT_ASTC_8x5_SRGB_BLOCK, { 8, 5, 16, "ASTC 8x5 sRGB" } },
+	{ VK_FORMAT_ASTC_8x6_UNORM_BLOCK, { 8, 6, 16, "ASTC 8x6" } },
+	{ VK_FORMAT_ASTC_8x6_SRGB_BLOCK, { 8, 6, 16, "ASTC 8x6 sRGB" } },
+	{ VK_FORMAT_ASTC_8x8_UNORM_BLOCK, { 8, 8, 16, "ASTC 8x8" } },
+	{ VK_FORMAT_ASTC_8x8_SRGB_BLOCK, { 8, 8, 16, "ASTC 8x8 sRGB" } },
+	{ VK_FORMAT_ASTC_10x5_UNORM_BLOCK, { 10, 5, 16, "ASTC 10x5" } },
+	{ VK_FORMAT_ASTC_10x5_SRGB_BLOCK, { 10, 5, 16, "ASTC 10x5 sRGB" } },
+	{ VK_FORMAT_ASTC_10x6_UNORM_BLOCK, { 10, 6, 16, "ASTC 10x6" } },
+	{ VK_FORMAT_ASTC_10x6_SRGB_BLOCK, { 10, 6, 16, "ASTC 10x6 sRGB" } },
+	{ VK_FORMAT_ASTC_10x8_UNORM_BLOCK, { 10, 8, 16, "ASTC 10x8" } },
+	{ VK_FORMAT_ASTC_10x8_SRGB_BLOCK, { 10, 8, 16, "ASTC 10x8 sRGB" } },
+	{ VK_FORMAT_ASTC_10x10_UNORM_BLOCK, { 10, 10, 16, "ASTC 10x10" } },
+	{ VK_FORMAT_ASTC_10x10_SRGB_BLOCK, { 10, 10, 16, "ASTC 10x10 sRGB" } },
+	{ VK_FORMAT_ASTC_12x10_UNORM_BLOCK, { 12, 10, 16, "ASTC 12x10" } },
+	{ VK_FORMAT_ASTC_12x10_SRGB_BLOCK, { 12, 10, 16, "ASTC 12x10 sRGB" } },
+	{ VK_FORMAT_ASTC_12x12_UNORM_BLOCK, { 12, 12, 16, "ASTC 12x12" } },
+	{ VK_FORMAT_ASTC_12x12_SRGB_BLOCK, { 12, 12, 16, "ASTC 12x12 sRGB" } },
+};
+
+// ETC1 intensity modifiers: selector 0 is +small, 1 +large, 2 -small, 3 -large
+static const int etcModifiers[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, \
+	{ 47, 183 } };
+static const int eacModifiers[16][8] =
+{
+	{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 },
+	{ -2, -4, -6, -13, 1, 3, 5, 12 }, { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 }, { -2, -6, -8, -10, 1, 5, 7, 9 },
+	{ -2, -5, -8, -10, 1, 4, 7, 9 }, { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 }, { -4, -6, -8, -9, 3, 5, 7, 8 },
+	{ -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+TextureFormatInfo textureFormatInfo(uint32_t format)
+{
+	if(textureFormatUniversal(format))
+		return { 4, 4, format & TEXTURE_UNIVERSAL_ALPHA ? 16u : 8u, \
+			format & TEXTURE_UNIVERSAL_ALPHA ? "universal RGBA" : "universal RGB" };
+	for(const FormatEntry& entry : formats)
+		if((uint32_t)entry.format == format) return entry.info;
+	return { 1, 1, 0, "unknown" };
+}
+
+bool textureFormatUniversal(uint32_t format)
+{
+	return (format & ~(TEXTURE_UNIVERSAL_ALPHA | TEXTURE_UNIVERSAL_SRGB)) == TEXTURE_FORMAT_UNIVERSAL;
+}
+
+uint64_t textureLevelSize(uint32_t format, uint32_t width, uint32_t height, uint32_t layers)
+{
+	TextureFormatInfo info = textureFormatInfo(format);
+	uint64_t blocksX = (width + info.blockWidth - 1) / info.blockWidth;
+	uint64_t blocksY = (height + info.blockHeight - 1) / info.blockHeight;
+	return blocksX * blocksY * info.blockBytes * layers;
+}
+
+uint32_t universalTargets(uint32_t format, VkFormat targets[TEXTURE_MAX_UNIVERSAL_TARGETS])
+{
+	bool srgb = (format & TEXTURE_UNIVERSAL_SRGB) != 0;
+	if(format & TEXTURE_UNIVERSAL_ALPHA)
+	{
+		targets[0] = srgb ? VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+		targets[1] = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	}
+	else
+	{
+		targets[0] = srgb ? VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+		targets[1] = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+	targets[2] = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	return 3;
+}
+
+bool universalTargetIsCopy(uint32_t format, VkFormat target)
+{
+	VkFormat targets[TEXTURE_MAX_UNIVERSAL_TARGETS];
+	universalTargets(format, targets);
+	return target == targets[0];
+}
+
+static uint8_t clampByte(int value)
+{
+	return (uint8_t)std::min(std::max(value, 0), 255);
+}
+
+static int etcModifier(uint32_t table, uint32_t selector)
+{
+	int modifier = etcModifiers[table][selector & 1];
+	return selector & 2 ? -modifier : modifier;
+}
+
+// ETC1S: the base colour, the table and a selector per texel; texel i is x * 4 + y, column major
+static void unpackEtc1s(const uint8_t* block, uint8_t base[3], uint32_t& table, uint8_t selectors[16])
+{
+	for(uint32_t c = 0; c < 3; c++)
+	{
+		uint32_t value = block[c] >> 3;
+		base[c] = (uint8_t)(value << 3 | value >> 2);
+	}
+	table = block[3] >> 5;
+	uint32_t msb = block[4] << 8 | block[5], lsb = block[6] << 8 | block[7];
+	for(uint32_t i = 0; i < 16; i++) selectors[i] = (uint8_t)(((msb >> i) & 1) << 1 | ((lsb >> i) & 1));
+}
+
+static void unpackEac(const uint8_t* block, int values[8], uint8_t indices[16])
+{
+	int base = block[0], multiplier = block[1] >> 4, table = block[1] & 15;
+	for(uint32_t k = 0; k < 8; k++) values[k] = clampByte(base + eacModifiers[table][k] * multiplier);
+	uint64_t bits = 0;
+	for(uint32_t i = 2; i < 8; i++) bits = bits << 8 | block[i];
+	for(uint32_t i = 0; i < 16; i++) indices[i] = (uint8_t)((bits >> (45 - 3 * i)) & 7);
+}
+
+static uint16_t pack565(const uint8_t color[3])
+{
+	return (uint16_t)((color[0] * 31 + 127) / 255 << 11 | (color[1] * 63 + 127) / 255 << 5 | (color[2] * 31 + 127) / 255);
+}
+
+static void unpack565(uint16_t value, int color[3])
+{
+	int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+	color[0] = r << 3 | r >> 2;
+	color[1] = g << 2 | g >> 4;
+	color[2] = b << 3 | b >> 2;
+}
+
+// the extreme colours in use become the endpoints, every ETC1S colour the nearest BC1 one
+static void etc1sToBc1(const uint8_t* etc, uint8_t* bc)
+{
+	uint8_t base[3], selectors[16];
+	uint32_t table;
+	unpackEtc1s(etc, base, table, selectors);
+	uint8_t colors[4][3];
+	for(uint32_t s = 0; s < 4; s++)
+		for(uint32_t c = 0; c < 3; c++) colors[s][c] = clampByte(base[c] + etcModifier(table, s));
+	// from the darkest selector the block uses to the brightest: -large, -small, +small, +large
+	static const uint32_t order[4] = { 3, 2, 0, 1 };
+	uint32_t used = 0, low = 3, high = 0;
+	for(uint32_t i = 0; i < 16; i++) used |= 1u << selectors[i];
+	for(uint32_t k = 0; k < 4; k++)
+		if(used & (1u << order[k]))
+		{
+			low = std::min(low, k);
+			high = std::max(high, k);
+		}
+	uint16_t endpoints[2] = { pack565(colors[order[high]]), pack565(colors[order[low]]) };
+	if(endpoints[0] < endpoints[1]) std::swap(endpoints[0], endpoints[1]); // four colour mode
+	int palette[4][3];
+	unpack565(endpoints[0], palette[0]);
+	unpack565(endpoints[1], palette[1]);
+	for(uint32_t c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+	uint32_t map[4];
+	for(uint32_t s = 0; s < 4; s++)
+	{
+		int best = 1 << 30;
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			int error = 0;
+			for(uint32_t c = 0; c < 3; c++) error += (colors[s][c] - palette[k][c]) * (colors[s][c] - palette[k][c]);
+			if(error < best)
+			{
+				best = error;
+				map[s] = k;
+			}
+		}
+	}
+	// equal endpoints make a three colour block, where index 0 is still the colour
+	if(endpoints[0] == endpoints[1]) map[0] = map[1] = map[2] = map[3] = 0;
+	uint32_t indices = 0;
+	for(uint32_t y = 0; y < 4; y++)
+		for(uint32_t x = 0; x < 4; x++) indices |= map[selectors[x * 4 + y]] << (2 * (y * 4 + x));
+	bc[0] = (uint8_t)endpoints[0];
+	bc[1] = (uint8_t)(endpoints[0] >> 8);
+	bc[2] = (uint8_t)endpoints[1];
+	bc[3] = (uint8_t)(endpoints[1] >> 8);
+	for(uint32_t i = 0; i < 4; i++) bc[4 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// the extreme alphas in use become the endpoints of an eight value block
+static void eacToBc4(const uint8_t* eac, uint8_t* bc)
+{
+	int values[8];
+	uint8_t indices[16];
+	unpackEac(eac, values, indices);
+	int high = 0, low = 255;
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		high = std::max(high, values[indices[i]]);
+		low = std::min(low, values[indices[i]]);
+	}
+	int palette[8] = { high, low };
+	for(int k = 1; k < 7; k++) palette[k + 1] = ((7 - k) * high + k * low) / 7;
+	uint32_t map[8] = {};
+	for(uint32_t v = 0; v < 8 && high != low; v++)
+		for(uint32_t k = 1; k < 8; k++)
+			if(abs(values[v] - palette[k]) < abs(values[v] - palette[map[v]])) map[v] = k;
+	uint64_t bits = 0;
+	for(uint32_t y = 0; y < 4; y++)
+		for(uint32_t x = 0; x < 4; x++) bits |= (uint64_t)map[indices[x * 4 + y]] << (3 * (y * 4 + x));
+	bc[0] = (uint8_t)high;
+	bc[1] = (uint8_t)low;
+	for(uint32_t i = 0; i < 6; i++) bc[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+// texels of the block inside the image
+static void decodeUniversal(const uint8_t* block, bool alpha, uint8_t* destination, uint32_t width, uint32_t height, \
+	uint32_t blockX, uint32_t blockY)
+{
+	int alphas[8];
+	uint8_t alphaIndices[16];
+	if(alpha)
+	{
+		unpackEac(block, alphas, alphaIndices);
+		block += 8;
+	}
+	uint8_t base[3], selectors[16];
+	uint32_t table;
+	unpackEtc1s(block, base, table, selectors);
+	for(uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++)
+		for(uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++)
+		{
+			uint8_t* texel = destination + ((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * 4;
+			for(uint32_t c = 0; c < 3; c++) texel[c] = clampByte(base[c] + etcModifier(table, selectors[x * 4 + y]));
+			texel[3] = alpha ? (uint8_t)alphas[alphaIndices[x * 4 + y]] : 255;
+		}
+}
+
+void transcodeBlockRow(uint32_t format, VkFormat target, const uint8_t* source, uint8_t* destination, \
+	uint32_t width, uint32_t height, uint32_t row)
+{
+	bool alpha = (format & TEXTURE_UNIVERSAL_ALPHA) != 0;
+	uint32_t sourceBytes = alpha ? 16 : 8;
+	uint32_t blocksX = (width + 3) / 4;
+	TextureFormatInfo info = textureFormatInfo(target);
+	source += (size_t)row * blocksX * sourceBytes;
+	if(info.blockWidth == 1)
+	{
+		for(uint32_t x = 0; x < blocksX; x++) decodeUniversal(source + x * sourceBytes, alpha, destination, width, height, x, row);
+		return;
+	}
+	destination += (size_t)row * blocksX * info.blockBytes;
+	if(universalTargetIsCopy(format, target))
+	{
+		memcpy(destination, source, (size_t)blocksX * sourceBytes);
+		return;
+	}
+	for(uint32_t x = 0; x < blocksX; x++)
+	{
+		const uint8_t* block = source + x * sourceBytes;
+		uint8_t* out = destination + x * info.blockBytes;
+		if(alpha)
+		{
+			eacToBc4(block, out);
+			block += 8;
+			out += 8;
+		}
+		etc1sToBc1(block, out);
+	}
+}
+
+// a base colour per modifier table, refined once around the selectors it picked
+static void encodeEtc1s(const uint8_t texels[64], uint8_t* block)
+{
+	int bestError = 1 << 30;
+	uint32_t bestBase[3] = {}, bestTable = 0, bestSelectors[16] = {};
+	float mean[3] = {};
+	for(uint32_t i = 0; i < 16; i++)
+		for(uint32_t c = 0; c < 3; c++) mean[c] += texels[i * 4 + c] / 16.0f;
+	for(uint32_t table = 0; table < 8; table++)
+	{
+		float target[3] = { mean[0], mean[1], mean[2] };
+		for(uint32_t pass = 0; pass < 2; pass++)
+		{
+			uint32_t quantized[3];
+			int base[3];
+			for(uint32_t c = 0; c < 3; c++)
+			{
+				quantized[c] = (uint32_t)std::min(std::max(target[c] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+				base[c] = (int)(quantized[c] << 3 | quantized[c] >> 2);
+			}
+			int error = 0;
+			uint32_t selectors[16];
+			float sum[3] = {};
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				const uint8_t* texel = texels + i * 4;
+				int best = 1 << 30;
+				for(uint32_t s = 0; s < 4; s++)
+				{
+					int e = 0;
+					for(uint32_t c = 0; c < 3; c++)
+					{
+						int d = clampByte(base[c] + etcModifier(table, s)) - texel[c];
+						e += d * d;
+					}
+					if(e < best)
+					{
+						best = e;
+						selectors[i] = s;
+					}
+				}
+				error += best;
+				for(uint32_t c = 0; c < 3; c++) sum[c] += texel[c] - etcModifier(table, selectors[i]);
+			}
+			if(error < bestError)
+			{
+				bestError = error;
+				bestTable = table;
+				memcpy(bestBase, quantized, sizeof(bestBase));
+				memcpy(bestSelectors, selectors, sizeof(bestSelectors));
+			}
+			for(uint32_t c = 0; c < 3; c++) target[c] = sum[c] / 16.0f;
+		}
+	}
+	// differential mode, both halves the same: no colour deltas, the table twice
+	for(uint32_t c = 0; c < 3; c++) block[c] = (uint8_t)(bestBase[c] << 3);
+	block[3] = (uint8_t)(bestTable << 5 | bestTable << 2 | 2);
+	uint32_t msb = 0, lsb = 0;
+	for(uint32_t y = 0; y < 4; y++)
+		for(uint32_t x = 0; x < 4; x++)
+		{
+			uint32_t selector = bestSelectors[y * 4 + x];
+			msb |= (selector >> 1) << (x * 4 + y);
+			lsb |= (selector & 1) << (x * 4 + y);
+		}
+	block[4] = (uint8_t)(msb >> 8);
+	block[5] = (uint8_t)msb;
+	block[6] = (uint8_t)(lsb >> 8);
+	block[7] = (uint8_t)lsb;
+}
+
+// every table with the multipliers either side of the one that spans the block's range
+static void encodeEac(const uint8_t texels[64], uint8_t* block)
+{
+	int low = 255, high = 0;
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		low = std::min(low, (int)texels[i * 4 + 3]);
+		high = std::max(high, (int)texels[i * 4 + 3]);
+	}
+	int bestError = 1 << 30, bestBase = low, bestMultiplier = 1, bestTable = 13;
+	uint32_t bestIndices[16] = {};
+	if(low == high)
+		for(uint32_t i = 0; i < 16; i++) bestIndices[i] = 4; // table 13 has a zero modifier
+	for(int table = 0; table < 16 && low != high; table++)
+	{
+		int span = eacModifiers[table][7] - eacModifiers[table][3];
+		int estimate = (high - low) / span;
+		for(int multiplier = std::max(estimate, 1); multiplier <= std::min(estimate + 1, 15); multiplier++)
+		{
+			int base = clampByte((int)((high + low - (eacModifiers[table][7] + eacModifiers[table][3]) * multiplier) / 2.0f + 0.5f));
+			int error = 0;
+			uint32_t indices[16];
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				int best = 1 << 30;
+				for(uint32_t k = 0; k < 8; k++)
+				{
+					int d = clampByte(base + eacModifiers[table][k] * multiplier) - texels[i * 4 + 3];
+					if(d * d < best)
+					{
+						best = d * d;
+						indices[i] = k;
+					}
+				}
+				error += best;
+			}
+			if(error < bestError)
+			{
+				bestError = error;
+				bestBase = base;
+				bestMultiplier = multiplier;
+				bestTable = table;
+				memcpy(bestIndices, indices, sizeof(bestIndices));
+			}
+		}
+	}
+	block[0] = (uint8_t)bestBase;
+	block[1] = (uint8_t)(bestMultiplier << 4 | bestTable);
+	uint64_t bits = 0;
+	for(uint32_t y = 0; y < 4; y++)
+		for(uint32_t x = 0; x < 4; x++) bits |= (uint64_t)bestIndices[y * 4 + x] << (45 - 3 * (x * 4 + y));
+	for(uint32_t i = 0; i < 6; i++) block[2 + i] = (uint8_t)(bits >> (40 - 8 * i));
+}
+
+void encodeUniversalBlock(const uint8_t texels[64], bool alpha, uint8_t* block)
+{
+	if(alpha)
+	{
+		encodeEac(texels, block);
+		block += 8;
+	}
+	encodeEtc1s(texels, block);
+}
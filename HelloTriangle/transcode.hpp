@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vulkan/vulkan.h> // format enums only, shared with tools/texconv
+
+// Block compressed texture formats and the universal intermediate format of .btex files.
+// A universal texture is stored as ETC1S: ETC1 blocks whose two halves share one base
+// colour and one modifier table, plus an EAC alpha block in front of each when the
+// texture has alpha. Those are valid ETC2 RGB8 / RGBA8 blocks, so ETC2 devices (the Pi)
+// take them as they are. For other devices a block maps onto BC1 / BC3 almost for free:
+// the four ETC1S colours lie on a line, which becomes the BC1 endpoints, and the eight
+// EAC alphas span the BC4 endpoints. RGBA8 is the fallback when neither is sampled.
+// The codec is deliberately this simple so a whole mip chain transcodes at load.
+
+// not VkFormats; the low bits say what the blocks hold
+#define TEXTURE_FORMAT_UNIVERSAL 0x42550000u    // "BU"
+#define TEXTURE_UNIVERSAL_ALPHA 1u
+#define TEXTURE_UNIVERSAL_SRGB 2u
+#define TEXTURE_MAX_UNIVERSAL_TARGETS 3
+
+struct TextureFormatInfo
+{
+	uint32_t blockWidth, blockHeight;
+	uint32_t blockBytes;        // 0 for formats .btex doesn't know
+	const char* name;
+};
+
+TextureFormatInfo textureFormatInfo(uint32_t format);
+bool textureFormatUniversal(uint32_t format);
+// bytes of one level, all layers
+uint64_t textureLevelSize(uint32_t format, uint32_t width, uint32_t height, uint32_t layers);
+
+// what a universal format can become, best first: ETC2, then BC, then RGBA8; returns the count
+uint32_t universalTargets(uint32_t format, VkFormat targets[TEXTURE_MAX_UNIVERSAL_TARGETS]);
+// the target stores the universal blocks bit for bit
+bool universalTargetIsCopy(uint32_t format, VkFormat target);
+// one row of blocks of one layer; source and destination point at that layer in the level
+void transcodeBlockRow(uint32_t format, VkFormat target, const uint8_t* source, uint8_t* destination, \
+	uint32_t width, uint32_t height, uint32_t row);
+
+// offline: one 4x4 block of RGBA8 texels, row major, into a universal block (16 bytes with alpha, else 8)
+void encodeUniversalBlock(const uint8_t texels[64], bool alpha, uint8_t* block);
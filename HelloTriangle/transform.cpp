@@ -0,0 +1,238 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "transform.hpp"
+
+// 4-wide float vector, lowered to SSE on x86 and NEON on the Pi.
+// aligned(4) so loads from tightly packed glm::mat4 arrays are always legal.
+typedef float v4f __attribute__((vector_size(16), aligned(4)));
+
+// local = T * R * S, written column-major straight into the world slot
+static inline void composeTRS(const glm::vec3& t, const glm::quat& q, const glm::vec3& s, float* m)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	m[0]  = (1.0f - 2.0f * (yy + zz)) * s.x;
+	m[1]  = (2.0f * (xy + wz)) * s.x;
+	m[2]  = (2.0f * (xz - wy)) * s.x;
+	m[3]  = 0.0f;
+	m[4]  = (2.0f * (xy - wz)) * s.y;
+	m[5]  = (1.0f - 2.0f * (xx + zz)) * s.y;
+	m[6]  = (2.0f * (yz + wx)) * s.y;
+	m[7]  = 0.0f;
+	m[8]  = (2.0f * (xz + wy)) * s.z;
+	m[9]  = (2.0f * (yz - wx)) * s.z;
+	m[10] = (1.0f - 2.0f * (xx + yy)) * s.z;
+	m[11] = 0.0f;
+	m[12] = t.x;
+	m[13] = t.y;
+	m[14] = t.z;
+	m[15] = 1.0f;
+}
+
+// out = p * l, one column at a time: out[j] = sum_k p[k] * l[j][k]
+static inline void mulMat4(const float* p, const float* l, float* out)
+{
+	v4f p0 = *(const v4f*)(p + 0);
+	v4f p1 = *(const v4f*)(p + 4);
+	v4f p2 = *(const v4f*)(p + 8);
+	v4f p3 = *(const v4f*)(p + 12);
+	for(int j = 0; j < 4; j++)
+	{
+		const float* c = l + j * 4;
+		*(v4f*)(out + j * 4) = p0 * c[0] + p1 * c[1] + p2 * c[2] + p3 * c[3];
+	}
+}
+
+TransformHandle TransformHierarchy::addNode(TransformHandle parentHandle)
+{
+	uint32_t parentSlot = TRANSFORM_NO_PARENT;
+	if(parentHandle != TRANSFORM_NO_PARENT)
+	{
+		if(parentHandle >= handleToSlot.size())
+			throw std::runtime_error("Invalid parent transform handle!\n");
+		parentSlot = handleToSlot[parentHandle];
+	}
+	// appending keeps parents before children, since the parent already exists
+	uint32_t s = (uint32_t)parent.size();
+	TransformHandle handle = (TransformHandle)handleToSlot.size();
+	parent.push_back(parentSlot);
+	localPosition.push_back(glm::vec3(0.0f));
+	localRotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	localScale.push_back(glm::vec3(1.0f));
+	worldMatrix.push_back(glm::mat4(1.0f));
+	dirty.push_back(1);
+	changedFrame.push_back(0);
+	handleToSlot.push_back(s);
+	slotToHandle.push_back(handle);
+	return handle;
+}
+
+void TransformHierarchy::setParent(TransformHandle node, TransformHandle parentHandle)
+{
+	uint32_t s = handleToSlot[node];
+	uint32_t parentSlot = TRANSFORM_NO_PARENT;
+	if(parentHandle != TRANSFORM_NO_PARENT)
+	{
+		parentSlot = handleToSlot[parentHandle];
+		// refuse to create a cycle
+		for(uint32_t p = parentSlot; p != TRANSFORM_NO_PARENT; p = parent[p])
+			if(p == s) throw std::runtime_error("Transform parent would create a cycle!\n");
+	}
+	parent[s] = parentSlot;
+	dirty[s] = 1;
+	// a parent after its child breaks the single pass ordering
+	if(parentSlot != TRANSFORM_NO_PARENT && parentSlot > s)
+		needsSort = true;
+}
+
+void TransformHierarchy::setLocal(TransformHandle node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	uint32_t s = handleToSlot[node];
+	localPosition[s] = position;
+	localRotation[s] = rotation;
+	localScale[s] = scale;
+	dirty[s] = 1;
+}
+
+void TransformHierarchy::setPosition(TransformHandle node, const glm::vec3& position)
+{
+	uint32_t s = handleToSlot[node];
+	localPosition[s] = position;
+	dirty[s] = 1;
+}
+
+void TransformHierarchy::setRotation(TransformHandle node, const glm::quat& rotation)
+{
+	uint32_t s = handleToSlot[node];
+	localRotation[s] = rotation;
+	dirty[s] = 1;
+}
+
+void TransformHierarchy::setScale(TransformHandle node, const glm::vec3& scale)
+{
+	uint32_t s = handleToSlot[node];
+	localScale[s] = scale;
+	dirty[s] = 1;
+}
+
+// stable sort by depth: parents first, siblings stay together in breadth-first order
+void TransformHierarchy::sortByDepth()
+{
+	size_t n = parent.size();
+	std::vector<uint32_t> depth(n, UINT32_MAX);
+	std::vector<uint32_t> chain;
+	for(uint32_t i = 0; i < n; i++)
+	{
+		// walk up until a node of known depth, then unwind
+		uint32_t p = i;
+		while(p != TRANSFORM_NO_PARENT && depth[p] == UINT32_MAX)
+		{
+			chain.push_back(p);
+			p = parent[p];
+		}
+		uint32_t d = (p == TRANSFORM_NO_PARENT) ? 0 : depth[p] + 1;
+		while(!chain.empty())
+		{
+			depth[chain.back()] = d++;
+			chain.pop_back();
+		}
+	}
+
+	std::vector<uint32_t> order(n);
+	for(uint32_t i = 0; i < n; i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return depth[a] < depth[b]; });
+
+	std::vector<uint32_t> newSlot(n);
+	for(uint32_t i = 0; i < n; i++) newSlot[order[i]] = i;
+
+	std::vector<uint32_t> newParent(n);
+	std::vector<glm::vec3> newPosition(n), newScale(n);
+	std::vector<glm::quat> newRotation(n);
+	std::vector<TransformHandle> newSlotToHandle(n);
+	for(uint32_t i = 0; i < n; i++)
+	{
+		uint32_t o = order[i];
+		newParent[i] = parent[o] == TRANSFORM_NO_PARENT ? TRANSFORM_NO_PARENT : newSlot[parent[o]];
+		newPosition[i] = localPosition[o];
+		newRotation[i] = localRotation[o];
+		newScale[i] = localScale[o];
+		newSlotToHandle[i] = slotToHandle[o];
+		handleToSlot[slotToHandle[o]] = i;
+	}
+	parent.swap(newParent);
+	localPosition.swap(newPosition);
+	localRotation.swap(newRotation);
+	localScale.swap(newScale);
+	slotToHandle.swap(newSlotToHandle);
+
+	// every slot moved, so every matrix must be rebuilt and re-uploaded
+	std::fill(dirty.begin(), dirty.end(), 1);
+	needsSort = false;
+}
+
+uint32_t TransformHierarchy::update()
+{
+	if(needsSort) sortByDepth();
+	frame++;
+
+	size_t n = parent.size();
+	if(n == 0) return 0;
+	uint8_t* d = dirty.data();
+	const uint32_t* p = parent.data();
+	float* w = &worldMatrix.data()[0][0][0];
+	uint32_t recomputed = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		uint32_t ps = p[i];
+		// parents were handled earlier in this pass, so dirt flows down the tree
+		if(ps != TRANSFORM_NO_PARENT) d[i] |= d[ps];
+		if(!d[i]) continue;
+
+		float* out = w + i * 16;
+		if(ps == TRANSFORM_NO_PARENT)
+			composeTRS(localPosition[i], localRotation[i], localScale[i], out);
+		else
+		{
+			float local[16];
+			composeTRS(localPosition[i], localRotation[i], localScale[i], local);
+			mulMat4(w + (size_t)ps * 16, local, out);
+		}
+		changedFrame[i] = frame;
+		recomputed++;
+	}
+	if(recomputed) memset(d, 0, n);
+	return recomputed;
+}
+
+void TransformHierarchy::setUploadTargets(uint32_t count, size_t capacity)
+{
+	targetFrame.assign(count, 0);
+	targetCapacity = capacity;
+}
+
+uint32_t TransformHierarchy::upload(uint32_t target, glm::mat4* dst)
+{
+	uint64_t last = targetFrame[target];
+	size_t n = parent.size();
+	if(n > targetCapacity)
+		throw std::runtime_error("Scene has more transforms than the upload buffer holds!\n");
+	const uint64_t* changed = changedFrame.data();
+	uint32_t written = 0;
+	// copy contiguous runs of changed matrices with one memcpy each
+	size_t i = 0;
+	while(i < n)
+	{
+		if(changed[i] <= last) { i++; continue; }
+		size_t run = i;
+		while(run < n && changed[run] > last) run++;
+		memcpy(dst + i, worldMatrix.data() + i, (run - i) * sizeof(glm::mat4));
+		written += (uint32_t)(run - i);
+		i = run;
+	}
+	targetFrame[target] = frame;
+	return written;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Scene transform hierarchy.
+// All per-node data lives in parallel (SoA) arrays, ordered so that a parent's
+// slot is always lower than its children's. World matrices can then be rebuilt
+// front-to-back in a single linear pass, and only dirty subtrees are touched.
+// Handles stay valid when nodes are re-sorted; slots (the index of a node's
+// matrix in the upload buffer) may change, so query slot() each frame.
+
+typedef uint32_t TransformHandle;
+#define TRANSFORM_NO_PARENT UINT32_MAX
+
+class TransformHierarchy
+{
+	public:
+		TransformHandle addNode(TransformHandle parent = TRANSFORM_NO_PARENT);
+		void setParent(TransformHandle node, TransformHandle parent);
+
+		void setLocal(TransformHandle node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+		void setPosition(TransformHandle node, const glm::vec3& position);
+		void setRotation(TransformHandle node, const glm::quat& rotation);
+		void setScale(TransformHandle node, const glm::vec3& scale);
+
+		const glm::mat4& world(TransformHandle node) const { return worldMatrix[handleToSlot[node]]; }
+		uint32_t slot(TransformHandle node) const { return handleToSlot[node]; }
+		size_t size() const { return parent.size(); }
+
+		// rebuild world matrices of dirty subtrees, returns number of nodes recomputed
+		uint32_t update();
+		// number of upload buffers (e.g. one per swapchain image) that mirror the world array,
+		// and how many matrices each of them can hold
+		void setUploadTargets(uint32_t count, size_t capacity);
+		// copy every world matrix that changed since this target was last written, returns count
+		uint32_t upload(uint32_t target, glm::mat4* dst);
+
+	private:
+		// per-slot data, parents before children
+		std::vector<uint32_t> parent;          // parent slot or TRANSFORM_NO_PARENT
+		std::vector<glm::vec3> localPosition;
+		std::vector<glm::quat> localRotation;
+		std::vector<glm::vec3> localScale;
+		std::vector<glm::mat4> worldMatrix;
+		std::vector<uint8_t> dirty;
+		std::vector<uint64_t> changedFrame;    // frame in which the world matrix last changed
+
+		// stable handle <-> slot mapping
+		std::vector<uint32_t> handleToSlot;
+		std::vector<TransformHandle> slotToHandle;
+
+		std::vector<uint64_t> targetFrame;     // last frame written into each upload target
+		size_t targetCapacity = 0;
+		uint64_t frame = 0;
+		bool needsSort = false;
+
+		void sortByDepth();
+};
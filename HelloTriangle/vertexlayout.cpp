@@ -0,0 +1,287 @@
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "vertexlayout.hpp"
+
+static const VertexLayout vertexLayouts[VERTEX_LAYOUT_COUNT] = {
+	{ "full", 36, 4, {
+		{ VERTEX_POSITION, VERTEX_FLOAT3, 0 },
+		{ VERTEX_NORMAL, VERTEX_FLOAT3, 12 },
+		{ VERTEX_COLOR, VERTEX_UNORM8X4, 24 },
+		{ VERTEX_UV, VERTEX_FLOAT2, 28 } } },
+	{ "compact", 20, 4, {
+		{ VERTEX_POSITION, VERTEX_SNORM16X4, 0 },
+		{ VERTEX_NORMAL, VERTEX_OCT_SNORM16X2, 8 },
+		{ VERTEX_COLOR, VERTEX_UNORM8X4, 12 },
+		{ VERTEX_UV, VERTEX_UNORM16X2, 16 } } },
+	{ "half", 20, 4, {
+		{ VERTEX_POSITION, VERTEX_HALF4, 0 },
+		{ VERTEX_NORMAL, VERTEX_OCT_SNORM16X2, 8 },
+		{ VERTEX_COLOR, VERTEX_UNORM8X4, 12 },
+		{ VERTEX_UV, VERTEX_UNORM16X2, 16 } } },
+};
+
+struct VertexEncodingInfo
+{
+	uint32_t size;
+	VkFormat format;
+	const char* glslType;
+	bool quantized;             // decoded value lives in -1..1 / 0..1 and needs the per-mesh range
+};
+
+static const VertexEncodingInfo encodingInfo[] = {
+	{ 8, VK_FORMAT_R32G32_SFLOAT, "vec2", false },              // VERTEX_FLOAT2
+	{ 12, VK_FORMAT_R32G32B32_SFLOAT, "vec3", false },          // VERTEX_FLOAT3
+	{ 8, VK_FORMAT_R16G16B16A16_SFLOAT, "vec4", true },         // VERTEX_HALF4
+	{ 8, VK_FORMAT_R16G16B16A16_SNORM, "vec4", true },          // VERTEX_SNORM16X4
+	{ 4, VK_FORMAT_R16G16_SNORM, "vec2", false },               // VERTEX_OCT_SNORM16X2
+	{ 4, VK_FORMAT_R8G8B8A8_UNORM, "vec4", false },             // VERTEX_UNORM8X4
+	{ 4, VK_FORMAT_R16G16_UNORM, "vec2", true },                // VERTEX_UNORM16X2
+};
+
+static const char* semanticNames[VERTEX_SEMANTIC_COUNT] = { "Position", "Normal", "Color", "UV" };
+
+const VertexLayout& getVertexLayout(uint32_t id)
+{
+	if(id >= VERTEX_LAYOUT_COUNT) throw std::runtime_error("Unknown vertex layout!\n");
+	return vertexLayouts[id];
+}
+
+bool findVertexLayout(const std::string& name, uint32_t& id)
+{
+	for(uint32_t i = 0; i < VERTEX_LAYOUT_COUNT; i++)
+		if(name == vertexLayouts[i].name) { id = i; return true; }
+	return false;
+}
+
+uint32_t vertexEncodingSize(VertexEncoding encoding) { return encodingInfo[encoding].size; }
+VkFormat vertexEncodingFormat(VertexEncoding encoding) { return encodingInfo[encoding].format; }
+
+uint32_t vertexInputAttributes(const VertexLayout& layout, uint32_t binding, VkVertexInputAttributeDescription* out)
+{
+	for(uint32_t a = 0; a < layout.attributeCount; a++)
+	{
+		out[a].location = layout.attributes[a].semantic; // matches generateVertexLayoutGlsl()
+		out[a].binding = binding;
+		out[a].format = encodingInfo[layout.attributes[a].encoding].format;
+		out[a].offset = layout.attributes[a].offset;
+	}
+	return layout.attributeCount;
+}
+
+// * PACKING * //
+
+static uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, 4);
+	uint32_t sign = (x >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((x >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = x & 0x7FFFFF;
+	if(((x >> 23) & 0xFF) == 0xFF) return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // inf/nan
+	if(exponent >= 31) return (uint16_t)(sign | 0x7C00); // overflow to inf
+	if(exponent <= 0)
+	{
+		// subnormal or zero
+		if(exponent < -10) return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if((mantissa >> (shift - 1)) & 1) half++; // round half up
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if(mantissa & 0x1000) half++; // round, may carry into the exponent which is still correct
+	return (uint16_t)half;
+}
+
+static int16_t toSnorm16(float v)
+{
+	return (int16_t)lrintf(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+}
+
+static uint16_t toUnorm16(float v)
+{
+	return (uint16_t)lrintf(std::max(0.0f, std::min(1.0f, v)) * 65535.0f);
+}
+
+static uint8_t toUnorm8(float v)
+{
+	return (uint8_t)lrintf(std::max(0.0f, std::min(1.0f, v)) * 255.0f);
+}
+
+// octahedral map of a unit vector onto the [-1,1] square
+static void octEncode(const float* n, float* out)
+{
+	float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	if(l1 == 0.0f) { out[0] = 0.0f; out[1] = 0.0f; return; }
+	float x = n[0] / l1, y = n[1] / l1;
+	if(n[2] < 0.0f)
+	{
+		float ox = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float oy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = ox;
+		y = oy;
+	}
+	out[0] = x;
+	out[1] = y;
+}
+
+VertexQuantization computeVertexQuantization(const VertexLayout& layout, const MeshVertex* vertices, size_t count)
+{
+	VertexQuantization q;
+	for(int k = 0; k < 3; k++) { q.positionScale[k] = 1.0f; q.positionOffset[k] = 0.0f; }
+	for(int k = 0; k < 2; k++) { q.uvScale[k] = 1.0f; q.uvOffset[k] = 0.0f; }
+	if(count == 0) return q;
+
+	float lo[5], hi[5];
+	for(int k = 0; k < 5; k++) { lo[k] = INFINITY; hi[k] = -INFINITY; }
+	for(size_t i = 0; i < count; i++)
+	{
+		for(int k = 0; k < 3; k++) { lo[k] = std::min(lo[k], vertices[i].position[k]); hi[k] = std::max(hi[k], vertices[i].position[k]); }
+		for(int k = 0; k < 2; k++) { lo[3 + k] = std::min(lo[3 + k], vertices[i].uv[k]); hi[3 + k] = std::max(hi[3 + k], vertices[i].uv[k]); }
+	}
+	for(uint32_t a = 0; a < layout.attributeCount; a++)
+	{
+		const VertexAttributeLayout& attr = layout.attributes[a];
+		if(!encodingInfo[attr.encoding].quantized) continue;
+		if(attr.semantic == VERTEX_POSITION)
+		{
+			// one uniform scale for all axes keeps the grid isotropic, -1..1 around the center
+			float extent = 0.0f;
+			for(int k = 0; k < 3; k++) extent = std::max(extent, (hi[k] - lo[k]) * 0.5f);
+			if(extent == 0.0f) extent = 1.0f;
+			for(int k = 0; k < 3; k++)
+			{
+				q.positionScale[k] = extent;
+				q.positionOffset[k] = (hi[k] + lo[k]) * 0.5f;
+			}
+		}
+		else if(attr.semantic == VERTEX_UV)
+		{
+			// 0..1 over the used range, so tiled UVs outside 0..1 survive
+			for(int k = 0; k < 2; k++)
+			{
+				float range = hi[3 + k] - lo[3 + k];
+				q.uvScale[k] = range > 0.0f ? range : 1.0f;
+				q.uvOffset[k] = lo[3 + k];
+			}
+		}
+	}
+	return q;
+}
+
+void packVertex(const VertexLayout& layout, const VertexQuantization& q, const MeshVertex& vertex, void* out)
+{
+	char* base = (char*)out;
+	memset(base, 0, layout.stride);
+	for(uint32_t a = 0; a < layout.attributeCount; a++)
+	{
+		const VertexAttributeLayout& attr = layout.attributes[a];
+		float v[4] = { 0, 0, 0, 0 };
+		switch(attr.semantic)
+		{
+			case VERTEX_POSITION:
+				for(int k = 0; k < 3; k++) v[k] = vertex.position[k];
+				if(encodingInfo[attr.encoding].quantized)
+					for(int k = 0; k < 3; k++) v[k] = (v[k] - q.positionOffset[k]) / q.positionScale[k];
+				break;
+			case VERTEX_NORMAL:
+				for(int k = 0; k < 3; k++) v[k] = vertex.normal[k];
+				break;
+			case VERTEX_COLOR:
+				for(int k = 0; k < 4; k++) v[k] = vertex.color[k];
+				break;
+			case VERTEX_UV:
+				for(int k = 0; k < 2; k++) v[k] = vertex.uv[k];
+				if(encodingInfo[attr.encoding].quantized)
+					for(int k = 0; k < 2; k++) v[k] = (v[k] - q.uvOffset[k]) / q.uvScale[k];
+				break;
+			default:
+				break;
+		}
+
+		char* dst = base + attr.offset;
+		switch(attr.encoding)
+		{
+			case VERTEX_FLOAT2: memcpy(dst, v, 8); break;
+			case VERTEX_FLOAT3: memcpy(dst, v, 12); break;
+			case VERTEX_HALF4:
+			{
+				uint16_t h[4] = { floatToHalf(v[0]), floatToHalf(v[1]), floatToHalf(v[2]), floatToHalf(1.0f) };
+				memcpy(dst, h, 8);
+				break;
+			}
+			case VERTEX_SNORM16X4:
+			{
+				int16_t s[4] = { toSnorm16(v[0]), toSnorm16(v[1]), toSnorm16(v[2]), 32767 };
+				memcpy(dst, s, 8);
+				break;
+			}
+			case VERTEX_OCT_SNORM16X2:
+			{
+				float e[2];
+				octEncode(v, e);
+				int16_t s[2] = { toSnorm16(e[0]), toSnorm16(e[1]) };
+				memcpy(dst, s, 4);
+				break;
+			}
+			case VERTEX_UNORM8X4:
+			{
+				uint8_t u[4] = { toUnorm8(v[0]), toUnorm8(v[1]), toUnorm8(v[2]), toUnorm8(v[3]) };
+				memcpy(dst, u, 4);
+				break;
+			}
+			case VERTEX_UNORM16X2:
+			{
+				uint16_t u[2] = { toUnorm16(v[0]), toUnorm16(v[1]) };
+				memcpy(dst, u, 4);
+				break;
+			}
+		}
+	}
+}
+
+// * SHADER GENERATION * //
+
+std::string generateVertexLayoutGlsl(const VertexLayout& layout)
+{
+	std::string glsl;
+	glsl += "// generated by tools/layoutgen from vertexlayout.cpp, do not edit\n";
+	glsl += "// vertex layout \"" + std::string(layout.name) + "\", " + std::to_string(layout.stride) + " bytes\n\n";
+	for(uint32_t a = 0; a < layout.attributeCount; a++)
+	{
+		const VertexAttributeLayout& attr = layout.attributes[a];
+		glsl += "layout(location = " + std::to_string(attr.semantic) + ") in " + encodingInfo[attr.encoding].glslType + \
+			" in" + semanticNames[attr.semantic] + ";\n";
+	}
+
+	glsl += "\nstruct Vertex {\n    vec3 position;\n    vec3 normal;\n    vec4 color;\n    vec2 uv;\n};\n\n";
+	glsl += "vec3 octDecode(vec2 e)\n{\n";
+	glsl += "    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n";
+	glsl += "    float t = max(-n.z, 0.0);\n";
+	glsl += "    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));\n";
+	glsl += "    return normalize(n);\n}\n\n";
+
+	// position stays in quantized space, its range is folded into the draw transform
+	glsl += "Vertex decodeVertex(vec4 uvTransform)\n{\n    Vertex v;\n";
+	glsl += "    v.position = vec3(0.0);\n    v.normal = vec3(0.0, 0.0, 1.0);\n    v.color = vec4(1.0);\n    v.uv = vec2(0.0);\n";
+	for(uint32_t a = 0; a < layout.attributeCount; a++)
+	{
+		const VertexAttributeLayout& attr = layout.attributes[a];
+		switch(attr.semantic)
+		{
+			case VERTEX_POSITION: glsl += "    v.position = inPosition.xyz;\n"; break;
+			case VERTEX_NORMAL:
+				glsl += attr.encoding == VERTEX_OCT_SNORM16X2 ? "    v.normal = octDecode(inNormal);\n" : "    v.normal = normalize(inNormal);\n";
+				break;
+			case VERTEX_COLOR: glsl += "    v.color = inColor;\n"; break;
+			case VERTEX_UV: glsl += "    v.uv = inUV * uvTransform.xy + uvTransform.zw;\n"; break;
+			default: break;
+		}
+	}
+	glsl += "    return v;\n}\n";
+	return glsl;
+}
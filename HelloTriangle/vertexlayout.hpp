@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <vulkan/vulkan.h> // types and format enums only, usable from the offline tools
+
+#include "meshformat.hpp"
+
+// Single source of truth for packed vertex layouts. The same table drives
+//  - meshconv, which packs MeshVertex data with packVertex(),
+//  - the pipeline's VkVertexInputAttributeDescriptions (vertexInputAttributes()),
+//  - the GLSL inputs and decodeVertex() emitted by tools/layoutgen.
+// Positions and UVs may be quantized against a per-mesh range; the position
+// range is folded into the draw transform, the UV range is pushed to the shader.
+
+enum VertexSemantic : uint32_t
+{
+	VERTEX_POSITION = 0,
+	VERTEX_NORMAL = 1,
+	VERTEX_COLOR = 2,
+	VERTEX_UV = 3,
+	VERTEX_SEMANTIC_COUNT
+};
+
+enum VertexEncoding : uint32_t
+{
+	VERTEX_FLOAT2,         // R32G32_SFLOAT
+	VERTEX_FLOAT3,         // R32G32B32_SFLOAT
+	VERTEX_HALF4,          // R16G16B16A16_SFLOAT, w unused
+	VERTEX_SNORM16X4,      // R16G16B16A16_SNORM, w unused
+	VERTEX_OCT_SNORM16X2,  // R16G16_SNORM, octahedral unit vector
+	VERTEX_UNORM8X4,       // R8G8B8A8_UNORM
+	VERTEX_UNORM16X2,      // R16G16_UNORM
+};
+
+enum VertexLayoutId : uint32_t
+{
+	VERTEX_LAYOUT_FULL = 0,     // 36 bytes: float position/normal/uv, unorm8 color
+	VERTEX_LAYOUT_COMPACT = 1,  // 20 bytes: snorm16 position, octahedral normal, unorm8 color, unorm16 uv
+	VERTEX_LAYOUT_HALF = 2,     // 20 bytes: like compact with half-float positions
+	VERTEX_LAYOUT_COUNT
+};
+
+struct VertexAttributeLayout
+{
+	VertexSemantic semantic;
+	VertexEncoding encoding;
+	uint32_t offset;            // bytes into the vertex; the shader location is the semantic
+};
+
+struct VertexLayout
+{
+	const char* name;           // also names the generated shader: shaders/mesh_<name>.vert.spv
+	uint32_t stride;
+	uint32_t attributeCount;
+	VertexAttributeLayout attributes[VERTEX_SEMANTIC_COUNT];
+};
+
+// per-mesh dequantization: value = encoded * scale + offset
+struct VertexQuantization
+{
+	float positionScale[3];
+	float positionOffset[3];
+	float uvScale[2];
+	float uvOffset[2];
+};
+
+const VertexLayout& getVertexLayout(uint32_t id); // throws on unknown ids
+bool findVertexLayout(const std::string& name, uint32_t& id);
+
+// bytes per attribute and the VkFormat used to fetch it
+uint32_t vertexEncodingSize(VertexEncoding encoding);
+VkFormat vertexEncodingFormat(VertexEncoding encoding);
+// fills out[] (VERTEX_SEMANTIC_COUNT entries max) for one binding, returns the attribute count
+uint32_t vertexInputAttributes(const VertexLayout& layout, uint32_t binding, VkVertexInputAttributeDescription* out);
+
+// fit the quantization ranges of a layout to a set of vertices
+VertexQuantization computeVertexQuantization(const VertexLayout& layout, const MeshVertex* vertices, size_t count);
+void packVertex(const VertexLayout& layout, const VertexQuantization& q, const MeshVertex& vertex, void* out);
+
+// GLSL vertex inputs plus a Vertex decodeVertex(vec4 uvTransform) function for the layout
+std::string generateVertexLayoutGlsl(const VertexLayout& layout);
@@ -0,0 +1,212 @@
+#include <stdexcept>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <optional>
+#include <cstdarg>
+
+#include "benvulkan.hpp"
+#include "vkdispatch.hpp"
+
+DeviceDispatch vkd;
+
+static const char* callNames[VKD_CALL_COUNT] = {
+	"acquire", "submit", "present", "wait_semaphores", "wait_fences", "begin_cb", "end_cb",
+	"begin_render_pass", "end_render_pass", "begin_rendering", "end_rendering", "barrier",
+	"bind_pipeline", "bind_vertex", "bind_index", "bind_sets", "push_constants", "set_viewport", "set_scissor",
+	"draw", "draw_indexed", "draw_indexed_indirect", "dispatch", "fill_buffer", "copy_image_to_buffer",
+	"copy_buffer_to_image", "copy_image", "blit_image",
+};
+
+const char* vkdCallName(uint32_t call)
+{
+	return call < VKD_CALL_COUNT ? callNames[call] : "unknown";
+}
+
+template<typename T> static void loadDeviceFunction(VkDevice device, T& function, const char* name, const char* alias = nullptr)
+{
+	function = (T)vkGetDeviceProcAddr(device, name);
+	if(!function && alias) function = (T)vkGetDeviceProcAddr(device, alias);
+}
+
+void DeviceDispatch::init(VkDevice device)
+{
+	loadDeviceFunction(device, acquireNextImageKHR, "vkAcquireNextImageKHR");
+	loadDeviceFunction(device, queueSubmitFn, "vkQueueSubmit");
+	loadDeviceFunction(device, queuePresentKHR, "vkQueuePresentKHR");
+	loadDeviceFunction(device, waitSemaphoresFn, "vkWaitSemaphores", "vkWaitSemaphoresKHR");
+	loadDeviceFunction(device, waitForFencesFn, "vkWaitForFences");
+	loadDeviceFunction(device, beginCommandBufferFn, "vkBeginCommandBuffer");
+	loadDeviceFunction(device, endCommandBufferFn, "vkEndCommandBuffer");
+	loadDeviceFunction(device, cmdBeginRenderPassFn, "vkCmdBeginRenderPass");
+	loadDeviceFunction(device, cmdEndRenderPassFn, "vkCmdEndRenderPass");
+	loadDeviceFunction(device, beginRendering, "vkCmdBeginRendering", "vkCmdBeginRenderingKHR");
+	loadDeviceFunction(device, endRendering, "vkCmdEndRendering", "vkCmdEndRenderingKHR");
+	loadDeviceFunction(device, cmdPipelineBarrierFn, "vkCmdPipelineBarrier");
+	loadDeviceFunction(device, cmdBindPipelineFn, "vkCmdBindPipeline");
+	loadDeviceFunction(device, cmdBindVertexBuffersFn, "vkCmdBindVertexBuffers");
+	loadDeviceFunction(device, cmdBindIndexBufferFn, "vkCmdBindIndexBuffer");
+	loadDeviceFunction(device, cmdBindDescriptorSetsFn, "vkCmdBindDescriptorSets");
+	loadDeviceFunction(device, cmdPushConstantsFn, "vkCmdPushConstants");
+	loadDeviceFunction(device, cmdSetViewportFn, "vkCmdSetViewport");
+	loadDeviceFunction(device, cmdSetScissorFn, "vkCmdSetScissor");
+	loadDeviceFunction(device, cmdDrawFn, "vkCmdDraw");
+	loadDeviceFunction(device, cmdDrawIndexedFn, "vkCmdDrawIndexed");
+	loadDeviceFunction(device, cmdDrawIndexedIndirectFn, "vkCmdDrawIndexedIndirect");
+	loadDeviceFunction(device, cmdDispatchFn, "vkCmdDispatch");
+	loadDeviceFunction(device, cmdFillBufferFn, "vkCmdFillBuffer");
+	loadDeviceFunction(device, cmdCopyImageToBufferFn, "vkCmdCopyImageToBuffer");
+	loadDeviceFunction(device, cmdCopyBufferToImageFn, "vkCmdCopyBufferToImage");
+	loadDeviceFunction(device, cmdCopyImageFn, "vkCmdCopyImage");
+	loadDeviceFunction(device, cmdBlitImageFn, "vkCmdBlitImage");
+	// the swapchain functions are missing on headless compute devices, everything else is core 1.0
+	if(!queueSubmitFn || !beginCommandBufferFn || !cmdPipelineBarrierFn || !cmdDrawIndexedFn || !cmdCopyImageToBufferFn || \
+		!cmdCopyBufferToImageFn || !cmdCopyImageFn || !cmdBlitImageFn)
+		throw std::runtime_error("Failed to load device functions!\n");
+	lastFrame = Clock::now();
+}
+
+DeviceDispatch::ThreadCounters* DeviceDispatch::registerThread()
+{
+	std::lock_guard<std::mutex> guard(threadsLock);
+	threadStats.emplace_back(new ThreadCounters());
+	return threadStats.back().get();
+}
+
+void DeviceDispatch::recordingDone(VkCommandBuffer commandBuffer)
+{
+	Recording& recording = threadRecording();
+	if(recording.commandBuffer != commandBuffer) return;
+	VkdCommandCounts now = commandCounts();
+	VkdCommandCounts counts = { now.draws - recording.start.draws, now.bindChanges - recording.start.bindChanges, \
+		now.redundantSets - recording.start.redundantSets };
+	recording.commandBuffer = VK_NULL_HANDLE;
+	std::lock_guard<std::mutex> guard(recordedLock);
+	recordedCommands[commandBuffer] = RecordedCommands{ counts, recording.oneTime };
+}
+
+void DeviceDispatch::countSubmitted(uint32_t count, const VkSubmitInfo* submits)
+{
+	std::lock_guard<std::mutex> guard(recordedLock);
+	for(uint32_t s = 0; s < count; s++)
+		for(uint32_t c = 0; c < submits[s].commandBufferCount; c++)
+		{
+			auto it = recordedCommands.find(submits[s].pCommandBuffers[c]);
+			if(it == recordedCommands.end()) continue;
+			submittedCounts.draws += it->second.counts.draws;
+			submittedCounts.bindChanges += it->second.counts.bindChanges;
+			submittedCounts.redundantSets += it->second.counts.redundantSets;
+			if(it->second.oneTime) recordedCommands.erase(it);
+		}
+}
+
+// the growth of a running total since the last call
+template<typename T> static T take(T total, T& taken)
+{
+	T delta = total - taken;
+	taken = total;
+	return delta;
+}
+
+// appends to a fixed size buffer, output past its end is cut off
+static size_t appendf(char* buffer, size_t size, size_t used, const char* format, ...)
+{
+	if(used >= size) return used;
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buffer + used, size - used, format, args);
+	va_end(args);
+	return n < 0 ? used : std::min(size, used + n);
+}
+
+void DeviceDispatch::frameDone()
+{
+	Clock::time_point now = Clock::now();
+	double frameMilliseconds = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+	lastFrame = now;
+	{
+		std::lock_guard<std::mutex> guard(threadsLock);
+		for(auto& thread : threadStats)
+		{
+			VkdFrameStats& taken = thread->taken;
+			current.calls += take(thread->calls.get(), taken.calls);
+			current.recorded.draws += take(thread->draws.get(), taken.recorded.draws);
+			current.recorded.bindChanges += take(thread->bindChanges.get(), taken.recorded.bindChanges);
+			current.recorded.redundantSets += take(thread->redundantSets.get(), taken.recorded.redundantSets);
+			for(uint32_t call = 0; call < VKD_CALL_COUNT; call++)
+			{
+				current.callCounts[call] += take(thread->callCounts[call].get(), taken.callCounts[call]);
+				current.callMilliseconds[call] += take(thread->callMilliseconds[call].get(), taken.callMilliseconds[call]);
+			}
+		}
+	}
+	{
+		std::lock_guard<std::mutex> guard(recordedLock);
+		current.submitted = submittedCounts;
+		submittedCounts = VkdCommandCounts{};
+	}
+	current.frames = 1;
+
+	// rows are formatted here and written by the log thread, one slot per row so a dropped one never
+	// leaves half a row; the header is longer than a slot and goes out in pieces
+	char row[LOG_MESSAGE_SIZE];
+	if(!traceChecked)
+	{
+		traceChecked = true;
+		const char* path = getenv("BENT_VK_TRACE");
+		if(path != nullptr)
+		{
+			traceFile = logOpenFile(path);
+			if(traceFile < 0) LOG_WARN("Couldn't open Vulkan call trace %s\n", path);
+			else
+			{
+				logWriteFile(traceFile, "frame,frame_ms,calls,recorded_draws,recorded_bind_changes,recorded_redundant," \
+					"submitted_draws,submitted_bind_changes,submitted_redundant");
+				size_t used = 0;
+				for(uint32_t call = 0; call < VKD_CALL_COUNT; call++) used = appendf(row, sizeof(row), used, ",%s", callNames[call]);
+				logWriteFile(traceFile, "%s", row);
+				used = 0;
+				for(uint32_t call = 0; call < VKD_CALL_COUNT; call++)
+					if(vkdCallTimed(call)) used = appendf(row, sizeof(row), used, ",%s_ms", callNames[call]);
+				logWriteFile(traceFile, "%s\n", row);
+				LOG_INFO("Tracing Vulkan calls per frame to %s\n", path);
+			}
+		}
+	}
+	if(traceFile >= 0)
+	{
+		size_t used = appendf(row, sizeof(row), 0, "%llu,%.3f,%llu,%llu,%llu,%llu,%llu,%llu,%llu", \
+			(unsigned long long)frameNumber, frameMilliseconds, (unsigned long long)current.calls, \
+			(unsigned long long)current.recorded.draws, (unsigned long long)current.recorded.bindChanges, \
+			(unsigned long long)current.recorded.redundantSets, (unsigned long long)current.submitted.draws, \
+			(unsigned long long)current.submitted.bindChanges, (unsigned long long)current.submitted.redundantSets);
+		for(uint32_t call = 0; call < VKD_CALL_COUNT; call++)
+			used = appendf(row, sizeof(row), used, ",%llu", (unsigned long long)current.callCounts[call]);
+		for(uint32_t call = 0; call < VKD_CALL_COUNT; call++)
+			if(vkdCallTimed(call)) used = appendf(row, sizeof(row), used, ",%.3f", current.callMilliseconds[call]);
+		logWriteFile(traceFile, "%s\n", row);
+	}
+
+	period.frames += current.frames;
+	period.calls += current.calls;
+	period.recorded.draws += current.recorded.draws;
+	period.recorded.bindChanges += current.recorded.bindChanges;
+	period.recorded.redundantSets += current.recorded.redundantSets;
+	period.submitted.draws += current.submitted.draws;
+	period.submitted.bindChanges += current.submitted.bindChanges;
+	period.submitted.redundantSets += current.submitted.redundantSets;
+	for(uint32_t call = 0; call < VKD_CALL_COUNT; call++)
+	{
+		period.callCounts[call] += current.callCounts[call];
+		period.callMilliseconds[call] += current.callMilliseconds[call];
+	}
+	current = VkdFrameStats{};
+	frameNumber++;
+}
+
+VkdFrameStats DeviceDispatch::takeStats()
+{
+	VkdFrameStats stats = period;
+	period = VkdFrameStats{};
+	return stats;
+}
@@ -0,0 +1,498 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Device level entry points used while rendering, fetched once with
+// vkGetDeviceProcAddr so the calls skip the loader trampoline. Each wrapper
+// counts itself; binds and state sets are compared against what the command
+// buffer being recorded already has, so a frame reports how many of them
+// changed state and how many were redundant. Acquire, submit, present, waits
+// and command buffer begin/end are timed. frameDone() closes a frame: its
+// numbers add up for the periodic report and, with BENT_VK_TRACE=<file>, go
+// out as one CSV row next to the frame time, written by the log thread.
+// Command buffers may be recorded on several threads at once: the bound state
+// and the counts are kept per thread. Each thread only adds to its own
+// counters, which are atomics frameDone() reads at any time; a job that is
+// still recording shows up in the next frame.
+// Draws and binds are counted twice: as recorded this frame, and as held by
+// the command buffers submitted this frame. Prerecorded command buffers only
+// show up in the second, every frame they are submitted.
+
+#define VKD_PUSH_CONSTANT_BYTES 128 // compared for redundant pushes, the guaranteed minimum
+
+enum VkdCall
+{
+	VKD_ACQUIRE_NEXT_IMAGE,
+	VKD_QUEUE_SUBMIT,
+	VKD_QUEUE_PRESENT,
+	VKD_WAIT_SEMAPHORES,
+	VKD_WAIT_FOR_FENCES,
+	VKD_BEGIN_COMMAND_BUFFER,
+	VKD_END_COMMAND_BUFFER,
+	VKD_CMD_BEGIN_RENDER_PASS,
+	VKD_CMD_END_RENDER_PASS,
+	VKD_CMD_BEGIN_RENDERING,
+	VKD_CMD_END_RENDERING,
+	VKD_CMD_PIPELINE_BARRIER,
+	VKD_CMD_BIND_PIPELINE,
+	VKD_CMD_BIND_VERTEX_BUFFERS,
+	VKD_CMD_BIND_INDEX_BUFFER,
+	VKD_CMD_BIND_DESCRIPTOR_SETS,
+	VKD_CMD_PUSH_CONSTANTS,
+	VKD_CMD_SET_VIEWPORT,
+	VKD_CMD_SET_SCISSOR,
+	VKD_CMD_DRAW,
+	VKD_CMD_DRAW_INDEXED,
+	VKD_CMD_DRAW_INDEXED_INDIRECT,
+	VKD_CMD_DISPATCH,
+	VKD_CMD_FILL_BUFFER,
+	VKD_CMD_COPY_IMAGE_TO_BUFFER,
+	VKD_CMD_COPY_BUFFER_TO_IMAGE,
+	VKD_CMD_COPY_IMAGE,
+	VKD_CMD_BLIT_IMAGE,
+	VKD_CALL_COUNT,
+};
+
+const char* vkdCallName(uint32_t call);
+// acquire through command buffer begin/end block the CPU or can be slow in drivers
+inline bool vkdCallTimed(uint32_t call) { return call <= VKD_END_COMMAND_BUFFER; }
+
+// what went into a command buffer
+struct VkdCommandCounts
+{
+	uint64_t draws;             // draws and dispatches
+	uint64_t bindChanges;       // binds and state sets that changed the command buffer's state
+	uint64_t redundantSets;     // binds and state sets repeating it
+};
+
+struct VkdFrameStats
+{
+	uint64_t frames;
+	uint64_t calls;
+	VkdCommandCounts recorded;  // recorded this frame, on any thread
+	VkdCommandCounts submitted; // in the command buffers submitted this frame, as last recorded
+	uint64_t callCounts[VKD_CALL_COUNT];
+	double callMilliseconds[VKD_CALL_COUNT]; // timed calls only
+};
+
+// written by one thread only, so an add is a relaxed load and store instead of a locked
+// read-modify-write; any thread may read it
+template<typename T> struct VkdCounter
+{
+	std::atomic<T> value{ 0 };
+	void add(T n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+	T get() const { return value.load(std::memory_order_relaxed); }
+};
+
+class DeviceDispatch
+{
+	public:
+		void init(VkDevice device);
+		// with dynamic rendering from core 1.3 or the KHR extension
+		bool hasDynamicRendering() const { return beginRendering && endRendering; }
+		// vkWaitSemaphores from core 1.2 or the KHR timeline extension
+		bool hasTimelineWaits() const { return waitSemaphoresFn != nullptr; }
+		// ends the current frame; opens the CSV trace first time round if BENT_VK_TRACE is set,
+		// the logger closes it in logStop
+		void frameDone();
+		// totals since the last call, for periodic reports
+		VkdFrameStats takeStats();
+
+		VkResult acquireNextImage(VkDevice device, VkSwapchainKHR swapChain, uint64_t timeout, VkSemaphore semaphore, \
+			VkFence fence, uint32_t* imageIndex)
+		{
+			Timer timer(this, VKD_ACQUIRE_NEXT_IMAGE);
+			return acquireNextImageKHR(device, swapChain, timeout, semaphore, fence, imageIndex);
+		}
+		VkResult queueSubmit(VkQueue queue, uint32_t count, const VkSubmitInfo* submits, VkFence fence)
+		{
+			Timer timer(this, VKD_QUEUE_SUBMIT);
+			countSubmitted(count, submits);
+			return queueSubmitFn(queue, count, submits, fence);
+		}
+		VkResult queuePresent(VkQueue queue, const VkPresentInfoKHR* presentInfo)
+		{
+			Timer timer(this, VKD_QUEUE_PRESENT);
+			return queuePresentKHR(queue, presentInfo);
+		}
+		VkResult waitSemaphores(VkDevice device, const VkSemaphoreWaitInfo* waitInfo, uint64_t timeout)
+		{
+			Timer timer(this, VKD_WAIT_SEMAPHORES);
+			return waitSemaphoresFn(device, waitInfo, timeout);
+		}
+		VkResult waitForFences(VkDevice device, uint32_t count, const VkFence* fences, VkBool32 waitAll, uint64_t timeout)
+		{
+			Timer timer(this, VKD_WAIT_FOR_FENCES);
+			return waitForFencesFn(device, count, fences, waitAll, timeout);
+		}
+		VkResult beginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* beginInfo)
+		{
+			Timer timer(this, VKD_BEGIN_COMMAND_BUFFER);
+			CommandState& state = threadState();
+			state = CommandState{};
+			state.commandBuffer = commandBuffer;
+			Recording& recording = threadRecording();
+			recording.commandBuffer = commandBuffer;
+			recording.oneTime = (beginInfo->flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != 0;
+			recording.start = commandCounts();
+			return beginCommandBufferFn(commandBuffer, beginInfo);
+		}
+		VkResult endCommandBuffer(VkCommandBuffer commandBuffer)
+		{
+			Timer timer(this, VKD_END_COMMAND_BUFFER);
+			recordingDone(commandBuffer);
+			return endCommandBufferFn(commandBuffer);
+		}
+
+		void cmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* beginInfo, VkSubpassContents contents)
+		{
+			count(VKD_CMD_BEGIN_RENDER_PASS);
+			cmdBeginRenderPassFn(commandBuffer, beginInfo, contents);
+		}
+		void cmdEndRenderPass(VkCommandBuffer commandBuffer)
+		{
+			count(VKD_CMD_END_RENDER_PASS);
+			cmdEndRenderPassFn(commandBuffer);
+		}
+		void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfo* renderingInfo)
+		{
+			count(VKD_CMD_BEGIN_RENDERING);
+			beginRendering(commandBuffer, renderingInfo);
+		}
+		void cmdEndRendering(VkCommandBuffer commandBuffer)
+		{
+			count(VKD_CMD_END_RENDERING);
+			endRendering(commandBuffer);
+		}
+		void cmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, \
+			VkDependencyFlags flags, uint32_t memoryBarrierCount, const VkMemoryBarrier* memoryBarriers, \
+			uint32_t bufferBarrierCount, const VkBufferMemoryBarrier* bufferBarriers, \
+			uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers)
+		{
+			count(VKD_CMD_PIPELINE_BARRIER);
+			cmdPipelineBarrierFn(commandBuffer, srcStage, dstStage, flags, memoryBarrierCount, memoryBarriers, \
+				bufferBarrierCount, bufferBarriers, imageBarrierCount, imageBarriers);
+		}
+
+		void cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+		{
+			count(VKD_CMD_BIND_PIPELINE);
+			CommandState& s = track(commandBuffer);
+			VkPipeline& bound = bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? s.computePipeline : s.graphicsPipeline;
+			changed(bound != pipeline);
+			bound = pipeline;
+			cmdBindPipelineFn(commandBuffer, bindPoint, pipeline);
+		}
+		void cmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, \
+			const VkBuffer* buffers, const VkDeviceSize* offsets)
+		{
+			count(VKD_CMD_BIND_VERTEX_BUFFERS);
+			CommandState& s = track(commandBuffer);
+			// only binding 0 is tracked, the renderer uses no other
+			bool same = firstBinding == 0 && bindingCount == 1 && s.vertexBuffer == buffers[0] && s.vertexOffset == offsets[0];
+			changed(!same);
+			if(firstBinding == 0)
+			{
+				s.vertexBuffer = buffers[0];
+				s.vertexOffset = offsets[0];
+			}
+			cmdBindVertexBuffersFn(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+		}
+		void cmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+		{
+			count(VKD_CMD_BIND_INDEX_BUFFER);
+			CommandState& s = track(commandBuffer);
+			changed(s.indexBuffer != buffer || s.indexOffset != offset || s.indexType != indexType);
+			s.indexBuffer = buffer;
+			s.indexOffset = offset;
+			s.indexType = indexType;
+			cmdBindIndexBufferFn(commandBuffer, buffer, offset, indexType);
+		}
+		void cmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, \
+			uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+		{
+			count(VKD_CMD_BIND_DESCRIPTOR_SETS);
+			CommandState& s = track(commandBuffer);
+			// set 0 without dynamic offsets is tracked
+			bool same = firstSet == 0 && setCount == 1 && dynamicOffsetCount == 0 && s.setLayout == layout && s.set == sets[0];
+			changed(!same);
+			if(firstSet == 0)
+			{
+				s.setLayout = layout;
+				s.set = sets[0];
+			}
+			cmdBindDescriptorSetsFn(commandBuffer, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+		}
+		void cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stages, \
+			uint32_t offset, uint32_t size, const void* values)
+		{
+			count(VKD_CMD_PUSH_CONSTANTS);
+			CommandState& s = track(commandBuffer);
+			uint32_t end = offset + size;
+			if(end <= VKD_PUSH_CONSTANT_BYTES)
+			{
+				// [pushBegin, pushEnd) holds the bytes known to be pushed for this layout and stages
+				bool sameLayout = s.pushLayout == layout && s.pushStages == stages;
+				changed(!(sameLayout && offset >= s.pushBegin && end <= s.pushEnd && \
+					memcmp(s.pushBytes + offset, values, size) == 0));
+				if(sameLayout && offset <= s.pushEnd && end >= s.pushBegin)
+				{
+					s.pushBegin = std::min(s.pushBegin, offset);
+					s.pushEnd = std::max(s.pushEnd, end);
+				}
+				else
+				{
+					s.pushBegin = offset;
+					s.pushEnd = end;
+				}
+				memcpy(s.pushBytes + offset, values, size);
+				s.pushLayout = layout;
+				s.pushStages = stages;
+			}
+			else changed(true);
+			cmdPushConstantsFn(commandBuffer, layout, stages, offset, size, values);
+		}
+		void cmdSetViewport(VkCommandBuffer commandBuffer, uint32_t first, uint32_t viewportCount, const VkViewport* viewports)
+		{
+			count(VKD_CMD_SET_VIEWPORT);
+			CommandState& s = track(commandBuffer);
+			bool same = first == 0 && viewportCount == 1 && s.viewportValid && memcmp(&s.viewport, viewports, sizeof(VkViewport)) == 0;
+			changed(!same);
+			if(first == 0)
+			{
+				s.viewport = viewports[0];
+				s.viewportValid = true;
+			}
+			cmdSetViewportFn(commandBuffer, first, viewportCount, viewports);
+		}
+		void cmdSetScissor(VkCommandBuffer commandBuffer, uint32_t first, uint32_t scissorCount, const VkRect2D* scissors)
+		{
+			count(VKD_CMD_SET_SCISSOR);
+			CommandState& s = track(commandBuffer);
+			bool same = first == 0 && scissorCount == 1 && s.scissorValid && memcmp(&s.scissor, scissors, sizeof(VkRect2D)) == 0;
+			changed(!same);
+			if(first == 0)
+			{
+				s.scissor = scissors[0];
+				s.scissorValid = true;
+			}
+			cmdSetScissorFn(commandBuffer, first, scissorCount, scissors);
+		}
+
+		void cmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+		{
+			count(VKD_CMD_DRAW);
+			stats().draws.add(1);
+			cmdDrawFn(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		}
+		void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, \
+			int32_t vertexOffset, uint32_t firstInstance)
+		{
+			count(VKD_CMD_DRAW_INDEXED);
+			stats().draws.add(1);
+			cmdDrawIndexedFn(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		}
+		void cmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, \
+			uint32_t stride)
+		{
+			count(VKD_CMD_DRAW_INDEXED_INDIRECT);
+			stats().draws.add(1);
+			cmdDrawIndexedIndirectFn(commandBuffer, buffer, offset, drawCount, stride);
+		}
+		void cmdDispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z)
+		{
+			count(VKD_CMD_DISPATCH);
+			stats().draws.add(1);
+			cmdDispatchFn(commandBuffer, x, y, z);
+		}
+		void cmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data)
+		{
+			count(VKD_CMD_FILL_BUFFER);
+			cmdFillBufferFn(commandBuffer, buffer, offset, size, data);
+		}
+		void cmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout, VkBuffer buffer, \
+			uint32_t regionCount, const VkBufferImageCopy* regions)
+		{
+			count(VKD_CMD_COPY_IMAGE_TO_BUFFER);
+			cmdCopyImageToBufferFn(commandBuffer, image, layout, buffer, regionCount, regions);
+		}
+		void cmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, VkImageLayout layout, \
+			uint32_t regionCount, const VkBufferImageCopy* regions)
+		{
+			count(VKD_CMD_COPY_BUFFER_TO_IMAGE);
+			cmdCopyBufferToImageFn(commandBuffer, buffer, image, layout, regionCount, regions);
+		}
+		void cmdCopyImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, \
+			VkImageLayout dstLayout, uint32_t regionCount, const VkImageCopy* regions)
+		{
+			count(VKD_CMD_COPY_IMAGE);
+			cmdCopyImageFn(commandBuffer, srcImage, srcLayout, dstImage, dstLayout, regionCount, regions);
+		}
+		void cmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, \
+			VkImageLayout dstLayout, uint32_t regionCount, const VkImageBlit* regions, VkFilter filter)
+		{
+			count(VKD_CMD_BLIT_IMAGE);
+			cmdBlitImageFn(commandBuffer, srcImage, srcLayout, dstImage, dstLayout, regionCount, regions, filter);
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+		struct Timer
+		{
+			DeviceDispatch* dispatch;
+			uint32_t call;
+			Clock::time_point start;
+			Timer(DeviceDispatch* dispatch, uint32_t call) : dispatch(dispatch), call(call), start(Clock::now())
+			{
+				dispatch->count(call);
+			}
+			~Timer()
+			{
+				dispatch->stats().callMilliseconds[call].add( \
+					std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+		};
+		// what the command buffer this thread records has bound, reset when it moves on to another one
+		struct CommandState
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+			VkPipeline computePipeline = VK_NULL_HANDLE;
+			VkBuffer vertexBuffer = VK_NULL_HANDLE;
+			VkDeviceSize vertexOffset = 0;
+			VkBuffer indexBuffer = VK_NULL_HANDLE;
+			VkDeviceSize indexOffset = 0;
+			VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+			VkPipelineLayout setLayout = VK_NULL_HANDLE;
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			VkPipelineLayout pushLayout = VK_NULL_HANDLE;
+			VkShaderStageFlags pushStages = 0;
+			uint32_t pushBegin = 0, pushEnd = 0;
+			uint8_t pushBytes[VKD_PUSH_CONSTANT_BYTES];
+			VkViewport viewport;
+			bool viewportValid = false;
+			VkRect2D scissor;
+			bool scissorValid = false;
+		};
+
+		static CommandState& threadState()
+		{
+			static thread_local CommandState state;
+			return state;
+		}
+		// this thread's running totals; taken is what frameDone has already added up, under threadsLock
+		struct ThreadCounters
+		{
+			VkdCounter<uint64_t> calls, draws, bindChanges, redundantSets;
+			VkdCounter<uint64_t> callCounts[VKD_CALL_COUNT];
+			VkdCounter<double> callMilliseconds[VKD_CALL_COUNT];
+			VkdFrameStats taken{};
+		};
+		ThreadCounters& stats()
+		{
+			static thread_local ThreadCounters* own = nullptr;
+			if(own == nullptr) own = registerThread();
+			return *own;
+		}
+		ThreadCounters* registerThread();
+		void count(uint32_t call)
+		{
+			ThreadCounters& s = stats();
+			s.calls.add(1);
+			s.callCounts[call].add(1);
+		}
+		void changed(bool change)
+		{
+			if(change) stats().bindChanges.add(1);
+			else stats().redundantSets.add(1);
+		}
+		// the command buffer this thread is recording, and its counts when recording began
+		struct Recording
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			bool oneTime = false;
+			VkdCommandCounts start{};
+		};
+		static Recording& threadRecording()
+		{
+			static thread_local Recording recording;
+			return recording;
+		}
+		VkdCommandCounts commandCounts()
+		{
+			ThreadCounters& s = stats();
+			return { s.draws.get(), s.bindChanges.get(), s.redundantSets.get() };
+		}
+		void recordingDone(VkCommandBuffer commandBuffer);
+		void countSubmitted(uint32_t count, const VkSubmitInfo* submits);
+		CommandState& track(VkCommandBuffer commandBuffer)
+		{
+			CommandState& state = threadState();
+			if(state.commandBuffer != commandBuffer)
+			{
+				state = CommandState{};
+				state.commandBuffer = commandBuffer;
+			}
+			return state;
+		}
+
+		std::mutex threadsLock;
+		std::vector<std::unique_ptr<ThreadCounters>> threadStats; // one per thread that made a call
+		// what each command buffer held when it was last recorded; one time submit ones are dropped once submitted
+		struct RecordedCommands
+		{
+			VkdCommandCounts counts;
+			bool oneTime;
+		};
+		std::mutex recordedLock;
+		std::unordered_map<VkCommandBuffer, RecordedCommands> recordedCommands;
+		VkdCommandCounts submittedCounts{};  // since the last frameDone, under recordedLock
+		VkdFrameStats current{};    // this frame, summed over threads in frameDone
+		VkdFrameStats period{};     // frames since takeStats
+		Clock::time_point lastFrame;
+		uint64_t frameNumber = 0;
+		int traceFile = -1;         // logOpenFile output
+		bool traceChecked = false;
+
+		PFN_vkAcquireNextImageKHR acquireNextImageKHR = nullptr;
+		PFN_vkQueueSubmit queueSubmitFn = nullptr;
+		PFN_vkQueuePresentKHR queuePresentKHR = nullptr;
+		PFN_vkWaitSemaphores waitSemaphoresFn = nullptr;
+		PFN_vkWaitForFences waitForFencesFn = nullptr;
+		PFN_vkBeginCommandBuffer beginCommandBufferFn = nullptr;
+		PFN_vkEndCommandBuffer endCommandBufferFn = nullptr;
+		PFN_vkCmdBeginRenderPass cmdBeginRenderPassFn = nullptr;
+		PFN_vkCmdEndRenderPass cmdEndRenderPassFn = nullptr;
+		PFN_vkCmdBeginRendering beginRendering = nullptr;
+		PFN_vkCmdEndRendering endRendering = nullptr;
+		PFN_vkCmdPipelineBarrier cmdPipelineBarrierFn = nullptr;
+		PFN_vkCmdBindPipeline cmdBindPipelineFn = nullptr;
+		PFN_vkCmdBindVertexBuffers cmdBindVertexBuffersFn = nullptr;
+		PFN_vkCmdBindIndexBuffer cmdBindIndexBufferFn = nullptr;
+		PFN_vkCmdBindDescriptorSets cmdBindDescriptorSetsFn = nullptr;
+		PFN_vkCmdPushConstants cmdPushConstantsFn = nullptr;
+		PFN_vkCmdSetViewport cmdSetViewportFn = nullptr;
+		PFN_vkCmdSetScissor cmdSetScissorFn = nullptr;
+		PFN_vkCmdDraw cmdDrawFn = nullptr;
+		PFN_vkCmdDrawIndexed cmdDrawIndexedFn = nullptr;
+		PFN_vkCmdDrawIndexedIndirect cmdDrawIndexedIndirectFn = nullptr;
+		PFN_vkCmdDispatch cmdDispatchFn = nullptr;
+		PFN_vkCmdFillBuffer cmdFillBufferFn = nullptr;
+		PFN_vkCmdCopyImageToBuffer cmdCopyImageToBufferFn = nullptr;
+		PFN_vkCmdCopyBufferToImage cmdCopyBufferToImageFn = nullptr;
+		PFN_vkCmdCopyImage cmdCopyImageFn = nullptr;
+		PFN_vkCmdBlitImage cmdBlitImageFn = nullptr;
+};
+
+// the process renders with one device
+extern DeviceDispatch vkd;